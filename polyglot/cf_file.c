@@ -9,15 +9,57 @@
 #include "core/unordered_map.h"
 #include "polyglot/cf_file.h"
 
+#if POLYMEC_HAVE_MPI
+#include "mpi.h"
+#include "netcdf_par.h"
+#endif
+
 #if POLYMEC_HAVE_DOUBLE_PRECISION
 #define NC_REAL NC_DOUBLE
+#define nc_get_vara_real nc_get_vara_double
+#define nc_put_vara_real nc_put_vara_double
+#define nc_get_vars_real nc_get_vars_double
+#define nc_put_vars_real nc_put_vars_double
+#define nc_get_varm_real nc_get_varm_double
+#define nc_put_varm_real nc_put_varm_double
 #else
 #define NC_REAL NC_FLOAT
+#define nc_get_vara_real nc_get_vara_float
+#define nc_put_vara_real nc_put_vara_float
+#define nc_get_vars_real nc_get_vars_float
+#define nc_put_vars_real nc_put_vars_float
+#define nc_get_varm_real nc_get_varm_float
+#define nc_put_varm_real nc_put_varm_float
 #endif
 
+// Metadata for a variable defined on the lat-lon grid, cached when the 
+// variable is defined or found so that reads and writes need no queries.
+typedef struct
+{
+  int id;              // NetCDF variable ID.
+  bool time_dependent; // True if the first dimension is time.
+  bool surface;        // True for (2D) surface variables.
+  size_t count[4];     // Shape of the variable at a single time.
+  bool packed;         // True if stored scaled and offset.
+  nc_type type;        // Type of the stored values, if packed.
+  real_t scale_factor, add_offset; // Packing parameters.
+
+  // Stored values that mark missing data (read as NaN), and the stored 
+  // value to which NaNs are written.
+  bool has_fill, has_missing;
+  double fill_value, missing_value, nan_value;
+
+  // The range of stored values to which packed values are clamped.
+  double min_packed, max_packed;
+} cf_var_t;
+
 struct cf_file_t 
 {
   int file_id;
+  MPI_Comm comm;
+  int rank, nprocs;
+  bool parallel;   // True if the file was opened for parallel access.
+  bool collective; // True if variables use collective access.
   int cf_major_version, cf_minor_version, cf_patch_version;
   bool writing;
 
@@ -25,12 +67,38 @@ struct cf_file_t
   int time_id, time_dim, lat_id, lat_dim, lon_id, lon_dim, lev_id, lev_dim;
   char lev_name[POLYGLOT_CF_MAX_NAME+1];
 
-  // Lat-lon variable metadata/indices.
-  int nlat, nlon, nlev;
-  string_int_unordered_map_t *ll_vars, *td_ll_vars;
-  string_int_unordered_map_t *ll_surface_vars, *td_ll_surface_vars;
+  // Lengths of the lat-lon grid dimensions and the time series.
+  int nlat, nlon, nlev, ntimes;
+
+  // Lat-lon variable (and surface variable) metadata, by name.
+  string_ptr_unordered_map_t* vars;
+
+  // Unstructured (UGRID) mesh: dimensions, variables, global sizes, and 
+  // this process's portion of the mesh (its first node and cell, or the 
+  // global indices of its nodes).
+  char mesh_name[POLYGLOT_CF_MAX_NAME+1];
+  int mesh_id, node_dim, face_dim, cell_dim;
+  int face_nodes_dim, cell_nodes_dim, cell_faces_dim;
+  int node_x_id, node_y_id, node_z_id;
+  int face_nodes_id, cell_nodes_id, cell_faces_id, cell_shapes_id;
+  int num_mesh_nodes, num_mesh_faces, num_mesh_cells;
+  int max_face_nodes, max_cell_nodes, max_cell_faces;
+  int first_local_node, first_local_cell;
+  int num_local_nodes, num_local_cells;
+  int* local_node_ids;
+
+  // Mesh variable metadata, by name.
+  string_ptr_unordered_map_t* mesh_vars;
 };
 
+// Metadata for a variable defined on an unstructured mesh.
+typedef struct
+{
+  int id;
+  bool time_dependent;
+  cf_mesh_location_t location;
+} cf_mesh_var_t;
+
 // Helpers.
 static void get_first_attribute(int file_id, 
                                 int var_id, 
@@ -96,39 +164,378 @@ static int var_identifier(int file_id, const char* var_name)
     return id;
 }
 
-static void find_vertical_coordinate(int file_id, int* lev_id, int* lev_dim, char* lev_name)
+// Sets the parallel access mode (collective or independent) for the given 
+// variable, if the file is open for parallel access.
+static void set_par_access(cf_file_t* file, int var_id)
 {
-  // This name should identify a dimension AND a variable, and the variable should 
-  // have a "units" attribute, and a "positive" attribute (OR have a valid 
-  // set of pressure units).
-  int nvarsp;
-  int err = nc_inq(file_id, NULL, &nvarsp, NULL, NULL);
+#if POLYMEC_HAVE_MPI
+  if (file->parallel)
+  {
+    int err = nc_var_par_access(file->file_id, var_id, 
+                                (file->collective) ? NC_COLLECTIVE : NC_INDEPENDENT);
+    if (err != NC_NOERR)
+      polymec_error("cf_file: Error setting parallel access for var %d: %s", var_id, nc_strerror(err));
+  }
+#endif
+}
+
+// Caches metadata for the given lat-lon variable, returning it.
+static cf_var_t* add_var(cf_file_t* file, 
+                         const char* var_name, 
+                         int var_id,
+                         bool time_dependent,
+                         bool surface)
+{
+  cf_var_t* var = polymec_malloc(sizeof(cf_var_t));
+  var->id = var_id;
+  var->time_dependent = time_dependent;
+  var->surface = surface;
+  var->packed = false;
+  var->type = NC_REAL;
+  var->scale_factor = 1.0;
+  var->add_offset = 0.0;
+  var->has_fill = var->has_missing = false;
+  int d = 0;
+  if (time_dependent)
+    var->count[d++] = 1;
+  if (!surface)
+    var->count[d++] = (size_t)file->nlev;
+  var->count[d++] = (size_t)file->nlat;
+  var->count[d++] = (size_t)file->nlon;
+  string_ptr_unordered_map_insert_with_kv_dtors(file->vars, string_dup(var_name), var, 
+                                                string_free, polymec_free);
+  set_par_access(file, var_id);
+  return var;
+}
+
+// Returns the cached metadata for the given lat-lon variable, or NULL if 
+// there's no such variable.
+static cf_var_t* get_var(cf_file_t* file, const char* var_name)
+{
+  void** var_p = string_ptr_unordered_map_get(file->vars, (char*)var_name);
+  return (var_p != NULL) ? *var_p : NULL;
+}
+
+// Reads the given attribute of the given variable into *value, returning 
+// true if it exists and has a single value.
+static bool get_scalar_att(int file_id, int var_id, const char* name, double* value)
+{
+  size_t len;
+  if ((nc_inq_attlen(file_id, var_id, name, &len) != NC_NOERR) || (len != 1))
+    return false;
+  return (nc_get_att_double(file_id, var_id, name, value) == NC_NOERR);
+}
+
+// Sets the stored type of the given packed variable, along with the range to 
+// which packed values are clamped and the value to which NaNs are written. 
+// Integer values are kept clear of the most negative one, which is used as 
+// the fill value unless the variable has its own.
+static void set_packed_type(cf_var_t* var, nc_type type)
+{
+  var->type = type;
+  double fill_value;
+  if (type == NC_BYTE)
+  {
+    var->max_packed = 127.0;
+    fill_value = -128.0;
+  }
+  else if (type == NC_SHORT)
+  {
+    var->max_packed = 32767.0;
+    fill_value = -32768.0;
+  }
+  else if (type == NC_INT)
+  {
+    var->max_packed = 2147483647.0;
+    fill_value = -2147483648.0;
+  }
+  else
+  {
+    var->max_packed = HUGE_VAL;
+    fill_value = NAN;
+  }
+  var->min_packed = -var->max_packed;
+  if (var->has_fill)
+    var->nan_value = var->fill_value;
+  else if (var->has_missing)
+    var->nan_value = var->missing_value;
+  else
+    var->nan_value = fill_value;
+}
+
+// Reads the packing parameters and fill values for the given variable, if 
+// it has any.
+static void find_packing(cf_file_t* file, cf_var_t* var)
+{
+  double scale_factor = 1.0, add_offset = 0.0;
+  bool has_scale = get_scalar_att(file->file_id, var->id, "scale_factor", &scale_factor);
+  bool has_offset = get_scalar_att(file->file_id, var->id, "add_offset", &add_offset);
+  if (!has_scale && !has_offset) return;
+
+  nc_type type;
+  int err = nc_inq_vartype(file->file_id, var->id, &type);
+  if (err != NC_NOERR)
+    polymec_error("cf_file_open: Error retrieving type of var %d: %s", var->id, nc_strerror(err));
+  var->packed = true;
+  var->scale_factor = (real_t)scale_factor;
+  var->add_offset = (real_t)add_offset;
+  var->has_fill = get_scalar_att(file->file_id, var->id, "_FillValue", &var->fill_value);
+  var->has_missing = get_scalar_att(file->file_id, var->id, "missing_value", &var->missing_value);
+  set_packed_type(var, type);
+}
+
+// Returns the size of a stored value of the given packed variable, or 0 if 
+// its type isn't supported.
+static size_t packed_size(cf_var_t* var)
+{
+  switch (var->type)
+  {
+    case NC_BYTE: return sizeof(signed char);
+    case NC_SHORT: return sizeof(short);
+    case NC_INT: return sizeof(int);
+    case NC_FLOAT: 
+    case NC_DOUBLE: return sizeof(real_t);
+    default: return 0;
+  }
+}
+
+// Packs n values into the given buffer of stored values. NaNs are written 
+// as the variable's fill value, and other values are clamped to its range 
+// and rounded to the nearest integer (away from zero at halves) if it's 
+// stored as integers. NaNs and range limits are handled with selects 
+// rather than branches, so the loops have no control flow; compilers 
+// vectorize them when floating point comparisons may be assumed not to 
+// trap (e.g. -fno-trapping-math).
+#define PACK_INTEGERS(type) \
+{ \
+  type* p = packed; \
+  for (size_t i = 0; i < n; ++i) \
+  { \
+    double q = (values[i] - offset) * inv_scale; \
+    q = (q < min_packed) ? min_packed : q; \
+    q = (q > max_packed) ? max_packed : q; \
+    q += copysign(0.5, q); \
+    p[i] = (type)((values[i] != values[i]) ? nan_value : q); \
+  } \
+}
+
+static void pack_values(cf_var_t* var, 
+                        size_t n, 
+                        real_t* restrict values, 
+                        void* restrict packed)
+{
+  double inv_scale = 1.0 / var->scale_factor, offset = var->add_offset;
+  double min_packed = var->min_packed, max_packed = var->max_packed;
+  double nan_value = var->nan_value;
+  if (var->type == NC_BYTE)
+    PACK_INTEGERS(signed char)
+  else if (var->type == NC_SHORT)
+    PACK_INTEGERS(short)
+  else if (var->type == NC_INT)
+    PACK_INTEGERS(int)
+  else
+  {
+    real_t* p = packed;
+    for (size_t i = 0; i < n; ++i)
+    {
+      real_t q = (real_t)((values[i] - offset) * inv_scale);
+      p[i] = (values[i] != values[i]) ? (real_t)nan_value : q;
+    }
+  }
+}
+
+#undef PACK_INTEGERS
+
+// Unpacks n stored values into values. Whether the variable has fill or 
+// missing values is decided once, outside the loops, and values equal to 
+// them are replaced with NaN by a select, so these loops vectorize.
+#define UNPACK(type) \
+{ \
+  type* p = packed; \
+  if (!has_fill) \
+  { \
+    for (size_t i = 0; i < n; ++i) \
+      values[i] = scale_factor * p[i] + offset; \
+  } \
+  else \
+  { \
+    for (size_t i = 0; i < n; ++i) \
+    { \
+      real_t v = scale_factor * p[i] + offset; \
+      values[i] = ((p[i] == fill_value) | (p[i] == missing_value)) ? (real_t)NAN : v; \
+    } \
+  } \
+}
+
+static void unpack_values(cf_var_t* var, 
+                          size_t n, 
+                          void* restrict packed,
+                          real_t* restrict values)
+{
+  real_t scale_factor = var->scale_factor, offset = var->add_offset;
+  bool has_fill = (var->has_fill || var->has_missing);
+  double fill_value = (var->has_fill) ? var->fill_value : var->missing_value;
+  double missing_value = (var->has_missing) ? var->missing_value : fill_value;
+  if (var->type == NC_BYTE)
+    UNPACK(signed char)
+  else if (var->type == NC_SHORT)
+    UNPACK(short)
+  else if (var->type == NC_INT)
+    UNPACK(int)
+  else
+    UNPACK(real_t)
+}
+
+#undef UNPACK
+
+// If the given variable is packed, allocates a buffer of n stored values 
+// for a transfer of the given data, packing the data if we're writing. 
+// Returns NULL for unpacked variables.
+static void* begin_transfer(cf_var_t* var, bool writing, size_t n, real_t* data)
+{
+  if (!var->packed) return NULL;
+  size_t size = packed_size(var);
+  if (size == 0)
+    polymec_error("cf_file: Packed variables of type %d are not supported.", (int)var->type);
+  void* packed = polymec_malloc(size * MAX(n, 1));
+  if (writing)
+    pack_values(var, n, data, packed);
+  return packed;
+}
+
+// Finishes a transfer started with begin_transfer, unpacking the data if 
+// we're reading.
+static void end_transfer(cf_var_t* var, bool writing, size_t n, void* packed, real_t* data)
+{
+  if (packed == NULL) return;
+  if (!writing)
+    unpack_values(var, n, packed, data);
+  polymec_free(packed);
+}
+
+// Reads or writes a hyperslab of the given variable, starting at the given 
+// offset within data (or within packed, if it's not NULL). If stridep is 
+// NULL, the hyperslab is contiguous; if imapp is NULL, it's stored in 
+// order in data.
+static int transfer(cf_file_t* file, 
+                    cf_var_t* var, 
+                    bool writing,
+                    const size_t* startp,
+                    const size_t* countp,
+                    const ptrdiff_t* stridep,
+                    const ptrdiff_t* imapp,
+                    real_t* data,
+                    void* packed,
+                    size_t offset)
+{
+  int id = file->file_id;
+  if ((packed != NULL) && (var->type == NC_BYTE))
+  {
+    signed char* p = (signed char*)packed + offset;
+    if (stridep == NULL)
+      return (writing) ? nc_put_vara_schar(id, var->id, startp, countp, p)
+                       : nc_get_vara_schar(id, var->id, startp, countp, p);
+    else if (imapp == NULL)
+      return (writing) ? nc_put_vars_schar(id, var->id, startp, countp, stridep, p)
+                       : nc_get_vars_schar(id, var->id, startp, countp, stridep, p);
+    else
+      return (writing) ? nc_put_varm_schar(id, var->id, startp, countp, stridep, imapp, p)
+                       : nc_get_varm_schar(id, var->id, startp, countp, stridep, imapp, p);
+  }
+  else if ((packed != NULL) && (var->type == NC_SHORT))
+  {
+    short* p = (short*)packed + offset;
+    if (stridep == NULL)
+      return (writing) ? nc_put_vara_short(id, var->id, startp, countp, p)
+                       : nc_get_vara_short(id, var->id, startp, countp, p);
+    else if (imapp == NULL)
+      return (writing) ? nc_put_vars_short(id, var->id, startp, countp, stridep, p)
+                       : nc_get_vars_short(id, var->id, startp, countp, stridep, p);
+    else
+      return (writing) ? nc_put_varm_short(id, var->id, startp, countp, stridep, imapp, p)
+                       : nc_get_varm_short(id, var->id, startp, countp, stridep, imapp, p);
+  }
+  else if ((packed != NULL) && (var->type == NC_INT))
+  {
+    int* p = (int*)packed + offset;
+    if (stridep == NULL)
+      return (writing) ? nc_put_vara_int(id, var->id, startp, countp, p)
+                       : nc_get_vara_int(id, var->id, startp, countp, p);
+    else if (imapp == NULL)
+      return (writing) ? nc_put_vars_int(id, var->id, startp, countp, stridep, p)
+                       : nc_get_vars_int(id, var->id, startp, countp, stridep, p);
+    else
+      return (writing) ? nc_put_varm_int(id, var->id, startp, countp, stridep, imapp, p)
+                       : nc_get_varm_int(id, var->id, startp, countp, stridep, imapp, p);
+  }
+  else
+  {
+    // Packed floating point values are transferred like unpacked ones.
+    real_t* d = (packed != NULL) ? (real_t*)packed + offset : &data[offset];
+    if (stridep == NULL)
+      return (writing) ? nc_put_vara_real(id, var->id, startp, countp, d)
+                       : nc_get_vara_real(id, var->id, startp, countp, d);
+    else if (imapp == NULL)
+      return (writing) ? nc_put_vars_real(id, var->id, startp, countp, stridep, d)
+                       : nc_get_vars_real(id, var->id, startp, countp, stridep, d);
+    else
+      return (writing) ? nc_put_varm_real(id, var->id, startp, countp, stridep, imapp, d)
+                       : nc_get_varm_real(id, var->id, startp, countp, stridep, imapp, d);
+  }
+}
+
+// Metadata for each variable in a file, gathered in a single pass when the 
+// file is opened.
+typedef struct
+{
+  char name[NC_MAX_NAME+1];
+  int ndims;
+  int dim_ids[4]; // only valid for ndims <= 4.
+} nc_var_info_t;
+
+static nc_var_info_t* get_var_info(int file_id, int* num_vars)
+{
+  int err = nc_inq_nvars(file_id, num_vars);
   if (err != NC_NOERR)
-    polymec_error("cf_file_open: Error retrieving number of vars: ", nc_strerror(err));
-  for (int var_id = 0; var_id < nvarsp; ++var_id)
+    polymec_error("cf_file_open: Error retrieving number of vars: %s", nc_strerror(err));
+  nc_var_info_t* info = polymec_malloc(sizeof(nc_var_info_t) * MAX(*num_vars, 1));
+  for (int var_id = 0; var_id < *num_vars; ++var_id)
   {
-    // Find the name of this variable.
-    char var_name[POLYGLOT_CF_MAX_NAME+1];
-    err = nc_inq_varname(file_id, var_id, var_name);
+    err = nc_inq_var(file_id, var_id, info[var_id].name, NULL, &info[var_id].ndims, NULL, NULL);
     if (err != NC_NOERR)
-      polymec_error("cf_file_open: Error retrieving name of var %d: ", var_id, nc_strerror(err));
+      polymec_error("cf_file_open: Error retrieving var %d: %s", var_id, nc_strerror(err));
+    if (info[var_id].ndims <= 4)
+    {
+      err = nc_inq_vardimid(file_id, var_id, info[var_id].dim_ids);
+      if (err != NC_NOERR)
+        polymec_error("cf_file_open: Error retrieving dim IDs for var %d: %s", var_id, nc_strerror(err));
+    }
+  }
+  return info;
+}
 
+static void find_vertical_coordinate(int file_id, 
+                                     nc_var_info_t* vars,
+                                     int num_vars,
+                                     int* lev_id, 
+                                     int* lev_dim, 
+                                     char* lev_name)
+{
+  // This name should identify a dimension AND a variable, and the variable should 
+  // have a "units" attribute, and a "positive" attribute (OR have a valid 
+  // set of pressure units).
+  for (int var_id = 0; var_id < num_vars; ++var_id)
+  {
     // The vertical coordinate variable should have a single dimension.
-    int ndim;
-    err = nc_inq_varndims(file_id, var_id, &ndim);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_open: Error retrieving number of dims for var %d: ", var_id, nc_strerror(err));
-    if (ndim != 1) continue;
+    char* var_name = vars[var_id].name;
+    if (vars[var_id].ndims != 1) continue;
 
     // Find its dimension, and verify the dimensions's name is the same.
-    int dim_id;
+    int dim_id = vars[var_id].dim_ids[0];
     char dim_name[POLYGLOT_CF_MAX_NAME+1];
-    err = nc_inq_vardimid(file_id, var_id, &dim_id);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_open: Error retrieving dim ID for var %d: ", var_id, nc_strerror(err));
-    err = nc_inq_dimname(file_id, dim_id, dim_name);
+    int err = nc_inq_dimname(file_id, dim_id, dim_name);
     if (err != NC_NOERR)
-      polymec_error("cf_file_open: Error retrieving dim name for var %d: ", var_id, nc_strerror(err));
+      polymec_error("cf_file_open: Error retrieving dim name for var %d: %s", var_id, nc_strerror(err));
     if (strcmp(dim_name, var_name) != 0) continue;
 
     // If there's an axis attribute set equal to Z, this is it.
@@ -150,6 +557,7 @@ static void find_vertical_coordinate(int file_id, int* lev_id, int* lev_dim, cha
         (strcmp(standard_name, "height") == 0))
     {
       *lev_id = var_id;
+      *lev_dim = dim_id;
       strcpy(lev_name, var_name);
       return;
     }
@@ -166,6 +574,7 @@ static void find_vertical_coordinate(int file_id, int* lev_id, int* lev_dim, cha
          (string_casecmp(positive, "down") == 0)))
     {
       *lev_id = var_id;
+      *lev_dim = dim_id;
       strcpy(lev_name, var_name);
       return;
     }
@@ -183,6 +592,7 @@ static void find_vertical_coordinate(int file_id, int* lev_id, int* lev_dim, cha
          (strcmp(units, "hPa") == 0)))
     {
       *lev_id = var_id;
+      *lev_dim = dim_id;
       strcpy(lev_name, var_name);
       return;
     }
@@ -190,18 +600,169 @@ static void find_vertical_coordinate(int file_id, int* lev_id, int* lev_dim, cha
   polymec_error("Could not identify vertical coordinate from file metadata.");
 }
 
-// Implementation.
-
-cf_file_t* cf_file_new(const char* filename)
+// Returns the length of the given dimension.
+static int dimension_length(int file_id, int dim_id)
 {
-  int file_id;
-  int err = nc_create(filename, NC_CLOBBER | NC_NETCDF4, &file_id);
+  size_t len;
+  int err = nc_inq_dimlen(file_id, dim_id, &len);
   if (err != NC_NOERR)
-    polymec_error("cf_file_new: Couldn't open file %s: %s", filename, nc_strerror(err));
+    polymec_error("cf_file: Could not retrieve length of dimension %d: %s", dim_id, nc_strerror(err));
+  return (int)len;
+}
 
-  // Create our representation.
+// Creates a CF file object for the given NetCDF file and communicator, 
+// with nothing yet known about its contents.
+static cf_file_t* cf_file_alloc(MPI_Comm comm, int file_id, bool parallel)
+{
   cf_file_t* cf = polymec_malloc(sizeof(cf_file_t));
   cf->file_id = file_id;
+  cf->comm = comm;
+  MPI_Comm_rank(comm, &cf->rank);
+  MPI_Comm_size(comm, &cf->nprocs);
+  cf->parallel = parallel;
+  cf->collective = true;
+  cf->mesh_name[0] = '\0';
+  cf->mesh_id = -1;
+  cf->node_dim = cf->face_dim = cf->cell_dim = -1;
+  cf->face_nodes_dim = cf->cell_nodes_dim = cf->cell_faces_dim = -1;
+  cf->node_x_id = cf->node_y_id = cf->node_z_id = -1;
+  cf->face_nodes_id = cf->cell_nodes_id = cf->cell_faces_id = cf->cell_shapes_id = -1;
+  cf->num_mesh_nodes = cf->num_mesh_faces = cf->num_mesh_cells = 0;
+  cf->max_face_nodes = cf->max_cell_nodes = cf->max_cell_faces = 0;
+  cf->first_local_node = cf->first_local_cell = 0;
+  cf->num_local_nodes = cf->num_local_cells = 0;
+  cf->local_node_ids = NULL;
+  cf->mesh_vars = string_ptr_unordered_map_new();
+  return cf;
+}
+
+// Caches metadata for the given mesh variable.
+static void add_mesh_var(cf_file_t* file, 
+                         const char* var_name, 
+                         int var_id,
+                         bool time_dependent,
+                         cf_mesh_location_t location)
+{
+  cf_mesh_var_t* var = polymec_malloc(sizeof(cf_mesh_var_t));
+  var->id = var_id;
+  var->time_dependent = time_dependent;
+  var->location = location;
+  string_ptr_unordered_map_insert_with_kv_dtors(file->mesh_vars, string_dup(var_name), var, 
+                                                string_free, polymec_free);
+  set_par_access(file, var_id);
+}
+
+// Finds the (first) 3D UGRID mesh topology in the given file, along with 
+// the variables defined on it.
+static void find_mesh(cf_file_t* file, nc_var_info_t* vars, int num_vars)
+{
+  char value[POLYGLOT_CF_MAX_NAME+1];
+  for (int var_id = 0; var_id < num_vars; ++var_id)
+  {
+    get_first_attribute(file->file_id, var_id, "cf_role", value);
+    if (strcmp(value, "mesh_topology") != 0) continue;
+    int dim = 0;
+    if ((nc_get_att_int(file->file_id, var_id, "topology_dimension", &dim) != NC_NOERR) || (dim != 3))
+      continue;
+
+    file->mesh_id = var_id;
+    strcpy(file->mesh_name, vars[var_id].name);
+
+    // Node coordinates.
+    get_first_attribute(file->file_id, var_id, "node_coordinates", value);
+    int* coord_ids[3] = {&file->node_x_id, &file->node_y_id, &file->node_z_id};
+    char* saveptr;
+    char* coord = strtok_r(value, " ", &saveptr);
+    for (int d = 0; (d < 3) && (coord != NULL); ++d)
+    {
+      *coord_ids[d] = var_identifier(file->file_id, coord);
+      coord = strtok_r(NULL, " ", &saveptr);
+    }
+    if ((file->node_y_id == -1) || (file->node_z_id == -1))
+      file->node_x_id = -1;
+    if (file->node_x_id == -1)
+      polymec_error("cf_file_open: Mesh %s has invalid node coordinates.", file->mesh_name);
+    file->node_dim = vars[file->node_x_id].dim_ids[0];
+    file->num_mesh_nodes = dimension_length(file->file_id, file->node_dim);
+
+    // Connectivity.
+    get_first_attribute(file->file_id, var_id, "face_node_connectivity", value);
+    file->face_nodes_id = var_identifier(file->file_id, value);
+    get_first_attribute(file->file_id, var_id, "volume_node_connectivity", value);
+    file->cell_nodes_id = var_identifier(file->file_id, value);
+    get_first_attribute(file->file_id, var_id, "volume_face_connectivity", value);
+    file->cell_faces_id = var_identifier(file->file_id, value);
+    get_first_attribute(file->file_id, var_id, "volume_shape_type", value);
+    file->cell_shapes_id = var_identifier(file->file_id, value);
+    if ((file->face_nodes_id == -1) || (file->cell_nodes_id == -1) || 
+        (file->cell_faces_id == -1) || (file->cell_shapes_id == -1))
+      polymec_error("cf_file_open: Mesh %s has no face/volume connectivity.", file->mesh_name);
+    file->face_dim = vars[file->face_nodes_id].dim_ids[0];
+    file->face_nodes_dim = vars[file->face_nodes_id].dim_ids[1];
+    file->cell_dim = vars[file->cell_faces_id].dim_ids[0];
+    file->cell_nodes_dim = vars[file->cell_nodes_id].dim_ids[1];
+    file->cell_faces_dim = vars[file->cell_faces_id].dim_ids[1];
+    file->num_mesh_faces = dimension_length(file->file_id, file->face_dim);
+    file->num_mesh_cells = dimension_length(file->file_id, file->cell_dim);
+    file->max_face_nodes = dimension_length(file->file_id, file->face_nodes_dim);
+    file->max_cell_nodes = dimension_length(file->file_id, file->cell_nodes_dim);
+    file->max_cell_faces = dimension_length(file->file_id, file->cell_faces_dim);
+    set_par_access(file, file->node_x_id);
+    set_par_access(file, file->node_y_id);
+    set_par_access(file, file->node_z_id);
+    set_par_access(file, file->face_nodes_id);
+    set_par_access(file, file->cell_nodes_id);
+    set_par_access(file, file->cell_faces_id);
+    set_par_access(file, file->cell_shapes_id);
+    break;
+  }
+  if (file->mesh_id == -1) return;
+
+  // Variables on the mesh.
+  for (int var_id = 0; var_id < num_vars; ++var_id)
+  {
+    get_first_attribute(file->file_id, var_id, "mesh", value);
+    if (strcmp(value, file->mesh_name) != 0) continue;
+    int ndim = vars[var_id].ndims;
+    int* dim_ids = vars[var_id].dim_ids;
+    bool time_dependent = ((ndim == 2) && (dim_ids[0] == file->time_dim));
+    if ((ndim != 1) && !time_dependent) continue;
+    get_first_attribute(file->file_id, var_id, "location", value);
+    int dim = dim_ids[ndim-1];
+    if ((strcmp(value, "node") == 0) && (dim == file->node_dim))
+      add_mesh_var(file, vars[var_id].name, var_id, time_dependent, CF_MESH_NODE);
+    else if ((strcmp(value, "volume") == 0) && (dim == file->cell_dim))
+      add_mesh_var(file, vars[var_id].name, var_id, time_dependent, CF_MESH_CELL);
+  }
+}
+
+// Implementation.
+
+cf_file_t* cf_file_new(MPI_Comm comm, const char* filename)
+{
+  int file_id, err;
+  bool parallel = false;
+#if POLYMEC_HAVE_MPI
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  if (nprocs > 1)
+  {
+    err = nc_create_par(filename, NC_CLOBBER | NC_NETCDF4 | NC_MPIIO, 
+                        comm, MPI_INFO_NULL, &file_id);
+    if (err != NC_NOERR)
+      polymec_error("cf_file_new: Couldn't open file %s for parallel access: %s", filename, nc_strerror(err));
+    parallel = true;
+  }
+  else
+#endif
+  {
+    err = nc_create(filename, NC_CLOBBER | NC_NETCDF4, &file_id);
+    if (err != NC_NOERR)
+      polymec_error("cf_file_new: Couldn't open file %s: %s", filename, nc_strerror(err));
+  }
+
+  // Create our representation.
+  cf_file_t* cf = cf_file_alloc(comm, file_id, parallel);
   cf->cf_major_version = 1;
   cf->cf_minor_version = 6;
   cf->cf_patch_version = 0;
@@ -210,10 +771,8 @@ cf_file_t* cf_file_new(const char* filename)
   cf->time_dim = cf->lat_dim = cf->lon_dim = cf->lev_dim = -1;
   strcpy(cf->lev_name, "lev");
   cf->nlat = cf->nlon = cf->nlev = -1;
-  cf->ll_vars = string_int_unordered_map_new();
-  cf->td_ll_vars = string_int_unordered_map_new();
-  cf->ll_surface_vars = string_int_unordered_map_new();
-  cf->td_ll_surface_vars = string_int_unordered_map_new();
+  cf->ntimes = 0;
+  cf->vars = string_ptr_unordered_map_new();
 
   // Write in our conventions.
   char conventions[NC_MAX_NAME+1];
@@ -226,12 +785,28 @@ cf_file_t* cf_file_new(const char* filename)
   return cf;
 }
 
-cf_file_t* cf_file_open(const char* filename)
+cf_file_t* cf_file_open(MPI_Comm comm, const char* filename)
 {
-  int file_id;
-  int err = nc_open(filename, NC_NOWRITE, &file_id);
-  if (err != NC_NOERR)
-    polymec_error("cf_file_open: Couldn't open file %s: %s", filename, nc_strerror(err));
+  int file_id, err = NC_EINVAL;
+  bool parallel = false;
+#if POLYMEC_HAVE_MPI
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  if (nprocs > 1)
+  {
+    err = nc_open_par(filename, NC_NOWRITE | NC_MPIIO, comm, MPI_INFO_NULL, &file_id);
+    parallel = (err == NC_NOERR);
+  }
+#endif
+
+  // If we couldn't open the file for parallel access (e.g. it's not a 
+  // NetCDF4/HDF5 file), each process reads it on its own.
+  if (!parallel)
+  {
+    err = nc_open(filename, NC_NOWRITE, &file_id);
+    if (err != NC_NOERR)
+      polymec_error("cf_file_open: Couldn't open file %s: %s", filename, nc_strerror(err));
+  }
 
   char conventions[NC_MAX_NAME+1];
   get_first_global_attribute(file_id, "Conventions", conventions);
@@ -244,17 +819,14 @@ cf_file_t* cf_file_open(const char* filename)
   }
 
   // Create our representation.
-  cf_file_t* cf = polymec_malloc(sizeof(cf_file_t));
-  cf->file_id = file_id;
+  cf_file_t* cf = cf_file_alloc(comm, file_id, parallel);
   cf->cf_major_version = cf->cf_minor_version = cf->cf_patch_version = 0;
   cf->writing = false;
   cf->time_id = cf->lat_id = cf->lon_id = cf->lev_id = -1;
   cf->time_dim = cf->lat_dim = cf->lon_dim = cf->lev_dim = -1;
   cf->nlat = cf->nlon = cf->nlev = -1;
-  cf->ll_vars = string_int_unordered_map_new();
-  cf->td_ll_vars = string_int_unordered_map_new();
-  cf->ll_surface_vars = string_int_unordered_map_new();
-  cf->td_ll_surface_vars = string_int_unordered_map_new();
+  cf->ntimes = 0;
+  cf->vars = string_ptr_unordered_map_new();
 
   // Parse the CF conventions version numbers from the string.
   int num;
@@ -294,58 +866,55 @@ cf_file_t* cf_file_open(const char* filename)
   {
     cf->time_dim = dim_id;
     cf->time_id = var_identifier(cf->file_id, "time");
+    cf->ntimes = dimension_length(cf->file_id, cf->time_dim);
   }
   else if (err != NC_EBADDIM)
     polymec_error("cf_file_open: Error retrieving time dim ID: ", nc_strerror(err));
 
+  // Gather the metadata for all variables in one pass.
+  int num_vars;
+  nc_var_info_t* vars = get_var_info(cf->file_id, &num_vars);
+
   // If we've found a lat/lon grid, feel out the data related to it.
   if ((cf->lat_id != -1) && (cf->lon_id != -1))
   {
     // We have to figure out the vertical dimension / coordinate name and ID. 
-    find_vertical_coordinate(cf->file_id, &cf->lev_id, &cf->lev_dim, cf->lev_name);
+    find_vertical_coordinate(cf->file_id, vars, num_vars, 
+                             &cf->lev_id, &cf->lev_dim, cf->lev_name);
 
     // Get the dimensions of the lat/lon grid.
-    cf->nlat = cf_file_dimension(cf, "lat");
-    cf->nlon = cf_file_dimension(cf, "lon");
-    cf->nlev = cf_file_dimension(cf, cf->lev_name);
+    cf->nlat = dimension_length(cf->file_id, cf->lat_dim);
+    cf->nlon = dimension_length(cf->file_id, cf->lon_dim);
+    cf->nlev = dimension_length(cf->file_id, cf->lev_dim);
 
-    // Get all of the lat/lon variables we can find.
-    int nvarsp;
-    err = nc_inq(file_id, NULL, &nvarsp, NULL, NULL);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_open: Error retrieving number of vars: ", nc_strerror(err));
-    for (int var_id = 0; var_id < nvarsp; ++var_id)
+    // Classify the lat/lon variables by inspecting their dimensions.
+    for (int var_id = 0; var_id < num_vars; ++var_id)
     {
-      // Find the name of this variable.
-      char var_name[POLYGLOT_CF_MAX_NAME+1];
-      err = nc_inq_varname(file_id, var_id, var_name);
-      if (err != NC_NOERR)
-        polymec_error("cf_file_open: Error retrieving name of var %d: ", var_id, nc_strerror(err));
-
-      // The vertical coordinate variable should have a single dimension.
-      int ndim;
-      err = nc_inq_varndims(file_id, var_id, &ndim);
-      if (err != NC_NOERR)
-        polymec_error("cf_file_open: Error retrieving number of dims for var %d: ", var_id, nc_strerror(err));
-
-      // Find the dimension ids.
-      int dim_ids[ndim];
-      err = nc_inq_vardimid(file_id, var_id, dim_ids);
-      if (err != NC_NOERR)
-        polymec_error("cf_file_open: Error retrieving dim IDs for var %d: ", var_id, nc_strerror(err));
-
-      // Now we can determine the nature of the variable by inspecting its dimensions.
+      int ndim = vars[var_id].ndims;
+      int* dim_ids = vars[var_id].dim_ids;
+      char* var_name = vars[var_id].name;
       if ((ndim == 2) && (dim_ids[0] == cf->lat_dim) && (dim_ids[1] == cf->lon_dim))
-        string_int_unordered_map_insert_with_k_dtor(cf->ll_surface_vars, string_dup(var_name), var_id, string_free);
+        add_var(cf, var_name, var_id, false, true);
       else if ((ndim == 3) && (dim_ids[0] == cf->time_dim) && (dim_ids[1] == cf->lat_dim) && (dim_ids[2] == cf->lon_dim))
-        string_int_unordered_map_insert_with_k_dtor(cf->td_ll_surface_vars, string_dup(var_name), var_id, string_free);
+        add_var(cf, var_name, var_id, true, true);
       else if ((ndim == 3) && (dim_ids[0] == cf->lev_dim) && (dim_ids[1] == cf->lat_dim) && (dim_ids[2] == cf->lon_dim))
-        string_int_unordered_map_insert_with_k_dtor(cf->ll_vars, string_dup(var_name), var_id, string_free);
+        add_var(cf, var_name, var_id, false, false);
       else if ((ndim == 4) && (dim_ids[0] == cf->time_dim) && (dim_ids[1] == cf->lev_dim) && (dim_ids[2] == cf->lat_dim) && (dim_ids[3] == cf->lon_dim))
-        string_int_unordered_map_insert_with_k_dtor(cf->td_ll_vars, string_dup(var_name), var_id, string_free);
+        add_var(cf, var_name, var_id, true, false);
     }
+
+    // Find any packed variables.
+    int pos = 0;
+    char* var_name;
+    void* var;
+    while (string_ptr_unordered_map_next(cf->vars, &pos, &var_name, &var))
+      find_packing(cf, var);
   }
 
+  // Look for an unstructured mesh.
+  find_mesh(cf, vars, num_vars);
+  polymec_free(vars);
+
   return cf;
 }
 
@@ -354,10 +923,10 @@ void cf_file_close(cf_file_t* file)
   int err = nc_close(file->file_id);
   if (err != NC_NOERR)
     polymec_error("Error closing CF file.", nc_strerror(err));
-  string_int_unordered_map_free(file->ll_vars);
-  string_int_unordered_map_free(file->td_ll_vars);
-  string_int_unordered_map_free(file->ll_surface_vars);
-  string_int_unordered_map_free(file->td_ll_surface_vars);
+  string_ptr_unordered_map_free(file->vars);
+  string_ptr_unordered_map_free(file->mesh_vars);
+  if (file->local_node_ids != NULL)
+    polymec_free(file->local_node_ids);
   polymec_free(file);
 }
 
@@ -501,6 +1070,7 @@ void cf_file_define_latlon_grid(cf_file_t* file,
   err = nc_def_var(file->file_id, "lat", NC_REAL, 1, &file->lat_dim, &file->lat_id);
   if (err != NC_NOERR)
     polymec_error("cf_file_define_latlon_grid: Could not define lat variable: %s", nc_strerror(err));
+  set_par_access(file, file->lat_id);
   put_attribute(file->file_id, file->lat_id, "long_name", "latitude");
   put_attribute(file->file_id, file->lat_id, "standard_name", "latitude");
   put_attribute(file->file_id, file->lat_id, "units", latitude_units);
@@ -513,6 +1083,7 @@ void cf_file_define_latlon_grid(cf_file_t* file,
   err = nc_def_var(file->file_id, "lon", NC_REAL, 1, &file->lon_dim, &file->lon_id);
   if (err != NC_NOERR)
     polymec_error("cf_file_define_latlon_grid: Could not define lon variable: %s", nc_strerror(err));
+  set_par_access(file, file->lon_id);
   put_attribute(file->file_id, file->lon_id, "long_name", "longitude");
   put_attribute(file->file_id, file->lon_id, "standard_name", "longitude");
   put_attribute(file->file_id, file->lon_id, "units", longitude_units);
@@ -525,6 +1096,7 @@ void cf_file_define_latlon_grid(cf_file_t* file,
   err = nc_def_var(file->file_id, file->lev_name, NC_REAL, 1, &file->lev_dim, &file->lev_id);
   if (err != NC_NOERR)
     polymec_error("cf_file_define_latlon_grid: Could not define lev variable: %s", nc_strerror(err));
+  set_par_access(file, file->lev_id);
   put_attribute(file->file_id, file->lev_id, "units", vertical_units);
   put_attribute(file->file_id, file->lev_id, "positive", vertical_orientation);
   put_attribute(file->file_id, file->lev_id, "axis", "Z");
@@ -569,11 +1141,11 @@ void cf_file_get_latlon_grid_metadata(cf_file_t* file,
   get_first_attribute(file->file_id, file->lat_id, "units", latitude_units);
 
   // Longitude.
-  *num_latitude_points = file->nlon;
+  *num_longitude_points = file->nlon;
   get_first_attribute(file->file_id, file->lon_id, "units", longitude_units);
 
   // Vertical.
-  *num_latitude_points = file->nlev;
+  *num_vertical_points = file->nlev;
   get_first_attribute(file->file_id, file->lev_id, "units", vertical_units);
   get_first_attribute(file->file_id, file->lev_id, "positive", vertical_orientation);
 }
@@ -616,6 +1188,7 @@ void cf_file_define_time(cf_file_t* file,
   err = nc_def_var(file->file_id, "time", NC_REAL, 1, &file->time_dim, &file->time_id);
   if (err != NC_NOERR)
     polymec_error("cf_file_define_time: Error defining time var: %s", nc_strerror(err));
+  set_par_access(file, file->time_id);
 
   // Metadata.
   put_attribute(file->file_id, file->time_id, "long_name", "time");
@@ -639,28 +1212,27 @@ void cf_file_get_time_metadata(cf_file_t* file,
 }
 
 int cf_file_append_time(cf_file_t* file, real_t t)
+{
+  return cf_file_append_times(file, 1, &t);
+}
+
+int cf_file_append_times(cf_file_t* file, int num_times, real_t* times)
 {
   ASSERT(cf_file_has_time_series(file));
+  ASSERT(num_times > 0);
 
-  size_t size = (size_t)cf_file_num_times(file);
-  int err = nc_put_var1(file->file_id, file->time_id, &size, &t);
+  size_t startp = (size_t)file->ntimes, countp = (size_t)num_times;
+  int err = nc_put_vara_real(file->file_id, file->time_id, &startp, &countp, times);
   if (err != NC_NOERR)
-    polymec_error("cf_file_append_time: Error appending time t = %g: %s", t, nc_strerror(err));
+    polymec_error("cf_file_append_times: Error appending %d times: %s", num_times, nc_strerror(err));
+  file->ntimes += num_times;
 
-  return (int)size;
+  return (int)startp;
 }
 
 int cf_file_num_times(cf_file_t* file)
 {
-  if (!cf_file_has_time_series(file))
-    return 0;
-
-  // Find the size of the time series.
-  size_t size;
-  int err = nc_inq_dimlen(file->file_id, file->time_id, &size);
-  if (err != NC_NOERR)
-    polymec_error("cf_file_append_time: Error finding length of time series: %s", nc_strerror(err));
-  return (int)size;
+  return file->ntimes;
 }
 
 void cf_file_get_times(cf_file_t* file, real_t* times)
@@ -670,35 +1242,56 @@ void cf_file_get_times(cf_file_t* file, real_t* times)
     polymec_error("cf_file_get_times: Error retrieving times.");
 }
 
-void cf_file_define_latlon_var(cf_file_t* file, 
-                               const char* var_name,
-                               bool time_dependent,
-                               const char* short_name,
-                               const char* long_name,
-                               const char* units)
+// Defines a lat-lon variable with the given dimensions (excluding time), 
+// caching its metadata.
+static void define_var(cf_file_t* file, 
+                       const char* func_name,
+                       const char* var_name,
+                       bool time_dependent,
+                       bool surface,
+                       bool packed,
+                       real_t scale_factor,
+                       real_t add_offset,
+                       const char* short_name,
+                       const char* long_name,
+                       const char* units)
 {
-  ASSERT(cf_file_has_latlon_grid(file));
-  ASSERT(!cf_file_has_latlon_var(file, var_name));
-
-  // Define the variable and its dimensions based on whether we have a time 
-  // series.
-  int var_id;
+  int dims[4], ndims = 0;
   if (time_dependent)
   {
     ASSERT(cf_file_has_time_series(file));
-    int dims[4] = {file->time_dim, file->lev_dim, file->lat_dim, file->lon_dim};
-    int err = nc_def_var(file->file_id, var_name, NC_REAL, 4, dims, &var_id);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_define_latlon_var: Error defining var %s: %s", var_name, nc_strerror(err));
-    string_int_unordered_map_insert_with_k_dtor(file->td_ll_vars, string_dup(var_name), var_id, string_free);
+    dims[ndims++] = file->time_dim;
   }
-  else
+  if (!surface)
+    dims[ndims++] = file->lev_dim;
+  dims[ndims++] = file->lat_dim;
+  dims[ndims++] = file->lon_dim;
+
+  int var_id;
+  int err = nc_def_var(file->file_id, var_name, (packed) ? NC_SHORT : NC_REAL, 
+                       ndims, dims, &var_id);
+  if (err != NC_NOERR)
+    polymec_error("%s: Error defining var %s: %s", func_name, var_name, nc_strerror(err));
+  cf_var_t* var = add_var(file, var_name, var_id, time_dependent, surface);
+
+  // Packing parameters are stored with the type of the unpacked data.
+  if (packed)
   {
-    int dims[3] = {file->lev_dim, file->lat_dim, file->lon_dim};
-    int err = nc_def_var(file->file_id, var_name, NC_REAL, 3, dims, &var_id);
+    ASSERT(scale_factor != 0.0);
+    var->packed = true;
+    var->scale_factor = scale_factor;
+    var->add_offset = add_offset;
+    set_packed_type(var, NC_SHORT);
+    short fill_value = (short)var->nan_value;
+    var->has_fill = true;
+    var->fill_value = fill_value;
+    err = nc_put_att(file->file_id, var_id, "scale_factor", NC_REAL, 1, &scale_factor);
+    if (err == NC_NOERR)
+      err = nc_put_att(file->file_id, var_id, "add_offset", NC_REAL, 1, &add_offset);
+    if (err == NC_NOERR)
+      err = nc_put_att_short(file->file_id, var_id, "_FillValue", NC_SHORT, 1, &fill_value);
     if (err != NC_NOERR)
-      polymec_error("cf_file_define_latlon_var: Error defining var %s: %s", var_name, nc_strerror(err));
-    string_int_unordered_map_insert_with_k_dtor(file->ll_vars, string_dup(var_name), var_id, string_free);
+      polymec_error("%s: Error writing packing attributes for var %s: %s", func_name, var_name, nc_strerror(err));
   }
 
   // Metadata.
@@ -707,6 +1300,58 @@ void cf_file_define_latlon_var(cf_file_t* file,
   put_attribute(file->file_id, var_id, "units", units);
 }
 
+// Returns the number of values in a single time slice of the given variable.
+static size_t slice_size(cf_var_t* var)
+{
+  int ndims = 2 + (var->time_dependent ? 1 : 0) + (var->surface ? 0 : 1);
+  size_t n = 1;
+  for (int d = 0; d < ndims; ++d)
+    n *= var->count[d];
+  return n;
+}
+
+// Reads or writes the data for the given lat-lon variable at the given time 
+// index (ignored if the variable doesn't depend on time) using a single call.
+static void access_var(cf_file_t* file, 
+                       const char* func_name,
+                       const char* var_name,
+                       int time_index,
+                       bool writing,
+                       real_t* var_data)
+{
+  cf_var_t* var = get_var(file, var_name);
+  ASSERT(var != NULL);
+  size_t startp[4] = {0, 0, 0, 0};
+  if (var->time_dependent)
+  {
+    ASSERT(time_index >= 0);
+    ASSERT(time_index < cf_file_num_times(file));
+    startp[0] = (size_t)time_index;
+  }
+  size_t n = slice_size(var);
+  void* packed = begin_transfer(var, writing, n, var_data);
+  int err = transfer(file, var, writing, startp, var->count, NULL, NULL, var_data, packed, 0);
+  end_transfer(var, writing, n, packed, var_data);
+  if (err != NC_NOERR)
+  {
+    polymec_error("%s: Error %s data for var %s: %s", func_name, 
+                  (writing) ? "writing" : "reading", var_name, nc_strerror(err));
+  }
+}
+
+void cf_file_define_latlon_var(cf_file_t* file, 
+                               const char* var_name,
+                               bool time_dependent,
+                               const char* short_name,
+                               const char* long_name,
+                               const char* units)
+{
+  ASSERT(cf_file_has_latlon_grid(file));
+  ASSERT(!cf_file_has_latlon_var(file, var_name));
+  define_var(file, "cf_file_define_latlon_var", var_name, time_dependent, 
+             false, false, 1.0, 0.0, short_name, long_name, units);
+}
+
 void cf_file_get_latlon_var_metadata(cf_file_t* file, 
                                      const char* var_name,
                                      char* short_name,
@@ -714,7 +1359,8 @@ void cf_file_get_latlon_var_metadata(cf_file_t* file,
                                      char* units)
 {
   ASSERT(cf_file_has_latlon_grid(file));
-  int var_id = var_identifier(file->file_id, var_name);
+  cf_var_t* var = get_var(file, var_name);
+  int var_id = (var != NULL) ? var->id : var_identifier(file->file_id, var_name);
   get_first_attribute(file->file_id, var_id, "short_name", short_name);
   get_first_attribute(file->file_id, var_id, "long_name", long_name);
   get_first_attribute(file->file_id, var_id, "units", units);
@@ -723,8 +1369,8 @@ void cf_file_get_latlon_var_metadata(cf_file_t* file,
 bool cf_file_has_latlon_var(cf_file_t* file,
                             const char* var_name)
 {
-  return (string_int_unordered_map_contains(file->ll_vars, (char*)var_name) ||
-          string_int_unordered_map_contains(file->td_ll_vars, (char*)var_name));
+  cf_var_t* var = get_var(file, var_name);
+  return ((var != NULL) && !var->surface);
 }
 
 void cf_file_write_latlon_var(cf_file_t* file, 
@@ -733,40 +1379,7 @@ void cf_file_write_latlon_var(cf_file_t* file,
                               real_t* var_data)
 {
   ASSERT(cf_file_has_latlon_var(file, var_name));
-
-  int var_id = var_identifier(file->file_id, var_name);
-
-  // If we don't have a time series, we just write the whole thing.
-  if (!cf_file_has_time_series(file))
-  {
-    int err = nc_put_var(file->file_id, var_id, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_var: Error writing data for var %s: %s", var_name, nc_strerror(err));
-  }
-  // Otherwise, we get fancy and write a hyper slice.
-  else
-  {
-    ASSERT(time_index >= 0);
-    ASSERT(time_index < cf_file_num_times(file));
-
-    // Size up the dimensions.
-    size_t lat_len, lon_len, lev_len;
-    int err = nc_inq_dimlen(file->file_id, file->lat_dim, &lat_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_var: Error getting lat dimension %s", nc_strerror(err));
-    err = nc_inq_dimlen(file->file_id, file->lon_dim, &lon_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_var: Error getting lon dimension %s", nc_strerror(err));
-    err = nc_inq_dimlen(file->file_id, file->lev_dim, &lev_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_var: Error getting lev dimension %s", nc_strerror(err));
-
-    size_t startp[4] = {time_index, 0, 0, 0};
-    size_t countp[4] = {1, lev_len, lat_len, lon_len};
-    err = nc_put_vara(file->file_id, var_id, startp, countp, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_var: Error writing data for var %s: %s", var_name, nc_strerror(err));
-  }
+  access_var(file, "cf_file_write_latlon_var", var_name, time_index, true, var_data);
 }
 
 void cf_file_read_latlon_var(cf_file_t* file, 
@@ -775,51 +1388,7 @@ void cf_file_read_latlon_var(cf_file_t* file,
                              real_t* var_data)
 {
   ASSERT(cf_file_has_latlon_var(file, var_name));
-
-  bool time_dependent = false;
-  int var_id;
-  int* var_id_p = string_int_unordered_map_get(file->td_ll_vars, (char*)var_name);
-  if (var_id_p != NULL)
-    var_id = *var_id_p; 
-  else
-  {
-    var_id_p = string_int_unordered_map_get(file->ll_vars, (char*)var_name);
-    ASSERT(var_id_p != NULL);
-    time_dependent = true;
-    var_id = *var_id_p;
-  }
-
-  // If we don't have a time series, we just write the whole thing.
-  if (!time_dependent)
-  {
-    int err = nc_get_var(file->file_id, var_id, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_var: Error reading data for var %s: %s", var_name, nc_strerror(err));
-  }
-  // Otherwise, we get fancy and read a hyper slice.
-  else
-  {
-    ASSERT(time_index >= 0);
-    ASSERT(time_index < cf_file_num_times(file));
-
-    // Size up the dimensions.
-    size_t lat_len, lon_len, lev_len;
-    int err = nc_inq_dimlen(file->file_id, file->lat_dim, &lat_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_var: Error getting lat dimension %s", nc_strerror(err));
-    err = nc_inq_dimlen(file->file_id, file->lon_dim, &lon_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_var: Error getting lon dimension %s", nc_strerror(err));
-    err = nc_inq_dimlen(file->file_id, file->lev_dim, &lev_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_var: Error getting lev dimension %s", nc_strerror(err));
-
-    size_t startp[4] = {time_index, 0, 0, 0};
-    size_t countp[4] = {1, lev_len, lat_len, lon_len};
-    err = nc_get_vara(file->file_id, var_id, startp, countp, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_var: Error writing data for var %s: %s", var_name, nc_strerror(err));
-  }
+  access_var(file, "cf_file_read_latlon_var", var_name, time_index, false, var_data);
 }
 
 void cf_file_define_latlon_surface_var(cf_file_t* file, 
@@ -831,137 +1400,1369 @@ void cf_file_define_latlon_surface_var(cf_file_t* file,
 {
   ASSERT(cf_file_has_latlon_grid(file));
   ASSERT(!cf_file_has_latlon_surface_var(file, var_name));
+  define_var(file, "cf_file_define_latlon_surface_var", var_name, time_dependent, 
+             true, false, 1.0, 0.0, short_name, long_name, units);
+}
 
-  // Define the variable and its dimensions based on whether we have a time 
-  // series.
-  int var_id;
-  if (time_dependent)
-  {
-    ASSERT(cf_file_has_time_series(file));
+void cf_file_get_latlon_surface_var_metadata(cf_file_t* file, 
+                                             const char* var_name,
+                                             char* short_name,
+                                             char* long_name,
+                                             char* units)
+{
+  cf_file_get_latlon_var_metadata(file, var_name, short_name, long_name, units);
+}
 
-    int dims[3] = {file->time_dim, file->lat_dim, file->lon_dim};
-    int err = nc_def_var(file->file_id, var_name, NC_REAL, 3, dims, &var_id);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_define_latlon_surface_var: Error defining var %s: %s", var_name, nc_strerror(err));
-    string_int_unordered_map_insert_with_k_dtor(file->td_ll_surface_vars, string_dup(var_name), var_id, string_free);
-  }
+bool cf_file_has_latlon_surface_var(cf_file_t* file,
+                                    const char* var_name)
+{
+  cf_var_t* var = get_var(file, var_name);
+  return ((var != NULL) && var->surface);
+}
+
+void cf_file_write_latlon_surface_var(cf_file_t* file, 
+                                      const char* var_name,
+                                      int time_index, 
+                                      real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_var(file, "cf_file_write_latlon_surface_var", var_name, time_index, true, var_data);
+}
+
+void cf_file_read_latlon_surface_var(cf_file_t* file, 
+                                     const char* var_name,
+                                     int time_index, 
+                                     real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_var(file, "cf_file_read_latlon_surface_var", var_name, time_index, false, var_data);
+}
+
+// Reads or writes the given window of a lat-lon variable. Windows that don't 
+// cross the longitude seam are transferred with a single strided access. 
+// Windows that do are transferred in two pieces (one on either side of the 
+// seam), each mapped directly into its place in var_data.
+static void access_window(cf_file_t* file, 
+                          const char* func_name,
+                          const char* var_name,
+                          int time_index,
+                          cf_latlon_window_t* window,
+                          bool writing,
+                          real_t* var_data)
+{
+  cf_var_t* var = get_var(file, var_name);
+  ASSERT(var != NULL);
+
+  int lat_stride = MAX(window->lat_stride, 1);
+  int lon_stride = MAX(window->lon_stride, 1);
+  int lev_stride = MAX(window->lev_stride, 1);
+  ASSERT(window->lat_count > 0);
+  ASSERT(window->lon_count > 0);
+  ASSERT(window->lat_start >= 0);
+  ASSERT(window->lat_start + (window->lat_count-1) * lat_stride < file->nlat);
+  ASSERT(window->lon_start >= 0);
+  ASSERT(window->lon_start < file->nlon);
+  ASSERT((window->lon_count-1) * lon_stride < file->nlon); // no repeats
+
+  size_t startp[4], countp[4];
+  ptrdiff_t stridep[4], imapp[4];
+  int d = 0;
+  if (var->time_dependent)
+  {
+    ASSERT(time_index >= 0);
+    ASSERT(time_index < cf_file_num_times(file));
+    startp[d] = (size_t)time_index;
+    countp[d] = 1;
+    stridep[d] = 1;
+    imapp[d] = 0;
+    ++d;
+  }
+  if (!var->surface)
+  {
+    ASSERT(window->lev_count > 0);
+    ASSERT(window->lev_start >= 0);
+    ASSERT(window->lev_start + (window->lev_count-1) * lev_stride < file->nlev);
+    startp[d] = (size_t)window->lev_start;
+    countp[d] = (size_t)window->lev_count;
+    stridep[d] = lev_stride;
+    imapp[d] = window->lat_count * window->lon_count;
+    ++d;
+  }
+  startp[d] = (size_t)window->lat_start;
+  countp[d] = (size_t)window->lat_count;
+  stridep[d] = lat_stride;
+  imapp[d] = window->lon_count;
+  ++d;
+  int lon = d;
+  startp[lon] = (size_t)window->lon_start;
+  countp[lon] = (size_t)window->lon_count;
+  stridep[lon] = lon_stride;
+  imapp[lon] = 1;
+
+  // How many of the window's longitudes lie before the seam?
+  int n1 = (file->nlon - window->lon_start + lon_stride - 1) / lon_stride;
+  size_t n = (size_t)(window->lat_count * window->lon_count);
+  if (!var->surface)
+    n *= (size_t)window->lev_count;
+  void* packed = begin_transfer(var, writing, n, var_data);
+  int err;
+
+  // In collective mode, every process must make the same number of calls, 
+  // so all of them take the two-piece path (with an empty second piece if 
+  // their window doesn't wrap).
+  bool collective = (file->parallel && file->collective);
+  if ((n1 >= window->lon_count) && !collective)
+    err = transfer(file, var, writing, startp, countp, stridep, NULL, var_data, packed, 0);
   else
   {
-    int dims[2] = {file->lat_dim, file->lon_dim};
-    int err = nc_def_var(file->file_id, var_name, NC_REAL, 2, dims, &var_id);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_define_latlon_surface_var: Error defining var %s: %s", var_name, nc_strerror(err));
-    string_int_unordered_map_insert_with_k_dtor(file->ll_surface_vars, string_dup(var_name), var_id, string_free);
+    n1 = MIN(n1, window->lon_count);
+    countp[lon] = (size_t)n1;
+    err = transfer(file, var, writing, startp, countp, stridep, imapp, var_data, packed, 0);
+    if (err == NC_NOERR)
+    {
+      startp[lon] = (n1 < window->lon_count) ? 
+                    (size_t)(window->lon_start + n1 * lon_stride - file->nlon) : 0;
+      countp[lon] = (size_t)(window->lon_count - n1);
+      err = transfer(file, var, writing, startp, countp, stridep, imapp, var_data, packed, (size_t)n1);
+    }
   }
+  end_transfer(var, writing, n, packed, var_data);
+  if (err != NC_NOERR)
+  {
+    polymec_error("%s: Error %s window of var %s: %s", func_name, 
+                  (writing) ? "writing" : "reading", var_name, nc_strerror(err));
+  }
+}
 
-  // Metadata.
-  put_attribute(file->file_id, var_id, "short_name", short_name);
-  put_attribute(file->file_id, var_id, "long_name", long_name);
-  put_attribute(file->file_id, var_id, "units", units);
+void cf_file_write_latlon_var_window(cf_file_t* file, 
+                                     const char* var_name,
+                                     int time_index, 
+                                     cf_latlon_window_t* window,
+                                     real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_var(file, var_name));
+  access_window(file, "cf_file_write_latlon_var_window", var_name, 
+                time_index, window, true, var_data);
 }
 
-void cf_file_get_latlon_surface_var_metadata(cf_file_t* file, 
+void cf_file_read_latlon_var_window(cf_file_t* file, 
+                                    const char* var_name,
+                                    int time_index, 
+                                    cf_latlon_window_t* window,
+                                    real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_var(file, var_name));
+  access_window(file, "cf_file_read_latlon_var_window", var_name, 
+                time_index, window, false, var_data);
+}
+
+void cf_file_write_latlon_surface_var_window(cf_file_t* file, 
                                              const char* var_name,
-                                             char* short_name,
-                                             char* long_name,
-                                             char* units)
+                                             int time_index, 
+                                             cf_latlon_window_t* window,
+                                             real_t* var_data)
 {
-  cf_file_get_latlon_var_metadata(file, var_name, short_name, long_name, units);
+  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_window(file, "cf_file_write_latlon_surface_var_window", var_name, 
+                time_index, window, true, var_data);
 }
 
-bool cf_file_has_latlon_surface_var(cf_file_t* file,
-                                    const char* var_name)
+void cf_file_read_latlon_surface_var_window(cf_file_t* file, 
+                                            const char* var_name,
+                                            int time_index, 
+                                            cf_latlon_window_t* window,
+                                            real_t* var_data)
 {
-  return (string_int_unordered_map_contains(file->ll_surface_vars, (char*)var_name) ||
-          string_int_unordered_map_contains(file->td_ll_surface_vars, (char*)var_name));
+  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_window(file, "cf_file_read_latlon_surface_var_window", var_name, 
+                time_index, window, false, var_data);
 }
 
-void cf_file_write_latlon_surface_var(cf_file_t* file, 
-                                      const char* var_name,
-                                      int time_index, 
-                                      real_t* var_data)
+void cf_file_set_collective_io(cf_file_t* file, bool collective)
+{
+  if (collective == file->collective) return;
+  file->collective = collective;
+  if (file->time_id != -1)
+    set_par_access(file, file->time_id);
+  int pos = 0;
+  char* var_name;
+  void* var;
+  while (string_ptr_unordered_map_next(file->vars, &pos, &var_name, &var))
+    set_par_access(file, ((cf_var_t*)var)->id);
+  if (file->mesh_id != -1)
+  {
+    set_par_access(file, file->node_x_id);
+    set_par_access(file, file->node_y_id);
+    set_par_access(file, file->node_z_id);
+    set_par_access(file, file->face_nodes_id);
+    set_par_access(file, file->cell_nodes_id);
+    set_par_access(file, file->cell_faces_id);
+    set_par_access(file, file->cell_shapes_id);
+    pos = 0;
+    while (string_ptr_unordered_map_next(file->mesh_vars, &pos, &var_name, &var))
+      set_par_access(file, ((cf_mesh_var_t*)var)->id);
+  }
+}
+
+bool cf_file_is_parallel(cf_file_t* file)
+{
+  return file->parallel;
+}
+
+void cf_file_get_local_latlon_window(cf_file_t* file,
+                                     int num_lon_tiles,
+                                     cf_latlon_window_t* window)
+{
+  ASSERT(cf_file_has_latlon_grid(file));
+  ASSERT(num_lon_tiles > 0);
+  ASSERT((file->nprocs % num_lon_tiles) == 0);
+
+  // Processes are arranged in latitude-major order, with num_lon_tiles 
+  // processes in each band.
+  int num_lat_tiles = file->nprocs / num_lon_tiles;
+  int lat_tile = file->rank / num_lon_tiles;
+  int lon_tile = file->rank % num_lon_tiles;
+
+  // Divide the points as evenly as possible, giving the remainder to the 
+  // first tiles.
+  int nlat = file->nlat / num_lat_tiles, lat_rem = file->nlat % num_lat_tiles;
+  int nlon = file->nlon / num_lon_tiles, lon_rem = file->nlon % num_lon_tiles;
+  window->lat_start = lat_tile * nlat + MIN(lat_tile, lat_rem);
+  window->lat_count = nlat + ((lat_tile < lat_rem) ? 1 : 0);
+  window->lat_stride = 1;
+  window->lon_start = lon_tile * nlon + MIN(lon_tile, lon_rem);
+  window->lon_count = nlon + ((lon_tile < lon_rem) ? 1 : 0);
+  window->lon_stride = 1;
+  window->lev_start = 0;
+  window->lev_count = file->nlev;
+  window->lev_stride = 1;
+}
+
+// Reads or writes a contiguous range of time slices of a time-dependent 
+// lat-lon variable in a single access.
+static void access_times(cf_file_t* file, 
+                         const char* func_name,
+                         const char* var_name,
+                         int first_time_index,
+                         int num_times,
+                         bool writing,
+                         real_t* var_data)
+{
+  cf_var_t* var = get_var(file, var_name);
+  ASSERT(var != NULL);
+  ASSERT(var->time_dependent);
+  ASSERT(first_time_index >= 0);
+  ASSERT(num_times > 0);
+  ASSERT(first_time_index + num_times <= cf_file_num_times(file));
+
+  size_t startp[4] = {(size_t)first_time_index, 0, 0, 0};
+  size_t countp[4];
+  memcpy(countp, var->count, 4 * sizeof(size_t));
+  countp[0] = (size_t)num_times;
+  size_t n = (size_t)num_times * slice_size(var);
+  void* packed = begin_transfer(var, writing, n, var_data);
+  int err = transfer(file, var, writing, startp, countp, NULL, NULL, var_data, packed, 0);
+  end_transfer(var, writing, n, packed, var_data);
+  if (err != NC_NOERR)
+  {
+    polymec_error("%s: Error %s times %d-%d of var %s: %s", func_name, 
+                  (writing) ? "writing" : "reading", first_time_index, 
+                  first_time_index + num_times - 1, var_name, nc_strerror(err));
+  }
+}
+
+void cf_file_write_latlon_var_times(cf_file_t* file, 
+                                    const char* var_name,
+                                    int first_time_index, 
+                                    int num_times,
+                                    real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_var(file, var_name));
+  access_times(file, "cf_file_write_latlon_var_times", var_name, 
+               first_time_index, num_times, true, var_data);
+}
+
+void cf_file_read_latlon_var_times(cf_file_t* file, 
+                                   const char* var_name,
+                                   int first_time_index, 
+                                   int num_times,
+                                   real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_var(file, var_name));
+  access_times(file, "cf_file_read_latlon_var_times", var_name, 
+               first_time_index, num_times, false, var_data);
+}
+
+void cf_file_write_latlon_surface_var_times(cf_file_t* file, 
+                                            const char* var_name,
+                                            int first_time_index, 
+                                            int num_times,
+                                            real_t* var_data)
 {
   ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_times(file, "cf_file_write_latlon_surface_var_times", var_name, 
+               first_time_index, num_times, true, var_data);
+}
 
-  int var_id = var_identifier(file->file_id, var_name);
+void cf_file_read_latlon_surface_var_times(cf_file_t* file, 
+                                           const char* var_name,
+                                           int first_time_index, 
+                                           int num_times,
+                                           real_t* var_data)
+{
+  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_times(file, "cf_file_read_latlon_surface_var_times", var_name, 
+               first_time_index, num_times, false, var_data);
+}
 
-  // If we don't have a time series, we just write the whole thing.
-  if (!cf_file_has_time_series(file))
+// Reads the values of a time-dependent lat-lon variable at every time for 
+// the given grid point.
+static void read_time_series(cf_file_t* file, 
+                             const char* func_name,
+                             const char* var_name,
+                             int lev_index,
+                             int lat_index,
+                             int lon_index,
+                             real_t* values)
+{
+  cf_var_t* var = get_var(file, var_name);
+  ASSERT(var != NULL);
+  ASSERT(var->time_dependent);
+  ASSERT((lat_index >= 0) && (lat_index < file->nlat));
+  ASSERT((lon_index >= 0) && (lon_index < file->nlon));
+
+  size_t startp[4], countp[4] = {(size_t)file->ntimes, 1, 1, 1};
+  int d = 0;
+  startp[d++] = 0;
+  if (!var->surface)
   {
-    int err = nc_put_var(file->file_id, var_id, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_surface_var: Error writing data for var %s: %s", var_name, nc_strerror(err));
+    ASSERT((lev_index >= 0) && (lev_index < file->nlev));
+    startp[d++] = (size_t)lev_index;
   }
-  // Otherwise, we get fancy and write a hyper slice.
-  else
+  startp[d++] = (size_t)lat_index;
+  startp[d++] = (size_t)lon_index;
+
+  if (file->ntimes == 0) return;
+  size_t n = (size_t)file->ntimes;
+  void* packed = begin_transfer(var, false, n, values);
+  int err = transfer(file, var, false, startp, countp, NULL, NULL, values, packed, 0);
+  end_transfer(var, false, n, packed, values);
+  if (err != NC_NOERR)
+    polymec_error("%s: Error reading time series of var %s: %s", func_name, var_name, nc_strerror(err));
+}
+
+void cf_file_read_latlon_var_time_series(cf_file_t* file, 
+                                         const char* var_name,
+                                         int lev_index,
+                                         int lat_index,
+                                         int lon_index,
+                                         real_t* values)
+{
+  ASSERT(cf_file_has_latlon_var(file, var_name));
+  read_time_series(file, "cf_file_read_latlon_var_time_series", var_name, 
+                   lev_index, lat_index, lon_index, values);
+}
+
+void cf_file_read_latlon_surface_var_time_series(cf_file_t* file, 
+                                                 const char* var_name,
+                                                 int lat_index,
+                                                 int lon_index,
+                                                 real_t* values)
+{
+  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  read_time_series(file, "cf_file_read_latlon_surface_var_time_series", var_name, 
+                   0, lat_index, lon_index, values);
+}
+
+void cf_file_define_packed_latlon_var(cf_file_t* file, 
+                                      const char* var_name,
+                                      bool time_dependent,
+                                      real_t scale_factor,
+                                      real_t add_offset,
+                                      const char* short_name,
+                                      const char* long_name,
+                                      const char* units)
+{
+  ASSERT(cf_file_has_latlon_grid(file));
+  ASSERT(!cf_file_has_latlon_var(file, var_name));
+  define_var(file, "cf_file_define_packed_latlon_var", var_name, time_dependent, 
+             false, true, scale_factor, add_offset, short_name, long_name, units);
+}
+
+void cf_file_define_packed_latlon_surface_var(cf_file_t* file, 
+                                              const char* var_name,
+                                              bool time_dependent,
+                                              real_t scale_factor,
+                                              real_t add_offset,
+                                              const char* short_name,
+                                              const char* long_name,
+                                              const char* units)
+{
+  ASSERT(cf_file_has_latlon_grid(file));
+  ASSERT(!cf_file_has_latlon_surface_var(file, var_name));
+  define_var(file, "cf_file_define_packed_latlon_surface_var", var_name, time_dependent, 
+             true, true, scale_factor, add_offset, short_name, long_name, units);
+}
+
+bool cf_file_get_packing(cf_file_t* file,
+                         const char* var_name,
+                         real_t* scale_factor,
+                         real_t* add_offset)
+{
+  cf_var_t* var = get_var(file, var_name);
+  ASSERT(var != NULL);
+  *scale_factor = var->scale_factor;
+  *add_offset = var->add_offset;
+  return var->packed;
+}
+
+// Entities per chunk along the entity dimension of mesh variables.
+#define MESH_CHUNK_SIZE 65536
+
+// Defines a dimension, erroring on failure.
+static int define_dim(cf_file_t* file, const char* func_name, const char* name, int len)
+{
+  int dim_id;
+  int err = nc_def_dim(file->file_id, name, (size_t)len, &dim_id);
+  if (err != NC_NOERR)
+    polymec_error("%s: Could not define dimension %s: %s", func_name, name, nc_strerror(err));
+  return dim_id;
+}
+
+// Defines a mesh variable with the given type and dimensions, chunked along 
+// its entity dimension (the first non-time dimension) and compressed (if 
+// we're not writing in parallel, which the HDF5 filters don't support).
+static int define_mesh_data(cf_file_t* file, 
+                            const char* func_name,
+                            const char* name, 
+                            nc_type type,
+                            int ndims, 
+                            int* dims,
+                            int entity_dim)
+{
+  int var_id;
+  int err = nc_def_var(file->file_id, name, type, ndims, dims, &var_id);
+  if (err != NC_NOERR)
+    polymec_error("%s: Could not define variable %s: %s", func_name, name, nc_strerror(err));
+
+  size_t chunks[3];
+  for (int d = 0; d < ndims; ++d)
   {
-    ASSERT(time_index >= 0);
-    ASSERT(time_index < cf_file_num_times(file));
+    if (dims[d] == file->time_dim)
+      chunks[d] = 1;
+    else if (d == entity_dim)
+      chunks[d] = (size_t)MAX(1, MIN(dimension_length(file->file_id, dims[d]), MESH_CHUNK_SIZE));
+    else
+      chunks[d] = (size_t)dimension_length(file->file_id, dims[d]);
+  }
+  err = nc_def_var_chunking(file->file_id, var_id, NC_CHUNKED, chunks);
+  if ((err == NC_NOERR) && !file->parallel)
+    err = nc_def_var_deflate(file->file_id, var_id, 1, 1, 1);
+  if (err != NC_NOERR)
+    polymec_error("%s: Could not set storage for variable %s: %s", func_name, name, nc_strerror(err));
+  set_par_access(file, var_id);
+  return var_id;
+}
 
-    // Size up the dimensions.
-    size_t lat_len, lon_len;
-    int err = nc_inq_dimlen(file->file_id, file->lat_dim, &lat_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_surface_var: Error getting lat dimension %s", nc_strerror(err));
-    err = nc_inq_dimlen(file->file_id, file->lon_dim, &lon_len);
+void cf_file_define_mesh(cf_file_t* file,
+                         const char* mesh_name,
+                         int num_nodes,
+                         int num_faces,
+                         int num_cells,
+                         int max_face_nodes,
+                         int max_cell_nodes,
+                         int max_cell_faces)
+{
+  ASSERT(!cf_file_has_mesh(file));
+  ASSERT(num_nodes > 0);
+  ASSERT(num_faces > 0);
+  ASSERT(num_cells > 0);
+  ASSERT(max_face_nodes > 0);
+  ASSERT(max_cell_nodes > 0);
+  ASSERT(max_cell_faces > 0);
+  const char* func_name = "cf_file_define_mesh";
+
+  strncpy(file->mesh_name, mesh_name, POLYGLOT_CF_MAX_NAME);
+  file->mesh_name[POLYGLOT_CF_MAX_NAME] = '\0';
+  file->num_mesh_nodes = num_nodes;
+  file->num_mesh_faces = num_faces;
+  file->num_mesh_cells = num_cells;
+  file->max_face_nodes = max_face_nodes;
+  file->max_cell_nodes = max_cell_nodes;
+  file->max_cell_faces = max_cell_faces;
+
+  // Dimensions.
+  char name[POLYGLOT_CF_MAX_NAME+32];
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "n%s_node", mesh_name);
+  file->node_dim = define_dim(file, func_name, name, num_nodes);
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "n%s_face", mesh_name);
+  file->face_dim = define_dim(file, func_name, name, num_faces);
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "n%s_volume", mesh_name);
+  file->cell_dim = define_dim(file, func_name, name, num_cells);
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "nMax%s_face_nodes", mesh_name);
+  file->face_nodes_dim = define_dim(file, func_name, name, max_face_nodes);
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "nMax%s_volume_nodes", mesh_name);
+  file->cell_nodes_dim = define_dim(file, func_name, name, max_cell_nodes);
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "nMax%s_volume_faces", mesh_name);
+  file->cell_faces_dim = define_dim(file, func_name, name, max_cell_faces);
+
+  // The mesh topology variable, which holds only attributes.
+  int err = nc_def_var(file->file_id, mesh_name, NC_INT, 0, NULL, &file->mesh_id);
+  if (err != NC_NOERR)
+    polymec_error("%s: Could not define mesh %s: %s", func_name, mesh_name, nc_strerror(err));
+  put_attribute(file->file_id, file->mesh_id, "cf_role", "mesh_topology");
+  put_attribute(file->file_id, file->mesh_id, "long_name", "Topology data of 3D unstructured mesh");
+  int topology_dimension = 3;
+  err = nc_put_att_int(file->file_id, file->mesh_id, "topology_dimension", NC_INT, 1, &topology_dimension);
+  if (err != NC_NOERR)
+    polymec_error("%s: Could not write topology dimension: %s", func_name, nc_strerror(err));
+  char value[3*POLYGLOT_CF_MAX_NAME+64];
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "%s_node_x %s_node_y %s_node_z", 
+           mesh_name, mesh_name, mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "node_coordinates", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "%s_face_nodes", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "face_node_connectivity", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "%s_volume_nodes", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "volume_node_connectivity", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "%s_volume_faces", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "volume_face_connectivity", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "%s_volume_types", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "volume_shape_type", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "n%s_node", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "node_dimension", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "n%s_face", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "face_dimension", value);
+  snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "n%s_volume", mesh_name);
+  put_attribute(file->file_id, file->mesh_id, "volume_dimension", value);
+
+  // Node coordinates.
+  const char* axes[3] = {"x", "y", "z"};
+  int* coord_ids[3] = {&file->node_x_id, &file->node_y_id, &file->node_z_id};
+  for (int d = 0; d < 3; ++d)
+  {
+    snprintf(name, POLYGLOT_CF_MAX_NAME+32, "%s_node_%s", mesh_name, axes[d]);
+    *coord_ids[d] = define_mesh_data(file, func_name, name, NC_REAL, 1, &file->node_dim, 0);
+    snprintf(value, 3*POLYGLOT_CF_MAX_NAME+64, "%s coordinate of mesh nodes", axes[d]);
+    put_attribute(file->file_id, *coord_ids[d], "long_name", value);
+    put_attribute(file->file_id, *coord_ids[d], "mesh", mesh_name);
+    put_attribute(file->file_id, *coord_ids[d], "location", "node");
+  }
+
+  // Connectivity, padded with fill values.
+  int fill = -1, start_index = 0;
+  int dims[2] = {file->face_dim, file->face_nodes_dim};
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "%s_face_nodes", mesh_name);
+  file->face_nodes_id = define_mesh_data(file, func_name, name, NC_INT, 2, dims, 0);
+  put_attribute(file->file_id, file->face_nodes_id, "cf_role", "face_node_connectivity");
+  dims[0] = file->cell_dim;
+  dims[1] = file->cell_nodes_dim;
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "%s_volume_nodes", mesh_name);
+  file->cell_nodes_id = define_mesh_data(file, func_name, name, NC_INT, 2, dims, 0);
+  put_attribute(file->file_id, file->cell_nodes_id, "cf_role", "volume_node_connectivity");
+  dims[1] = file->cell_faces_dim;
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "%s_volume_faces", mesh_name);
+  file->cell_faces_id = define_mesh_data(file, func_name, name, NC_INT, 2, dims, 0);
+  put_attribute(file->file_id, file->cell_faces_id, "cf_role", "volume_face_connectivity");
+  int conn_ids[3] = {file->face_nodes_id, file->cell_nodes_id, file->cell_faces_id};
+  for (int i = 0; i < 3; ++i)
+  {
+    err = nc_def_var_fill(file->file_id, conn_ids[i], 0, &fill);
+    if (err == NC_NOERR)
+      err = nc_put_att_int(file->file_id, conn_ids[i], "start_index", NC_INT, 1, &start_index);
     if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_surface_var: Error getting lon dimension %s", nc_strerror(err));
+      polymec_error("%s: Could not set connectivity attributes: %s", func_name, nc_strerror(err));
+  }
+
+  // Cell shapes, stored as flags.
+  snprintf(name, POLYGLOT_CF_MAX_NAME+32, "%s_volume_types", mesh_name);
+  file->cell_shapes_id = define_mesh_data(file, func_name, name, NC_INT, 1, &file->cell_dim, 0);
+  put_attribute(file->file_id, file->cell_shapes_id, "cf_role", "volume_shape_type");
+  put_attribute(file->file_id, file->cell_shapes_id, "long_name", "Specifies the shape of the individual volumes.");
+  put_attribute(file->file_id, file->cell_shapes_id, "flag_meanings", 
+                "tetrahedron pyramid wedge hexahedron polyhedron");
+  int flag_values[5] = {CF_MESH_TETRAHEDRON, CF_MESH_PYRAMID, CF_MESH_WEDGE, 
+                        CF_MESH_HEXAHEDRON, CF_MESH_POLYHEDRON};
+  err = nc_put_att_int(file->file_id, file->cell_shapes_id, "flag_values", NC_INT, 5, flag_values);
+  if (err != NC_NOERR)
+    polymec_error("%s: Could not write volume shape flags: %s", func_name, nc_strerror(err));
+}
+
+bool cf_file_has_mesh(cf_file_t* file)
+{
+  return (file->mesh_id != -1);
+}
+
+void cf_file_get_mesh_metadata(cf_file_t* file,
+                               char* mesh_name,
+                               int* num_nodes,
+                               int* num_faces,
+                               int* num_cells,
+                               int* max_face_nodes,
+                               int* max_cell_nodes,
+                               int* max_cell_faces)
+{
+  ASSERT(cf_file_has_mesh(file));
+  strcpy(mesh_name, file->mesh_name);
+  *num_nodes = file->num_mesh_nodes;
+  *num_faces = file->num_mesh_faces;
+  *num_cells = file->num_mesh_cells;
+  *max_face_nodes = file->max_face_nodes;
+  *max_cell_nodes = file->max_cell_nodes;
+  *max_cell_faces = file->max_cell_faces;
+}
 
-    size_t startp[4] = {time_index, 0, 0};
-    size_t countp[4] = {1, lat_len, lon_len};
-    err = nc_put_vara(file->file_id, var_id, startp, countp, var_data);
+// Reads or writes a range of node coordinates.
+static void access_mesh_nodes(cf_file_t* file, 
+                              const char* func_name,
+                              int first_node,
+                              int num_nodes,
+                              bool writing,
+                              point_t* nodes)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_node >= 0);
+  ASSERT(num_nodes >= 0);
+  ASSERT(first_node + num_nodes <= file->num_mesh_nodes);
+
+  // Coordinates are mapped directly to/from the interleaved points.
+  size_t startp = (size_t)first_node, countp = (size_t)num_nodes;
+  ptrdiff_t stridep = 1, imapp = (ptrdiff_t)(sizeof(point_t) / sizeof(real_t));
+  int ids[3] = {file->node_x_id, file->node_y_id, file->node_z_id};
+  point_t dummy;
+  point_t* x = (num_nodes > 0) ? nodes : &dummy;
+  real_t* coords[3] = {&x->x, &x->y, &x->z};
+  for (int d = 0; d < 3; ++d)
+  {
+    int err = (writing) ? nc_put_varm_real(file->file_id, ids[d], &startp, &countp, &stridep, &imapp, coords[d])
+                        : nc_get_varm_real(file->file_id, ids[d], &startp, &countp, &stridep, &imapp, coords[d]);
     if (err != NC_NOERR)
-      polymec_error("cf_file_write_latlon_surface_var: Error writing data for var %s: %s", var_name, nc_strerror(err));
+      polymec_error("%s: Error %s node coordinates: %s", func_name, (writing) ? "writing" : "reading", nc_strerror(err));
   }
 }
 
-void cf_file_read_latlon_surface_var(cf_file_t* file, 
-                                     const char* var_name,
-                                     int time_index, 
-                                     real_t* var_data)
+void cf_file_write_mesh_nodes(cf_file_t* file,
+                              int first_node,
+                              int num_nodes,
+                              point_t* nodes)
 {
-  ASSERT(cf_file_has_latlon_surface_var(file, var_name));
+  access_mesh_nodes(file, "cf_file_write_mesh_nodes", first_node, num_nodes, true, nodes);
+}
 
-  bool time_dependent = false;
-  int var_id;
-  int* var_id_p = string_int_unordered_map_get(file->td_ll_vars, (char*)var_name);
-  if (var_id_p != NULL)
-    var_id = *var_id_p; 
+void cf_file_read_mesh_nodes(cf_file_t* file,
+                             int first_node,
+                             int num_nodes,
+                             point_t* nodes)
+{
+  access_mesh_nodes(file, "cf_file_read_mesh_nodes", first_node, num_nodes, false, nodes);
+}
+
+// Pads num rows of the given compressed (offsets, indices) connectivity to 
+// max_width entries each, storing them in padded. Orientation of cell faces 
+// (stored as ~face) is discarded, and if index_map is non-NULL, each index 
+// i is replaced by index_map[i].
+static void pad_connectivity(const char* func_name,
+                             int max_width,
+                             int first,
+                             int num,
+                             int* offsets,
+                             int* indices,
+                             int* index_map,
+                             int* padded)
+{
+  for (int i = 0; i < num; ++i)
+  {
+    int width = offsets[i+1] - offsets[i];
+    if (width > max_width)
+      polymec_error("%s: Entry %d has %d entries (max is %d).", func_name, first + i, width, max_width);
+    int* row = &padded[i * max_width];
+    for (int j = 0; j < width; ++j)
+    {
+      int index = indices[offsets[i] + j];
+      if (index < 0) 
+        index = ~index;
+      row[j] = (index_map != NULL) ? index_map[index] : index;
+    }
+    for (int j = width; j < max_width; ++j)
+      row[j] = -1;
+  }
+}
+
+// Reads or writes a range of padded rows of a connectivity variable.
+static void access_padded_connectivity(cf_file_t* file,
+                                       const char* func_name,
+                                       int var_id,
+                                       int max_width,
+                                       int first,
+                                       int num,
+                                       bool writing,
+                                       int* padded)
+{
+  size_t startp[2] = {(size_t)first, 0}, countp[2] = {(size_t)num, (size_t)max_width};
+  int err = (writing) ? nc_put_vara_int(file->file_id, var_id, startp, countp, padded)
+                      : nc_get_vara_int(file->file_id, var_id, startp, countp, padded);
+  if (err != NC_NOERR)
+    polymec_error("%s: Error %s connectivity: %s", func_name, (writing) ? "writing" : "reading", nc_strerror(err));
+}
+
+// Writes a range of rows of a padded connectivity variable from the given 
+// compressed (offsets, indices) arrays.
+static void write_connectivity(cf_file_t* file,
+                               const char* func_name,
+                               int var_id,
+                               int max_width,
+                               int first,
+                               int num,
+                               int* offsets,
+                               int* indices)
+{
+  int* padded = polymec_malloc(sizeof(int) * MAX(num * max_width, 1));
+  pad_connectivity(func_name, max_width, first, num, offsets, indices, NULL, padded);
+  access_padded_connectivity(file, func_name, var_id, max_width, first, num, true, padded);
+  polymec_free(padded);
+}
+
+// Reads a range of rows of a padded connectivity variable into the given 
+// compressed (offsets, indices) arrays.
+static void read_connectivity(cf_file_t* file,
+                              const char* func_name,
+                              int var_id,
+                              int max_width,
+                              int first,
+                              int num,
+                              int* offsets,
+                              int* indices)
+{
+  int* padded = polymec_malloc(sizeof(int) * MAX(num * max_width, 1));
+  access_padded_connectivity(file, func_name, var_id, max_width, first, num, false, padded);
+  offsets[0] = 0;
+  for (int i = 0; i < num; ++i)
+  {
+    int* row = &padded[i * max_width];
+    int width = 0;
+    while ((width < max_width) && (row[width] >= 0))
+    {
+      indices[offsets[i] + width] = row[width];
+      ++width;
+    }
+    offsets[i+1] = offsets[i] + width;
+  }
+  polymec_free(padded);
+}
+
+void cf_file_write_mesh_faces(cf_file_t* file,
+                              int first_face,
+                              int num_faces,
+                              int* face_node_offsets,
+                              int* face_nodes)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_face >= 0);
+  ASSERT(first_face + num_faces <= file->num_mesh_faces);
+  write_connectivity(file, "cf_file_write_mesh_faces", file->face_nodes_id, 
+                     file->max_face_nodes, first_face, num_faces, 
+                     face_node_offsets, face_nodes);
+}
+
+void cf_file_read_mesh_faces(cf_file_t* file,
+                             int first_face,
+                             int num_faces,
+                             int* face_node_offsets,
+                             int* face_nodes)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_face >= 0);
+  ASSERT(first_face + num_faces <= file->num_mesh_faces);
+  read_connectivity(file, "cf_file_read_mesh_faces", file->face_nodes_id, 
+                    file->max_face_nodes, first_face, num_faces, 
+                    face_node_offsets, face_nodes);
+}
+
+void cf_file_write_mesh_cells(cf_file_t* file,
+                              int first_cell,
+                              int num_cells,
+                              int* cell_face_offsets,
+                              int* cell_faces)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_cell >= 0);
+  ASSERT(first_cell + num_cells <= file->num_mesh_cells);
+  write_connectivity(file, "cf_file_write_mesh_cells", file->cell_faces_id, 
+                     file->max_cell_faces, first_cell, num_cells, 
+                     cell_face_offsets, cell_faces);
+}
+
+void cf_file_read_mesh_cells(cf_file_t* file,
+                             int first_cell,
+                             int num_cells,
+                             int* cell_face_offsets,
+                             int* cell_faces)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_cell >= 0);
+  ASSERT(first_cell + num_cells <= file->num_mesh_cells);
+  read_connectivity(file, "cf_file_read_mesh_cells", file->cell_faces_id, 
+                    file->max_cell_faces, first_cell, num_cells, 
+                    cell_face_offsets, cell_faces);
+}
+
+// Reads or writes a range of cell shapes.
+static void access_cell_shapes(cf_file_t* file,
+                               const char* func_name,
+                               int first_cell,
+                               int num_cells,
+                               bool writing,
+                               cf_mesh_shape_t* cell_shapes)
+{
+  int* shapes = polymec_malloc(sizeof(int) * MAX(num_cells, 1));
+  if (writing)
+  {
+    for (int c = 0; c < num_cells; ++c)
+      shapes[c] = (int)cell_shapes[c];
+  }
+  size_t startp = (size_t)first_cell, countp = (size_t)num_cells;
+  int err = (writing) ? nc_put_vara_int(file->file_id, file->cell_shapes_id, &startp, &countp, shapes)
+                      : nc_get_vara_int(file->file_id, file->cell_shapes_id, &startp, &countp, shapes);
+  if (err != NC_NOERR)
+    polymec_error("%s: Error %s cell shapes: %s", func_name, (writing) ? "writing" : "reading", nc_strerror(err));
+  if (!writing)
+  {
+    for (int c = 0; c < num_cells; ++c)
+    {
+      if ((shapes[c] < CF_MESH_TETRAHEDRON) || (shapes[c] > CF_MESH_POLYHEDRON))
+        polymec_error("%s: Cell %d has invalid shape %d.", func_name, first_cell + c, shapes[c]);
+      cell_shapes[c] = (cf_mesh_shape_t)shapes[c];
+    }
+  }
+  polymec_free(shapes);
+}
+
+void cf_file_write_mesh_cell_nodes(cf_file_t* file,
+                                   int first_cell,
+                                   int num_cells,
+                                   int* cell_node_offsets,
+                                   int* cell_nodes,
+                                   cf_mesh_shape_t* cell_shapes)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_cell >= 0);
+  ASSERT(first_cell + num_cells <= file->num_mesh_cells);
+  const char* func_name = "cf_file_write_mesh_cell_nodes";
+  write_connectivity(file, func_name, file->cell_nodes_id, 
+                     file->max_cell_nodes, first_cell, num_cells, 
+                     cell_node_offsets, cell_nodes);
+  access_cell_shapes(file, func_name, first_cell, num_cells, true, cell_shapes);
+}
+
+void cf_file_read_mesh_cell_nodes(cf_file_t* file,
+                                  int first_cell,
+                                  int num_cells,
+                                  int* cell_node_offsets,
+                                  int* cell_nodes,
+                                  cf_mesh_shape_t* cell_shapes)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(first_cell >= 0);
+  ASSERT(first_cell + num_cells <= file->num_mesh_cells);
+  const char* func_name = "cf_file_read_mesh_cell_nodes";
+  read_connectivity(file, func_name, file->cell_nodes_id, 
+                    file->max_cell_nodes, first_cell, num_cells, 
+                    cell_node_offsets, cell_nodes);
+  if (cell_shapes != NULL)
+    access_cell_shapes(file, func_name, first_cell, num_cells, false, cell_shapes);
+}
+
+// Returns the index of the given node in the given list, or -1 if it's not 
+// there.
+static inline int node_position(int node, int num_nodes, int* nodes)
+{
+  for (int i = 0; i < num_nodes; ++i)
+  {
+    if (nodes[i] == node) 
+      return i;
+  }
+  return -1;
+}
+
+// Returns the node joined by an edge to the given node of the given base 
+// face of cell c, but not in the base face itself, or -1 if there isn't one.
+static int node_above(mesh_t* mesh, int c, int base, int node, int num_base_nodes, int* base_nodes)
+{
+  for (int i = mesh->cell_face_offsets[c]; i < mesh->cell_face_offsets[c+1]; ++i)
+  {
+    int f = mesh->cell_faces[i];
+    if (f < 0) f = ~f;
+    if (f == base) continue;
+    int* nodes = &mesh->face_nodes[mesh->face_node_offsets[f]];
+    int nn = mesh->face_node_offsets[f+1] - mesh->face_node_offsets[f];
+    int j = node_position(node, nn, nodes);
+    if (j == -1) continue;
+    int neighbors[2] = {nodes[(j+nn-1) % nn], nodes[(j+1) % nn]};
+    for (int k = 0; k < 2; ++k)
+    {
+      if (node_position(neighbors[k], num_base_nodes, base_nodes) == -1)
+        return neighbors[k];
+    }
+  }
+  return -1;
+}
+
+// Finds the nodes of cell c of the given mesh (at most max_nodes) and their 
+// shape, ordered as described for cf_mesh_shape_t. Returns the number of 
+// nodes.
+static int get_cell_nodes(mesh_t* mesh, int c, int max_nodes, int* nodes, cf_mesh_shape_t* shape)
+{
+  // Gather the nodes in order of appearance.
+  int num_nodes = 0, num_faces = mesh->cell_face_offsets[c+1] - mesh->cell_face_offsets[c];
+  for (int i = mesh->cell_face_offsets[c]; i < mesh->cell_face_offsets[c+1]; ++i)
+  {
+    int f = mesh->cell_faces[i];
+    if (f < 0) f = ~f;
+    for (int j = mesh->face_node_offsets[f]; j < mesh->face_node_offsets[f+1]; ++j)
+    {
+      int n = mesh->face_nodes[j];
+      if (node_position(n, num_nodes, nodes) == -1)
+      {
+        ASSERT(num_nodes < max_nodes);
+        nodes[num_nodes++] = n;
+      }
+    }
+  }
+
+  // Identify the shape and the number of nodes in its base.
+  int base_size;
+  if ((num_nodes == 4) && (num_faces == 4))
+  {
+    *shape = CF_MESH_TETRAHEDRON;
+    base_size = 3;
+  }
+  else if ((num_nodes == 5) && (num_faces == 5))
+  {
+    *shape = CF_MESH_PYRAMID;
+    base_size = 4;
+  }
+  else if ((num_nodes == 6) && (num_faces == 5))
+  {
+    *shape = CF_MESH_WEDGE;
+    base_size = 3;
+  }
+  else if ((num_nodes == 8) && (num_faces == 6))
+  {
+    *shape = CF_MESH_HEXAHEDRON;
+    base_size = 4;
+  }
   else
   {
-    var_id_p = string_int_unordered_map_get(file->ll_vars, (char*)var_name);
-    ASSERT(var_id_p != NULL);
-    time_dependent = true;
-    var_id = *var_id_p;
+    *shape = CF_MESH_POLYHEDRON;
+    return num_nodes;
   }
 
-  // If we don't have a time series, we just write the whole thing.
-  if (!time_dependent)
+  // Find the base face and order its nodes so that its normal points into 
+  // the cell.
+  int ordered[8], base = -1;
+  for (int i = mesh->cell_face_offsets[c]; i < mesh->cell_face_offsets[c+1]; ++i)
   {
-    int err = nc_get_var(file->file_id, var_id, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_surface_var: Error reading data for var %s: %s", var_name, nc_strerror(err));
+    int f = mesh->cell_faces[i];
+    int ff = (f < 0) ? ~f : f;
+    if ((mesh->face_node_offsets[ff+1] - mesh->face_node_offsets[ff]) != base_size) continue;
+    int* face_nodes = &mesh->face_nodes[mesh->face_node_offsets[ff]];
+    for (int j = 0; j < base_size; ++j)
+      ordered[j] = (f >= 0) ? face_nodes[base_size-1-j] : face_nodes[j];
+    base = ff;
+    break;
   }
-  // Otherwise, we get fancy and read a hyper slice.
+
+  // The rest of the nodes follow the base.
+  bool valid = (base != -1);
+  if (valid && ((*shape == CF_MESH_TETRAHEDRON) || (*shape == CF_MESH_PYRAMID)))
+  {
+    for (int i = 0; i < num_nodes; ++i)
+    {
+      if (node_position(nodes[i], base_size, ordered) == -1)
+        ordered[base_size] = nodes[i];
+    }
+  }
+  else if (valid)
+  {
+    for (int j = 0; j < base_size; ++j)
+    {
+      ordered[base_size+j] = node_above(mesh, c, base, ordered[j], base_size, ordered);
+      valid = valid && (ordered[base_size+j] != -1);
+    }
+  }
+
+  // Cells whose faces don't fit their shape are treated as polyhedra.
+  if (valid)
+    memcpy(nodes, ordered, sizeof(int) * num_nodes);
   else
+    *shape = CF_MESH_POLYHEDRON;
+  return num_nodes;
+}
+
+// Returns the first index and number of indices in the block of the global 
+// indices [0, n) owned by this process when writing mesh entities shared by 
+// several processes. Indices are divided as evenly as possible, with the 
+// remainder going to the first processes.
+static void get_index_block(cf_file_t* file, int n, int* first, int* num)
+{
+  int base = n / file->nprocs, rem = n % file->nprocs;
+  *first = file->rank * base + MIN(file->rank, rem);
+  *num = base + ((file->rank < rem) ? 1 : 0);
+}
+
+// Returns the process owning the given global index in [0, n).
+static inline int index_owner(cf_file_t* file, int n, int index)
+{
+  int base = n / file->nprocs, rem = n % file->nprocs;
+  int num_big = rem * (base + 1);
+  return (index < num_big) ? index / (base + 1) : rem + (index - num_big) / base;
+}
+
+// Sends the given rows (of row_size bytes each), labeled with global indices 
+// in [0, n), to the processes that own those indices, and returns this 
+// process's block of rows, storing its first index and size in first and 
+// num. Rows with the same global index (those of shared nodes and faces) 
+// must be identical, and appear once in the block.
+static void* gather_rows(cf_file_t* file,
+                         int n,
+                         int num_rows,
+                         int* indices,
+                         size_t row_size,
+                         void* rows,
+                         int* first,
+                         int* num)
+{
+  get_index_block(file, n, first, num);
+  char* block = polymec_calloc(MAX(*num, 1), row_size);
+  char* my_rows = rows;
+  if (file->nprocs == 1)
+  {
+    for (int i = 0; i < num_rows; ++i)
+      memcpy(&block[row_size * indices[i]], &my_rows[row_size * i], row_size);
+    return block;
+  }
+
+  // Sort our rows by owner.
+  int nprocs = file->nprocs;
+  int* send_counts = polymec_calloc(4 * nprocs + 2, sizeof(int));
+  int* send_offsets = &send_counts[nprocs];
+  int* receive_counts = &send_counts[2*nprocs+1];
+  int* receive_offsets = &send_counts[3*nprocs+1];
+  int* owners = polymec_malloc(sizeof(int) * MAX(num_rows, 1));
+  for (int i = 0; i < num_rows; ++i)
+  {
+    ASSERT((indices[i] >= 0) && (indices[i] < n));
+    owners[i] = index_owner(file, n, indices[i]);
+    ++send_counts[owners[i]];
+  }
+  MPI_Alltoall(send_counts, 1, MPI_INT, receive_counts, 1, MPI_INT, file->comm);
+  for (int p = 0; p < nprocs; ++p)
+  {
+    send_offsets[p+1] = send_offsets[p] + send_counts[p];
+    receive_offsets[p+1] = receive_offsets[p] + receive_counts[p];
+  }
+  int num_received = receive_offsets[nprocs];
+  int* send_indices = polymec_malloc(sizeof(int) * MAX(num_rows, 1));
+  char* send_rows = polymec_malloc(row_size * MAX(num_rows, 1));
+  int next[nprocs];
+  memcpy(next, send_offsets, sizeof(int) * nprocs);
+  for (int i = 0; i < num_rows; ++i)
+  {
+    int j = next[owners[i]]++;
+    send_indices[j] = indices[i];
+    memcpy(&send_rows[row_size * j], &my_rows[row_size * i], row_size);
+  }
+  polymec_free(owners);
+
+  // Exchange the indices, then the rows (as bytes).
+  int* receive_indices = polymec_malloc(sizeof(int) * MAX(num_received, 1));
+  char* receive_rows = polymec_malloc(row_size * MAX(num_received, 1));
+  MPI_Alltoallv(send_indices, send_counts, send_offsets, MPI_INT, 
+                receive_indices, receive_counts, receive_offsets, MPI_INT, file->comm);
+  for (int p = 0; p <= nprocs; ++p)
+  {
+    if (p < nprocs)
+    {
+      send_counts[p] *= (int)row_size;
+      receive_counts[p] *= (int)row_size;
+    }
+    send_offsets[p] *= (int)row_size;
+    receive_offsets[p] *= (int)row_size;
+  }
+  MPI_Alltoallv(send_rows, send_counts, send_offsets, MPI_BYTE, 
+                receive_rows, receive_counts, receive_offsets, MPI_BYTE, file->comm);
+  for (int i = 0; i < num_received; ++i)
+  {
+    int j = receive_indices[i] - *first;
+    ASSERT((j >= 0) && (j < *num));
+    memcpy(&block[row_size * j], &receive_rows[row_size * i], row_size);
+  }
+
+  polymec_free(receive_rows);
+  polymec_free(receive_indices);
+  polymec_free(send_rows);
+  polymec_free(send_indices);
+  polymec_free(send_counts);
+  return block;
+}
+
+// Returns an array of global indices for num local entities, either copied 
+// from the given ones (which must be less than max_index) or (if ids is 
+// NULL) numbered consecutively in order of rank. Stores the number of 
+// distinct global indices in num_global.
+static int* global_indices(cf_file_t* file, int num, int* ids, int* num_global)
+{
+  int* global_ids = polymec_malloc(sizeof(int) * MAX(num, 1));
+  if (ids != NULL)
+  {
+    int max_id = -1;
+    for (int i = 0; i < num; ++i)
+    {
+      global_ids[i] = ids[i];
+      max_id = MAX(max_id, ids[i]);
+    }
+    MPI_Allreduce(&max_id, num_global, 1, MPI_INT, MPI_MAX, file->comm);
+    ++(*num_global);
+  }
+  else
+  {
+    int offset = 0;
+    MPI_Exscan(&num, &offset, 1, MPI_INT, MPI_SUM, file->comm);
+    if (file->rank == 0)
+      offset = 0;
+    for (int i = 0; i < num; ++i)
+      global_ids[i] = offset + i;
+    MPI_Allreduce(&num, num_global, 1, MPI_INT, MPI_SUM, file->comm);
+  }
+  return global_ids;
+}
+
+void cf_file_write_mesh(cf_file_t* file,
+                        const char* mesh_name,
+                        mesh_t* mesh,
+                        int* node_ids,
+                        int* face_ids)
+{
+  const char* func_name = "cf_file_write_mesh";
+
+  // Sizes of the local mesh.
+  int max_face_nodes = 0, max_cell_faces = 0, max_cell_face_nodes = 0;
+  for (int f = 0; f < mesh->num_faces; ++f)
+    max_face_nodes = MAX(max_face_nodes, mesh->face_node_offsets[f+1] - mesh->face_node_offsets[f]);
+  for (int c = 0; c < mesh->num_cells; ++c)
+  {
+    max_cell_faces = MAX(max_cell_faces, mesh->cell_face_offsets[c+1] - mesh->cell_face_offsets[c]);
+    int num_face_nodes = 0;
+    for (int i = mesh->cell_face_offsets[c]; i < mesh->cell_face_offsets[c+1]; ++i)
+    {
+      int f = mesh->cell_faces[i];
+      if (f < 0) f = ~f;
+      num_face_nodes += mesh->face_node_offsets[f+1] - mesh->face_node_offsets[f];
+    }
+    max_cell_face_nodes = MAX(max_cell_face_nodes, num_face_nodes);
+  }
+
+  // The nodes and shapes of our cells.
+  int num_cells = mesh->num_cells;
+  int* cell_node_offsets = polymec_malloc(sizeof(int) * (num_cells + 1));
+  int* cell_nodes = polymec_malloc(sizeof(int) * MAX(num_cells * max_cell_face_nodes, 1));
+  cf_mesh_shape_t* cell_shapes = polymec_malloc(sizeof(cf_mesh_shape_t) * MAX(num_cells, 1));
+  int max_cell_nodes = 0;
+  cell_node_offsets[0] = 0;
+  for (int c = 0; c < num_cells; ++c)
+  {
+    int num_nodes = get_cell_nodes(mesh, c, max_cell_face_nodes, 
+                                   &cell_nodes[cell_node_offsets[c]], &cell_shapes[c]);
+    cell_node_offsets[c+1] = cell_node_offsets[c] + num_nodes;
+    max_cell_nodes = MAX(max_cell_nodes, num_nodes);
+  }
+
+  // Global numbering and sizes. Cells aren't shared, so ours are numbered 
+  // consecutively in order of rank.
+  int num_global_nodes, num_global_faces, num_global_cells;
+  int* global_node_ids = global_indices(file, mesh->num_nodes, node_ids, &num_global_nodes);
+  int* global_face_ids = global_indices(file, mesh->num_faces, face_ids, &num_global_faces);
+  int first_cell = 0;
+  MPI_Exscan(&num_cells, &first_cell, 1, MPI_INT, MPI_SUM, file->comm);
+  if (file->rank == 0)
+    first_cell = 0;
+  MPI_Allreduce(&num_cells, &num_global_cells, 1, MPI_INT, MPI_SUM, file->comm);
+  int local_max[3] = {max_face_nodes, max_cell_nodes, max_cell_faces}, global_max[3];
+  MPI_Allreduce(local_max, global_max, 3, MPI_INT, MPI_MAX, file->comm);
+
+  cf_file_define_mesh(file, mesh_name, num_global_nodes, num_global_faces, num_global_cells, 
+                      global_max[0], global_max[1], global_max[2]);
+
+  // Each node and face is written once, by the process owning its block.
+  int first, num;
+  point_t* nodes = gather_rows(file, num_global_nodes, mesh->num_nodes, global_node_ids, 
+                               sizeof(point_t), mesh->nodes, &first, &num);
+  cf_file_write_mesh_nodes(file, first, num, nodes);
+  polymec_free(nodes);
+  int width = file->max_face_nodes;
+  int* padded = polymec_malloc(sizeof(int) * MAX(mesh->num_faces * width, 1));
+  pad_connectivity(func_name, width, 0, mesh->num_faces, mesh->face_node_offsets, 
+                   mesh->face_nodes, global_node_ids, padded);
+  int* faces = gather_rows(file, num_global_faces, mesh->num_faces, global_face_ids, 
+                           sizeof(int) * width, padded, &first, &num);
+  access_padded_connectivity(file, func_name, file->face_nodes_id, width, first, num, true, faces);
+  polymec_free(faces);
+  polymec_free(padded);
+
+  // Our cells.
+  width = MAX(file->max_cell_nodes, file->max_cell_faces);
+  padded = polymec_malloc(sizeof(int) * MAX(num_cells * width, 1));
+  pad_connectivity(func_name, file->max_cell_nodes, first_cell, num_cells, 
+                   cell_node_offsets, cell_nodes, global_node_ids, padded);
+  access_padded_connectivity(file, func_name, file->cell_nodes_id, file->max_cell_nodes, 
+                             first_cell, num_cells, true, padded);
+  pad_connectivity(func_name, file->max_cell_faces, first_cell, num_cells, 
+                   mesh->cell_face_offsets, mesh->cell_faces, global_face_ids, padded);
+  access_padded_connectivity(file, func_name, file->cell_faces_id, file->max_cell_faces, 
+                             first_cell, num_cells, true, padded);
+  access_cell_shapes(file, func_name, first_cell, num_cells, true, cell_shapes);
+  polymec_free(padded);
+
+  // Remember our portion of the mesh for writing variables.
+  file->first_local_node = ((node_ids == NULL) && (mesh->num_nodes > 0)) ? global_node_ids[0] : 0;
+  file->first_local_cell = first_cell;
+  file->num_local_nodes = mesh->num_nodes;
+  file->num_local_cells = num_cells;
+  if (file->local_node_ids != NULL)
+    polymec_free(file->local_node_ids);
+  file->local_node_ids = global_node_ids;
+
+  polymec_free(global_face_ids);
+  polymec_free(cell_shapes);
+  polymec_free(cell_nodes);
+  polymec_free(cell_node_offsets);
+}
+
+void cf_file_get_local_mesh_offsets(cf_file_t* file,
+                                    int* first_node,
+                                    int* first_cell)
+{
+  *first_node = file->first_local_node;
+  *first_cell = file->first_local_cell;
+}
+
+void cf_file_define_mesh_var(cf_file_t* file, 
+                             const char* var_name,
+                             cf_mesh_location_t location,
+                             bool time_dependent,
+                             const char* short_name,
+                             const char* long_name,
+                             const char* units)
+{
+  ASSERT(cf_file_has_mesh(file));
+  ASSERT(!cf_file_has_mesh_var(file, var_name));
+  ASSERT(!time_dependent || cf_file_has_time_series(file));
+
+  int dims[2], ndims = 0;
+  if (time_dependent)
+    dims[ndims++] = file->time_dim;
+  dims[ndims++] = (location == CF_MESH_NODE) ? file->node_dim : file->cell_dim;
+  int var_id = define_mesh_data(file, "cf_file_define_mesh_var", var_name, NC_REAL, 
+                                ndims, dims, ndims-1);
+  add_mesh_var(file, var_name, var_id, time_dependent, location);
+
+  // Metadata.
+  put_attribute(file->file_id, var_id, "mesh", file->mesh_name);
+  put_attribute(file->file_id, var_id, "location", (location == CF_MESH_NODE) ? "node" : "volume");
+  put_attribute(file->file_id, var_id, "short_name", short_name);
+  put_attribute(file->file_id, var_id, "long_name", long_name);
+  put_attribute(file->file_id, var_id, "units", units);
+}
+
+bool cf_file_has_mesh_var(cf_file_t* file,
+                          const char* var_name)
+{
+  return string_ptr_unordered_map_contains(file->mesh_vars, (char*)var_name);
+}
+
+// Reads or writes a range of values of a mesh variable.
+static void access_mesh_var(cf_file_t* file, 
+                            const char* func_name,
+                            const char* var_name,
+                            int time_index,
+                            int first,
+                            int num,
+                            bool writing,
+                            real_t* data)
+{
+  void** var_p = string_ptr_unordered_map_get(file->mesh_vars, (char*)var_name);
+  ASSERT(var_p != NULL);
+  cf_mesh_var_t* var = *var_p;
+  int num_entities = (var->location == CF_MESH_NODE) ? file->num_mesh_nodes : file->num_mesh_cells;
+  ASSERT(first >= 0);
+  ASSERT(num >= 0);
+  ASSERT(first + num <= num_entities);
+
+  size_t startp[2], countp[2];
+  int d = 0;
+  if (var->time_dependent)
   {
     ASSERT(time_index >= 0);
     ASSERT(time_index < cf_file_num_times(file));
+    startp[d] = (size_t)time_index;
+    countp[d++] = 1;
+  }
+  startp[d] = (size_t)first;
+  countp[d] = (size_t)num;
+  int err = (writing) ? nc_put_vara_real(file->file_id, var->id, startp, countp, data)
+                      : nc_get_vara_real(file->file_id, var->id, startp, countp, data);
+  if (err != NC_NOERR)
+  {
+    polymec_error("%s: Error %s data for var %s: %s", func_name, 
+                  (writing) ? "writing" : "reading", var_name, nc_strerror(err));
+  }
+}
 
-    // Size up the dimensions.
-    size_t lat_len, lon_len;
-    int err = nc_inq_dimlen(file->file_id, file->lat_dim, &lat_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_surface_var: Error getting lat dimension %s", nc_strerror(err));
-    err = nc_inq_dimlen(file->file_id, file->lon_dim, &lon_len);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_surface_var: Error getting lon dimension %s", nc_strerror(err));
+void cf_file_write_mesh_var(cf_file_t* file, 
+                            const char* var_name,
+                            int time_index, 
+                            int first,
+                            int num,
+                            real_t* var_data)
+{
+  access_mesh_var(file, "cf_file_write_mesh_var", var_name, time_index, 
+                  first, num, true, var_data);
+}
 
-    size_t startp[3] = {time_index, 0, 0};
-    size_t countp[3] = {1, lat_len, lon_len};
-    err = nc_get_vara(file->file_id, var_id, startp, countp, var_data);
-    if (err != NC_NOERR)
-      polymec_error("cf_file_read_latlon_surface_var: Error writing data for var %s: %s", var_name, nc_strerror(err));
+void cf_file_write_local_mesh_var(cf_file_t* file, 
+                                  const char* var_name,
+                                  int time_index, 
+                                  real_t* var_data)
+{
+  ASSERT(file->local_node_ids != NULL);
+  const char* func_name = "cf_file_write_local_mesh_var";
+  void** var_p = string_ptr_unordered_map_get(file->mesh_vars, (char*)var_name);
+  ASSERT(var_p != NULL);
+  cf_mesh_var_t* var = *var_p;
+  if (var->location == CF_MESH_CELL)
+  {
+    access_mesh_var(file, func_name, var_name, time_index, file->first_local_cell, 
+                    file->num_local_cells, true, var_data);
+  }
+  else
+  {
+    // Values at shared nodes are written once, like the nodes themselves.
+    int first, num;
+    real_t* values = gather_rows(file, file->num_mesh_nodes, file->num_local_nodes, 
+                                 file->local_node_ids, sizeof(real_t), var_data, 
+                                 &first, &num);
+    access_mesh_var(file, func_name, var_name, time_index, first, num, true, values);
+    polymec_free(values);
   }
 }
 
+void cf_file_read_mesh_var(cf_file_t* file, 
+                           const char* var_name,
+                           int time_index, 
+                           int first,
+                           int num,
+                           real_t* var_data)
+{
+  access_mesh_var(file, "cf_file_read_mesh_var", var_name, time_index, 
+                  first, num, false, var_data);
+}
+
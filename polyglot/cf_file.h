@@ -9,6 +9,7 @@
 #define POLYGLOT_CF_FILE_H
 
 #include "polyglot/polyglot.h"
+#include "core/mesh.h"
 
 // The CF file class provides an interface for reading and writing NetCDF 
 // files adhering to the Climate/Forecast conventions, the details of which 
@@ -21,14 +22,20 @@
 // This type provides the interface for CF files.
 typedef struct cf_file_t cf_file_t;
 
-// Opens a new CF file for writing simulation data, returning the CF 
-// file object. 
-cf_file_t* cf_file_new(const char* filename);
-
-// Opens an existing CF file for reading simulation data, returning the CF 
-// file object, or NULL if the file is not found or can't be opened, OR if 
-// the file is a NetCDF file that doesn't follow the CF conventions.
-cf_file_t* cf_file_open(const char* filename);
+// Opens a new CF file for writing simulation data on the processes in the 
+// given communicator, returning the CF file object. If the communicator has 
+// more than one process, the file is opened for parallel access, and all 
+// functions that define metadata or append times must be called by every 
+// process.
+cf_file_t* cf_file_new(MPI_Comm comm, const char* filename);
+
+// Opens an existing CF file for reading simulation data on the processes in 
+// the given communicator, returning the CF file object, or NULL if the file 
+// is not found or can't be opened, OR if the file is a NetCDF file that 
+// doesn't follow the CF conventions. If the file can't be opened for 
+// parallel access (for example, if it isn't a NetCDF4/HDF5 file), each 
+// process reads it independently.
+cf_file_t* cf_file_open(MPI_Comm comm, const char* filename);
 
 // Closes and destroys the given CF file handle. If the CF file was opened 
 // for writing, this flushes all buffers to disk.
@@ -227,6 +234,10 @@ void cf_file_read_latlon_grid(cf_file_t* file,
 // an integer index identifying that time.
 int cf_file_append_time(cf_file_t* file, real_t t);
 
+// Appends num_times times to the time series in the grid in a single write, 
+// returning the index of the first of them.
+int cf_file_append_times(cf_file_t* file, int num_times, real_t* times);
+
 // Writes a variable that is defined on the points of a lat-lon grid, 
 // specifying a time index that associates this entry with a given time. This 
 // time index is ignored if the variable is not time dependent.
@@ -259,4 +270,366 @@ void cf_file_read_latlon_surface_var(cf_file_t* file,
                                      int time_index, 
                                      real_t* var_data);
 
+// This type describes a window within a lat-lon grid: a range of indices 
+// along each of the latitudinal, longitudinal, and vertical dimensions, with 
+// strides that select every n-th point (a stride of 0 is treated as 1). 
+// A longitude window may run past the last longitude point, in which case 
+// it wraps around to the first (crossing the seam of a global grid). The 
+// vertical range is ignored for surface variables.
+typedef struct
+{
+  int lat_start, lat_count, lat_stride;
+  int lon_start, lon_count, lon_stride;
+  int lev_start, lev_count, lev_stride;
+} cf_latlon_window_t;
+
+// Writes the given window of a variable defined on the points of a lat-lon 
+// grid at the given time index (ignored if the variable is not 
+// time-dependent). var_data is stored in (vertical, lat, lon) order, with 
+// dimensions equal to the window's counts.
+void cf_file_write_latlon_var_window(cf_file_t* file, 
+                                     const char* var_name,
+                                     int time_index, 
+                                     cf_latlon_window_t* window,
+                                     real_t* var_data);
+
+// Reads the given window of a variable defined on the points of a lat-lon 
+// grid at the given time index (ignored if the variable is not 
+// time-dependent) into var_data, which is stored in (vertical, lat, lon) 
+// order, with dimensions equal to the window's counts.
+void cf_file_read_latlon_var_window(cf_file_t* file, 
+                                    const char* var_name,
+                                    int time_index, 
+                                    cf_latlon_window_t* window,
+                                    real_t* var_data);
+
+// Writes the given window of a surface variable defined on a lat-lon grid
+// at the given time index (ignored if the variable is not time-dependent). 
+// var_data is stored in (lat, lon) order.
+void cf_file_write_latlon_surface_var_window(cf_file_t* file, 
+                                             const char* var_name,
+                                             int time_index, 
+                                             cf_latlon_window_t* window,
+                                             real_t* var_data);
+
+// Reads the given window of a surface variable defined on a lat-lon grid
+// at the given time index (ignored if the variable is not time-dependent) 
+// into var_data, which is stored in (lat, lon) order.
+void cf_file_read_latlon_surface_var_window(cf_file_t* file, 
+                                            const char* var_name,
+                                            int time_index, 
+                                            cf_latlon_window_t* window,
+                                            real_t* var_data);
+
+// Returns true if the given file is open for parallel access by the 
+// processes in its communicator, false if each process accesses it alone.
+bool cf_file_is_parallel(cf_file_t* file);
+
+// Selects collective (true) or independent (false) access for variable data 
+// in a file open for parallel access. In collective mode (the default), every 
+// process must take part in each read or write of variable data, though it 
+// may transfer a different window. Appending times and writing to 
+// time-dependent variables requires collective access.
+void cf_file_set_collective_io(cf_file_t* file, bool collective);
+
+// Fetches the window of the lat-lon grid owned by this process when the grid 
+// is divided into tiles among the processes in the file's communicator. The 
+// processes are arranged into latitude bands of num_lon_tiles tiles each, 
+// so num_lon_tiles == 1 gives a decomposition into latitude bands. The 
+// number of processes must be divisible by num_lon_tiles. The window spans 
+// all vertical levels.
+void cf_file_get_local_latlon_window(cf_file_t* file,
+                                     int num_lon_tiles,
+                                     cf_latlon_window_t* window);
+
+// Writes num_times consecutive time slices of a time-dependent variable 
+// defined on the points of a lat-lon grid, starting at the given time index, 
+// in a single write. var_data is stored in (time, vertical, lat, lon) order. 
+// The times must already have been appended to the file.
+void cf_file_write_latlon_var_times(cf_file_t* file, 
+                                    const char* var_name,
+                                    int first_time_index, 
+                                    int num_times,
+                                    real_t* var_data);
+
+// Reads num_times consecutive time slices of a time-dependent variable 
+// defined on the points of a lat-lon grid, starting at the given time index, 
+// into var_data, stored in (time, vertical, lat, lon) order.
+void cf_file_read_latlon_var_times(cf_file_t* file, 
+                                   const char* var_name,
+                                   int first_time_index, 
+                                   int num_times,
+                                   real_t* var_data);
+
+// Writes num_times consecutive time slices of a time-dependent surface 
+// variable, starting at the given time index, in a single write. var_data 
+// is stored in (time, lat, lon) order.
+void cf_file_write_latlon_surface_var_times(cf_file_t* file, 
+                                            const char* var_name,
+                                            int first_time_index, 
+                                            int num_times,
+                                            real_t* var_data);
+
+// Reads num_times consecutive time slices of a time-dependent surface 
+// variable, starting at the given time index, into var_data, stored in 
+// (time, lat, lon) order.
+void cf_file_read_latlon_surface_var_times(cf_file_t* file, 
+                                           const char* var_name,
+                                           int first_time_index, 
+                                           int num_times,
+                                           real_t* var_data);
+
+// Reads the values of a time-dependent lat-lon variable at every time in 
+// the file's time series at the grid point with the given vertical, 
+// latitudinal and longitudinal indices. values must be large enough to 
+// hold cf_file_num_times(file) values.
+void cf_file_read_latlon_var_time_series(cf_file_t* file, 
+                                         const char* var_name,
+                                         int lev_index,
+                                         int lat_index,
+                                         int lon_index,
+                                         real_t* values);
+
+// Reads the values of a time-dependent surface variable at every time in 
+// the file's time series at the grid point with the given latitudinal and 
+// longitudinal indices.
+void cf_file_read_latlon_surface_var_time_series(cf_file_t* file, 
+                                                 const char* var_name,
+                                                 int lat_index,
+                                                 int lon_index,
+                                                 real_t* values);
+
+// Defines a (3D) lat-lon variable like cf_file_define_latlon_var, but stores 
+// its values as 16-bit integers packed according to the CF conventions: a 
+// value x is stored as round((x - add_offset) / scale_factor), clamped to 
+// [-32767, 32767]. NaNs are stored as the fill value -32768. Values are 
+// packed when written and unpacked when read (with fill values read as 
+// NaN), so the variable is accessed through real_t buffers like any other. 
+// Byte, short, int, float, and double variables with scale_factor or 
+// add_offset attributes in files that are opened for reading are unpacked 
+// the same way, with values equal to their _FillValue or missing_value 
+// attributes read as NaN.
+void cf_file_define_packed_latlon_var(cf_file_t* file, 
+                                      const char* var_name,
+                                      bool time_dependent,
+                                      real_t scale_factor,
+                                      real_t add_offset,
+                                      const char* short_name,
+                                      const char* long_name,
+                                      const char* units);
+
+// Defines a 2D lat-lon surface variable whose values are packed into 16-bit 
+// integers, as in cf_file_define_packed_latlon_var.
+void cf_file_define_packed_latlon_surface_var(cf_file_t* file, 
+                                              const char* var_name,
+                                              bool time_dependent,
+                                              real_t scale_factor,
+                                              real_t add_offset,
+                                              const char* short_name,
+                                              const char* long_name,
+                                              const char* units);
+
+// Returns true if the given lat-lon (or surface) variable is packed, 
+// storing its scale factor and offset in the given locations, or false if 
+// it's not (in which case they are set to 1 and 0).
+bool cf_file_get_packing(cf_file_t* file,
+                         const char* var_name,
+                         real_t* scale_factor,
+                         real_t* add_offset);
+
+// Unstructured meshes are stored following the UGRID conventions 
+// (http://ugrid-conventions.github.io/ugrid-conventions/) for 3D meshes: 
+// a mesh topology variable, node coordinates, face->node, cell 
+// (volume)->node, and cell->face connectivity, padded with -1 to the 
+// largest number of nodes per face, nodes per cell, and faces per cell, and 
+// the shape of each cell. Indices start at 0. Mesh data is stored in chunks 
+// and (unless written in parallel) compressed.
+
+// Locations for variables defined on an unstructured mesh.
+typedef enum
+{
+  CF_MESH_NODE,
+  CF_MESH_CELL
+} cf_mesh_location_t;
+
+// Cell shapes (the UGRID volume_shape_type). The nodes of a tetrahedron, 
+// pyramid, wedge, or hexahedron start with those of a base face (a 
+// triangle for a wedge, a quadrilateral for a pyramid), ordered 
+// counterclockwise as seen from inside the cell, followed by the apex or 
+// by the nodes joined to the base nodes in the same order. The nodes of 
+// other polyhedra appear in the order in which they are first found in the 
+// cell's faces.
+typedef enum
+{
+  CF_MESH_TETRAHEDRON,
+  CF_MESH_PYRAMID,
+  CF_MESH_WEDGE,
+  CF_MESH_HEXAHEDRON,
+  CF_MESH_POLYHEDRON
+} cf_mesh_shape_t;
+
+// Defines an unstructured mesh with the given name and (global) numbers of 
+// nodes, faces, and cells, and maximum numbers of nodes per face, nodes per 
+// cell, and faces per cell. Its data is written with the 
+// cf_file_write_mesh_* functions, which may each be called by several 
+// processes for different ranges.
+void cf_file_define_mesh(cf_file_t* file,
+                         const char* mesh_name,
+                         int num_nodes,
+                         int num_faces,
+                         int num_cells,
+                         int max_face_nodes,
+                         int max_cell_nodes,
+                         int max_cell_faces);
+
+// Returns true if the CF file contains an unstructured mesh, false if not.
+bool cf_file_has_mesh(cf_file_t* file);
+
+// Fetches the name and sizes of the unstructured mesh in the given file. 
+// mesh_name must be able to hold POLYGLOT_CF_MAX_NAME+1 characters.
+void cf_file_get_mesh_metadata(cf_file_t* file,
+                               char* mesh_name,
+                               int* num_nodes,
+                               int* num_faces,
+                               int* num_cells,
+                               int* max_face_nodes,
+                               int* max_cell_nodes,
+                               int* max_cell_faces);
+
+// Writes the positions of num_nodes nodes of the mesh, starting with 
+// first_node.
+void cf_file_write_mesh_nodes(cf_file_t* file,
+                              int first_node,
+                              int num_nodes,
+                              point_t* nodes);
+
+// Reads the positions of num_nodes nodes of the mesh, starting with 
+// first_node.
+void cf_file_read_mesh_nodes(cf_file_t* file,
+                             int first_node,
+                             int num_nodes,
+                             point_t* nodes);
+
+// Writes the nodes of num_faces faces of the mesh, starting with first_face. 
+// The nodes of the ith face are face_nodes[face_node_offsets[i]] through 
+// face_nodes[face_node_offsets[i+1]-1].
+void cf_file_write_mesh_faces(cf_file_t* file,
+                              int first_face,
+                              int num_faces,
+                              int* face_node_offsets,
+                              int* face_nodes);
+
+// Reads the nodes of num_faces faces of the mesh, starting with first_face, 
+// in the same format as cf_file_write_mesh_faces. face_node_offsets must 
+// hold num_faces+1 values, and face_nodes num_faces * max_face_nodes.
+void cf_file_read_mesh_faces(cf_file_t* file,
+                             int first_face,
+                             int num_faces,
+                             int* face_node_offsets,
+                             int* face_nodes);
+
+// Writes the faces of num_cells cells of the mesh, starting with first_cell, 
+// in the same format as cf_file_write_mesh_faces. Faces stored as ~face 
+// (to indicate their orientation) are written as face.
+void cf_file_write_mesh_cells(cf_file_t* file,
+                              int first_cell,
+                              int num_cells,
+                              int* cell_face_offsets,
+                              int* cell_faces);
+
+// Reads the faces of num_cells cells of the mesh, starting with first_cell, 
+// in the same format as cf_file_read_mesh_faces. cell_faces must hold 
+// num_cells * max_cell_faces values.
+void cf_file_read_mesh_cells(cf_file_t* file,
+                             int first_cell,
+                             int num_cells,
+                             int* cell_face_offsets,
+                             int* cell_faces);
+
+// Writes the nodes and shapes of num_cells cells of the mesh, starting with 
+// first_cell, in the same format as cf_file_write_mesh_faces. The nodes of 
+// each cell are ordered as described for cf_mesh_shape_t.
+void cf_file_write_mesh_cell_nodes(cf_file_t* file,
+                                   int first_cell,
+                                   int num_cells,
+                                   int* cell_node_offsets,
+                                   int* cell_nodes,
+                                   cf_mesh_shape_t* cell_shapes);
+
+// Reads the nodes and shapes of num_cells cells of the mesh, starting with 
+// first_cell, in the same format as cf_file_read_mesh_faces. cell_nodes must 
+// hold num_cells * max_cell_nodes values. cell_shapes may be NULL.
+void cf_file_read_mesh_cell_nodes(cf_file_t* file,
+                                  int first_cell,
+                                  int num_cells,
+                                  int* cell_node_offsets,
+                                  int* cell_nodes,
+                                  cf_mesh_shape_t* cell_shapes);
+
+// Defines and writes the given (polyhedral) mesh with the given name. This 
+// is a collective operation: each process writes its own cells (ghost 
+// cells are not written) along with their faces and nodes. node_ids and 
+// face_ids give the global index of each of the mesh's nodes and faces; 
+// nodes and faces shared by processes must have the same global index on 
+// each, and are written only once. The global indices of nodes (and faces) 
+// must run from 0 to the number of distinct nodes (faces) minus 1. If 
+// node_ids (face_ids) is NULL, the nodes (faces) of each process are 
+// numbered consecutively in order of rank, and shared ones are written once 
+// for each process that has them.
+void cf_file_write_mesh(cf_file_t* file,
+                        const char* mesh_name,
+                        mesh_t* mesh,
+                        int* node_ids,
+                        int* face_ids);
+
+// Fetches the global indices of the first node and first cell of this 
+// process's portion of a mesh written with cf_file_write_mesh. The node 
+// offset is meaningful only if the mesh was written without node_ids.
+void cf_file_get_local_mesh_offsets(cf_file_t* file,
+                                    int* first_node,
+                                    int* first_cell);
+
+// Defines a variable on the nodes or cells of the file's unstructured mesh.
+// If the variable is time-dependent, its dimensions will be (time, entity);
+// otherwise it has the single dimension (entity).
+void cf_file_define_mesh_var(cf_file_t* file, 
+                             const char* var_name,
+                             cf_mesh_location_t location,
+                             bool time_dependent,
+                             const char* short_name,
+                             const char* long_name,
+                             const char* units);
+
+// Returns true if this file contains a mesh variable with the given name,
+// false otherwise.
+bool cf_file_has_mesh_var(cf_file_t* file,
+                          const char* var_name);
+
+// Writes num values of a mesh variable for the entities starting at first, 
+// at the given time index (ignored if the variable is not time-dependent).
+void cf_file_write_mesh_var(cf_file_t* file, 
+                            const char* var_name,
+                            int time_index, 
+                            int first,
+                            int num,
+                            real_t* var_data);
+
+// Writes the values of a mesh variable for this process's nodes or (non-ghost)
+// cells of a mesh written with cf_file_write_mesh, at the given time index 
+// (ignored if the variable is not time-dependent). This is a collective 
+// operation.
+void cf_file_write_local_mesh_var(cf_file_t* file, 
+                                  const char* var_name,
+                                  int time_index, 
+                                  real_t* var_data);
+
+// Reads num values of a mesh variable for the entities starting at first, 
+// at the given time index (ignored if the variable is not time-dependent).
+void cf_file_read_mesh_var(cf_file_t* file, 
+                           const char* var_name,
+                           int time_index, 
+                           int first,
+                           int num,
+                           real_t* var_data);
+
 #endif
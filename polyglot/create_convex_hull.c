@@ -5,59 +5,527 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-#include "core/dlist.h"
+#include "core/array.h"
 #include "core/permutations.h"
-#include "geometry/create_convex_hull.h"
+#include "polyglot/robust_predicates.h"
+#include "polyglot/create_convex_hull.h"
 
-point_t* create_convex_hull(point_t* points, int num_points, int* hull_size)
+// This implementation of convex hull is given in pseudocode in Chapter 11 
+// of _Computational_Geometry_ by de Berg et al (1997). The points are 
+// inserted in random order. A conflict graph links each face of the current 
+// hull to the points not yet inserted that can see it, so inserting a point 
+// finds the faces it sees without searching, and the conflicts of each new 
+// face are drawn from those of the two faces that met at its horizon edge. 
+// A point sees a face if it lies strictly beyond its plane, which we decide 
+// with the filtered orientation predicate.
+
+// Working storage for building a hull. Faces are numbered in the order they 
+// are created and are never reused; a face that has been removed has -1 as 
+// its first vertex.
+typedef struct
+{
+  point_t* points;
+
+  int num_faces, face_capacity;
+  int* face_vertices;
+  int* face_neighbors;
+  int* face_conflicts;
+  bool* face_visible;
+
+  // Each conflict joins a point and a face that it sees, and belongs to a 
+  // doubly-linked list of the conflicts of each. Removed conflicts are kept 
+  // in a free list linked by next_in_face.
+  int num_conflicts, conflict_capacity, free_conflicts;
+  int* conflict_points;
+  int* conflict_faces;
+  int* next_in_face;
+  int* prev_in_face;
+  int* next_in_point;
+  int* prev_in_point;
+
+  // The first conflict of each point, the new face whose horizon edge 
+  // starts at each point, and the new face for which each point was last 
+  // considered as a conflict.
+  int* point_conflicts;
+  int* horizon_faces;
+  int* marks;
+
+  // Faces visible from the point being inserted, the new faces, and for 
+  // each new face the removed and the remaining face across its horizon edge.
+  int_array_t* visible;
+  int_array_t* new_faces;
+  int_array_t* horizon;
+
+  // Batched visibility tests.
+  int test_capacity;
+  int* tested_points;
+  point_t** test_points[4];
+  real_t* orientations;
+} hull_builder_t;
+
+static hull_builder_t* hull_builder_new(point_t* points, int num_points)
+{
+  hull_builder_t* b = polymec_malloc(sizeof(hull_builder_t));
+  b->points = points;
+  b->num_faces = 0;
+  b->face_capacity = MAX(16, 2 * num_points);
+  b->face_vertices = polymec_malloc(sizeof(int) * 3 * b->face_capacity);
+  b->face_neighbors = polymec_malloc(sizeof(int) * 3 * b->face_capacity);
+  b->face_conflicts = polymec_malloc(sizeof(int) * b->face_capacity);
+  b->face_visible = polymec_malloc(sizeof(bool) * b->face_capacity);
+  b->num_conflicts = 0;
+  b->conflict_capacity = MAX(16, 2 * num_points);
+  b->free_conflicts = -1;
+  b->conflict_points = polymec_malloc(sizeof(int) * b->conflict_capacity);
+  b->conflict_faces = polymec_malloc(sizeof(int) * b->conflict_capacity);
+  b->next_in_face = polymec_malloc(sizeof(int) * b->conflict_capacity);
+  b->prev_in_face = polymec_malloc(sizeof(int) * b->conflict_capacity);
+  b->next_in_point = polymec_malloc(sizeof(int) * b->conflict_capacity);
+  b->prev_in_point = polymec_malloc(sizeof(int) * b->conflict_capacity);
+  b->point_conflicts = polymec_malloc(sizeof(int) * num_points);
+  b->horizon_faces = polymec_malloc(sizeof(int) * num_points);
+  b->marks = polymec_malloc(sizeof(int) * num_points);
+  for (int i = 0; i < num_points; ++i)
+  {
+    b->point_conflicts[i] = -1;
+    b->marks[i] = -1;
+  }
+  b->visible = int_array_new();
+  b->new_faces = int_array_new();
+  b->horizon = int_array_new();
+  b->test_capacity = 0;
+  b->tested_points = NULL;
+  for (int i = 0; i < 4; ++i)
+    b->test_points[i] = NULL;
+  b->orientations = NULL;
+  return b;
+}
+
+static void hull_builder_free(hull_builder_t* b)
+{
+  polymec_free(b->face_vertices);
+  polymec_free(b->face_neighbors);
+  polymec_free(b->face_conflicts);
+  polymec_free(b->face_visible);
+  polymec_free(b->conflict_points);
+  polymec_free(b->conflict_faces);
+  polymec_free(b->next_in_face);
+  polymec_free(b->prev_in_face);
+  polymec_free(b->next_in_point);
+  polymec_free(b->prev_in_point);
+  polymec_free(b->point_conflicts);
+  polymec_free(b->horizon_faces);
+  polymec_free(b->marks);
+  int_array_free(b->visible);
+  int_array_free(b->new_faces);
+  int_array_free(b->horizon);
+  if (b->test_capacity > 0)
+  {
+    polymec_free(b->tested_points);
+    for (int i = 0; i < 4; ++i)
+      polymec_free(b->test_points[i]);
+    polymec_free(b->orientations);
+  }
+  polymec_free(b);
+}
+
+static int add_face(hull_builder_t* b, int v0, int v1, int v2)
+{
+  if (b->num_faces == b->face_capacity)
+  {
+    b->face_capacity *= 2;
+    b->face_vertices = polymec_realloc(b->face_vertices, sizeof(int) * 3 * b->face_capacity);
+    b->face_neighbors = polymec_realloc(b->face_neighbors, sizeof(int) * 3 * b->face_capacity);
+    b->face_conflicts = polymec_realloc(b->face_conflicts, sizeof(int) * b->face_capacity);
+    b->face_visible = polymec_realloc(b->face_visible, sizeof(bool) * b->face_capacity);
+  }
+  int f = b->num_faces++;
+  b->face_vertices[3*f] = v0;
+  b->face_vertices[3*f+1] = v1;
+  b->face_vertices[3*f+2] = v2;
+  b->face_neighbors[3*f] = b->face_neighbors[3*f+1] = b->face_neighbors[3*f+2] = -1;
+  b->face_conflicts[f] = -1;
+  b->face_visible[f] = false;
+  return f;
+}
+
+static void add_conflict(hull_builder_t* b, int p, int f)
+{
+  int k = b->free_conflicts;
+  if (k != -1)
+    b->free_conflicts = b->next_in_face[k];
+  else
+  {
+    if (b->num_conflicts == b->conflict_capacity)
+    {
+      b->conflict_capacity *= 2;
+      b->conflict_points = polymec_realloc(b->conflict_points, sizeof(int) * b->conflict_capacity);
+      b->conflict_faces = polymec_realloc(b->conflict_faces, sizeof(int) * b->conflict_capacity);
+      b->next_in_face = polymec_realloc(b->next_in_face, sizeof(int) * b->conflict_capacity);
+      b->prev_in_face = polymec_realloc(b->prev_in_face, sizeof(int) * b->conflict_capacity);
+      b->next_in_point = polymec_realloc(b->next_in_point, sizeof(int) * b->conflict_capacity);
+      b->prev_in_point = polymec_realloc(b->prev_in_point, sizeof(int) * b->conflict_capacity);
+    }
+    k = b->num_conflicts++;
+  }
+  b->conflict_points[k] = p;
+  b->conflict_faces[k] = f;
+  b->prev_in_face[k] = -1;
+  b->next_in_face[k] = b->face_conflicts[f];
+  if (b->face_conflicts[f] != -1)
+    b->prev_in_face[b->face_conflicts[f]] = k;
+  b->face_conflicts[f] = k;
+  b->prev_in_point[k] = -1;
+  b->next_in_point[k] = b->point_conflicts[p];
+  if (b->point_conflicts[p] != -1)
+    b->prev_in_point[b->point_conflicts[p]] = k;
+  b->point_conflicts[p] = k;
+}
+
+// Removes the face f and all of its conflicts.
+static void remove_face(hull_builder_t* b, int f)
+{
+  int k = b->face_conflicts[f];
+  while (k != -1)
+  {
+    int next = b->next_in_face[k];
+    int p = b->conflict_points[k];
+    if (b->prev_in_point[k] != -1)
+      b->next_in_point[b->prev_in_point[k]] = b->next_in_point[k];
+    else
+      b->point_conflicts[p] = b->next_in_point[k];
+    if (b->next_in_point[k] != -1)
+      b->prev_in_point[b->next_in_point[k]] = b->prev_in_point[k];
+    b->next_in_face[k] = b->free_conflicts;
+    b->free_conflicts = k;
+    k = next;
+  }
+  b->face_conflicts[f] = -1;
+  b->face_vertices[3*f] = -1;
+  b->face_visible[f] = false;
+}
+
+// Makes room for num_tests batched visibility tests.
+static void reserve_tests(hull_builder_t* b, int num_tests)
+{
+  if (num_tests > b->test_capacity)
+  {
+    b->test_capacity = MAX(num_tests, 2 * b->test_capacity);
+    b->tested_points = polymec_realloc(b->tested_points, sizeof(int) * b->test_capacity);
+    for (int i = 0; i < 4; ++i)
+      b->test_points[i] = polymec_realloc(b->test_points[i], sizeof(point_t*) * b->test_capacity);
+    b->orientations = polymec_realloc(b->orientations, sizeof(real_t) * b->test_capacity);
+  }
+}
+
+// Adds conflicts between the face f and those of the num_tests points in 
+// tested_points that see it.
+static void add_visible_conflicts(hull_builder_t* b, int f, int num_tests)
 {
-  // This implementation of convex hull is given in pseudocode in 
-  // Chapter 11 of _Computational_Geometry_ by de Berg et al (1997).
-
-  // We store the indices of the points in the convex hull in a doubly-linked 
-  // list named hull.
-  int_dlist_t* hull = int_dlist_new();
-
-  // Find 4 points that form a tetrahedron. 
-  int i0 = 0, i1 = 1, i2 = 2;
-  while (points_are_colinear(&points[i0], &points[i1], &points[i2]) && 
-         (i2 < num_points))
-    ++i2;
-  if (i2 == num_points)
-    polymec_error("create_convex_hull: all points are colinear.");
-  int i3 = (i2 == 2) ? 3 : 2;
-  while (points_are_coplanar(&points[i0], &points[i1], &points[i2], &points[i3]) && 
-         (i3 < num_points))
-    ++i3;
-  if (i3 == num_points)
-    polymec_error("create_convex_hull: all points are coplanar.");
-
-  // Insert these points into the convex hull.
-  int_dlist_append(hull, i0);
-  int_dlist_append(hull, i1);
-  int_dlist_append(hull, i2);
-  int_dlist_append(hull, i3);
-
-  // Create a random permutation of the remaining points.
-  int perm[num_points-4];
+  int* v = &b->face_vertices[3*f];
+  for (int i = 0; i < num_tests; ++i)
+  {
+    b->test_points[0][i] = &b->points[v[0]];
+    b->test_points[1][i] = &b->points[v[1]];
+    b->test_points[2][i] = &b->points[v[2]];
+    b->test_points[3][i] = &b->points[b->tested_points[i]];
+  }
+  robust_orientations(num_tests, b->test_points[0], b->test_points[1], 
+                      b->test_points[2], b->test_points[3], b->orientations);
+  for (int i = 0; i < num_tests; ++i)
+  {
+    if (b->orientations[i] > 0.0)
+      add_conflict(b, b->tested_points[i], f);
+  }
+}
+
+// Inserts the point p into the hull, if it lies outside it.
+static void insert_point(hull_builder_t* b, int p)
+{
+  if (b->point_conflicts[p] == -1)
+    return;
+
+  // The faces that p sees are its conflicts.
+  int_array_clear(b->visible);
+  for (int k = b->point_conflicts[p]; k != -1; k = b->next_in_point[k])
+  {
+    int f = b->conflict_faces[k];
+    b->face_visible[f] = true;
+    int_array_append(b->visible, f);
+  }
+
+  // Each edge between a visible face and a hidden one lies on the horizon, 
+  // and gets a new face joining it to p.
+  int_array_clear(b->new_faces);
+  int_array_clear(b->horizon);
+  for (size_t i = 0; i < b->visible->size; ++i)
+  {
+    int f = b->visible->data[i];
+    for (int j = 0; j < 3; ++j)
+    {
+      int g = b->face_neighbors[3*f+j];
+      if (b->face_visible[g])
+        continue;
+      int v1 = b->face_vertices[3*f+(j+1)%3], v2 = b->face_vertices[3*f+(j+2)%3];
+      int h = add_face(b, v1, v2, p);
+      b->face_neighbors[3*h+2] = g;
+      for (int k = 0; k < 3; ++k)
+      {
+        if (b->face_neighbors[3*g+k] == f)
+          b->face_neighbors[3*g+k] = h;
+      }
+      b->horizon_faces[v1] = h;
+      int_array_append(b->new_faces, h);
+      int_array_append(b->horizon, f);
+      int_array_append(b->horizon, g);
+    }
+  }
+
+  // The horizon is a cycle, so each new face meets the one whose horizon 
+  // edge starts where its own ends.
+  for (size_t i = 0; i < b->new_faces->size; ++i)
+  {
+    int h = b->new_faces->data[i];
+    int n = b->horizon_faces[b->face_vertices[3*h+1]];
+    b->face_neighbors[3*h] = n;
+    b->face_neighbors[3*n+1] = h;
+  }
+
+  // A point that sees a new face saw one of the faces that met at its 
+  // horizon edge.
+  for (size_t i = 0; i < b->new_faces->size; ++i)
+  {
+    int h = b->new_faces->data[i];
+    int num_tests = 0;
+    for (int l = 0; l < 2; ++l)
+    {
+      int f = b->horizon->data[2*i+l];
+      for (int k = b->face_conflicts[f]; k != -1; k = b->next_in_face[k])
+      {
+        int q = b->conflict_points[k];
+        if ((q != p) && (b->marks[q] != h))
+        {
+          b->marks[q] = h;
+          reserve_tests(b, num_tests + 1);
+          b->tested_points[num_tests++] = q;
+        }
+      }
+    }
+    add_visible_conflicts(b, h, num_tests);
+  }
+
+  for (size_t i = 0; i < b->visible->size; ++i)
+    remove_face(b, b->visible->data[i]);
+}
+
+convex_hull_t* convex_hull_new(point_t* points, int num_points)
+{
+  if (num_points < 4)
+    polymec_error("convex_hull_new: at least 4 points are needed.");
+
+  // Find 4 points that form a tetrahedron.
+  int i0 = 0, i1 = 1;
+  while ((i1 < num_points) && (point_distance(&points[i0], &points[i1]) == 0.0))
+    ++i1;
+  int i2 = -1;
+  for (int i = i1+1; (i < num_points) && (i2 == -1); ++i)
+  {
+    vector_t u, v, uxv;
+    point_displacement(&points[i0], &points[i1], &u);
+    point_displacement(&points[i0], &points[i], &v);
+    vector_cross(&u, &v, &uxv);
+    if (vector_mag(&uxv) > 0.0)
+      i2 = i;
+  }
+  if (i2 == -1)
+    polymec_error("convex_hull_new: all points are colinear.");
+  int i3 = -1;
+  real_t o = 0.0;
+  for (int i = 0; (i < num_points) && (i3 == -1); ++i)
+  {
+    o = robust_orientation(&points[i0], &points[i1], &points[i2], &points[i]);
+    if (o != 0.0)
+      i3 = i;
+  }
+  if (i3 == -1)
+    polymec_error("convex_hull_new: all points are coplanar.");
+  if (o < 0.0)
+  {
+    int i = i0;
+    i0 = i1;
+    i1 = i;
+  }
+
+  // Its faces, which turn counterclockwise as seen from outside since it is 
+  // positively oriented.
+  hull_builder_t* b = hull_builder_new(points, num_points);
+  int tet[4] = {i0, i1, i2, i3};
+  add_face(b, i0, i2, i1);
+  add_face(b, i0, i1, i3);
+  add_face(b, i1, i2, i3);
+  add_face(b, i0, i3, i2);
+  for (int f = 0; f < 4; ++f)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      int v1 = b->face_vertices[3*f+(j+1)%3], v2 = b->face_vertices[3*f+(j+2)%3];
+      for (int g = 0; g < 4; ++g)
+      {
+        for (int k = 0; k < 3; ++k)
+        {
+          if ((b->face_vertices[3*g+k] == v2) && (b->face_vertices[3*g+(k+1)%3] == v1))
+            b->face_neighbors[3*f+j] = g;
+        }
+      }
+    }
+  }
+
+  // Find the conflicts of the remaining points, which we insert in random 
+  // order.
+  int* order = polymec_malloc(sizeof(int) * num_points);
   rng_t* rng = host_rng_new();
-  random_permutation(num_points-4, rng, perm);
-  for (int i = 0; i < num_points-4; ++i)
-    perm[i] += 4;
+  random_permutation(num_points, rng, order);
+  rng_free(rng);
+  int num_remaining = 0;
+  for (int i = 0; i < num_points; ++i)
+  {
+    int p = order[i];
+    if ((p != tet[0]) && (p != tet[1]) && (p != tet[2]) && (p != tet[3]))
+      order[num_remaining++] = p;
+  }
+  reserve_tests(b, num_remaining);
+  for (int f = 0; f < 4; ++f)
+  {
+    memcpy(b->tested_points, order, sizeof(int) * num_remaining);
+    add_visible_conflicts(b, f, num_remaining);
+  }
+
+  for (int i = 0; i < num_remaining; ++i)
+    insert_point(b, order[i]);
+  polymec_free(order);
 
-  // Create the array of points from our linked list.
-  point_t* hull_points = polymec_malloc(sizeof(point_t) * hull->size);
-  int_dlist_node_t* node = NULL;
-  int index, i = 0;
-  while (int_dlist_next(hull, &node, &index))
+  // Gather the faces that remain.
+  convex_hull_t* hull = polymec_malloc(sizeof(convex_hull_t));
+  hull->points = points;
+  hull->num_points = num_points;
+  int* face_index = polymec_malloc(sizeof(int) * b->num_faces);
+  hull->num_faces = 0;
+  for (int f = 0; f < b->num_faces; ++f)
   {
-    hull_points[i] = points[index];
-    ++i; 
+    face_index[f] = hull->num_faces;
+    if (b->face_vertices[3*f] != -1)
+      ++hull->num_faces;
   }
-  *hull_size = hull->size;
+  hull->faces = polymec_malloc(sizeof(int) * 3 * hull->num_faces);
+  hull->face_neighbors = polymec_malloc(sizeof(int) * 3 * hull->num_faces);
+  bool* is_vertex = polymec_calloc(num_points, sizeof(bool));
+  for (int f = 0; f < b->num_faces; ++f)
+  {
+    if (b->face_vertices[3*f] == -1)
+      continue;
+    int i = face_index[f];
+    for (int j = 0; j < 3; ++j)
+    {
+      hull->faces[3*i+j] = b->face_vertices[3*f+j];
+      hull->face_neighbors[3*i+j] = face_index[b->face_neighbors[3*f+j]];
+      is_vertex[b->face_vertices[3*f+j]] = true;
+    }
+  }
+  polymec_free(face_index);
+  hull_builder_free(b);
+
+  hull->num_vertices = 0;
+  for (int i = 0; i < num_points; ++i)
+  {
+    if (is_vertex[i])
+      ++hull->num_vertices;
+  }
+  hull->vertices = polymec_malloc(sizeof(int) * hull->num_vertices);
+  hull->bbox.x1 = hull->bbox.y1 = hull->bbox.z1 = REAL_MAX;
+  hull->bbox.x2 = hull->bbox.y2 = hull->bbox.z2 = -REAL_MAX;
+  for (int i = 0, j = 0; i < num_points; ++i)
+  {
+    if (is_vertex[i])
+    {
+      hull->vertices[j++] = i;
+      bbox_grow(&hull->bbox, &points[i]);
+    }
+  }
+  polymec_free(is_vertex);
 
-  // Clean up and get out.
-  int_dlist_free(hull);
+  // Containment queries start from the centroid of the first tetrahedron, 
+  // which lies inside the hull unless rounding moves it onto a face.
+  hull->center.x = 0.25 * (points[i0].x + points[i1].x + points[i2].x + points[i3].x);
+  hull->center.y = 0.25 * (points[i0].y + points[i1].y + points[i2].y + points[i3].y);
+  hull->center.z = 0.25 * (points[i0].z + points[i1].z + points[i2].z + points[i3].z);
+  hull->has_center = true;
+  for (int f = 0; (f < hull->num_faces) && hull->has_center; ++f)
+  {
+    int* v = &hull->faces[3*f];
+    if (robust_orientation(&points[v[0]], &points[v[1]], &points[v[2]], 
+                           &hull->center) >= 0.0)
+      hull->has_center = false;
+  }
+  return hull;
+}
+
+void convex_hull_free(convex_hull_t* hull)
+{
+  polymec_free(hull->vertices);
+  polymec_free(hull->faces);
+  polymec_free(hull->face_neighbors);
+  polymec_free(hull);
+}
+
+bool convex_hull_contains(convex_hull_t* hull, point_t* x)
+{
+  if ((x->x < hull->bbox.x1) || (x->x > hull->bbox.x2) || 
+      (x->y < hull->bbox.y1) || (x->y > hull->bbox.y2) || 
+      (x->z < hull->bbox.z1) || (x->z > hull->bbox.z2))
+    return false;
+
+  // Walk toward the face that the ray from the center through x crosses. 
+  // Since the faces turn counterclockwise as seen from outside, the ray 
+  // crosses the face (v0, v1, v2) if x lies on or to the left of each of the 
+  // planes through the center and one of its edges, and otherwise we cross 
+  // the first edge it lies to the right of. x is inside the hull if and only 
+  // if it lies inside this face. A walk that hasn't arrived after visiting 
+  // every face has cycled, and we fall back to testing every face.
+  point_t* c = &hull->center;
+  int f = 0;
+  for (int step = 0; hull->has_center && (step < hull->num_faces); ++step)
+  {
+    int* v = &hull->faces[3*f];
+    int j = 0;
+    while ((j < 3) && 
+           (robust_orientation(c, &hull->points[v[(j+1)%3]], 
+                               &hull->points[v[(j+2)%3]], x) >= 0.0))
+      ++j;
+    if (j == 3)
+    {
+      return (robust_orientation(&hull->points[v[0]], &hull->points[v[1]], 
+                                 &hull->points[v[2]], x) <= 0.0);
+    }
+    f = hull->face_neighbors[3*f+j];
+  }
+
+  for (f = 0; f < hull->num_faces; ++f)
+  {
+    int* v = &hull->faces[3*f];
+    if (robust_orientation(&hull->points[v[0]], &hull->points[v[1]], 
+                           &hull->points[v[2]], x) > 0.0)
+      return false;
+  }
+  return true;
+}
+
+point_t* create_convex_hull(point_t* points, int num_points, int* hull_size)
+{
+  convex_hull_t* hull = convex_hull_new(points, num_points);
+  point_t* hull_points = polymec_malloc(sizeof(point_t) * hull->num_vertices);
+  for (int i = 0; i < hull->num_vertices; ++i)
+    hull_points[i] = points[hull->vertices[i]];
+  *hull_size = hull->num_vertices;
+  convex_hull_free(hull);
   return hull_points;
 }
- 
@@ -10,9 +10,55 @@
 
 #include "core/point.h"
 
-// Creates the convex hull of the given points, returning it in an array and 
-// setting *hull_size to the number of points in it.
+// This type represents the convex hull of a set of points as a closed 
+// surface of triangles. It refers to the points it was built from (which 
+// are not copied), so they must outlive it.
+typedef struct
+{
+  point_t* points;
+  int num_points;
+
+  // The points at the vertices of the faces, as indices into points, in 
+  // increasing order. These include all of the corners of the hull, and may 
+  // include other points on its boundary that lie in the planes of its 
+  // faces. Of points that coincide, at most one is included.
+  int num_vertices;
+  int* vertices;
+
+  // The ith face has the vertices faces[3*i], faces[3*i+1], and 
+  // faces[3*i+2] (indices into points), which turn counterclockwise as seen 
+  // from outside the hull. face_neighbors[3*i+j] is the face across its edge 
+  // opposite its jth vertex.
+  int num_faces;
+  int* faces;
+  int* face_neighbors;
+
+  // The bounding box of the hull.
+  bbox_t bbox;
+
+  // A point strictly inside the hull, from which containment queries walk 
+  // across its faces. has_center is false if rounding put the centroid of 
+  // the hull's first tetrahedron on or outside its boundary.
+  point_t center;
+  bool has_center;
+} convex_hull_t;
+
+// Computes the convex hull of the given points (which must not all lie in 
+// one plane) by randomized incremental construction with a conflict graph, 
+// in O(N log N) expected time.
+convex_hull_t* convex_hull_new(point_t* points, int num_points);
+
+// Frees the given convex hull.
+void convex_hull_free(convex_hull_t* hull);
+
+// Returns true if x lies within the convex hull or on its boundary. The test 
+// is exact. It walks from face to face to the one that the ray from the 
+// hull's center toward x passes through, and tests x against that face alone.
+bool convex_hull_contains(convex_hull_t* hull, point_t* x);
+
+// Creates the convex hull of the given points, returning its vertices in an 
+// array and setting *hull_size to their number.
 point_t* create_convex_hull(point_t* points, int num_points, int* hull_size);
- 
+
 #endif
 
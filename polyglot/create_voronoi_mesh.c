@@ -5,27 +5,1016 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-#include "geometry/create_voronoi_mesh.h"
+#include "core/array.h"
+#include "core/partition_mesh.h"
+#include "core/thread_pool.h"
+#include "polyglot/delaunay_triangulation.h"
+#include "polyglot/robust_predicates.h"
+#include "polyglot/create_voronoi_mesh.h"
+
+// The cells are clipped to the bounding box by reflecting generators across 
+// the faces of the box: the bisector of a generator and its reflection is 
+// the plane of the face, and the reflection of any other generator is 
+// never closer to a point in the box than that generator itself. So the 
+// Voronoi cell of each generator among the generators and their 
+// reflections is its Voronoi cell clipped to the box, provided it has been 
+// reflected across each face that its unclipped cell reaches. We can't 
+// know which faces those are without triangulating, so we reflect the 
+// generators that lie within a few mean spacings of each face, triangulate, 
+// and then add any reflections that turn out to be missing.
+
+// The faces of the bounding box, in the order of the bbox_t fields.
+static const char* box_face_tags[6] = {"x1", "x2", "y1", "y2", "z1", "z2"};
+#define ALL_BOX_FACES 0x3f
+
+// Generators within this many mean spacings of a face of the box are 
+// reflected across it before we triangulate.
+#define NEAR_FACE_SPACINGS 2.0
+
+// When more than this fraction of the points of a triangulation move too far 
+// to be moved in place, we triangulate them again rather than moving them.
+#define MAX_REINSERTED_FRACTION 0.1
+
+// Passes over tets, faces, and cells are done in parallel in blocks of at 
+// least this many items.
+#define MIN_ITEMS_PER_BLOCK 4096
+
+// The load imbalance tolerated when a mesh is partitioned among processes.
+#define IMBALANCE_TOL 0.05
+
+// A block of items processed by one thread.
+typedef struct
+{
+  void* context;
+  void (*process)(void* context, int begin, int end);
+  int begin, end;
+} block_t;
+
+static void process_block(void* context)
+{
+  block_t* block = context;
+  block->process(block->context, block->begin, block->end);
+}
+
+// Runs process(context, begin, end) over the items [0, num_items) in 
+// blocks, using the given threads if there are any.
+static void process_in_blocks(thread_pool_t* threads, 
+                              int num_items, 
+                              void* context, 
+                              void (*process)(void* context, int begin, int end))
+{
+  int num_blocks = (threads != NULL) ? 
+    MIN(4 * thread_pool_num_threads(threads), num_items / MIN_ITEMS_PER_BLOCK) : 1;
+  if (num_blocks <= 1)
+  {
+    process(context, 0, num_items);
+    return;
+  }
+  block_t blocks[num_blocks];
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    blocks[b].context = context;
+    blocks[b].process = process;
+    blocks[b].begin = (int)(((size_t)num_items * b) / num_blocks);
+    blocks[b].end = (int)(((size_t)num_items * (b+1)) / num_blocks);
+    thread_pool_schedule(threads, &blocks[b], process_block);
+  }
+  thread_pool_execute(threads);
+}
+
+// Returns the reflection of the point x across the given face of the box.
+static point_t reflection(point_t* x, bbox_t* bbox, int face)
+{
+  point_t y = *x;
+  switch (face)
+  {
+    case 0: y.x = 2.0 * bbox->x1 - x->x; break;
+    case 1: y.x = 2.0 * bbox->x2 - x->x; break;
+    case 2: y.y = 2.0 * bbox->y1 - x->y; break;
+    case 3: y.y = 2.0 * bbox->y2 - x->y; break;
+    case 4: y.z = 2.0 * bbox->z1 - x->z; break;
+    default: y.z = 2.0 * bbox->z2 - x->z;
+  }
+  return y;
+}
+
+// Returns a bit mask of the faces of the box that x lies within the given 
+// distance of (or beyond).
+static int faces_near(point_t* x, bbox_t* bbox, real_t distance)
+{
+  return ((x->x <= bbox->x1 + distance) ? 0x01 : 0) | 
+         ((x->x >= bbox->x2 - distance) ? 0x02 : 0) | 
+         ((x->y <= bbox->y1 + distance) ? 0x04 : 0) | 
+         ((x->y >= bbox->y2 - distance) ? 0x08 : 0) | 
+         ((x->z <= bbox->z1 + distance) ? 0x10 : 0) | 
+         ((x->z >= bbox->z2 - distance) ? 0x20 : 0);
+}
+
+// Appends the faces of the box in the given mask across which the generator 
+// g is to be reflected to reflected_faces (as 6*g + face).
+static void reflect(int g, int mask, int_array_t* reflected_faces)
+{
+  for (int face = 0; face < 6; ++face)
+  {
+    if ((mask >> face) & 1)
+      int_array_append(reflected_faces, 6*g + face);
+  }
+}
+
+// Returns true if the given points don't all lie in one plane.
+static bool span_volume(point_t* points, int num_points)
+{
+  int a = 0, b = 1, c = -1;
+  while ((b < num_points) && (point_distance(&points[a], &points[b]) == 0.0))
+    ++b;
+  for (int i = b+1; i < num_points; ++i)
+  {
+    vector_t u, v, uxv;
+    point_displacement(&points[a], &points[b], &u);
+    point_displacement(&points[a], &points[i], &v);
+    vector_cross(&u, &v, &uxv);
+    if (vector_mag(&uxv) > 0.0)
+    {
+      c = i;
+      break;
+    }
+  }
+  if (c == -1)
+    return false;
+  for (int i = 0; i < num_points; ++i)
+  {
+    if (robust_orientation(&points[a], &points[b], &points[c], &points[i]) != 0.0)
+      return true;
+  }
+  return false;
+}
+
+// Computes the circumcenters of the tets in an adjacency.
+typedef struct
+{
+  delaunay_adjacency_t* adj;
+  point_t* points;
+  point_t* centers;
+} circumcenter_context_t;
+
+static void compute_circumcenters(void* context, int begin, int end)
+{
+  circumcenter_context_t* cc = context;
+  for (int i = begin; i < end; ++i)
+  {
+    int* v = &cc->adj->tet_vertices[4*i];
+    point_t* a = &cc->points[v[0]];
+    vector_t u, w, z, wxz, zxu, uxw;
+    point_displacement(a, &cc->points[v[1]], &u);
+    point_displacement(a, &cc->points[v[2]], &w);
+    point_displacement(a, &cc->points[v[3]], &z);
+    vector_cross(&w, &z, &wxz);
+    vector_cross(&z, &u, &zxu);
+    vector_cross(&u, &w, &uxw);
+    real_t u2 = vector_dot(&u, &u), w2 = vector_dot(&w, &w), z2 = vector_dot(&z, &z);
+    real_t D = 2.0 * vector_dot(&u, &wxz);
+    point_t* x = &cc->centers[i];
+    x->x = a->x + (u2 * wxz.x + w2 * zxu.x + z2 * uxw.x) / D;
+    x->y = a->y + (u2 * wxz.y + w2 * zxu.y + z2 * uxw.y) / D;
+    x->z = a->z + (u2 * wxz.z + w2 * zxu.z + z2 * uxw.z) / D;
+  }
+}
+
+// Computes the circumcenters of all of the tets in the given adjacency.
+static point_t* circumcenters(thread_pool_t* threads, 
+                              delaunay_adjacency_t* adj, 
+                              point_t* points)
+{
+  circumcenter_context_t context = {.adj = adj, .points = points, 
+    .centers = polymec_malloc(sizeof(point_t) * MAX(1, adj->num_tets))};
+  process_in_blocks(threads, adj->num_tets, &context, compute_circumcenters);
+  return context.centers;
+}
+
+// Returns a bit mask of the faces of the box across which the generator g 
+// must be reflected, given the adjacency and circumcenters of a 
+// triangulation that includes it. If g lies on the convex hull of the 
+// triangulation, its cell is unbounded, and it must be reflected across 
+// every face. Otherwise its cell is the convex hull of the circumcenters 
+// of its tets, and it must be reflected across each face that one of them 
+// reaches (within the given tolerance).
+static int needed_reflections(delaunay_adjacency_t* adj, 
+                              point_t* centers, 
+                              int g, 
+                              bbox_t* bbox, 
+                              real_t tolerance)
+{
+  int mask = 0;
+  for (int k = adj->vertex_tet_offsets[g]; k < adj->vertex_tet_offsets[g+1]; ++k)
+  {
+    int tet = adj->vertex_tets[k];
+    int* v = &adj->tet_vertices[4*tet];
+    for (int i = 0; i < 4; ++i)
+    {
+      if ((v[i] != g) && (adj->tet_neighbors[4*tet+i] == -1))
+        return ALL_BOX_FACES;
+    }
+    mask |= faces_near(&centers[tet], bbox, tolerance);
+  }
+  return mask;
+}
+
+// A Delaunay triangulation of a set of generators within a bounding box 
+// together with their reflections across the faces of the box that their 
+// Voronoi cells reach, and its adjacency.
+typedef struct
+{
+  int num_generators;
+  bbox_t bbox;
+
+  // The generators, followed by their reflections. The pth point is the 
+  // reflection of the generator g across the face of the box such that 
+  // reflected_faces->data[p - num_generators] is 6*g + face, and 
+  // reflections[g] is the mask of the faces across which g is reflected.
+  int num_points;
+  point_t* points;
+  int_array_t* reflected_faces;
+  char* reflections;
+
+  delaunay_triangulation_t* t;
+
+  // The adjacency of the triangulation and the circumcenters of its tets.
+  delaunay_adjacency_t* adj;
+  point_t* centers;
+} reflected_triangulation_t;
+
+// Returns the index of a tet having the vertex v in the triangulation, or 
+// -1 if there is none.
+static int tet_hint(delaunay_adjacency_t* adj, int v)
+{
+  int k = adj->vertex_tet_offsets[v];
+  return (adj->vertex_tet_offsets[v+1] > k) ? adj->tet_indices[adj->vertex_tets[k]] : -1;
+}
+
+// Appends the points for the reflections in rt->reflected_faces that 
+// rt->points doesn't yet include, returning the index of the first.
+static int add_reflections(reflected_triangulation_t* rt)
+{
+  int first = rt->num_points;
+  rt->num_points = rt->num_generators + (int)rt->reflected_faces->size;
+  rt->points = polymec_realloc(rt->points, sizeof(point_t) * rt->num_points);
+  for (int p = first; p < rt->num_points; ++p)
+  {
+    int reflected_face = rt->reflected_faces->data[p - rt->num_generators];
+    rt->points[p] = reflection(&rt->points[reflected_face/6], &rt->bbox, 
+                               reflected_face%6);
+  }
+  return first;
+}
+
+// Computes the adjacency of the triangulation and the circumcenters of its 
+// tets, adding any reflections of the generators that are missing (and 
+// repeating) until there are none.
+static void complete_reflections(reflected_triangulation_t* rt, 
+                                 thread_pool_t* threads)
+{
+  bbox_t* bbox = &rt->bbox;
+  real_t tolerance = 1e-10 * MAX(bbox->x2 - bbox->x1, 
+                                 MAX(bbox->y2 - bbox->y1, bbox->z2 - bbox->z1));
+  while (true)
+  {
+    rt->adj = delaunay_adjacency_new(rt->t);
+    rt->centers = circumcenters(threads, rt->adj, rt->points);
+    for (int g = 0; g < rt->num_generators; ++g)
+    {
+      int mask = needed_reflections(rt->adj, rt->centers, g, bbox, tolerance) & 
+                 ~rt->reflections[g];
+      if (mask != 0)
+      {
+        rt->reflections[g] |= (char)mask;
+        reflect(g, mask, rt->reflected_faces);
+      }
+    }
+    if (rt->num_generators + (int)rt->reflected_faces->size == rt->num_points)
+      break;
+    for (int p = add_reflections(rt); p < rt->num_points; ++p)
+    {
+      // Start looking from a tet of the reflected generator.
+      int g = rt->reflected_faces->data[p - rt->num_generators] / 6;
+      int v = delaunay_triangulation_insert(rt->t, &rt->points[p], tet_hint(rt->adj, g));
+      ASSERT(v == p);
+    }
+    polymec_free(rt->centers);
+    delaunay_adjacency_free(rt->adj);
+  }
+
+  for (int g = 0; g < rt->num_generators; ++g)
+  {
+    if (rt->adj->vertex_tet_offsets[g+1] == rt->adj->vertex_tet_offsets[g])
+      polymec_error("Voronoi generator %d coincides with another.", g);
+  }
+}
+
+// Triangulates the given generators, which lie strictly within the given 
+// bounding box, with their reflections. The generators are reflected 
+// across the faces that they lie near, and then across any others that 
+// their cells turn out to reach. If the generators are too few or too flat 
+// to triangulate by themselves, all of them are reflected across every face.
+static reflected_triangulation_t* reflected_triangulation_new(thread_pool_t* threads, 
+                                                              point_t* generators, 
+                                                              int num_generators, 
+                                                              bbox_t* bbox)
+{
+  reflected_triangulation_t* rt = polymec_malloc(sizeof(reflected_triangulation_t));
+  rt->num_generators = num_generators;
+  rt->bbox = *bbox;
+  real_t spacing = pow((bbox->x2 - bbox->x1) * (bbox->y2 - bbox->y1) * 
+                       (bbox->z2 - bbox->z1) / num_generators, 1.0/3.0);
+  bool flat = (num_generators < 4) || !span_volume(generators, num_generators);
+  rt->reflections = polymec_malloc(sizeof(char) * num_generators);
+  rt->reflected_faces = int_array_new();
+  for (int g = 0; g < num_generators; ++g)
+  {
+    rt->reflections[g] = (char)(flat ? ALL_BOX_FACES : 
+      faces_near(&generators[g], bbox, NEAR_FACE_SPACINGS * spacing));
+    reflect(g, rt->reflections[g], rt->reflected_faces);
+  }
+  rt->num_points = num_generators;
+  rt->points = polymec_malloc(sizeof(point_t) * num_generators);
+  memcpy(rt->points, generators, sizeof(point_t) * num_generators);
+  add_reflections(rt);
+
+  rt->t = delaunay_triangulation_new(rt->points, rt->num_points);
+  complete_reflections(rt, threads);
+  return rt;
+}
+
+// Moves the generators of the triangulation (and their reflections) to the 
+// given points, which lie strictly within its bounding box. Each generator 
+// is moved in place with its reflections if it can be without changing the 
+// tets. The rest are removed and reinserted, unless there are so many of 
+// them that it's cheaper to triangulate the points from scratch.
+static void reflected_triangulation_move(reflected_triangulation_t* rt, 
+                                         thread_pool_t* threads, 
+                                         point_t* generators)
+{
+  ASSERT(rt->t != NULL);
+
+  // Find the reflections of each generator.
+  int num_generators = rt->num_generators;
+  int* reflection_offsets = polymec_calloc(num_generators + 1, sizeof(int));
+  for (size_t j = 0; j < rt->reflected_faces->size; ++j)
+    ++reflection_offsets[rt->reflected_faces->data[j]/6 + 1];
+  for (int g = 0; g < num_generators; ++g)
+    reflection_offsets[g+1] += reflection_offsets[g];
+  int* reflection_points = polymec_malloc(sizeof(int) * MAX(1, rt->reflected_faces->size));
+  int* next = polymec_malloc(sizeof(int) * num_generators);
+  memcpy(next, reflection_offsets, sizeof(int) * num_generators);
+  for (size_t j = 0; j < rt->reflected_faces->size; ++j)
+    reflection_points[next[rt->reflected_faces->data[j]/6]++] = num_generators + (int)j;
+  polymec_free(next);
+
+  int_array_t* moves = int_array_new();
+  bool rebuild = false;
+  for (int g = 0; g < num_generators; ++g)
+  {
+    point_t* x = &generators[g];
+    if ((x->x == rt->points[g].x) && (x->y == rt->points[g].y) && (x->z == rt->points[g].z))
+      continue;
+    int vertices[7], num_vertices = 1;
+    point_t points[7];
+    vertices[0] = g;
+    points[0] = *x;
+    for (int k = reflection_offsets[g]; k < reflection_offsets[g+1]; ++k)
+    {
+      int p = reflection_points[k];
+      int reflected_face = rt->reflected_faces->data[p - num_generators];
+      vertices[num_vertices] = p;
+      points[num_vertices] = reflection(x, &rt->bbox, reflected_face%6);
+      ++num_vertices;
+    }
+    for (int i = 0; i < num_vertices; ++i)
+      rt->points[vertices[i]] = points[i];
+
+    // Once we know we're starting over, we just update the points.
+    if (!rebuild && 
+        !delaunay_triangulation_move_in_place(rt->t, vertices, points, num_vertices, 
+                                              tet_hint(rt->adj, g)))
+    {
+      for (int i = 0; i < num_vertices; ++i)
+        int_array_append(moves, vertices[i]);
+      rebuild = (moves->size > MAX_REINSERTED_FRACTION * rt->num_points);
+    }
+  }
+  polymec_free(reflection_points);
+  polymec_free(reflection_offsets);
+
+  if (rebuild)
+  {
+    delaunay_triangulation_free(rt->t);
+    rt->t = delaunay_triangulation_new(rt->points, rt->num_points);
+  }
+  else
+  {
+    for (size_t j = 0; j < moves->size; ++j)
+    {
+      int p = moves->data[j];
+      delaunay_triangulation_move(rt->t, p, &rt->points[p], tet_hint(rt->adj, p));
+    }
+    delaunay_triangulation_clear_changes(rt->t);
+  }
+  int_array_free(moves);
+  polymec_free(rt->centers);
+  delaunay_adjacency_free(rt->adj);
+  complete_reflections(rt, threads);
+}
+
+static void reflected_triangulation_free(reflected_triangulation_t* rt)
+{
+  polymec_free(rt->centers);
+  delaunay_adjacency_free(rt->adj);
+  if (rt->t != NULL)
+    delaunay_triangulation_free(rt->t);
+  polymec_free(rt->reflections);
+  int_array_free(rt->reflected_faces);
+  polymec_free(rt->points);
+  polymec_free(rt);
+}
+
+// Returns the first tet of the set of tets sharing a node with the tet i, 
+// using the union-find structure in node_tets.
+static int find_node(int* node_tets, int i)
+{
+  while (node_tets[i] != i)
+  {
+    node_tets[i] = node_tets[node_tets[i]];
+    i = node_tets[i];
+  }
+  return i;
+}
+
+// Merges the sets of tets sharing nodes with the tets i and j.
+static void merge_nodes(int* node_tets, int i, int j)
+{
+  i = find_node(node_tets, i);
+  j = find_node(node_tets, j);
+  if (i < j)
+    node_tets[j] = i;
+  else if (j < i)
+    node_tets[i] = j;
+}
+
+// Identifies the neighbors of each tet having a generator as a vertex that 
+// share its circumsphere (exactly). These tets share a Voronoi node.
+typedef struct
+{
+  delaunay_adjacency_t* adj;
+  point_t* points;
+  int num_generators;
+  char* cospherical;
+} cospherical_context_t;
+
+static void find_cospherical_neighbors(void* context, int begin, int end)
+{
+  cospherical_context_t* cc = context;
+  delaunay_adjacency_t* adj = cc->adj;
+  for (int i = begin; i < end; ++i)
+  {
+    int* v = &adj->tet_vertices[4*i];
+    int mask = 0;
+    if ((v[0] < cc->num_generators) || (v[1] < cc->num_generators) || 
+        (v[2] < cc->num_generators) || (v[3] < cc->num_generators))
+    {
+      for (int j = 0; j < 4; ++j)
+      {
+        int n = adj->tet_neighbors[4*i+j];
+        if (n <= i) continue;
+        int* w = &adj->tet_vertices[4*n];
+        int k = (adj->tet_neighbors[4*n] == i) ? 0 : 
+                (adj->tet_neighbors[4*n+1] == i) ? 1 : 
+                (adj->tet_neighbors[4*n+2] == i) ? 2 : 3;
+        if (robust_in_sphere(&cc->points[v[0]], &cc->points[v[1]], 
+                             &cc->points[v[2]], &cc->points[v[3]], 
+                             &cc->points[w[k]]) == 0.0)
+          mask |= (1 << j);
+      }
+    }
+    cc->cospherical[i] = (char)mask;
+  }
+}
+
+// Computes the areas, centers, and normals of mesh faces.
+static void compute_face_geometry(void* context, int begin, int end)
+{
+  mesh_t* mesh = context;
+  for (int f = begin; f < end; ++f)
+  {
+    int* nodes = &mesh->face_nodes[mesh->face_node_offsets[f]];
+    int num_nodes = mesh->face_node_offsets[f+1] - mesh->face_node_offsets[f];
+
+    // Break the face up into triangles that share the average of its nodes.
+    point_t x0 = {.x = 0.0, .y = 0.0, .z = 0.0};
+    for (int n = 0; n < num_nodes; ++n)
+    {
+      x0.x += mesh->nodes[nodes[n]].x;
+      x0.y += mesh->nodes[nodes[n]].y;
+      x0.z += mesh->nodes[nodes[n]].z;
+    }
+    x0.x /= num_nodes; x0.y /= num_nodes; x0.z /= num_nodes;
+    vector_t A = {.x = 0.0, .y = 0.0, .z = 0.0};
+    vector_t Ax[num_nodes];
+    point_t xt[num_nodes];
+    for (int n = 0; n < num_nodes; ++n)
+    {
+      point_t* x1 = &mesh->nodes[nodes[n]];
+      point_t* x2 = &mesh->nodes[nodes[(n+1) % num_nodes]];
+      vector_t u, v;
+      point_displacement(&x0, x1, &u);
+      point_displacement(&x0, x2, &v);
+      vector_cross(&u, &v, &Ax[n]);
+      vector_scale(&Ax[n], 0.5);
+      A.x += Ax[n].x; A.y += Ax[n].y; A.z += Ax[n].z;
+      xt[n].x = (x0.x + x1->x + x2->x) / 3.0;
+      xt[n].y = (x0.y + x1->y + x2->y) / 3.0;
+      xt[n].z = (x0.z + x1->z + x2->z) / 3.0;
+    }
+    real_t area = vector_mag(&A);
+    vector_t* nf = &mesh->face_normals[f];
+    *nf = A;
+    vector_scale(nf, 1.0 / area);
+    mesh->face_areas[f] = area;
+
+    // The center is the average of those of the triangles, weighted by area.
+    point_t* xf = &mesh->face_centers[f];
+    xf->x = xf->y = xf->z = 0.0;
+    for (int n = 0; n < num_nodes; ++n)
+    {
+      real_t a = vector_dot(&Ax[n], nf) / area;
+      xf->x += a * xt[n].x;
+      xf->y += a * xt[n].y;
+      xf->z += a * xt[n].z;
+    }
+  }
+}
+
+// Computes the volumes and centers of mesh cells, given the generator 
+// inside each one.
+typedef struct
+{
+  mesh_t* mesh;
+  point_t* generators;
+} cell_geometry_context_t;
+
+static void compute_cell_geometry(void* context, int begin, int end)
+{
+  cell_geometry_context_t* cc = context;
+  mesh_t* mesh = cc->mesh;
+  for (int c = begin; c < end; ++c)
+  {
+    // Break the cell up into tets that share the generator, each with a 
+    // base on a triangle of one of the faces.
+    point_t* xg = &cc->generators[c];
+    real_t V = 0.0;
+    point_t* xc = &mesh->cell_centers[c];
+    xc->x = xc->y = xc->z = 0.0;
+    for (int k = mesh->cell_face_offsets[c]; k < mesh->cell_face_offsets[c+1]; ++k)
+    {
+      int f = mesh->cell_faces[k];
+      real_t sign = 1.0;
+      if (f < 0)
+      {
+        f = ~f;
+        sign = -1.0;
+      }
+      int* nodes = &mesh->face_nodes[mesh->face_node_offsets[f]];
+      int num_nodes = mesh->face_node_offsets[f+1] - mesh->face_node_offsets[f];
+      point_t* xf = &mesh->face_centers[f];
+      for (int n = 0; n < num_nodes; ++n)
+      {
+        point_t* x1 = &mesh->nodes[nodes[n]];
+        point_t* x2 = &mesh->nodes[nodes[(n+1) % num_nodes]];
+        vector_t u, v, w, vxw;
+        point_displacement(xg, xf, &u);
+        point_displacement(xg, x1, &v);
+        point_displacement(xg, x2, &w);
+        vector_cross(&v, &w, &vxw);
+        real_t Vt = sign * vector_dot(&u, &vxw) / 6.0;
+        V += Vt;
+        xc->x += 0.25 * Vt * (xg->x + xf->x + x1->x + x2->x);
+        xc->y += 0.25 * Vt * (xg->y + xf->y + x1->y + x2->y);
+        xc->z += 0.25 * Vt * (xg->z + xf->z + x1->z + x2->z);
+      }
+    }
+    mesh->cell_volumes[c] = V;
+    xc->x /= V; xc->y /= V; xc->z /= V;
+  }
+}
+
+// Builds the whole Voronoi mesh of the given generators on comm.
+static mesh_t* voronoi_mesh_new(MPI_Comm comm, point_t* generators, 
+                                int num_generators, bbox_t* bounding_box)
+{
+  thread_pool_t* threads = NULL;
+  if (num_generators >= 2 * MIN_ITEMS_PER_BLOCK)
+    threads = thread_pool_new();
+
+  // Triangulate the generators with their reflections. We don't need the 
+  // triangulation itself once we have its adjacency.
+  reflected_triangulation_t* rt = reflected_triangulation_new(threads, generators, 
+                                                              num_generators, 
+                                                              bounding_box);
+  delaunay_triangulation_free(rt->t);
+  rt->t = NULL;
+  delaunay_adjacency_t* adj = rt->adj;
+  point_t* points = rt->points;
+  point_t* centers = rt->centers;
+  int_array_t* reflected_faces = rt->reflected_faces;
+
+  // Each tet with a generator as a vertex has a Voronoi node at its 
+  // circumcenter. Tets that share a circumsphere share a node, which we 
+  // identify with the first of them.
+  cospherical_context_t cospherical_context = {.adj = adj, .points = points, 
+    .num_generators = num_generators, 
+    .cospherical = polymec_malloc(sizeof(char) * MAX(1, adj->num_tets))};
+  process_in_blocks(threads, adj->num_tets, &cospherical_context, 
+                    find_cospherical_neighbors);
+  int* node_tets = polymec_malloc(sizeof(int) * MAX(1, adj->num_tets));
+  for (int i = 0; i < adj->num_tets; ++i)
+    node_tets[i] = i;
+  for (int i = 0; i < adj->num_tets; ++i)
+  {
+    for (int j = 0; j < 4; ++j)
+    {
+      if ((cospherical_context.cospherical[i] >> j) & 1)
+        merge_nodes(node_tets, i, adj->tet_neighbors[4*i+j]);
+    }
+  }
+  polymec_free(cospherical_context.cospherical);
+
+  // Each edge joining two generators, or a generator and one of its 
+  // reflections, has a Voronoi face whose nodes are those of the ring of 
+  // tets around it. Edges to other reflections have faces of zero area 
+  // (lying in a face of the box), as do those whose rings have fewer than 
+  // 3 distinct nodes, and we skip them. The nodes of a ring turn 
+  // counterclockwise about the edge looking from its second vertex, so the 
+  // face's normal points out of the first.
+  int* node_indices = polymec_malloc(sizeof(int) * MAX(1, adj->num_tets));
+  for (int i = 0; i < adj->num_tets; ++i)
+    node_indices[i] = -1;
+  int_array_t* node_tet_list = int_array_new();
+  int_array_t* face_node_offsets = int_array_new();
+  int_array_t* face_nodes = int_array_new();
+  int_array_t* face_cells = int_array_new();
+  int_array_t* box_faces[6];
+  for (int face = 0; face < 6; ++face)
+    box_faces[face] = int_array_new();
+  int_array_append(face_node_offsets, 0);
+  for (int e = 0; e < adj->num_edges; ++e)
+  {
+    int a = adj->edge_vertices[2*e], b = adj->edge_vertices[2*e+1];
+    if (a >= num_generators) continue;
+    int box_face = -1;
+    if (b >= num_generators)
+    {
+      int reflected_face = reflected_faces->data[b - num_generators];
+      if ((reflected_face / 6) != a) continue;
+      box_face = reflected_face % 6;
+    }
+    ASSERT(!adj->edge_on_hull[e]);
+
+    int begin = adj->edge_tet_offsets[e], end = adj->edge_tet_offsets[e+1];
+    int first = (int)face_nodes->size, num_nodes = 0;
+    for (int k = begin; k < end; ++k)
+    {
+      int node = find_node(node_tets, adj->edge_tets[k]);
+      if ((num_nodes > 0) && (node == face_nodes->data[first + num_nodes - 1]))
+        continue;
+      int_array_append(face_nodes, node);
+      ++num_nodes;
+    }
+    if ((num_nodes > 1) && (face_nodes->data[first] == face_nodes->data[first + num_nodes - 1]))
+      --num_nodes;
+    if (num_nodes < 3)
+    {
+      int_array_resize(face_nodes, first);
+      continue;
+    }
+    int_array_resize(face_nodes, first + num_nodes);
+
+    // Number the face's nodes.
+    for (int n = first; n < first + num_nodes; ++n)
+    {
+      int node = face_nodes->data[n];
+      if (node_indices[node] == -1)
+      {
+        node_indices[node] = (int)node_tet_list->size;
+        int_array_append(node_tet_list, node);
+      }
+      face_nodes->data[n] = node_indices[node];
+    }
+
+    int f = (int)face_cells->size / 2;
+    int_array_append(face_node_offsets, (int)face_nodes->size);
+    int_array_append(face_cells, a);
+    int_array_append(face_cells, (box_face == -1) ? b : -1);
+    if (box_face != -1)
+      int_array_append(box_faces[box_face], f);
+  }
+  polymec_free(node_indices);
+  polymec_free(node_tets);
+
+  // Create the mesh.
+  int num_faces = (int)face_cells->size / 2;
+  int num_nodes = (int)node_tet_list->size;
+  mesh_t* mesh = mesh_new(comm, num_generators, 0, num_faces, num_nodes);
+  for (int n = 0; n < num_nodes; ++n)
+    mesh->nodes[n] = centers[node_tet_list->data[n]];
+  int_array_free(node_tet_list);
+  reflected_triangulation_free(rt);
+
+  // Face <-> node and face <-> cell connectivity.
+  memcpy(mesh->face_node_offsets, face_node_offsets->data, sizeof(int) * (num_faces + 1));
+  memcpy(mesh->face_cells, face_cells->data, sizeof(int) * 2 * num_faces);
+  memset(mesh->cell_face_offsets, 0, sizeof(int) * (num_generators + 1));
+  for (int f = 0; f < num_faces; ++f)
+  {
+    ++mesh->cell_face_offsets[face_cells->data[2*f]+1];
+    if (face_cells->data[2*f+1] != -1)
+      ++mesh->cell_face_offsets[face_cells->data[2*f+1]+1];
+  }
+  for (int c = 0; c < num_generators; ++c)
+    mesh->cell_face_offsets[c+1] += mesh->cell_face_offsets[c];
+  mesh_reserve_connectivity_storage(mesh);
+  memcpy(mesh->face_nodes, face_nodes->data, sizeof(int) * face_nodes->size);
+  int_array_free(face_node_offsets);
+  int_array_free(face_nodes);
+
+  // Cell <-> face connectivity. A face's normal points out of its first 
+  // cell and into its second.
+  int* next = polymec_malloc(sizeof(int) * num_generators);
+  memcpy(next, mesh->cell_face_offsets, sizeof(int) * num_generators);
+  for (int f = 0; f < num_faces; ++f)
+  {
+    int c1 = face_cells->data[2*f], c2 = face_cells->data[2*f+1];
+    mesh->cell_faces[next[c1]++] = f;
+    if (c2 != -1)
+      mesh->cell_faces[next[c2]++] = ~f;
+  }
+  polymec_free(next);
+  int_array_free(face_cells);
+
+  // Tag the faces on the boundary of the box.
+  for (int face = 0; face < 6; ++face)
+  {
+    int* tag = mesh_create_tag(mesh->face_tags, box_face_tags[face], box_faces[face]->size);
+    memcpy(tag, box_faces[face]->data, sizeof(int) * box_faces[face]->size);
+    int_array_free(box_faces[face]);
+  }
+
+  // Compute the mesh's geometry.
+  mesh_construct_edges(mesh);
+  process_in_blocks(threads, num_faces, mesh, compute_face_geometry);
+  cell_geometry_context_t cell_context = {.mesh = mesh, .generators = generators};
+  process_in_blocks(threads, num_generators, &cell_context, compute_cell_geometry);
+
+  if (threads != NULL)
+    thread_pool_free(threads);
+  return mesh;
+}
 
 mesh_t* create_voronoi_mesh(MPI_Comm comm, point_t* generators, 
                             int num_generators, bbox_t* bounding_box)
 {
-  // Check to see whether tetgen is installed.
-  int status = system("tetgen");
-  if (status != 0)
-    polymec_error("create_voronoi_mesh: tetgen must be installed in your PATH.");
+  ASSERT((generators != NULL) || (num_generators == 0));
+  ASSERT(num_generators >= 0);
+  ASSERT(bounding_box != NULL);
+
+  for (int g = 0; g < num_generators; ++g)
+  {
+    point_t* x = &generators[g];
+    if ((x->x <= bounding_box->x1) || (x->x >= bounding_box->x2) || 
+        (x->y <= bounding_box->y1) || (x->y >= bounding_box->y2) || 
+        (x->z <= bounding_box->z1) || (x->z >= bounding_box->z2))
+      polymec_error("create_voronoi_mesh: generator %d does not lie strictly within the bounding box.", g);
+  }
+
+  int rank, nproc;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nproc);
+  if (nproc == 1)
+  {
+    if (num_generators == 0)
+      polymec_error("create_voronoi_mesh: no generators were given.");
+    return voronoi_mesh_new(comm, generators, num_generators, bounding_box);
+  }
+
+  // Gather the generators to rank 0, in rank order.
+  point_t* all_generators = NULL;
+  int total_num_generators = 0;
+#if POLYMEC_HAVE_MPI
+  int counts[nproc], displs[nproc];
+  int num_bytes = (int)sizeof(point_t) * num_generators;
+  MPI_Allgather(&num_bytes, 1, MPI_INT, counts, 1, MPI_INT, comm);
+  int total_num_bytes = 0;
+  for (int p = 0; p < nproc; ++p)
+  {
+    displs[p] = total_num_bytes;
+    total_num_bytes += counts[p];
+  }
+  total_num_generators = total_num_bytes / (int)sizeof(point_t);
+  if (total_num_generators == 0)
+    polymec_error("create_voronoi_mesh: no generators were given.");
+  if (rank == 0)
+    all_generators = polymec_malloc(sizeof(point_t) * total_num_generators);
+  MPI_Gatherv(generators, num_bytes, MPI_BYTE, all_generators, counts, displs, 
+              MPI_BYTE, 0, comm);
+#endif
+
+  // Build the whole mesh on rank 0 and partition it among the processes.
+  mesh_t* mesh = NULL;
+  if (rank == 0)
+  {
+    mesh = voronoi_mesh_new(MPI_COMM_SELF, all_generators, total_num_generators, 
+                            bounding_box);
+    polymec_free(all_generators);
+  }
+  migrator_t* migrator = partition_mesh(&mesh, comm, NULL, IMBALANCE_TOL);
+  migrator_free(migrator);
+  return mesh;
+}
+
+struct cvt_iterator_t
+{
+  int num_generators;
+  bbox_t bbox;
+  sp_func_t* density;
+  thread_pool_t* threads;
+  reflected_triangulation_t* rt;
+
+  // The centroids and energies of the cells of the current generators, 
+  // which are valid if have_cells is true.
+  bool have_cells;
+  point_t* centroids;
+  real_t* energies;
+};
+
+// Computes the centroids and energies of the cells of the generators of a 
+// CVT iterator.
+static void compute_cell_moments(void* context, int begin, int end)
+{
+  // Each cell is divided into tets with apexes at its generator and bases 
+  // fanning out over its faces, and these are integrated with the 4-point 
+  // rule of degree 2, which is exact for uniform density.
+  static const real_t alpha = 0.5854101966249685, beta = 0.1381966011250105;
+  cvt_iterator_t* cvt = context;
+  delaunay_adjacency_t* adj = cvt->rt->adj;
+  point_t* centers = cvt->rt->centers;
+  for (int g = begin; g < end; ++g)
+  {
+    point_t* z = &cvt->rt->points[g];
+    real_t m = 0.0, e = 0.0;
+    vector_t mx = {.x = 0.0, .y = 0.0, .z = 0.0};
+    for (int k = adj->vertex_edge_offsets[g]; k < adj->vertex_edge_offsets[g+1]; ++k)
+    {
+      int edge = adj->vertex_edges[k];
+      int* ring = &adj->edge_tets[adj->edge_tet_offsets[edge]];
+      int ring_size = adj->edge_tet_offsets[edge+1] - adj->edge_tet_offsets[edge];
+      for (int j = 1; j < ring_size - 1; ++j)
+      {
+        point_t* x[4] = {z, &centers[ring[0]], &centers[ring[j]], &centers[ring[j+1]]};
+        vector_t u, v, w, vxw;
+        point_displacement(x[0], x[1], &u);
+        point_displacement(x[0], x[2], &v);
+        point_displacement(x[0], x[3], &w);
+        vector_cross(&v, &w, &vxw);
+        real_t V = fabs(vector_dot(&u, &vxw)) / 6.0;
+        if (V == 0.0) continue;
+        for (int q = 0; q < 4; ++q)
+        {
+          point_t xq = {.x = 0.0, .y = 0.0, .z = 0.0};
+          for (int i = 0; i < 4; ++i)
+          {
+            real_t c = (i == q) ? alpha : beta;
+            xq.x += c * x[i]->x;
+            xq.y += c * x[i]->y;
+            xq.z += c * x[i]->z;
+          }
+          real_t rho = 1.0;
+          if (cvt->density != NULL)
+            sp_func_eval(cvt->density, &xq, &rho);
+          real_t dm = 0.25 * V * rho;
+          m += dm;
+          mx.x += dm * xq.x;
+          mx.y += dm * xq.y;
+          mx.z += dm * xq.z;
+          real_t d = point_distance(&xq, z);
+          e += dm * d * d;
+        }
+      }
+    }
+    cvt->energies[g] = e;
+    if (m > 0.0)
+    {
+      cvt->centroids[g].x = mx.x / m;
+      cvt->centroids[g].y = mx.y / m;
+      cvt->centroids[g].z = mx.z / m;
+    }
+    else
+      cvt->centroids[g] = *z;
+  }
+}
+
+static void compute_cells(cvt_iterator_t* cvt)
+{
+  if (!cvt->have_cells)
+  {
+    process_in_blocks(cvt->threads, cvt->num_generators, cvt, compute_cell_moments);
+    cvt->have_cells = true;
+  }
+}
+
+cvt_iterator_t* cvt_iterator_new(point_t* generators, 
+                                 int num_generators, 
+                                 bbox_t* bounding_box, 
+                                 sp_func_t* density)
+{
+  ASSERT(generators != NULL);
+  ASSERT(num_generators > 0);
+  ASSERT(bounding_box != NULL);
+  ASSERT((density == NULL) || (sp_func_num_comp(density) == 1));
+
+  for (int g = 0; g < num_generators; ++g)
+  {
+    point_t* x = &generators[g];
+    if ((x->x <= bounding_box->x1) || (x->x >= bounding_box->x2) || 
+        (x->y <= bounding_box->y1) || (x->y >= bounding_box->y2) || 
+        (x->z <= bounding_box->z1) || (x->z >= bounding_box->z2))
+      polymec_error("cvt_iterator_new: generator %d does not lie strictly within the bounding box.", g);
+  }
+
+  cvt_iterator_t* cvt = polymec_malloc(sizeof(cvt_iterator_t));
+  cvt->num_generators = num_generators;
+  cvt->bbox = *bounding_box;
+  cvt->density = density;
+  cvt->threads = (num_generators >= 2 * MIN_ITEMS_PER_BLOCK) ? thread_pool_new() : NULL;
+  cvt->rt = reflected_triangulation_new(cvt->threads, generators, 
+                                        num_generators, bounding_box);
+  cvt->have_cells = false;
+  cvt->centroids = polymec_malloc(sizeof(point_t) * num_generators);
+  cvt->energies = polymec_malloc(sizeof(real_t) * num_generators);
+  return cvt;
+}
+
+void cvt_iterator_free(cvt_iterator_t* cvt)
+{
+  polymec_free(cvt->energies);
+  polymec_free(cvt->centroids);
+  reflected_triangulation_free(cvt->rt);
+  if (cvt->threads != NULL)
+    thread_pool_free(cvt->threads);
+  polymec_free(cvt);
+}
 
-  // Generate a temporary directory for working with tetgen.
-  char template[FILENAME_MAX], dir_path[FILENAME_MAX];
-  sprintf(template, "voronoi-XXXXXX");
-  bool made_dir = make_temp_directory(template, dir_path);
-  if (!made_dir)
-    polymec_error("create_voronoi_mesh: Could not open temporary directory.");
+point_t* cvt_iterator_generators(cvt_iterator_t* cvt, int* num_generators)
+{
+  *num_generators = cvt->num_generators;
+  return cvt->rt->points;
+}
 
-  // Make the input .node file containing the generators.
-  char input_file[FILENAME_MAX];
-  join_paths(dir_path, "voronoi.nodes", input_file);
+real_t cvt_iterator_energy(cvt_iterator_t* cvt)
+{
+  compute_cells(cvt);
+  real_t energy = 0.0;
+  for (int g = 0; g < cvt->num_generators; ++g)
+    energy += cvt->energies[g];
+  return energy;
+}
 
-  polymec_not_implemented("create_voronoi_mesh");
+real_t cvt_iterator_iterate(cvt_iterator_t* cvt)
+{
+  compute_cells(cvt);
+  real_t max_displacement = 0.0;
+  for (int g = 0; g < cvt->num_generators; ++g)
+    max_displacement = MAX(max_displacement, point_distance(&cvt->rt->points[g], &cvt->centroids[g]));
+  reflected_triangulation_move(cvt->rt, cvt->threads, cvt->centroids);
+  cvt->have_cells = false;
+  return max_displacement;
 }
 
+int cvt_iterator_run(cvt_iterator_t* cvt, 
+                     int max_iterations, 
+                     real_t energy_tol, 
+                     real_t displacement_tol)
+{
+  ASSERT(max_iterations >= 0);
+  ASSERT(energy_tol >= 0.0);
+  ASSERT(displacement_tol >= 0.0);
+  real_t energy = cvt_iterator_energy(cvt);
+  for (int i = 0; i < max_iterations; ++i)
+  {
+    real_t displacement = cvt_iterator_iterate(cvt);
+    real_t new_energy = cvt_iterator_energy(cvt);
+    log_debug("cvt_iterator_run: iteration %d: energy = %g, max displacement = %g", 
+              i+1, new_energy, displacement);
+    if (((energy - new_energy) <= energy_tol * energy) || 
+        (displacement <= displacement_tol))
+      return i+1;
+    energy = new_energy;
+  }
+  return max_iterations;
+}
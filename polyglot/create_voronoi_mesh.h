@@ -9,12 +9,65 @@
 #define POLYMEC_CREATE_VORONOI_MESH_H
 
 #include "core/mesh.h"
+#include "core/sp_func.h"
 
-// Creates a Voronoi mesh from a set of generator points within the given 
-// bounding box using the algorithm described by Hugo Ledoux in his 2007 
-// paper "Computing the 3D Voronoi Diagram Robustly: An Easy Explanation".
+// Creates a mesh whose cells are the Voronoi cells of the given generator 
+// points, clipped to the given bounding box. The generators must be distinct 
+// and lie strictly within the box. The mesh is built directly from the 
+// Delaunay triangulation of the generators (as described by Hugo Ledoux in 
+// his 2007 paper "Computing the 3D Voronoi Diagram Robustly: An Easy 
+// Explanation"), and its cell volumes and centers are those of the clipped 
+// polyhedra. Faces on the boundary of the box are tagged "x1", "x2", "y1", 
+// "y2", "z1", and "z2". On a single process, cell i belongs to generator i. 
+// On more than one, each process may pass any number of generators (even 
+// none). They are gathered to rank 0 in rank order, and the whole mesh is 
+// built serially on rank 0 and then partitioned among the processes in 
+// comm, so each gets only its own cells.
 mesh_t* create_voronoi_mesh(MPI_Comm comm, point_t* generators, 
                             int num_generators, bbox_t* bounding_box);
- 
+
+// This type moves a set of generators toward a centroidal Voronoi 
+// tessellation (CVT) of a bounding box, in which each generator lies at the 
+// centroid of its (clipped) Voronoi cell, by Lloyd iteration. When few 
+// generators move far enough to change the Delaunay triangulation, it is 
+// repaired in place by moving those generators; when more than a tenth of 
+// them do, as is usual in the first iterations, it is rebuilt from scratch. 
+// The cell centroids are computed in parallel.
+typedef struct cvt_iterator_t cvt_iterator_t;
+
+// Creates a CVT iterator for the given generators, which must be distinct 
+// and lie strictly within the bounding box. If density is non-NULL, it is a 
+// positive scalar function with respect to which centroids are computed; 
+// otherwise the density is uniform. The generators are copied.
+cvt_iterator_t* cvt_iterator_new(point_t* generators, 
+                                 int num_generators, 
+                                 bbox_t* bounding_box, 
+                                 sp_func_t* density);
+
+// Destroys the given CVT iterator.
+void cvt_iterator_free(cvt_iterator_t* cvt);
+
+// Returns the current generators of the iterator, storing their number in 
+// num_generators.
+point_t* cvt_iterator_generators(cvt_iterator_t* cvt, int* num_generators);
+
+// Returns the energy of the current generators: the sum over their cells 
+// of the integral of density * |x - generator|**2. Lloyd iterations never 
+// increase it.
+real_t cvt_iterator_energy(cvt_iterator_t* cvt);
+
+// Performs one Lloyd iteration, moving each generator to the centroid of 
+// its cell, and returns the largest distance that a generator moved.
+real_t cvt_iterator_iterate(cvt_iterator_t* cvt);
+
+// Performs Lloyd iterations until one decreases the energy by no more than 
+// energy_tol times its previous value, or moves no generator farther than 
+// displacement_tol, or until max_iterations have been performed. Returns 
+// the number of iterations performed.
+int cvt_iterator_run(cvt_iterator_t* cvt, 
+                     int max_iterations, 
+                     real_t energy_tol, 
+                     real_t displacement_tol);
+
 #endif
 
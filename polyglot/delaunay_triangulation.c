@@ -5,25 +5,24 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-#include "core/array_utils.h"
-#include "core/tuple.h"
-#include "core/slist.h"
-#include "core/unordered_set.h"
-#include "geometry/tetrahedron.h"
-#include "geometry/delaunay_triangulation.h"
-
-// Algorithms for constructing Delaunay triangulations.
-typedef enum
-{
-  BOWYER_WATSON,
-  INCREMENTAL_FLIP,
-  DIVIDE_AND_CONQUER,
-  DEWALL
-} delaunay_triangulation_algorithm_t;
-
-// We use some of Shewchuk's robust geometric predicates.
-extern real_t orient3d(real_t* pa, real_t* pb, real_t* pc, real_t* pd);
-extern real_t insphere(real_t* pa, real_t* pb, real_t* pc, real_t* pd, real_t* pe);
+#include "core/array.h"
+#include "core/thread_pool.h"
+#include "polyglot/delaunay_triangulation.h"
+#include "polyglot/robust_predicates.h"
+
+// The triangulation stores 4 vertices and 4 neighbors for each tet, with 
+// neighbor i across the face opposite vertex i. Every tet is positively 
+// oriented (its 4th vertex lies on the side of its first 3 from which they 
+// appear counterclockwise). During construction, each face of the convex 
+// hull is also attached to a "ghost" tet whose 4th vertex is a vertex at 
+// infinity, so every tet has 4 neighbors. When construction is finished, 
+// the ghost tets are stored after all of the (finite) tets.
+#define INFINITE_VERTEX -1
+
+// Tets are allocated from a pool: the slots of deleted tets are marked with 
+// this vertex and placed on a free list, from which new tets are taken 
+// before the pool is enlarged.
+#define DEAD_VERTEX -2
 
 struct delaunay_triangulation_t 
 {
@@ -31,6 +30,30 @@ struct delaunay_triangulation_t
   point_t* vertices;
   int num_vertices, vertex_cap, num_tets, tet_cap;
   int* tet_vertices;
+  int* tet_neighbors;
+  int num_ghost_tets;
+
+  // Once it has been constructed, the triangulation can be changed by 
+  // inserting, removing, and moving vertices. Its tets then stay in their 
+  // slots until they are destroyed, and the changes to each slot since the 
+  // change log was last cleared are recorded in tet_changes.
+  int num_finite_tets;
+  char* tet_changes; // NULL during construction
+  int_array_t* changed_tets; // slots with nonzero tet_changes
+  int* vertex_tets; // the last finite tet created with each vertex
+
+  // Work space for point location and cavity construction.
+  int* tet_marks; // marks for tets visited in the current search
+  int mark; // the current mark
+  int last_tet; // the finite tet created most recently
+  uint32_t rng_state; // state for randomized walks and insertion order
+  int_array_t *cavity, *boundary, *new_tets, *edges;
+  int_array_t* stack; // tets whose faces are checked during flipping
+  int_array_t* free_tets; // free list of tet slots
+
+  // The numbers of merges attempted and failed during construction by 
+  // divide and conquer.
+  int num_merges, num_failed_merges;
 };
 
 // This helper allocates storage for a new vertex.
@@ -41,6 +64,8 @@ static void allocate_new_vertex(delaunay_triangulation_t* t)
     while (t->vertex_cap < (t->num_vertices+1))
       t->vertex_cap *= 2;
     t->vertices = polymec_realloc(t->vertices, sizeof(point_t)*t->vertex_cap);
+    if (t->vertex_tets != NULL)
+      t->vertex_tets = polymec_realloc(t->vertex_tets, sizeof(int)*t->vertex_cap);
   }
 }
 
@@ -51,349 +76,2684 @@ static void allocate_new_tets(delaunay_triangulation_t* t, int num_new_tets)
 
   if ((t->num_tets+num_new_tets) >= t->tet_cap)
   {
+    int old_cap = t->tet_cap;
     while (t->tet_cap < (t->num_tets+num_new_tets))
       t->tet_cap *= 2;
     t->tet_vertices = polymec_realloc(t->tet_vertices, 4*sizeof(int)*t->tet_cap);
+    t->tet_neighbors = polymec_realloc(t->tet_neighbors, 4*sizeof(int)*t->tet_cap);
+    t->tet_marks = polymec_realloc(t->tet_marks, sizeof(int)*t->tet_cap);
+    if (t->tet_changes != NULL)
+    {
+      t->tet_changes = polymec_realloc(t->tet_changes, sizeof(char)*t->tet_cap);
+      memset(&t->tet_changes[old_cap], 0, sizeof(char)*(t->tet_cap-old_cap));
+    }
   }
 }
 
-// This helper returns the index of the tetrahedron containing the point p.
-static int tet_containing_point(delaunay_triangulation_t* t, point_t* p)
+// Returns a pseudo-random number (xorshift).
+static inline uint32_t next_random(delaunay_triangulation_t* t)
 {
-  // FIXME
-  return 0;
+  uint32_t x = t->rng_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  t->rng_state = x;
+  return x;
+}
+
+// Returns a positive number if the tet (a, b, c, d) is positively oriented, 
+// a negative number if it is negatively oriented, and zero if its vertices 
+// are coplanar.
+static inline real_t orientation(delaunay_triangulation_t* t, int a, int b, int c, int d)
+{
+  return robust_orientation(&t->vertices[a], &t->vertices[b], 
+                            &t->vertices[c], &t->vertices[d]);
+}
+
+// Breaks a tie in the in-sphere test of e against the positively oriented 
+// tet (a, b, c, d), in which e lies exactly on the circumsphere, by 
+// symbolic perturbation: each vertex is lifted slightly above the 
+// paraboloid, by an amount that decreases (infinitesimally fast) with its 
+// index, as in CGAL. This makes the Delaunay triangulation of any point set 
+// unique, so every algorithm (and every piece of a divided point set) 
+// agrees on it.
+static real_t perturbed_in_sphere(delaunay_triangulation_t* t, int a, int b, int c, int d, int e)
+{
+  // The sign is that of the first nonzero term in the expansion of the 
+  // perturbed determinant, taking the vertices in descending order.
+  int v[5] = {a, b, c, d, e};
+  for (int i = 1; i < 5; ++i)
+  {
+    for (int j = i; (j > 0) && (v[j] > v[j-1]); --j)
+    {
+      int tmp = v[j];
+      v[j] = v[j-1];
+      v[j-1] = tmp;
+    }
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    real_t o = 0.0;
+    if (v[i] == e)
+      return -1.0; // e is lifted above the sphere.
+    else if (v[i] == d)
+      o = orientation(t, a, b, c, e);
+    else if (v[i] == c)
+      o = orientation(t, a, b, e, d);
+    else if (v[i] == b)
+      o = orientation(t, a, e, c, d);
+    else 
+      o = orientation(t, e, b, c, d);
+    if (o != 0.0)
+      return o;
+  }
+  return -1.0; // not reached for a positively oriented tet.
+}
+
+// Returns a positive number if e lies inside the circumsphere of the 
+// positively oriented tet (a, b, c, d) and a negative number if it lies 
+// outside. Ties (cospherical points) are broken by perturbed_in_sphere.
+static inline real_t in_sphere(delaunay_triangulation_t* t, int a, int b, int c, int d, int e)
+{
+  real_t s = robust_in_sphere(&t->vertices[a], &t->vertices[b], &t->vertices[c], 
+                              &t->vertices[d], &t->vertices[e]);
+  if (s != 0.0)
+    return s;
+  else
+    return perturbed_in_sphere(t, a, b, c, d, e);
+}
+
+// Returns true if the given tet is a ghost tet.
+static inline bool is_ghost(delaunay_triangulation_t* t, int tet)
+{
+  int* v = &t->tet_vertices[4*tet];
+  return ((v[0] == INFINITE_VERTEX) || (v[1] == INFINITE_VERTEX) || 
+          (v[2] == INFINITE_VERTEX) || (v[3] == INFINITE_VERTEX));
+}
+
+// Returns the orientation of the given tet with its ith vertex replaced by 
+// the vertex v.
+static inline real_t orientation_with(delaunay_triangulation_t* t, int tet, int i, int v)
+{
+  int w[4] = {t->tet_vertices[4*tet], t->tet_vertices[4*tet+1], 
+              t->tet_vertices[4*tet+2], t->tet_vertices[4*tet+3]};
+  w[i] = v;
+  return orientation(t, w[0], w[1], w[2], w[3]);
 }
 
-// This helper inserts a vertex into the tetrahedron with the given index
-// in the triangulation, breaking it into 4 tetrahedra. The indices of the 
-// 4 new tetrahedra are stored in new_tet_indices.
-static void flip14(delaunay_triangulation_t* t, int old_tet_index, int* new_tet_indices)
+// Computes the orientations of the (finite) tet tau with each of its 
+// vertices in turn replaced by the vertex v, storing them in o.
+static inline void orientations_with(delaunay_triangulation_t* t, int tau, int v, real_t* o)
 {
+  ASSERT(!is_ghost(t, tau));
+  int* w = &t->tet_vertices[4*tau];
+  point_t *x[4] = {&t->vertices[w[0]], &t->vertices[w[1]], 
+                   &t->vertices[w[2]], &t->vertices[w[3]]};
+  point_t* y = &t->vertices[v];
+  point_t *a[4] = {y, x[0], x[0], x[0]}, 
+          *b[4] = {x[1], y, x[1], x[1]}, 
+          *c[4] = {x[2], x[2], y, x[2]}, 
+          *d[4] = {x[3], x[3], x[3], y};
+  robust_orientations(4, a, b, c, d, o);
 }
 
-// Given a tetrahedron tau1 = (v, a, b, c), this helper retrieves the index 
-// and the vertex d of the tetrahedron tau2 = (a, b, c, d) adjacent to tau1 
-// that shares the vertices (a, b, c).
-static void find_adjacent_tet(delaunay_triangulation_t* t, 
-                              int tau1, int v, int a, int b, int c,
-                              int* tau2, int* d)
+// Returns the index of the face of the tet tau1 that it shares with tau2.
+static inline int shared_face(delaunay_triangulation_t* t, int tau1, int tau2)
 {
+  int* n = &t->tet_neighbors[4*tau1];
+  return (n[0] == tau2) ? 0 : (n[1] == tau2) ? 1 : (n[2] == tau2) ? 2 : 3;
 }
 
-// This helper performs a bistellar flip of two tetrahedra tau = (a, b, c, d) 
-// and tau_a = (b, c, d, e) within the triangulation t. Notice that the 
-// face common to tau and tau_a is (b, c, d).
-static void flip(delaunay_triangulation_t* t, 
-                 int tau, int tau_a, int a, int b, int c, int d, int e,
-                 int_slist_t* stack)
+// This helper returns the index of a tet containing the vertex v (which is 
+// not yet in the triangulation), walking from the most recently created 
+// tet. If v lies outside the convex hull, a ghost tet whose hull face is 
+// visible from v is returned.
+static int tet_containing_point(delaunay_triangulation_t* t, int v)
 {
-  // Figure out how many facets of the tetrahedron tau_a are visible to 
-  // point p within tetrahedron tau, and identify any degeneracies.
-  point_t* p = &t->vertices[a];
-  int tau_a_vertices[] = {b, c, d, e};
-  static const int tau_a_facets[4][3] = {{1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}};
-  int num_visible_facets = 0;
-  bool abdp_coplanar = false, p_lies_on_abc = false;
-  for (int f = 0; f < 4; ++f)
+  // We use a "visibility walk": we step from a tet to a neighbor if v lies 
+  // on the far side of the face between them. Faces are tried in a random 
+  // order, which keeps the walk from cycling.
+  int tau = t->last_tet, prev = -1;
+  ASSERT(!is_ghost(t, tau));
+  while (true)
   {
-    point_t* v1 = &t->vertices[tau_a_vertices[tau_a_facets[f][0]]];
-    point_t* v2 = &t->vertices[tau_a_vertices[tau_a_facets[f][1]]];
-    point_t* v3 = &t->vertices[tau_a_vertices[tau_a_facets[f][2]]];
-    // We use Shewchuk's ORIENT3D predicate to determine whether p lies above 
-    // the face (v1, v2, v3).
-    real_t pa[3] = {v1->x, v1->y, v1->z}, 
-           pb[3] = {v2->x, v2->y, v2->z}, 
-           pc[3] = {v3->x, v3->y, v3->z}, 
-           pd[3] = {p->x, p->y, p->z};
-    real_t orientation = orient3d(pa, pb, pc, pd);
-    if (orientation < 0.0)
-      ++num_visible_facets; // p is above (v1, v2, v3).
+    real_t o[4];
+    orientations_with(t, tau, v, o);
+    int first = (int)(next_random(t) & 3), next = -1;
+    for (int j = 0; j < 4; ++j)
+    {
+      int i = (first + j) & 3;
+      int neighbor = t->tet_neighbors[4*tau+i];
+      if (neighbor == prev) continue; // we came from there
+      if (o[i] < 0.0)
+      {
+        next = neighbor;
+        break;
+      }
+    }
+    if (next == -1)
+      return tau;
+    prev = tau;
+    tau = next;
+    if (is_ghost(t, tau))
+      return tau;
   }
+}
 
-  // Now flip tets according to the various cases in Ledoux's paper.
-  if (num_visible_facets == 1) // case 1
+// Returns true if the circumsphere of the given tet contains the vertex v. 
+// The "circumsphere" of a ghost tet is the open half space beyond its hull 
+// face, plus the circumcircle of the face itself.
+static bool in_conflict(delaunay_triangulation_t* t, int tet, int v)
+{
+  int* w = &t->tet_vertices[4*tet];
+  for (int i = 0; i < 4; ++i)
   {
-    // The union of tau and tau_a is convex, so a flip23 is performed.
-    // FIXME
-//    flip23(t, tau, tau_a);
-//    int_slist_push(stack, ...);
+    if (w[i] == INFINITE_VERTEX)
+    {
+      real_t o = orientation_with(t, tet, i, v);
+      if (o != 0.0)
+        return (o > 0.0);
+
+      // v lies in the plane of the hull face, so it's inside the face's 
+      // circumcircle if it's inside the circumsphere of the finite tet on 
+      // the other side.
+      return in_conflict(t, t->tet_neighbors[4*tet+i], v);
+    }
   }
-  else if (num_visible_facets == 2) // case 2
+  return (in_sphere(t, w[0], w[1], w[2], w[3], v) > 0.0);
+}
+
+// Determines which neighbors of the cavity tet c have circumspheres that 
+// contain the vertex v, storing the result for neighbor i in conflicts[i]. 
+// Neighbors that have already been tested (those marked with mark or its 
+// negative) are skipped. The in-sphere tests for the finite neighbors are 
+// evaluated together.
+static void find_conflicts(delaunay_triangulation_t* t, int c, int v, int mark, bool* conflicts)
+{
+  point_t *a[4], *b[4], *cc[4], *d[4], *e[4];
+  int tested[4], num_tests = 0;
+  for (int i = 0; i < 4; ++i)
   {
-    // The union of tau and tau_a is non-convex. Attempt to construct a 
-    // tetrahedron tau_b = (a, b, p, d) such that the edge (a, b) is shared 
-    // by tau, tau_a, and tau_b. If tau_b can be constructed, perform a flip32.
-    bool abpd_exists = false;
-    // FIXME
-    if (abpd_exists)
+    conflicts[i] = false;
+    int n = t->tet_neighbors[4*c+i];
+    if ((t->tet_marks[n] == mark) || (t->tet_marks[n] == -mark)) 
+      continue;
+    if (is_ghost(t, n))
+      conflicts[i] = in_conflict(t, n, v);
+    else
     {
+      int* w = &t->tet_vertices[4*n];
+      a[num_tests] = &t->vertices[w[0]];
+      b[num_tests] = &t->vertices[w[1]];
+      cc[num_tests] = &t->vertices[w[2]];
+      d[num_tests] = &t->vertices[w[3]];
+      e[num_tests] = &t->vertices[v];
+      tested[num_tests++] = i;
     }
-    
-    // If not, then no flip is performed, and this non-convex case will be 
-    // rectified by another flip elsewhere.
   }
-  else if (abdp_coplanar) // case 3
+  real_t s[4];
+  robust_in_spheres(num_tests, a, b, cc, d, e, s);
+  for (int j = 0; j < num_tests; ++j)
   {
-    // a, b, d, and p are coplanar, so the creation of a tetrahedron (a, b, d, p) 
-    // requires the tetrahedra tau and tau_a to be in the "config44" state.
-    bool config44 = false;
-    // FIXME
-    if (config44)
+    if (s[j] == 0.0)
     {
+      int* w = &t->tet_vertices[4*t->tet_neighbors[4*c+tested[j]]];
+      s[j] = perturbed_in_sphere(t, w[0], w[1], w[2], w[3], v);
     }
+    conflicts[tested[j]] = (s[j] > 0.0);
   }
-  else if (p_lies_on_abc) // case 4
+}
+
+// Returns the index of a new tet, taken from the free list if possible.
+static int new_tet(delaunay_triangulation_t* t)
+{
+  if (t->free_tets->size > 0)
   {
-    // p lies on an edge of the face (a, b, c). So it is coplanar with both 
-    // (a, b, c) and one other face. We perform a flip23 on tau and tau_a 
-    // for reasons explained by Ledoux.
-    // FIXME
+    int tet = t->free_tets->data[t->free_tets->size-1];
+    int_array_resize(t->free_tets, t->free_tets->size-1);
+    return tet;
   }
+  allocate_new_tets(t, 1);
+  return t->num_tets++;
+}
+
+// Deletes the given tet, returning its slot to the free list.
+static void delete_tet(delaunay_triangulation_t* t, int tet)
+{
+  t->tet_vertices[4*tet] = DEAD_VERTEX;
+  int_array_append(t->free_tets, tet);
 }
 
-// This helper creates an initial set of tets within the triangulation so that 
-// the convex hull covers the entire domain.
-static void initial_aggregation(delaunay_triangulation_t* t, 
-                                point_t* points, 
-                                int num_points, 
-                                int_unordered_set_t* points_in_t)
+// Returns true if the given tet has been deleted.
+static inline bool is_dead(delaunay_triangulation_t* t, int tet)
 {
-  // Find the points in the convex hull.
-  // FIXME.
+  return (t->tet_vertices[4*tet] == DEAD_VERTEX);
 }
 
+// Change log entries for tet slots. A slot is listed in changed_tets the 
+// first time it changes.
+#define TET_CREATED 1
+#define TET_DESTROYED 2
+#define TET_LISTED 4
 
-static void incremental_flip(delaunay_triangulation_t* t, point_t* points, int num_points)
+// Lists the given tet slot in the change log if it isn't already.
+static inline void list_change(delaunay_triangulation_t* t, int tet)
 {
-  polymec_not_implemented("incremental_flip()");
-  for (int i = 0; i < num_points; ++i)
+  if (!(t->tet_changes[tet] & TET_LISTED))
   {
-    // Insert the new vertex.
-    allocate_new_vertex(t);
-    int v_index = t->num_vertices;
-    t->vertices[v_index] = points[i];
-    t->num_vertices++;
+    int_array_append(t->changed_tets, tet);
+    t->tet_changes[tet] |= TET_LISTED;
+  }
+}
 
-    // Figure out which tet (tau) the point v lies in.
-    int tau = tet_containing_point(t, &points[i]);
+// Records in the change log that the given tet is about to be destroyed 
+// (or overwritten). Only finite tets are logged, and a tet that was created 
+// since the log was cleared simply disappears from it.
+static inline void log_destruction(delaunay_triangulation_t* t, int tet)
+{
+  if ((t->tet_changes == NULL) || is_ghost(t, tet)) return;
+  --t->num_finite_tets;
+  char* change = &t->tet_changes[tet];
+  if (*change & TET_CREATED)
+    *change &= ~TET_CREATED;
+  else
+  {
+    list_change(t, tet);
+    *change |= TET_DESTROYED;
+  }
+}
 
-    // Insert a vertex into that tet and split it into 4 parts ("flip14" in 
-    // Ledoux's paper).
-    int new_tets[4];
-    flip14(t, tau, new_tets);
+// Records in the change log that the given tet has been created.
+static inline void log_creation(delaunay_triangulation_t* t, int tet)
+{
+  if ((t->tet_changes == NULL) || is_ghost(t, tet)) return;
+  ++t->num_finite_tets;
+  for (int i = 0; i < 4; ++i)
+    t->vertex_tets[t->tet_vertices[4*tet+i]] = tet;
+  list_change(t, tet);
+  t->tet_changes[tet] |= TET_CREATED;
+}
 
-    // Push the 4 new tetrahedra onto a working stack.
-    int_slist_t* stack = int_slist_new();
-    for (int j = 0; j < 4; ++j)
-      int_slist_push(stack, new_tets[j]);
+// Returns true if the vertex v coincides with one of the vertices of tau.
+static bool duplicates_vertex(delaunay_triangulation_t* t, int tau, int v)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    int u = t->tet_vertices[4*tau+i];
+    if ((u != INFINITE_VERTEX) && 
+        (t->vertices[u].x == t->vertices[v].x) && 
+        (t->vertices[u].y == t->vertices[v].y) && 
+        (t->vertices[u].z == t->vertices[v].z))
+      return true;
+  }
+  return false;
+}
 
-    // Perform all necessary flips to rectify the new vertex.
-    while (!int_slist_empty(stack))
+// Compares (vertex, vertex, tet, face) tuples by their vertices.
+static int edge_cmp(const void* l, const void* r)
+{
+  const int* e1 = l;
+  const int* e2 = r;
+  if (e1[0] != e2[0])
+    return (e1[0] < e2[0]) ? -1 : 1;
+  if (e1[1] != e2[1])
+    return (e1[1] < e2[1]) ? -1 : 1;
+  return 0;
+}
+
+static void fill_cavity(delaunay_triangulation_t* t, int v, int_array_t* created);
+
+// Inserts the vertex v into the triangulation using the Bowyer-Watson 
+// algorithm, starting from the tet tau, which contains v. The tets whose 
+// circumspheres contain v form a cavity, which is replaced by tets that 
+// connect v to each of its boundary faces. Returns false (and leaves the 
+// triangulation unchanged) if v coincides with a vertex of tau.
+static bool insert_vertex(delaunay_triangulation_t* t, int v, int tau)
+{
+  // Skip v if it duplicates a vertex of tau.
+  if (duplicates_vertex(t, tau, v))
+    return false;
+
+  // Grow the cavity from tau by a breadth-first search through the tets 
+  // adjacent to it. Tets in the cavity are marked with the current mark, 
+  // and tets we've found not to conflict are marked with its negative. The 
+  // boundary faces are stored as (cavity tet, face) pairs.
+  int_array_t* cavity = t->cavity;
+  int_array_t* boundary = t->boundary;
+  int_array_clear(cavity);
+  int_array_clear(boundary);
+  ++t->mark;
+  int mark = t->mark;
+  int_array_append(cavity, tau);
+  t->tet_marks[tau] = mark;
+  for (size_t k = 0; k < cavity->size; ++k)
+  {
+    int c = cavity->data[k];
+    bool conflicts[4];
+    find_conflicts(t, c, v, mark, conflicts);
+    for (int i = 0; i < 4; ++i)
     {
-      // Pull the tet tau off the stack and retrieve its vertex indices
-      // (v, a, b, c), where v is the vertex we just inserted.
-      int tau = int_slist_pop(stack, NULL);
-      int v = -1, a = -1, b = -1, c = -1;
-      for (int j = 0; j < 4; ++j)
+      int n = t->tet_neighbors[4*c+i];
+      if (t->tet_marks[n] == mark) continue;
+      if (conflicts[i])
       {
-        if (t->tet_vertices[j] == v_index)
-          v = t->tet_vertices[j];
-        else
-        {
-          if (a == -1) 
-            a = t->tet_vertices[j];
-          else if (b == -1)
-            b = t->tet_vertices[j];
-          else if (c == -1)
-            c = t->tet_vertices[j];
-        }
+        t->tet_marks[n] = mark;
+        int_array_append(cavity, n);
+      }
+      else
+      {
+        t->tet_marks[n] = -mark;
+        int_array_append(boundary, c);
+        int_array_append(boundary, i);
       }
-
-      // Find the tetrahedron (a, b, c, d) adjacent to tau = (v, a, b, c) 
-      // that shares the vertices (a, b, c).
-      int tau_a, d;
-      find_adjacent_tet(t, tau, v, a, b, c, &tau_a, &d);
-
-      // If the fourth vertex d of tau_a is inside the circumsphere of tau, 
-      // flip tau and tau_a. Use Shewchuk's INSPHERE predicate for this.
-      real_t pv[3] = {t->vertices[v].x, t->vertices[v].y, t->vertices[v].z};
-      real_t pa[3] = {t->vertices[a].x, t->vertices[a].y, t->vertices[a].z};
-      real_t pb[3] = {t->vertices[b].x, t->vertices[b].y, t->vertices[b].z};
-      real_t pc[3] = {t->vertices[c].x, t->vertices[c].y, t->vertices[c].z};
-      real_t pd[3] = {t->vertices[d].x, t->vertices[d].y, t->vertices[d].z};
-      if (insphere(pv, pa, pb, pc, pd) > 0.0)
-        flip(t, tau, tau_a, v, a, b, c, d, stack);
     }
-
-    // Clean up.
-    int_slist_free(stack);
   }
+  fill_cavity(t, v, NULL);
+  return true;
 }
 
-static void bowyer_watson(delaunay_triangulation_t* t, point_t* points, int num_points)
+// Replaces the tets of the cavity (t->cavity) with tets that connect the 
+// vertex v to each of its boundary faces (t->boundary, as (cavity tet, face) 
+// pairs). The new tets are appended to created if it isn't NULL.
+static void fill_cavity(delaunay_triangulation_t* t, int v, int_array_t* created)
 {
-  // Initialize an aggregate of tets whose convex hull spans the entire domain.
-  int_unordered_set_t* points_in_t = int_unordered_set_new();
-  initial_aggregation(t, points, num_points, points_in_t);
+  // We create one new tet for each boundary face, reusing the slots of the 
+  // cavity's tets and taking any others from the pool. A new tet is a copy of the cavity tet on the boundary 
+  // face with v replacing the vertex opposite the face, so its orientation 
+  // is preserved. First we record the data we need from the cavity tets: 
+  // (outside tet, its face, 4 new vertices) for each new tet.
+  int_array_t* cavity = t->cavity;
+  int_array_t* boundary = t->boundary;
+  int num_new_tets = (int)(boundary->size / 2);
+  int num_cavity_tets = (int)cavity->size;
+  int_array_t* new_tets = t->new_tets;
+  int_array_resize(new_tets, 6*num_new_tets);
+  for (int j = 0; j < num_new_tets; ++j)
+  {
+    int c = boundary->data[2*j], i = boundary->data[2*j+1];
+    int* data = &new_tets->data[6*j];
+    data[0] = t->tet_neighbors[4*c+i];
+    data[1] = shared_face(t, data[0], c);
+    memcpy(&data[2], &t->tet_vertices[4*c], 4*sizeof(int));
+    data[2+i] = v;
+  }
+  for (int j = 0; j < num_cavity_tets; ++j)
+    log_destruction(t, cavity->data[j]);
 
-  // Now add the rest of the points.
-  tetrahedron_t* tet = tetrahedron_new();
-  int_unordered_set_t* intersected_tets = int_unordered_set_new();
-  int_tuple_unordered_set_t* intersected_faces = int_tuple_unordered_set_new();
-  for (int i = 0; i < num_points; ++i)
+  int_array_t* edges = t->edges;
+  int_array_clear(edges);
+  for (int j = 0; j < num_new_tets; ++j)
   {
-    // Skip vertices in the initial aggregation.
-    if (int_unordered_set_contains(points_in_t, i))
-      continue;
+    int tet = (j < num_cavity_tets) ? cavity->data[j] : new_tet(t);
+    int i = boundary->data[2*j+1];
+    int* data = &new_tets->data[6*j];
+    memcpy(&t->tet_vertices[4*tet], &data[2], 4*sizeof(int));
+    t->tet_marks[tet] = 0;
+    log_creation(t, tet);
+    if (!is_ghost(t, tet))
+      t->last_tet = tet;
+    if (created != NULL)
+      int_array_append(created, tet);
 
-    point_t* x = &points[i];
+    // Connect the new tet to the tet outside the cavity.
+    t->tet_neighbors[4*tet+i] = data[0];
+    t->tet_neighbors[4*data[0]+data[1]] = tet;
 
-    // Find all the tets whose circumcenters contain this point and 
-    // mark them as intersected.
-    for (int j = 0; j < t->num_tets; ++j)
+    // Each of the other faces of the new tet contains v and an edge of the 
+    // boundary face, which it shares with the new tet on the boundary face 
+    // across that edge.
+    for (int k = 0; k < 4; ++k)
     {
-      point_t *xa = &points[t->tet_vertices[4*j]],
-              *xb = &points[t->tet_vertices[4*j+1]],
-              *xc = &points[t->tet_vertices[4*j+2]],
-              *xd = &points[t->tet_vertices[4*j+3]];
-      tetrahedron_set_vertices(tet, xa, xb, xc, xd);
-
-      if (tetrahedron_contains_point(tet, x))
-        int_unordered_set_insert(intersected_tets, j);
+      if (k == i) continue;
+      int e[2], ne = 0;
+      for (int l = 0; l < 4; ++l)
+      {
+        if ((l != i) && (l != k))
+          e[ne++] = data[2+l];
+      }
+      int_array_append(edges, MIN(e[0], e[1]));
+      int_array_append(edges, MAX(e[0], e[1]));
+      int_array_append(edges, tet);
+      int_array_append(edges, k);
     }
+  }
+
+  // Match the edges to connect the new tets to one another.
+  int num_edges = (int)(edges->size / 4);
+  qsort(edges->data, num_edges, 4*sizeof(int), edge_cmp);
+  for (int j = 0; j < num_edges; j += 2)
+  {
+    int* e1 = &edges->data[4*j];
+    int* e2 = &edges->data[4*j+4];
+    ASSERT((e1[0] == e2[0]) && (e1[1] == e2[1]));
+    t->tet_neighbors[4*e1[2]+e1[3]] = e2[2];
+    t->tet_neighbors[4*e2[2]+e2[3]] = e1[2];
+  }
+
+  // Return any cavity tets we didn't reuse to the pool.
+  for (int j = num_new_tets; j < num_cavity_tets; ++j)
+    delete_tet(t, cavity->data[j]);
+}
 
-    // Now make a list of the faces of these intersected tets. If a face 
-    // occurs twice in this list, it is removed.
-    int pos = 0, tet_index;
-    while (int_unordered_set_next(intersected_tets, &pos, &tet_index))
+// Stores the vertices of the face opposite vertex i of the tet with the 
+// given vertices in f, in ascending order.
+static inline void sorted_face(int* v, int i, int* f)
+{
+  int n = 0;
+  for (int j = 0; j < 4; ++j)
+  {
+    if (j != i)
+      f[n++] = v[j];
+  }
+  if (f[0] > f[1]) { int tmp = f[0]; f[0] = f[1]; f[1] = tmp; }
+  if (f[1] > f[2]) { int tmp = f[1]; f[1] = f[2]; f[2] = tmp; }
+  if (f[0] > f[1]) { int tmp = f[0]; f[0] = f[1]; f[1] = tmp; }
+}
+
+// Returns true if the tet with the given vertices contains the vertex v.
+static inline bool has_vertex(int* w, int v)
+{
+  return ((w[0] == v) || (w[1] == v) || (w[2] == v) || (w[3] == v));
+}
+
+// This helper replaces the given old tets with new tets whose vertices are 
+// given (4 per tet), reusing the old tets' slots and taking any others from 
+// the pool. The new tets are connected to one another and to the tets 
+// around the old ones by matching their faces, and are pushed onto the 
+// flip stack.
+static void replace_tets(delaunay_triangulation_t* t, 
+                         int* old_tets, int num_old_tets, 
+                         int* new_vertices, int num_new_tets)
+{
+  // Record the faces on the boundary of the old tets' union, with the tets 
+  // on the other side of them.
+  int faces[4*num_old_tets][4], num_faces = 0;
+  for (int j = 0; j < num_old_tets; ++j)
+  {
+    int tet = old_tets[j];
+    for (int i = 0; i < 4; ++i)
     {
-      // A face of a tet is stored as an ordered triple of its point indices.
+      int n = t->tet_neighbors[4*tet+i];
+      bool interior = false;
+      for (int k = 0; k < num_old_tets; ++k)
+        interior = interior || (n == old_tets[k]);
+      if (interior) continue;
+      sorted_face(&t->tet_vertices[4*tet], i, faces[num_faces]);
+      faces[num_faces++][3] = n;
+    }
+  }
 
-      // This array allow us to express the 4 faces of this tet in terms 
-      // of offsets from the first vertex of the tet.
-      int offsets[4][3] = {{0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3}};
+  // Reuse the old slots, and free any that are left over.
+  for (int j = 0; j < num_old_tets; ++j)
+    log_destruction(t, old_tets[j]);
+  int new_tets[num_new_tets];
+  for (int j = 0; j < num_new_tets; ++j)
+    new_tets[j] = (j < num_old_tets) ? old_tets[j] : new_tet(t);
+  for (int j = num_new_tets; j < num_old_tets; ++j)
+    delete_tet(t, old_tets[j]);
+  for (int j = 0; j < num_new_tets; ++j)
+  {
+    memcpy(&t->tet_vertices[4*new_tets[j]], &new_vertices[4*j], 4*sizeof(int));
+    t->tet_marks[new_tets[j]] = 0;
+    log_creation(t, new_tets[j]);
+  }
 
-      // Add each of these tet faces to our list. If it's already in there, 
-      // take it out instead.
-      for (int j = 0; j < 4; ++j)
+  // Connect each face of each new tet to the new tet or outside tet that 
+  // shares it.
+  int new_faces[4*num_new_tets][3];
+  for (int j = 0; j < 4*num_new_tets; ++j)
+    sorted_face(&new_vertices[4*(j/4)], j%4, new_faces[j]);
+  for (int j = 0; j < 4*num_new_tets; ++j)
+  {
+    int tet = new_tets[j/4];
+    int* f = new_faces[j];
+    int n = -2;
+    for (int k = 0; k < 4*num_new_tets; ++k)
+    {
+      int* g = new_faces[k];
+      if ((k/4 != j/4) && (f[0] == g[0]) && (f[1] == g[1]) && (f[2] == g[2]))
       {
-        int* f = int_tuple_new(3);
-        f[0] = t->tet_vertices[4*tet_index+offsets[j][0]];
-        f[1] = t->tet_vertices[4*tet_index+offsets[j][1]];
-        f[2] = t->tet_vertices[4*tet_index+offsets[j][2]];
-        int_qsort(f, 3);
-
-        if (int_tuple_unordered_set_contains(intersected_faces, f))
-          int_tuple_unordered_set_delete(intersected_faces, f);
-        else
-          int_tuple_unordered_set_insert(intersected_faces, f);
+        n = new_tets[k/4];
+        break;
+      }
+    }
+    for (int k = 0; (k < num_faces) && (n == -2); ++k)
+    {
+      int* face = faces[k];
+      if ((f[0] == face[0]) && (f[1] == face[1]) && (f[2] == face[2]))
+      {
+        n = face[3];
+        if (n != -1)
+        {
+          // The outside tet's face is opposite its vertex not on f.
+          int* w = &t->tet_vertices[4*n];
+          int l = 0;
+          while ((w[l] == f[0]) || (w[l] == f[1]) || (w[l] == f[2])) ++l;
+          t->tet_neighbors[4*n+l] = tet;
+        }
       }
     }
+    ASSERT(n != -2);
+    t->tet_neighbors[4*tet+j%4] = n;
+  }
+  for (int j = 0; j < num_new_tets; ++j)
+  {
+    int_array_append(t->stack, new_tets[j]);
+    if (!is_ghost(t, new_tets[j]))
+      t->last_tet = new_tets[j];
+  }
+}
+
+// Copies the vertices of the given tet to w, replacing the vertex u with v.
+static inline void copy_replacing(delaunay_triangulation_t* t, int tet, int u, int v, int* w)
+{
+  memcpy(w, &t->tet_vertices[4*tet], 4*sizeof(int));
+  for (int i = 0; i < 4; ++i)
+  {
+    if (w[i] == u)
+      w[i] = v;
+  }
+}
 
-    // Now we assemble new tets consisting of the above faces.
+// Computes stand-ins for the orientations of the ghost tet tau with each of 
+// its vertices replaced by the vertex v, which lies in the closure of its 
+// hull face, storing them in o. These are zero for the hull face itself and 
+// for the faces through the hull edges on which v lies, and positive for 
+// the others.
+static void hull_orientations_with(delaunay_triangulation_t* t, int tau, int v, real_t* o)
+{
+  int* w = &t->tet_vertices[4*tau];
+  int k = 0;
+  while (w[k] != INFINITE_VERTEX) ++k;
 
-    // First, overwrite any of the tets that were intersected.
-    pos = 0;
-    while (int_unordered_set_next(intersected_tets, &pos, &tet_index))
+  // v lies on the line through the edge (p, q) of the hull face if it lies 
+  // in the plane through p, q, and the vertex of the finite tet beneath it.
+  int n = t->tet_neighbors[4*tau+k];
+  int apex = t->tet_vertices[4*n+shared_face(t, n, tau)];
+  for (int i = 0; i < 4; ++i)
+  {
+    if (i == k)
+      o[i] = 0.0;
+    else
     {
+      int e[2], ne = 0;
+      for (int l = 0; l < 4; ++l)
+      {
+        if ((l != i) && (l != k))
+          e[ne++] = w[l];
+      }
+      o[i] = (orientation(t, e[0], e[1], v, apex) == 0.0) ? 0.0 : 1.0;
+    }
+  }
+}
 
+// This helper inserts the vertex v into the tet tau that contains it, 
+// breaking tau into 4 tets (a "flip14" in Ledoux's paper). If v lies on a 
+// face or an edge of tau, every tet sharing that face or edge is broken up 
+// instead, so that no flat tets are created. If that face or edge lies on 
+// the convex hull, this includes the ghost tets on it.
+static void flip14(delaunay_triangulation_t* t, int v, int tau)
+{
+  // Find the tets whose closures contain v: tau and the tets across the 
+  // faces on which v lies. Each new tet is a copy of one of these with v 
+  // replacing the vertex opposite a face that v doesn't lie on, so its 
+  // orientation is preserved.
+  int_array_t* old_tets = t->cavity;
+  int_array_t* new_vertices = t->new_tets;
+  int_array_clear(old_tets);
+  int_array_clear(new_vertices);
+  ++t->mark;
+  int_array_append(old_tets, tau);
+  t->tet_marks[tau] = t->mark;
+  for (size_t k = 0; k < old_tets->size; ++k)
+  {
+    int c = old_tets->data[k];
+    real_t o[4];
+    if (is_ghost(t, c))
+      hull_orientations_with(t, c, v, o);
+    else
+      orientations_with(t, c, v, o);
+    for (int i = 0; i < 4; ++i)
+    {
+      if (o[i] == 0.0)
+      {
+        int n = t->tet_neighbors[4*c+i];
+        if (t->tet_marks[n] != t->mark)
+        {
+          t->tet_marks[n] = t->mark;
+          int_array_append(old_tets, n);
+        }
+      }
+      else
+      {
+        for (int l = 0; l < 4; ++l)
+          int_array_append(new_vertices, (l == i) ? v : t->tet_vertices[4*c+l]);
+      }
     }
+  }
+  replace_tets(t, old_tets->data, (int)old_tets->size, 
+               new_vertices->data, (int)(new_vertices->size/4));
+}
 
-    // Now add new tets until we exhaust the rest of the intersected faces.
-    while (!int_tuple_unordered_set_empty(intersected_faces))
+// This helper inserts the vertex v, which lies outside the convex hull 
+// beyond the hull face of the ghost tet tau. The ghost tets whose hull 
+// faces v sees form a cavity, which is replaced as in the Bowyer-Watson 
+// algorithm by tets connecting v to those faces and to the edges around 
+// them, so the hull stays convex. The new tets are pushed onto the flip 
+// stack.
+static void attach_vertex(delaunay_triangulation_t* t, int v, int tau)
+{
+  int_array_t* cavity = t->cavity;
+  int_array_t* boundary = t->boundary;
+  int_array_clear(cavity);
+  int_array_clear(boundary);
+  ++t->mark;
+  int mark = t->mark;
+  int_array_append(cavity, tau);
+  t->tet_marks[tau] = mark;
+  for (size_t k = 0; k < cavity->size; ++k)
+  {
+    int c = cavity->data[k];
+    for (int i = 0; i < 4; ++i)
     {
+      // The neighbors across the faces through the vertex at infinity are 
+      // the ghost tets on the adjacent hull faces.
+      int n = t->tet_neighbors[4*c+i];
+      if (t->tet_marks[n] == mark) continue;
+      if ((t->tet_vertices[4*c+i] != INFINITE_VERTEX) && (t->tet_marks[n] != -mark))
+      {
+        int j = 0;
+        while (t->tet_vertices[4*n+j] != INFINITE_VERTEX) ++j;
+        if (orientation_with(t, n, j, v) > 0.0)
+        {
+          t->tet_marks[n] = mark;
+          int_array_append(cavity, n);
+          continue;
+        }
+        t->tet_marks[n] = -mark;
+      }
+      int_array_append(boundary, c);
+      int_array_append(boundary, i);
     }
   }
+  fill_cavity(t, v, t->stack);
+}
 
-  // Clean up.
-  int_unordered_set_free(intersected_tets);
-  int_tuple_unordered_set_free(intersected_faces);
-  int_unordered_set_free(points_in_t);
+// This helper replaces tau = (v, a, b, c) and tau_a = (a, b, c, d) with 
+// 3 tets sharing the edge (v, d).
+static void flip23(delaunay_triangulation_t* t, int tau, int tau_a, int v, int d)
+{
+  int old_tets[2] = {tau, tau_a}, new_vertices[12], n = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    int u = t->tet_vertices[4*tau+i];
+    if (u != v)
+      copy_replacing(t, tau, u, d, &new_vertices[4*(n++)]);
+  }
+  replace_tets(t, old_tets, 2, new_vertices, 3);
 }
 
-static void divide_and_conquer(delaunay_triangulation_t* t, point_t* points, int num_points)
+// This helper replaces the 3 tets tau = (v, x, y, z), tau_a = (x, y, z, d), 
+// and tau_b = (x, y, v, d) around the edge (x, y) with 2 tets sharing the 
+// face (v, z, d).
+static void flip32(delaunay_triangulation_t* t, int tau, int tau_a, int tau_b, 
+                   int x, int y, int d)
 {
-  polymec_not_implemented("divide_and_conquer()");
+  int old_tets[3] = {tau, tau_a, tau_b}, new_vertices[8];
+  copy_replacing(t, tau, x, d, &new_vertices[0]);
+  copy_replacing(t, tau, y, d, &new_vertices[4]);
+  replace_tets(t, old_tets, 3, new_vertices, 2);
 }
 
-static void dewall(delaunay_triangulation_t* t, point_t* points, int num_points)
+// This helper replaces the 4 tets tau = (v, x, y, z), tau_a = (x, y, z, d), 
+// tau_b = (x, y, v, e) and tau_c = (x, y, d, e) around the edge (x, y), 
+// where v, d, x, and y are coplanar, with 4 tets around the edge (v, d).
+static void flip44(delaunay_triangulation_t* t, int tau, int tau_a, int tau_b, int tau_c, 
+                   int x, int y, int d)
 {
-  polymec_not_implemented("dewall()");
+  int old_tets[4] = {tau, tau_a, tau_b, tau_c}, new_vertices[16];
+  copy_replacing(t, tau, x, d, &new_vertices[0]);
+  copy_replacing(t, tau, y, d, &new_vertices[4]);
+  copy_replacing(t, tau_b, x, d, &new_vertices[8]);
+  copy_replacing(t, tau_b, y, d, &new_vertices[12]);
+  replace_tets(t, old_tets, 4, new_vertices, 4);
 }
 
-delaunay_triangulation_t* delaunay_triangulation_new(point_t* points, int num_points)
+// Given a tetrahedron tau = (v, a, b, c), this helper retrieves the index 
+// of the tetrahedron tau_a = (a, b, c, d) adjacent to tau that shares the 
+// vertices (a, b, c), and its vertex d.
+static void find_adjacent_tet(delaunay_triangulation_t* t, int tau, int v, 
+                              int* tau_a, int* d)
 {
-  ASSERT(num_points >= 4);
+  int i = 0;
+  while (t->tet_vertices[4*tau+i] != v) ++i;
+  *tau_a = t->tet_neighbors[4*tau+i];
+  *d = t->tet_vertices[4*(*tau_a)+shared_face(t, *tau_a, tau)];
+}
 
-  delaunay_triangulation_t* t = polymec_malloc(sizeof(delaunay_triangulation_t));
-  t->algorithm = BOWYER_WATSON;
-  t->num_vertices = 0;
-  t->vertex_cap = 32;
-  t->vertices = polymec_malloc(sizeof(point_t) * t->vertex_cap);
+// This helper restores the Delaunay property across the face opposite v of 
+// the ghost tet tau = (v, x, y, infinity), which it shares with the ghost 
+// tet tau_a = (x, y, infinity, d). Since the hull stays convex, d never 
+// lies beyond the hull face (v, x, y), so this is only necessary if the 
+// hull faces (v, x, y) and (x, y, d) are coplanar and d lies inside the 
+// circumcircle of (v, x, y). Then, as in case 3 of flip, tau, tau_a, and 
+// the tets tau_b = (x, y, v, e) and tau_c = (x, y, d, e) beneath them are 
+// flipped to 4 tets around the edge (v, d), provided that the line through 
+// v and d crosses the edge (x, y).
+static void flip_on_hull(delaunay_triangulation_t* t, int tau, int tau_a, int v, int d)
+{
+  int* w = &t->tet_vertices[4*tau];
+  int iz = 0;
+  while (w[iz] != INFINITE_VERTEX) ++iz;
+  if ((orientation_with(t, tau, iz, d) != 0.0) || !in_conflict(t, tau, d))
+    return;
+  int xy[2], n = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    if ((i != iz) && (w[i] != v))
+      xy[n++] = w[i];
+  }
+  int x = xy[0], y = xy[1];
+  int tau_b = t->tet_neighbors[4*tau+iz];
+  int* wa = &t->tet_vertices[4*tau_a];
+  int jz = 0;
+  while (wa[jz] != INFINITE_VERTEX) ++jz;
+  int tau_c = t->tet_neighbors[4*tau_a+jz];
+  int* wb = &t->tet_vertices[4*tau_b];
+  int e = 0;
+  while ((wb[e] == x) || (wb[e] == y) || (wb[e] == v)) ++e;
+  if (!has_vertex(&t->tet_vertices[4*tau_c], wb[e]))
+    return;
 
-  t->num_tets = 0;
-  t->tet_cap = 32;
-  t->tet_vertices = polymec_malloc(sizeof(int) * 4 * t->tet_cap);
+  // The new finite tets are positively oriented if the line through v and 
+  // d crosses the edge.
+  int u[4];
+  copy_replacing(t, tau_b, x, d, u);
+  if (orientation(t, u[0], u[1], u[2], u[3]) <= 0.0)
+    return;
+  copy_replacing(t, tau_b, y, d, u);
+  if (orientation(t, u[0], u[1], u[2], u[3]) <= 0.0)
+    return;
+  flip44(t, tau, tau_a, tau_b, tau_c, x, y, d);
+}
 
-  switch(t->algorithm)
+// This helper restores the Delaunay property across the face of the tet 
+// tau = (v, a, b, c) opposite the vertex v that was just inserted, by 
+// flipping tau and its neighbor tau_a = (a, b, c, d) according to the cases 
+// in Ledoux's paper if d lies inside the circumsphere of tau.
+static void flip(delaunay_triangulation_t* t, int tau, int v)
+{
+  int tau_a, d;
+  find_adjacent_tet(t, tau, v, &tau_a, &d);
+
+  // The vertex at infinity lies outside every circumsphere, and faces on 
+  // the hull are handled separately.
+  if (d == INFINITE_VERTEX)
+    return;
+  if (is_ghost(t, tau))
   {
-    case BOWYER_WATSON:
-      bowyer_watson(t, points, num_points);
-      break;
-    case INCREMENTAL_FLIP:
-      incremental_flip(t, points, num_points);
-      break;
-    case DIVIDE_AND_CONQUER:
-      divide_and_conquer(t, points, num_points);
-      break;
-    case DEWALL:
-      dewall(t, points, num_points);
+    flip_on_hull(t, tau, tau_a, v, d);
+    return;
   }
+  int* w = &t->tet_vertices[4*tau];
+  if (in_sphere(t, w[0], w[1], w[2], w[3], d) <= 0.0)
+    return;
 
-  return t;
+  // Order the face (a, b, c) so that (v, a, b, c) is positively oriented, 
+  // and find where the line through v and d crosses its plane by checking 
+  // the orientation of (v, d) with each of its edges. It passes through the 
+  // interior of (a, b, c) if all of these are positive.
+  int iv = 0;
+  while (w[iv] != v) ++iv;
+  int abc[3], n = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (i != iv)
+      abc[n++] = w[i];
+  }
+  if (iv % 2 == 1)
+  {
+    int tmp = abc[1];
+    abc[1] = abc[2];
+    abc[2] = tmp;
+  }
+  int num_negative = 0, num_zero = 0, edge = -1;
+  for (int k = 0; k < 3; ++k)
+  {
+    real_t o = orientation(t, v, d, abc[k], abc[(k+1)%3]);
+    if (o < 0.0)
+    {
+      ++num_negative;
+      edge = k;
+    }
+    else if (o == 0.0)
+    {
+      ++num_zero;
+      if (num_negative == 0)
+        edge = k;
+    }
+  }
+
+  if ((num_negative == 0) && (num_zero == 0)) // case 1
+  {
+    // The union of tau and tau_a is convex, so a flip23 is performed.
+    flip23(t, tau, tau_a, v, d);
+  }
+  else if (num_negative == 1) // case 2
+  {
+    // The union of tau and tau_a is non-convex across the edge (x, y). If 
+    // the edge is shared by a third tet tau_b = (x, y, v, d), we perform a 
+    // flip32. If not, no flip is performed, and this non-convex case will 
+    // be rectified by another flip elsewhere.
+    int x = abc[edge], y = abc[(edge+1)%3], z = abc[(edge+2)%3];
+    int iz = 0;
+    while (w[iz] != z) ++iz;
+    int tau_b = t->tet_neighbors[4*tau+iz];
+    if ((tau_b != -1) && has_vertex(&t->tet_vertices[4*tau_b], d))
+      flip32(t, tau, tau_a, tau_b, x, y, d);
+  }
+  else if ((num_negative == 0) && (num_zero == 1)) // case 3
+  {
+    // x, y, d, and v are coplanar, so the line through v and d crosses the 
+    // edge (x, y). We flip tau and tau_a if they are in the "config44" 
+    // state: the edge is shared by exactly two other tets tau_b = (x, y, v, e) 
+    // and tau_c = (x, y, d, e).
+    int x = abc[edge], y = abc[(edge+1)%3], z = abc[(edge+2)%3];
+    int iz = 0;
+    while (w[iz] != z) ++iz;
+    int tau_b = t->tet_neighbors[4*tau+iz];
+    int* wa = &t->tet_vertices[4*tau_a];
+    int jz = 0;
+    while (wa[jz] != z) ++jz;
+    int tau_c = t->tet_neighbors[4*tau_a+jz];
+    if ((tau_b != -1) && (tau_c != -1) && (tau_b != tau_c))
+    {
+      int* wb = &t->tet_vertices[4*tau_b];
+      int e = 0;
+      while ((wb[e] == x) || (wb[e] == y) || (wb[e] == v)) ++e;
+      if (has_vertex(&t->tet_vertices[4*tau_c], wb[e]))
+        flip44(t, tau, tau_a, tau_b, tau_c, x, y, d);
+    }
+  }
 }
 
-void delaunay_triangulation_free(delaunay_triangulation_t* t)
+// Bits per axis in the Hilbert keys used to order points.
+#define HILBERT_BITS 16
+
+// Returns the index of the point x along a Hilbert curve through the given 
+// bounding box, using Skilling's algorithm ("Programming the Hilbert curve", 
+// 2004).
+static uint64_t hilbert_key(point_t* x, bbox_t* bbox)
 {
-  polymec_free(t->vertices);
-  polymec_free(t->tet_vertices);
-  polymec_free(t);
+  static const uint32_t max_coord = (1u << HILBERT_BITS) - 1;
+  real_t xs[3] = {x->x, x->y, x->z};
+  real_t lo[3] = {bbox->x1, bbox->y1, bbox->z1}, hi[3] = {bbox->x2, bbox->y2, bbox->z2};
+  uint32_t X[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    real_t w = hi[i] - lo[i];
+    real_t s = (w > 0.0) ? (xs[i] - lo[i]) / w : 0.0;
+    X[i] = (uint32_t)MIN(max_coord, MAX(0.0, s * max_coord));
+  }
+
+  // Transform the coordinates into the "transpose" of the Hilbert index.
+  uint32_t M = 1u << (HILBERT_BITS - 1);
+  for (uint32_t Q = M; Q > 1; Q >>= 1)
+  {
+    uint32_t P = Q - 1;
+    for (int i = 0; i < 3; ++i)
+    {
+      if (X[i] & Q)
+        X[0] ^= P;
+      else
+      {
+        uint32_t s = (X[0] ^ X[i]) & P;
+        X[0] ^= s;
+        X[i] ^= s;
+      }
+    }
+  }
+  for (int i = 1; i < 3; ++i)
+    X[i] ^= X[i-1];
+  uint32_t s = 0;
+  for (uint32_t Q = M; Q > 1; Q >>= 1)
+  {
+    if (X[2] & Q)
+      s ^= Q - 1;
+  }
+  for (int i = 0; i < 3; ++i)
+    X[i] ^= s;
+
+  // Interleave the bits of the transpose.
+  uint64_t key = 0;
+  for (int b = HILBERT_BITS - 1; b >= 0; --b)
+    for (int i = 0; i < 3; ++i)
+      key = (key << 1) | ((X[i] >> b) & 1);
+  return key;
 }
 
-int delaunay_triangulation_num_vertices(delaunay_triangulation_t* t)
+// A point index and the key by which it's ordered.
+typedef struct
 {
-  return t->num_vertices;
+  uint64_t key;
+  int index;
+} ordered_point_t;
+
+static int ordered_point_cmp(const void* l, const void* r)
+{
+  const ordered_point_t* p1 = l;
+  const ordered_point_t* p2 = r;
+  return (p1->key < p2->key) ? -1 : (p1->key > p2->key) ? 1 : 0;
 }
 
-void delaunay_triangulation_get_vertices(delaunay_triangulation_t* t, int* indices, int num_vertices, point_t* vertices)
+// Returns a newly allocated array containing the order in which the 
+// given vertices are inserted into the triangulation. This is a biased randomized 
+// insertion order (BRIO, Amenta et al, 2003): the vertices are divided into 
+// rounds of (roughly) doubling size, each of which is sorted along a Hilbert 
+// curve. Randomization keeps the expected work small, and the Hilbert order 
+// keeps consecutive points close to one another, so point location walks 
+// are short.
+static int* insertion_order(delaunay_triangulation_t* t, int* vertices, int num_points)
 {
-#ifndef NDEBUG
-  for (int i = 0; i < num_vertices; ++i)
+  bbox_t bbox = {.x1 = REAL_MAX, .x2 = -REAL_MAX, 
+                 .y1 = REAL_MAX, .y2 = -REAL_MAX, 
+                 .z1 = REAL_MAX, .z2 = -REAL_MAX};
+  for (int i = 0; i < num_points; ++i)
   {
-    ASSERT(indices[i] >= 0);
-    ASSERT(indices[i] < t->num_vertices);
+    point_t* x = &t->vertices[vertices[i]];
+    bbox.x1 = MIN(bbox.x1, x->x); bbox.x2 = MAX(bbox.x2, x->x);
+    bbox.y1 = MIN(bbox.y1, x->y); bbox.y2 = MAX(bbox.y2, x->y);
+    bbox.z1 = MIN(bbox.z1, x->z); bbox.z2 = MAX(bbox.z2, x->z);
   }
-#endif
-  for (int i = 0; i < num_vertices; ++i)
-    vertices[i] = t->vertices[indices[i]];
+
+  // A point belongs to round r with probability 2^-(r+1). Rounds are 
+  // inserted from the highest (smallest) to the lowest (largest).
+  ordered_point_t* points = polymec_malloc(sizeof(ordered_point_t) * num_points);
+  for (int i = 0; i < num_points; ++i)
+  {
+    uint64_t round = 0;
+    while ((round < 15) && (next_random(t) & 1))
+      ++round;
+    points[i].key = ((15 - round) << (3*HILBERT_BITS)) | hilbert_key(&t->vertices[vertices[i]], &bbox);
+    points[i].index = vertices[i];
+  }
+  qsort(points, num_points, sizeof(ordered_point_t), ordered_point_cmp);
+  int* order = polymec_malloc(sizeof(int) * num_points);
+  for (int i = 0; i < num_points; ++i)
+    order[i] = points[i].index;
+  polymec_free(points);
+  return order;
 }
 
-int delaunay_triangulation_num_tetrahedra(delaunay_triangulation_t* t)
+// Returns true if the vertices a, b, and c are collinear.
+static bool collinear(delaunay_triangulation_t* t, int a, int b, int c)
 {
-  return t->num_tets;
+  vector_t ab, ac, n;
+  point_displacement(&t->vertices[a], &t->vertices[b], &ab);
+  point_displacement(&t->vertices[a], &t->vertices[c], &ac);
+  vector_cross(&ab, &ac, &n);
+  return ((n.x == 0.0) && (n.y == 0.0) && (n.z == 0.0));
 }
 
-bool delaunay_triangulation_next(delaunay_triangulation_t* t,
-                                 int* pos, int* v1, int* v2, int* v3, int* v4)
+// This helper finds the positions i1, i2, i3 of the first 3 of the given 
+// points that, with the first point, form a tet that isn't flat. Returns 
+// false if the points are coplanar.
+static bool find_first_tet(delaunay_triangulation_t* t, int* points, int num_points, 
+                           int* i1, int* i2, int* i3)
 {
-  if (*pos >= t->num_tets)
-    return false;
-  int i = *pos;
-  *v1 = t->tet_vertices[4*i];
-  *v2 = t->tet_vertices[4*i+1];
-  *v3 = t->tet_vertices[4*i+2];
-  *v4 = t->tet_vertices[4*i+3];
-  ++(*pos);
-  return true;
+  *i1 = 1;
+  while ((*i1 < num_points) && 
+         (t->vertices[points[*i1]].x == t->vertices[points[0]].x) &&
+         (t->vertices[points[*i1]].y == t->vertices[points[0]].y) &&
+         (t->vertices[points[*i1]].z == t->vertices[points[0]].z))
+    ++(*i1);
+  *i2 = *i1 + 1;
+  while ((*i2 < num_points) && collinear(t, points[0], points[*i1], points[*i2]))
+    ++(*i2);
+  *i3 = *i2 + 1;
+  while ((*i3 < num_points) && 
+         (orientation(t, points[0], points[*i1], points[*i2], points[*i3]) == 0.0))
+    ++(*i3);
+  return (*i3 < num_points);
 }
 
+// This helper creates the initial tet of the triangulation from the first 
+// 4 points in the given insertion order that aren't coplanar, moving them 
+// to the front of the order. The faces of the tet are attached to 4 ghost 
+// tets.
+static void initial_aggregation(delaunay_triangulation_t* t, int* order, int num_points)
+{
+  int i1, i2, i3;
+  if (!find_first_tet(t, order, num_points, &i1, &i2, &i3))
+    polymec_error("delaunay_triangulation_new: the points are coplanar.");
+  int indices[3] = {i1, i2, i3};
+  for (int i = 0; i < 3; ++i)
+  {
+    int tmp = order[i+1];
+    order[i+1] = order[indices[i]];
+    order[indices[i]] = tmp;
+  }
+
+  // Create the tet, positively oriented.
+  int v[4] = {order[0], order[1], order[2], order[3]};
+  if (orientation(t, v[0], v[1], v[2], v[3]) < 0.0)
+  {
+    v[1] = order[2];
+    v[2] = order[1];
+  }
+  allocate_new_tets(t, 5);
+  memcpy(t->tet_vertices, v, 4*sizeof(int));
+
+  // The ghost tet across face i replaces vertex i with the vertex at 
+  // infinity, and swaps two of the others to preserve its orientation.
+  for (int i = 0; i < 4; ++i)
+  {
+    int* g = &t->tet_vertices[4*(i+1)];
+    memcpy(g, v, 4*sizeof(int));
+    g[i] = INFINITE_VERTEX;
+    int j = (i + 1) % 4, k = (i + 2) % 4;
+    g[j] = v[k];
+    g[k] = v[j];
+    t->tet_neighbors[i] = i + 1;
+    t->tet_neighbors[4*(i+1)+i] = 0;
+  }
+
+  // Ghost tets i and j share the face containing the vertex at infinity 
+  // and the two vertices of the tet other than i and j.
+  for (int i = 0; i < 4; ++i)
+  {
+    int* g = &t->tet_vertices[4*(i+1)];
+    for (int l = 0; l < 4; ++l)
+    {
+      if (l == i) continue;
+      // The face of ghost i opposite its vertex l lacks the tet's vertex 
+      // g[l], and is shared with the ghost tet that replaced g[l].
+      int j = 0;
+      while (v[j] != g[l]) ++j;
+      t->tet_neighbors[4*(i+1)+l] = j + 1;
+    }
+  }
+  t->num_tets = 5;
+  t->last_tet = 0;
+  for (int i = 0; i < 5; ++i)
+    t->tet_marks[i] = 0;
+}
+
+// This helper moves the ghost tets after the finite ones when a 
+// triangulation has been constructed, discarding the free tet slots.
+static void separate_ghost_tets(delaunay_triangulation_t* t)
+{
+  int num_tets = t->num_tets;
+  int* new_index = polymec_malloc(sizeof(int) * num_tets);
+  int num_finite = 0, num_ghosts = 0, num_dead = 0;
+  for (int tet = 0; tet < num_tets; ++tet)
+  {
+    if (!is_dead(t, tet) && !is_ghost(t, tet))
+      ++num_finite;
+  }
+  for (int tet = 0; tet < num_tets; ++tet)
+  {
+    if (is_dead(t, tet))
+    {
+      new_index[tet] = -1;
+      ++num_dead;
+    }
+    else if (is_ghost(t, tet))
+      new_index[tet] = num_finite + num_ghosts++;
+    else
+      new_index[tet] = tet - num_ghosts - num_dead;
+  }
+
+  int* vertices = polymec_malloc(4 * sizeof(int) * num_tets);
+  int* neighbors = polymec_malloc(4 * sizeof(int) * num_tets);
+  for (int tet = 0; tet < num_tets; ++tet)
+  {
+    int n = new_index[tet];
+    if (n == -1) continue;
+    memcpy(&vertices[4*n], &t->tet_vertices[4*tet], 4*sizeof(int));
+    for (int i = 0; i < 4; ++i)
+      neighbors[4*n+i] = new_index[t->tet_neighbors[4*tet+i]];
+  }
+  memcpy(t->tet_vertices, vertices, 4 * sizeof(int) * num_tets);
+  memcpy(t->tet_neighbors, neighbors, 4 * sizeof(int) * num_tets);
+  t->last_tet = new_index[t->last_tet];
+  polymec_free(neighbors);
+  polymec_free(vertices);
+  polymec_free(new_index);
+
+  t->num_tets = num_finite;
+  t->num_ghost_tets = num_ghosts;
+  int_array_clear(t->free_tets);
+}
+
+// Triangulates the given points (which must not be coplanar) by 
+// incremental insertion with bistellar flips.
+static void incremental_flip(delaunay_triangulation_t* t, int* points, int num_points)
+{
+  // Start with a single tet and the ghost tets on its faces, as in the 
+  // Bowyer-Watson algorithm, and insert the rest of the points in a biased 
+  // randomized order.
+  int* order = insertion_order(t, points, num_points);
+  initial_aggregation(t, order, num_points);
+  for (int i = 4; i < num_points; ++i)
+  {
+    // Figure out which tet (tau) the vertex v lies in, and split it, or 
+    // connect v to the hull if it lies outside.
+    int v = order[i];
+    int tau = tet_containing_point(t, v);
+    if (duplicates_vertex(t, tau, v)) continue;
+    int_array_clear(t->stack);
+    if (is_ghost(t, tau))
+      attach_vertex(t, v, tau);
+    else
+      flip14(t, v, tau);
+
+    // Perform all necessary flips to rectify the new vertex. Tets on the 
+    // stack may have been flipped away since they were pushed.
+    while (t->stack->size > 0)
+    {
+      int tau = t->stack->data[t->stack->size-1];
+      int_array_resize(t->stack, t->stack->size-1);
+      if (!is_dead(t, tau) && has_vertex(&t->tet_vertices[4*tau], v))
+        flip(t, tau, v);
+    }
+  }
+  polymec_free(order);
+  separate_ghost_tets(t);
+}
+
+// Triangulates the given points (which must not be coplanar) using the 
+// Bowyer-Watson algorithm.
+static void bowyer_watson(delaunay_triangulation_t* t, int* points, int num_points)
+{
+  // Start with a single tet, and insert the rest of the points in a biased 
+  // randomized order.
+  int* order = insertion_order(t, points, num_points);
+  initial_aggregation(t, order, num_points);
+  for (int i = 4; i < num_points; ++i)
+  {
+    int v = order[i];
+    int tau = tet_containing_point(t, v);
+    insert_vertex(t, v, tau);
+  }
+  polymec_free(order);
+  separate_ghost_tets(t);
+}
+
+// Point sets with fewer than this many points are triangulated serially 
+// by the divide-and-conquer algorithm.
+#define MIN_DC_POINTS 1024
+
+// A node in the tree of point sets built by the divide-and-conquer 
+// algorithm. The points of a node are order[begin:end). Those of an 
+// interior node are split by a cutting plane into order[begin:mid) and 
+// order[mid:end), each of which belongs to a child.
+typedef struct dc_node_t dc_node_t;
+struct dc_node_t
+{
+  delaunay_triangulation_t* t; // the triangulation being constructed
+  int* order; // the points, permuted so that each node's are contiguous
+  int* position; // the position of each point in order
+  int begin, mid, end, depth;
+  bool splittable; // true if the node has enough points to be split
+  int low, high; // indices of the children (-1 for a leaf)
+  bool merge_failed; // true if the children's triangulations couldn't be merged
+  bbox_t bbox; // bounding box of the node's points
+  delaunay_triangulation_t* result; // the triangulation of the node's points
+  dc_node_t* nodes; // all nodes in the tree
+};
+
+// Returns a new triangulation of num_points of the given vertices, which 
+// it shares (and doesn't own).
+static delaunay_triangulation_t* triangulation_new(point_t* vertices, 
+                                                   int num_vertices, 
+                                                   int num_points)
+{
+  delaunay_triangulation_t* t = polymec_malloc(sizeof(delaunay_triangulation_t));
+  t->algorithm = BOWYER_WATSON;
+  t->vertices = vertices;
+  t->num_vertices = num_vertices;
+  t->vertex_cap = num_vertices;
+
+  // A Delaunay triangulation of n points has about 6.5n tets.
+  t->num_tets = 0;
+  t->num_ghost_tets = 0;
+  t->tet_cap = MAX(32, 7 * num_points);
+  t->tet_vertices = polymec_malloc(sizeof(int) * 4 * t->tet_cap);
+  t->tet_neighbors = polymec_malloc(sizeof(int) * 4 * t->tet_cap);
+  t->tet_marks = polymec_malloc(sizeof(int) * t->tet_cap);
+  t->mark = 0;
+  t->last_tet = 0;
+  t->rng_state = 2463534242u;
+  t->num_merges = t->num_failed_merges = 0;
+  t->cavity = int_array_new();
+  t->boundary = int_array_new();
+  t->new_tets = int_array_new();
+  t->edges = int_array_new();
+  t->stack = int_array_new();
+  t->free_tets = int_array_new();
+  t->num_finite_tets = 0;
+  t->tet_changes = NULL;
+  t->changed_tets = NULL;
+  t->vertex_tets = NULL;
+  return t;
+}
+
+// Frees a triangulation created by triangulation_new, leaving its vertices.
+static void triangulation_free(delaunay_triangulation_t* t)
+{
+  t->vertices = NULL;
+  delaunay_triangulation_free(t);
+}
+
+// A point coordinate, used to sort points along an axis.
+typedef struct
+{
+  real_t x;
+  int index;
+} keyed_point_t;
+
+static int keyed_point_cmp(const void* l, const void* r)
+{
+  const keyed_point_t* p1 = l;
+  const keyed_point_t* p2 = r;
+  if (p1->x != p2->x)
+    return (p1->x < p2->x) ? -1 : 1;
+  return (p1->index < p2->index) ? -1 : (p1->index > p2->index) ? 1 : 0;
+}
+
+static inline real_t coordinate(point_t* x, int axis)
+{
+  return (axis == 0) ? x->x : (axis == 1) ? x->y : x->z;
+}
+
+// Computes the bounding box of the node's points, and splits them along 
+// the longest axis of the box at their median, sorting them along that 
+// axis. The split falls between two distinct coordinates, so that a plane 
+// separates the two halves strictly, and leaves neither half coplanar. If 
+// there's no such split, the node remains a leaf (mid is set to -1).
+static void split_node(void* context)
+{
+  dc_node_t* node = context;
+  delaunay_triangulation_t* t = node->t;
+  int* points = &node->order[node->begin];
+  int num_points = node->end - node->begin;
+  bbox_t* bbox = &node->bbox;
+  bbox->x1 = bbox->y1 = bbox->z1 = REAL_MAX;
+  bbox->x2 = bbox->y2 = bbox->z2 = -REAL_MAX;
+  for (int i = 0; i < num_points; ++i)
+  {
+    point_t* x = &t->vertices[points[i]];
+    bbox->x1 = MIN(bbox->x1, x->x); bbox->x2 = MAX(bbox->x2, x->x);
+    bbox->y1 = MIN(bbox->y1, x->y); bbox->y2 = MAX(bbox->y2, x->y);
+    bbox->z1 = MIN(bbox->z1, x->z); bbox->z2 = MAX(bbox->z2, x->z);
+  }
+  node->mid = -1;
+  if (!node->splittable) return;
+
+  real_t widths[3] = {bbox->x2 - bbox->x1, bbox->y2 - bbox->y1, bbox->z2 - bbox->z1};
+  int axes[3] = {0, 1, 2};
+  for (int i = 1; i < 3; ++i)
+  {
+    for (int j = i; (j > 0) && (widths[axes[j]] > widths[axes[j-1]]); --j)
+    {
+      int tmp = axes[j];
+      axes[j] = axes[j-1];
+      axes[j-1] = tmp;
+    }
+  }
+
+  keyed_point_t* keyed = polymec_malloc(sizeof(keyed_point_t) * num_points);
+  for (int a = 0; (a < 3) && (node->mid == -1); ++a)
+  {
+    int axis = axes[a];
+    if (widths[axis] == 0.0) break;
+    for (int i = 0; i < num_points; ++i)
+    {
+      keyed[i].x = coordinate(&t->vertices[points[i]], axis);
+      keyed[i].index = points[i];
+    }
+    qsort(keyed, num_points, sizeof(keyed_point_t), keyed_point_cmp);
+
+    // Move the split from the median to the nearest change in coordinate.
+    int m = num_points / 2, lo = m, hi = m;
+    while ((lo > 0) && (keyed[lo-1].x == keyed[lo].x)) --lo;
+    while ((hi < num_points) && (keyed[hi-1].x == keyed[hi].x)) ++hi;
+    int split = ((m - lo) <= (hi - m)) ? lo : hi;
+    if ((split < 4) || (split > num_points - 4)) continue;
+
+    for (int i = 0; i < num_points; ++i)
+      points[i] = keyed[i].index;
+    int i1, i2, i3;
+    if (find_first_tet(t, points, split, &i1, &i2, &i3) && 
+        find_first_tet(t, &points[split], num_points - split, &i1, &i2, &i3))
+      node->mid = node->begin + split;
+  }
+  polymec_free(keyed);
+}
+
+// Triangulates the node's points serially.
+static void triangulate_node_serially(dc_node_t* node)
+{
+  delaunay_triangulation_t* t = node->t;
+  int num_points = node->end - node->begin;
+  node->result = triangulation_new(t->vertices, t->num_vertices, num_points);
+  bowyer_watson(node->result, &node->order[node->begin], num_points);
+}
+
+// Computes the circumcenter c and squared circumradius r2 of the tet with the 
+// given vertices in floating point, returning false if they can't be computed.
+static bool circumsphere(delaunay_triangulation_t* t, int* v, point_t* c, real_t* r2)
+{
+  // Solve A u = b, where the rows of A are the edges from the first vertex, 
+  // and b holds half their squared lengths, using Cramer's rule.
+  point_t* x0 = &t->vertices[v[0]];
+  real_t A[3][3], b[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    point_t* x = &t->vertices[v[i+1]];
+    A[i][0] = x->x - x0->x;
+    A[i][1] = x->y - x0->y;
+    A[i][2] = x->z - x0->z;
+    b[i] = 0.5 * (A[i][0]*A[i][0] + A[i][1]*A[i][1] + A[i][2]*A[i][2]);
+  }
+  real_t c12[3] = {A[1][1]*A[2][2] - A[1][2]*A[2][1], 
+                   A[1][2]*A[2][0] - A[1][0]*A[2][2], 
+                   A[1][0]*A[2][1] - A[1][1]*A[2][0]};
+  real_t c20[3] = {A[2][1]*A[0][2] - A[2][2]*A[0][1], 
+                   A[2][2]*A[0][0] - A[2][0]*A[0][2], 
+                   A[2][0]*A[0][1] - A[2][1]*A[0][0]};
+  real_t c01[3] = {A[0][1]*A[1][2] - A[0][2]*A[1][1], 
+                   A[0][2]*A[1][0] - A[0][0]*A[1][2], 
+                   A[0][0]*A[1][1] - A[0][1]*A[1][0]};
+  real_t det = A[0][0]*c12[0] + A[0][1]*c12[1] + A[0][2]*c12[2];
+  if (det == 0.0) 
+    return false;
+  real_t u[3];
+  for (int j = 0; j < 3; ++j)
+    u[j] = (b[0]*c12[j] + b[1]*c20[j] + b[2]*c01[j]) / det;
+  c->x = x0->x + u[0];
+  c->y = x0->y + u[1];
+  c->z = x0->z + u[2];
+  *r2 = u[0]*u[0] + u[1]*u[1] + u[2]*u[2];
+  return (isfinite(*r2) != 0);
+}
+
+// Returns the orientation of the tet (a, b, c, d), computed in floating point.
+static inline real_t fp_orientation(point_t* a, point_t* b, point_t* c, point_t* d)
+{
+  vector_t ab, ac, ad, n;
+  point_displacement(a, b, &ab);
+  point_displacement(a, c, &ac);
+  point_displacement(a, d, &ad);
+  vector_cross(&ab, &ac, &n);
+  return vector_dot(&n, &ad);
+}
+
+// Returns true if the circumsphere of the given (finite or ghost) tet may 
+// contain points in the given bounding box. This test is conservative: it's 
+// computed in floating point with the given tolerance, and reports any tet 
+// it can't rule out.
+static bool may_conflict(delaunay_triangulation_t* t, int tet, bbox_t* bbox, real_t tol)
+{
+  int* v = &t->tet_vertices[4*tet];
+  int i_inf = -1;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (v[i] == INFINITE_VERTEX)
+      i_inf = i;
+  }
+
+  if (i_inf == -1)
+  {
+    // The sphere must reach the box.
+    point_t c;
+    real_t r2;
+    if (!circumsphere(t, v, &c, &r2))
+      return true;
+    real_t dx = MAX(0.0, MAX(bbox->x1 - c.x, c.x - bbox->x2)),
+           dy = MAX(0.0, MAX(bbox->y1 - c.y, c.y - bbox->y2)),
+           dz = MAX(0.0, MAX(bbox->z1 - c.z, c.z - bbox->z2));
+    return (sqrt(dx*dx + dy*dy + dz*dz) <= sqrt(r2) * (1.0 + 1e-6) + tol);
+  }
+  else
+  {
+    // The half space beyond the hull face must reach a corner of the box.
+    point_t* x[4];
+    for (int i = 0; i < 4; ++i)
+      x[i] = (i == i_inf) ? NULL : &t->vertices[v[i]];
+    vector_t e1, e2, n;
+    point_t* f[3];
+    for (int i = 0, j = 0; i < 4; ++i)
+    {
+      if (i != i_inf) 
+        f[j++] = x[i];
+    }
+    point_displacement(f[0], f[1], &e1);
+    point_displacement(f[0], f[2], &e2);
+    vector_cross(&e1, &e2, &n);
+    real_t margin = tol * vector_mag(&n);
+    for (int corner = 0; corner < 8; ++corner)
+    {
+      point_t p = {.x = (corner & 1) ? bbox->x2 : bbox->x1, 
+                   .y = (corner & 2) ? bbox->y2 : bbox->y1, 
+                   .z = (corner & 4) ? bbox->z2 : bbox->z1};
+      x[i_inf] = &p;
+      if (fp_orientation(x[0], x[1], x[2], x[3]) > -margin)
+        return true;
+    }
+    return false;
+  }
+}
+
+// Compares tets by their sorted vertices.
+static int tet_key_cmp(const void* l, const void* r)
+{
+  const int* k1 = l;
+  const int* k2 = r;
+  for (int i = 0; i < 4; ++i)
+  {
+    if (k1[i] != k2[i])
+      return (k1[i] < k2[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+// Compares (face vertex, face vertex, face vertex, tet, face) tuples by their 
+// vertices.
+static int face_cmp(const void* l, const void* r)
+{
+  const int* f1 = l;
+  const int* f2 = r;
+  for (int i = 0; i < 3; ++i)
+  {
+    if (f1[i] != f2[i])
+      return (f1[i] < f2[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+static int int_cmp(const void* l, const void* r)
+{
+  int i1 = *((const int*)l), i2 = *((const int*)r);
+  return (i1 < i2) ? -1 : (i1 > i2) ? 1 : 0;
+}
+
+// Stores the sorted vertices of the given tet in key.
+static inline void tet_key(delaunay_triangulation_t* t, int tet, int* key)
+{
+  memcpy(key, &t->tet_vertices[4*tet], 4*sizeof(int));
+  for (int i = 1; i < 4; ++i)
+  {
+    for (int j = i; (j > 0) && (key[j] < key[j-1]); --j)
+    {
+      int tmp = key[j];
+      key[j] = key[j-1];
+      key[j-1] = tmp;
+    }
+  }
+}
+
+// Copies the given tet of the triangulation src into the slot new_tet of dest, 
+// mapping its neighbors to their slots in dest with new_index. Faces whose 
+// neighbors aren't in dest are recorded in pending.
+static void copy_tet(delaunay_triangulation_t* src, int tet, int* new_index,
+                     delaunay_triangulation_t* dest, int new_tet, 
+                     int_array_t* pending)
+{
+  memcpy(&dest->tet_vertices[4*new_tet], &src->tet_vertices[4*tet], 4*sizeof(int));
+  dest->tet_marks[new_tet] = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    int n = new_index[src->tet_neighbors[4*tet+i]];
+    dest->tet_neighbors[4*new_tet+i] = n;
+    if (n == -1)
+    {
+      int f[3];
+      sorted_face(&src->tet_vertices[4*tet], i, f);
+      int_array_append(pending, f[0]);
+      int_array_append(pending, f[1]);
+      int_array_append(pending, f[2]);
+      int_array_append(pending, new_tet);
+      int_array_append(pending, i);
+    }
+  }
+}
+
+// Merges the triangulations of the node's children. A tet of a child's 
+// triangulation whose circumsphere contains none of the other child's points 
+// is Delaunay for the node's points, and is kept. The other tets form a 
+// "wall" along the cutting plane, which is replaced by the tets of the 
+// triangulation of the wall's vertices that either have vertices on both 
+// sides of the plane or are also wall tets. Every tet of the node's 
+// triangulation that isn't kept is among these, because the triangulations 
+// are unique. If it lies on one side of the plane, it's a tet of that 
+// child's triangulation, and so a wall tet. If it crosses the plane, its 
+// vertices on each side span a simplex of that child's triangulation whose 
+// tets there differ from its tets in the node's, so one of them is a wall 
+// tet, and all of its vertices are wall vertices. Either way, its sphere 
+// contains no points at all, so it is a tet of the wall's triangulation. 
+// The selected tets then fill the space left by the kept ones, which we 
+// check by matching up their faces. Returns false if the pieces can't be 
+// joined (which can only happen if the conservative conflict test fails).
+static bool merge_children(dc_node_t* node)
+{
+  delaunay_triangulation_t* t = node->t;
+  dc_node_t* children[2] = {&node->nodes[node->low], &node->nodes[node->high]};
+  delaunay_triangulation_t* T[2] = {children[0]->result, children[1]->result};
+  bbox_t* bbox = &node->bbox;
+  real_t tol = 1e-10 * sqrt((bbox->x2-bbox->x1)*(bbox->x2-bbox->x1) + 
+                            (bbox->y2-bbox->y1)*(bbox->y2-bbox->y1) + 
+                            (bbox->z2-bbox->z1)*(bbox->z2-bbox->z1));
+
+  // Sort the children's tets into kept tets and wall tets.
+  int_array_t* wall_vertices = int_array_new();
+  int_array_t* wall_keys = int_array_new();
+  int* new_index[3];
+  int num_kept = 0;
+  for (int k = 0; k < 2; ++k)
+  {
+    int num_tets = T[k]->num_tets + T[k]->num_ghost_tets;
+    new_index[k] = polymec_malloc(sizeof(int) * num_tets);
+    for (int tet = 0; tet < num_tets; ++tet)
+    {
+      if (may_conflict(T[k], tet, &children[1-k]->bbox, tol))
+      {
+        new_index[k][tet] = -1;
+        int key[4];
+        tet_key(T[k], tet, key);
+        for (int i = 0; i < 4; ++i)
+        {
+          int_array_append(wall_keys, key[i]);
+          if (key[i] != INFINITE_VERTEX)
+            int_array_append(wall_vertices, key[i]);
+        }
+      }
+      else
+        new_index[k][tet] = num_kept++;
+    }
+  }
+  qsort(wall_keys->data, wall_keys->size/4, 4*sizeof(int), tet_key_cmp);
+  qsort(wall_vertices->data, wall_vertices->size, sizeof(int), int_cmp);
+  int num_wall_vertices = 0;
+  for (size_t i = 0; i < wall_vertices->size; ++i)
+  {
+    if ((i == 0) || (wall_vertices->data[i] != wall_vertices->data[i-1]))
+      wall_vertices->data[num_wall_vertices++] = wall_vertices->data[i];
+  }
+
+  // Triangulate the wall's vertices, and select the tets that replace it.
+  bool merged = false;
+  delaunay_triangulation_t* W = NULL;
+  int i1, i2, i3;
+  if (find_first_tet(t, wall_vertices->data, num_wall_vertices, &i1, &i2, &i3))
+  {
+    W = triangulation_new(t->vertices, t->num_vertices, num_wall_vertices);
+    bowyer_watson(W, wall_vertices->data, num_wall_vertices);
+    int num_wall_tets = W->num_tets + W->num_ghost_tets;
+    new_index[2] = polymec_malloc(sizeof(int) * num_wall_tets);
+    int num_tets = num_kept;
+    for (int tet = 0; tet < num_wall_tets; ++tet)
+    {
+      int* v = &W->tet_vertices[4*tet];
+      bool low = false, high = false;
+      for (int i = 0; i < 4; ++i)
+      {
+        if (v[i] != INFINITE_VERTEX)
+        {
+          if (node->position[v[i]] < node->mid)
+            low = true;
+          else
+            high = true;
+        }
+      }
+      int key[4];
+      tet_key(W, tet, key);
+      if ((low && high) || 
+          (bsearch(key, wall_keys->data, wall_keys->size/4, 4*sizeof(int), tet_key_cmp) != NULL))
+        new_index[2][tet] = num_tets++;
+      else
+        new_index[2][tet] = -1;
+    }
+
+    // Assemble the merged triangulation, and connect the kept tets to the 
+    // new ones by matching the faces that were left unconnected.
+    delaunay_triangulation_t* R = triangulation_new(t->vertices, t->num_vertices, 0);
+    allocate_new_tets(R, num_tets);
+    R->num_tets = num_tets;
+    int_array_t* pending = int_array_new();
+    delaunay_triangulation_t* sources[3] = {T[0], T[1], W};
+    for (int k = 0; k < 3; ++k)
+    {
+      int n = sources[k]->num_tets + sources[k]->num_ghost_tets;
+      for (int tet = 0; tet < n; ++tet)
+      {
+        if (new_index[k][tet] != -1)
+        {
+          copy_tet(sources[k], tet, new_index[k], R, new_index[k][tet], pending);
+          if (!is_ghost(R, new_index[k][tet]))
+            R->last_tet = new_index[k][tet];
+        }
+      }
+    }
+    int num_pending = (int)(pending->size / 5);
+    qsort(pending->data, num_pending, 5*sizeof(int), face_cmp);
+    merged = (num_pending % 2 == 0);
+    for (int j = 0; merged && (j < num_pending); j += 2)
+    {
+      int* f1 = &pending->data[5*j];
+      int* f2 = &pending->data[5*j+5];
+      if (face_cmp(f1, f2) != 0)
+        merged = false;
+      else
+      {
+        R->tet_neighbors[4*f1[3]+f1[4]] = f2[3];
+        R->tet_neighbors[4*f2[3]+f2[4]] = f1[3];
+      }
+    }
+    int_array_free(pending);
+    polymec_free(new_index[2]);
+    triangulation_free(W);
+
+    if (merged)
+    {
+      separate_ghost_tets(R);
+      node->result = R;
+    }
+    else
+      triangulation_free(R);
+  }
+
+  polymec_free(new_index[1]);
+  polymec_free(new_index[0]);
+  int_array_free(wall_keys);
+  int_array_free(wall_vertices);
+  triangulation_free(T[1]);
+  triangulation_free(T[0]);
+  children[0]->result = children[1]->result = NULL;
+  return merged;
+}
+
+// Triangulates the points of the given node: directly for a leaf, and by 
+// merging the triangulations of its children otherwise.
+static void triangulate_node(void* context)
+{
+  dc_node_t* node = context;
+  node->merge_failed = ((node->low != -1) && !merge_children(node));
+  if ((node->low == -1) || node->merge_failed)
+    triangulate_node_serially(node);
+}
+
+// Triangulates the given points (indices of distinct vertices) using a 
+// parallel divide-and-conquer algorithm. 
+// The points are split recursively by cutting planes, the leaves of the 
+// resulting tree are triangulated (in parallel) with the Bowyer-Watson 
+// algorithm, and sibling triangulations are merged across their walls, from 
+// the bottom of the tree up. Merges on the same level run in parallel, but 
+// each one triangulates its wall's vertices serially.
+static void divide_and_conquer(delaunay_triangulation_t* t, int* points, int num_points)
+{
+  thread_pool_t* threads = thread_pool_new();
+  int min_points = MAX(MIN_DC_POINTS, num_points / (4 * thread_pool_num_threads(threads)));
+
+  int* order = polymec_malloc(sizeof(int) * num_points);
+  int* position = polymec_malloc(sizeof(int) * t->num_vertices);
+  memcpy(order, points, sizeof(int) * num_points);
+
+  // Build the tree one level at a time, splitting the nodes on each level 
+  // in parallel.
+  int cap = 64, num_nodes = 1;
+  dc_node_t* nodes = polymec_malloc(sizeof(dc_node_t) * cap);
+  nodes[0] = (dc_node_t){.t = t, .order = order, .position = position, 
+                         .begin = 0, .end = num_points, .depth = 0, 
+                         .low = -1, .high = -1, .result = NULL};
+  int level_begin = 0, level_end = 1, max_depth = 0;
+  while (level_begin < level_end)
+  {
+    for (int n = level_begin; n < level_end; ++n)
+    {
+      nodes[n].splittable = ((nodes[n].end - nodes[n].begin) >= 2 * min_points);
+      thread_pool_schedule(threads, &nodes[n], split_node);
+    }
+    thread_pool_execute(threads);
+    for (int n = level_begin; n < level_end; ++n)
+    {
+      if (nodes[n].mid == -1) continue;
+      if (num_nodes + 2 > cap)
+      {
+        cap *= 2;
+        nodes = polymec_realloc(nodes, sizeof(dc_node_t) * cap);
+      }
+      int depth = nodes[n].depth + 1;
+      max_depth = MAX(max_depth, depth);
+      nodes[n].low = num_nodes;
+      nodes[n].high = num_nodes + 1;
+      nodes[num_nodes++] = (dc_node_t){.t = t, .order = order, .position = position, 
+                                       .begin = nodes[n].begin, .end = nodes[n].mid, 
+                                       .depth = depth, .low = -1, .high = -1, 
+                                       .result = NULL};
+      nodes[num_nodes++] = (dc_node_t){.t = t, .order = order, .position = position, 
+                                       .begin = nodes[n].mid, .end = nodes[n].end, 
+                                       .depth = depth, .low = -1, .high = -1, 
+                                       .result = NULL};
+    }
+    level_begin = level_end;
+    level_end = num_nodes;
+  }
+  for (int i = 0; i < num_points; ++i)
+    position[order[i]] = i;
+
+  // Triangulate the nodes from the bottom of the tree up. A merge that 
+  // fails is redone serially, so we keep track of those.
+  for (int n = 0; n < num_nodes; ++n)
+    nodes[n].nodes = nodes;
+  for (int depth = max_depth; depth >= 0; --depth)
+  {
+    for (int n = 0; n < num_nodes; ++n)
+    {
+      if (nodes[n].depth == depth)
+        thread_pool_schedule(threads, &nodes[n], triangulate_node);
+    }
+    thread_pool_execute(threads);
+    for (int n = 0; n < num_nodes; ++n)
+    {
+      if ((nodes[n].depth != depth) || (nodes[n].low == -1))
+        continue;
+      ++t->num_merges;
+      if (nodes[n].merge_failed)
+      {
+        ++t->num_failed_merges;
+        log_debug("delaunay_triangulation: Couldn't merge triangulations of %d points at depth %d; "
+                  "triangulated them serially.", nodes[n].end - nodes[n].begin, depth);
+      }
+    }
+  }
+  thread_pool_free(threads);
+
+  // Move the root's triangulation into place.
+  delaunay_triangulation_t* root = nodes[0].result;
+  polymec_free(t->tet_vertices);
+  polymec_free(t->tet_neighbors);
+  polymec_free(t->tet_marks);
+  t->tet_vertices = root->tet_vertices;
+  t->tet_neighbors = root->tet_neighbors;
+  t->tet_marks = root->tet_marks;
+  t->tet_cap = root->tet_cap;
+  t->num_tets = root->num_tets;
+  t->num_ghost_tets = root->num_ghost_tets;
+  t->last_tet = root->last_tet;
+  root->tet_vertices = root->tet_neighbors = root->tet_marks = NULL;
+  triangulation_free(root);
+
+  polymec_free(nodes);
+  polymec_free(position);
+  polymec_free(order);
+}
+
+delaunay_triangulation_t* delaunay_triangulation_new(point_t* points, int num_points)
+{
+  return delaunay_triangulation_new_with_algorithm(points, num_points, BOWYER_WATSON);
+}
+
+// A point and its index, used to find coincident points.
+typedef struct
+{
+  point_t x;
+  int index;
+} indexed_point_t;
+
+static int indexed_point_cmp(const void* l, const void* r)
+{
+  const indexed_point_t* p1 = l;
+  const indexed_point_t* p2 = r;
+  if (p1->x.x != p2->x.x)
+    return (p1->x.x < p2->x.x) ? -1 : 1;
+  if (p1->x.y != p2->x.y)
+    return (p1->x.y < p2->x.y) ? -1 : 1;
+  if (p1->x.z != p2->x.z)
+    return (p1->x.z < p2->x.z) ? -1 : 1;
+  return (p1->index < p2->index) ? -1 : (p1->index > p2->index) ? 1 : 0;
+}
+
+// Returns a newly allocated array of the indices of the distinct vertices 
+// of the triangulation, storing their number in num_distinct. Of a set of 
+// coincident vertices, only the one with the lowest index is included, so 
+// that every algorithm triangulates the same vertices.
+static int* distinct_vertices(delaunay_triangulation_t* t, int* num_distinct)
+{
+  int num_vertices = t->num_vertices;
+  indexed_point_t* points = polymec_malloc(sizeof(indexed_point_t) * num_vertices);
+  for (int i = 0; i < num_vertices; ++i)
+  {
+    points[i].x = t->vertices[i];
+    points[i].index = i;
+  }
+  qsort(points, num_vertices, sizeof(indexed_point_t), indexed_point_cmp);
+  int* indices = polymec_malloc(sizeof(int) * num_vertices);
+  *num_distinct = 0;
+  for (int i = 0; i < num_vertices; ++i)
+  {
+    if ((i == 0) || (points[i].x.x != points[i-1].x.x) || 
+        (points[i].x.y != points[i-1].x.y) || (points[i].x.z != points[i-1].x.z))
+      indices[(*num_distinct)++] = points[i].index;
+  }
+  polymec_free(points);
+  qsort(indices, *num_distinct, sizeof(int), int_cmp);
+  return indices;
+}
+
+delaunay_triangulation_t* delaunay_triangulation_new_with_algorithm(point_t* points, 
+                                                                    int num_points,
+                                                                    delaunay_triangulation_algorithm_t algorithm)
+{
+  ASSERT(num_points >= 4);
+
+  point_t* vertices = polymec_malloc(sizeof(point_t) * MAX(32, num_points));
+  memcpy(vertices, points, sizeof(point_t) * num_points);
+  delaunay_triangulation_t* t = triangulation_new(vertices, num_points, num_points);
+  t->algorithm = algorithm;
+  t->vertex_cap = MAX(32, num_points);
+
+  int num_distinct;
+  int* indices = distinct_vertices(t, &num_distinct);
+  switch(t->algorithm)
+  {
+    case BOWYER_WATSON:
+      bowyer_watson(t, indices, num_distinct);
+      break;
+    case INCREMENTAL_FLIP:
+      incremental_flip(t, indices, num_distinct);
+      break;
+    case DIVIDE_AND_CONQUER:
+      divide_and_conquer(t, indices, num_distinct);
+  }
+  polymec_free(indices);
+
+  // From here on, tets keep their slots until they're destroyed, so ghost 
+  // tets and free slots can appear anywhere.
+  t->num_finite_tets = t->num_tets;
+  t->num_tets += t->num_ghost_tets;
+  t->tet_changes = polymec_calloc(t->tet_cap, sizeof(char));
+  t->changed_tets = int_array_new();
+  t->vertex_tets = polymec_malloc(sizeof(int) * t->vertex_cap);
+  for (int i = 0; i < t->num_vertices; ++i)
+    t->vertex_tets[i] = -1;
+  for (int tet = 0; tet < t->num_finite_tets; ++tet)
+  {
+    for (int i = 0; i < 4; ++i)
+      t->vertex_tets[t->tet_vertices[4*tet+i]] = tet;
+  }
+
+  return t;
+}
+
+void delaunay_triangulation_free(delaunay_triangulation_t* t)
+{
+  if (t->changed_tets != NULL)
+    int_array_free(t->changed_tets);
+  if (t->tet_changes != NULL)
+    polymec_free(t->tet_changes);
+  if (t->vertex_tets != NULL)
+    polymec_free(t->vertex_tets);
+  int_array_free(t->free_tets);
+  int_array_free(t->stack);
+  int_array_free(t->edges);
+  int_array_free(t->new_tets);
+  int_array_free(t->boundary);
+  int_array_free(t->cavity);
+  polymec_free(t->tet_marks);
+  polymec_free(t->tet_neighbors);
+  polymec_free(t->vertices);
+  polymec_free(t->tet_vertices);
+  polymec_free(t);
+}
+
+int delaunay_triangulation_num_vertices(delaunay_triangulation_t* t)
+{
+  return t->num_vertices;
+}
+
+void delaunay_triangulation_get_vertices(delaunay_triangulation_t* t, int* indices, int num_vertices, point_t* vertices)
+{
+#ifndef NDEBUG
+  for (int i = 0; i < num_vertices; ++i)
+  {
+    ASSERT(indices[i] >= 0);
+    ASSERT(indices[i] < t->num_vertices);
+  }
+#endif
+  for (int i = 0; i < num_vertices; ++i)
+    vertices[i] = t->vertices[indices[i]];
+}
+
+int delaunay_triangulation_num_tetrahedra(delaunay_triangulation_t* t)
+{
+  return t->num_finite_tets;
+}
+
+bool delaunay_triangulation_next(delaunay_triangulation_t* t,
+                                 int* pos, int* v1, int* v2, int* v3, int* v4)
+{
+  while ((*pos < t->num_tets) && (is_dead(t, *pos) || is_ghost(t, *pos)))
+    ++(*pos);
+  if (*pos >= t->num_tets)
+    return false;
+  int i = *pos;
+  *v1 = t->tet_vertices[4*i];
+  *v2 = t->tet_vertices[4*i+1];
+  *v3 = t->tet_vertices[4*i+2];
+  *v4 = t->tet_vertices[4*i+3];
+  ++(*pos);
+  return true;
+}
+
+
+bool delaunay_triangulation_get_tet(delaunay_triangulation_t* t, 
+                                    int tet, 
+                                    int* v1, int* v2, int* v3, int* v4)
+{
+  if ((tet < 0) || (tet >= t->num_tets) || is_dead(t, tet) || is_ghost(t, tet))
+    return false;
+  *v1 = t->tet_vertices[4*tet];
+  *v2 = t->tet_vertices[4*tet+1];
+  *v3 = t->tet_vertices[4*tet+2];
+  *v4 = t->tet_vertices[4*tet+3];
+  return true;
+}
+
+void delaunay_triangulation_get_merge_counts(delaunay_triangulation_t* t, 
+                                             int* num_merges, 
+                                             int* num_failed_merges)
+{
+  *num_merges = t->num_merges;
+  *num_failed_merges = t->num_failed_merges;
+}
+
+// Returns the index of the vertex v in the tet with the given vertices.
+static inline int vertex_index(int* w, int v)
+{
+  return (w[0] == v) ? 0 : (w[1] == v) ? 1 : (w[2] == v) ? 2 : 3;
+}
+
+// This helper starts the next search for a tet from the given hint, if it 
+// is the index of a finite tet.
+static void use_hint(delaunay_triangulation_t* t, int hint)
+{
+  if ((hint >= 0) && (hint < t->num_tets) && !is_dead(t, hint) && !is_ghost(t, hint))
+    t->last_tet = hint;
+}
+
+// This helper makes sure that the search for a tet starts from a finite 
+// tet after the given (new) tets have replaced others.
+static void reset_last_tet(delaunay_triangulation_t* t, int* tets, int num_tets)
+{
+  if (!is_dead(t, t->last_tet) && !is_ghost(t, t->last_tet))
+    return;
+  for (int j = 0; j < num_tets; ++j)
+  {
+    int tet = tets[j];
+    if (is_dead(t, tet)) continue;
+    if (is_ghost(t, tet))
+    {
+      // The tet across the hull face of a ghost tet is finite.
+      int i = vertex_index(&t->tet_vertices[4*tet], INFINITE_VERTEX);
+      t->last_tet = t->tet_neighbors[4*tet+i];
+    }
+    else
+      t->last_tet = tet;
+    return;
+  }
+}
+
+// Returns a tet of which v is a vertex, or -1 if v isn't in the 
+// triangulation.
+static int tet_with_vertex(delaunay_triangulation_t* t, int v)
+{
+  int tau = t->vertex_tets[v];
+  if ((tau != -1) && (tau < t->num_tets) && !is_dead(t, tau) && 
+      has_vertex(&t->tet_vertices[4*tau], v))
+    return tau;
+
+  // Otherwise we walk to v. The walk stops at a tet whose closure contains 
+  // v, and all such tets have v as a vertex if it's in the triangulation.
+  tau = tet_containing_point(t, v);
+  return has_vertex(&t->tet_vertices[4*tau], v) ? tau : -1;
+}
+
+// Appends the tets that have the vertex v to star, starting from the tet 
+// tau, and marks them with the current mark. Tets already marked are 
+// skipped.
+static void add_star(delaunay_triangulation_t* t, int v, int tau, int_array_t* star)
+{
+  if (t->tet_marks[tau] == t->mark) return;
+  size_t first = star->size;
+  int_array_append(star, tau);
+  t->tet_marks[tau] = t->mark;
+  for (size_t k = first; k < star->size; ++k)
+  {
+    int c = star->data[k];
+    for (int i = 0; i < 4; ++i)
+    {
+      // The face opposite vertex i contains v unless vertex i is v.
+      if (t->tet_vertices[4*c+i] == v) continue;
+      int n = t->tet_neighbors[4*c+i];
+      if (t->tet_marks[n] != t->mark)
+      {
+        t->tet_marks[n] = t->mark;
+        int_array_append(star, n);
+      }
+    }
+  }
+}
+
+// Stores the tets that have the vertex v in star, starting from the tet 
+// tau, and marks them with the current mark.
+static void find_star(delaunay_triangulation_t* t, int v, int tau, int_array_t* star)
+{
+  int_array_clear(star);
+  ++t->mark;
+  add_star(t, v, tau, star);
+}
+
+// Returns true if the tuple w of 4 distinct vertices is an even permutation 
+// of the tuple u.
+static bool is_even_permutation(int* u, int* w)
+{
+  int p[4];
+  for (int i = 0; i < 4; ++i)
+    p[i] = vertex_index(u, w[i]);
+  int inversions = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    for (int j = i+1; j < 4; ++j)
+    {
+      if (p[i] > p[j])
+        ++inversions;
+    }
+  }
+  return ((inversions % 2) == 0);
+}
+
+// Removes the vertex v from the triangulation, given its star (the tets 
+// that have v as a vertex). The star is a cavity, which we fill with the 
+// tets of the Delaunay triangulation of the vertices on its boundary (the 
+// "link" of v) that lie inside it. Because triangulations are unique, these 
+// fit the cavity exactly. Returns false (leaving the triangulation 
+// unchanged) if the link's vertices are coplanar.
+static bool remove_vertex(delaunay_triangulation_t* t, int v, int_array_t* star)
+{
+  int num_star_tets = (int)star->size;
+
+  // Gather the link of v.
+  int_array_t* link = t->boundary;
+  int_array_clear(link);
+  for (int j = 0; j < num_star_tets; ++j)
+  {
+    int* w = &t->tet_vertices[4*star->data[j]];
+    for (int i = 0; i < 4; ++i)
+    {
+      if ((w[i] != v) && (w[i] != INFINITE_VERTEX))
+        int_array_append(link, w[i]);
+    }
+  }
+  qsort(link->data, link->size, sizeof(int), int_cmp);
+  int num_link = 0;
+  for (size_t i = 0; i < link->size; ++i)
+  {
+    if ((i == 0) || (link->data[i] != link->data[i-1]))
+      link->data[num_link++] = link->data[i];
+  }
+  int i1, i2, i3;
+  if ((num_link < 4) || !find_first_tet(t, link->data, num_link, &i1, &i2, &i3))
+    return false;
+
+  // Triangulate the link, and index the faces of its tets (including ghost 
+  // tets) by their vertices.
+  delaunay_triangulation_t* L = triangulation_new(t->vertices, t->num_vertices, num_link);
+  bowyer_watson(L, link->data, num_link);
+  int num_L_tets = L->num_tets + L->num_ghost_tets;
+  int* L_faces = polymec_malloc(sizeof(int) * 5 * 4 * num_L_tets);
+  for (int tet = 0; tet < num_L_tets; ++tet)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      int* f = &L_faces[5*(4*tet+i)];
+      sorted_face(&L->tet_vertices[4*tet], i, f);
+      f[3] = tet;
+      f[4] = i;
+    }
+  }
+  qsort(L_faces, 4*num_L_tets, 5*sizeof(int), face_cmp);
+
+  // The faces of the cavity are the faces of the star's tets opposite v. 
+  // We store each with the tet outside it and that tet's face.
+  int* cavity_faces = polymec_malloc(sizeof(int) * 5 * num_star_tets);
+  for (int j = 0; j < num_star_tets; ++j)
+  {
+    int tet = star->data[j];
+    int* w = &t->tet_vertices[4*tet];
+    int p = vertex_index(w, v);
+    int* f = &cavity_faces[5*j];
+    sorted_face(w, p, f);
+    f[3] = t->tet_neighbors[4*tet+p];
+    f[4] = shared_face(t, f[3], tet);
+  }
+  qsort(cavity_faces, num_star_tets, 5*sizeof(int), face_cmp);
+
+  // Find the link tet inside the cavity on each of its faces: the one whose 
+  // vertex off the face lies on the same side of it as v, which we can tell 
+  // from the orientations of the tets alone. Then fill in the rest of the 
+  // cavity from these.
+  int* slots = polymec_malloc(sizeof(int) * num_L_tets);
+  for (int tet = 0; tet < num_L_tets; ++tet)
+    slots[tet] = -1;
+  int_array_t* new_tets = t->new_tets;
+  int_array_clear(new_tets);
+  bool fits = true;
+  for (int j = 0; j < num_star_tets; ++j)
+  {
+    int* w = &t->tet_vertices[4*star->data[j]];
+    int p = vertex_index(w, v);
+    int f[3];
+    sorted_face(w, p, f);
+    int* entry = bsearch(f, L_faces, 4*num_L_tets, 5*sizeof(int), face_cmp);
+    if (entry == NULL) 
+    {
+      fits = false;
+      break;
+    }
+    int g = entry[3], q = entry[4];
+    int u[4];
+    memcpy(u, w, 4*sizeof(int));
+    u[p] = L->tet_vertices[4*g+q];
+    if (!is_even_permutation(u, &L->tet_vertices[4*g]))
+      g = L->tet_neighbors[4*g+q];
+    if (slots[g] == -1)
+    {
+      slots[g] = 0;
+      int_array_append(new_tets, g);
+    }
+  }
+  for (size_t k = 0; (k < new_tets->size) && fits; ++k)
+  {
+    int g = new_tets->data[k];
+    for (int i = 0; i < 4; ++i)
+    {
+      int f[3];
+      sorted_face(&L->tet_vertices[4*g], i, f);
+      if (bsearch(f, cavity_faces, num_star_tets, 5*sizeof(int), face_cmp) != NULL)
+        continue;
+      int n = L->tet_neighbors[4*g+i];
+      if (slots[n] == -1)
+      {
+        slots[n] = 0;
+        int_array_append(new_tets, n);
+      }
+    }
+  }
+
+  // The fill must stay inside the cavity: each face of the cavity must 
+  // have exactly one side filled.
+  for (int j = 0; (j < num_star_tets) && fits; ++j)
+  {
+    int* entry = bsearch(&cavity_faces[5*j], L_faces, 4*num_L_tets, 
+                         5*sizeof(int), face_cmp);
+    int g = entry[3];
+    int n = L->tet_neighbors[4*g+entry[4]];
+    fits = ((slots[g] == -1) != (slots[n] == -1));
+  }
+
+  if (fits)
+  {
+    // Replace the star's tets with the new ones, reusing their slots.
+    int num_new_tets = (int)new_tets->size;
+    for (int j = 0; j < num_star_tets; ++j)
+      log_destruction(t, star->data[j]);
+    for (int k = 0; k < num_new_tets; ++k)
+      slots[new_tets->data[k]] = (k < num_star_tets) ? star->data[k] : new_tet(t);
+    for (int j = num_new_tets; j < num_star_tets; ++j)
+      delete_tet(t, star->data[j]);
+
+    // Connect the new tets to one another as in the link's triangulation, 
+    // and to the tets outside the cavity across its faces.
+    for (int k = 0; k < num_new_tets; ++k)
+    {
+      int g = new_tets->data[k], tet = slots[g];
+      memcpy(&t->tet_vertices[4*tet], &L->tet_vertices[4*g], 4*sizeof(int));
+      t->tet_marks[tet] = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        int n = L->tet_neighbors[4*g+i];
+        if (slots[n] != -1)
+          t->tet_neighbors[4*tet+i] = slots[n];
+        else
+        {
+          int f[3];
+          sorted_face(&L->tet_vertices[4*g], i, f);
+          int* face = bsearch(f, cavity_faces, num_star_tets, 5*sizeof(int), face_cmp);
+          t->tet_neighbors[4*tet+i] = face[3];
+          t->tet_neighbors[4*face[3]+face[4]] = tet;
+        }
+      }
+      log_creation(t, tet);
+    }
+    t->last_tet = slots[new_tets->data[0]];
+    reset_last_tet(t, star->data, MIN(num_star_tets, num_new_tets));
+  }
+
+  polymec_free(slots);
+  polymec_free(cavity_faces);
+  polymec_free(L_faces);
+  triangulation_free(L);
+  return fits;
+}
+
+// Rebuilds the triangulation from scratch without the vertex v, for 
+// removals that can't be handled locally. All of the tets are destroyed, 
+// and new ones created.
+static void rebuild_without_vertex(delaunay_triangulation_t* t, int v)
+{
+  // Find the vertices that remain.
+  bool* present = polymec_calloc(t->num_vertices, sizeof(bool));
+  for (int tet = 0; tet < t->num_tets; ++tet)
+  {
+    if (is_dead(t, tet) || is_ghost(t, tet)) continue;
+    for (int i = 0; i < 4; ++i)
+      present[t->tet_vertices[4*tet+i]] = true;
+  }
+  present[v] = false;
+  int* points = polymec_malloc(sizeof(int) * t->num_vertices);
+  int num_points = 0;
+  for (int i = 0; i < t->num_vertices; ++i)
+  {
+    if (present[i])
+      points[num_points++] = i;
+  }
+  polymec_free(present);
+  int i1, i2, i3;
+  if ((num_points < 4) || !find_first_tet(t, points, num_points, &i1, &i2, &i3))
+    polymec_error("delaunay_triangulation_remove: the remaining vertices are coplanar.");
+
+  delaunay_triangulation_t* T = triangulation_new(t->vertices, t->num_vertices, num_points);
+  bowyer_watson(T, points, num_points);
+  polymec_free(points);
+
+  // Swap in the new tets.
+  for (int tet = 0; tet < t->num_tets; ++tet)
+  {
+    if (!is_dead(t, tet))
+      log_destruction(t, tet);
+  }
+  int old_cap = t->tet_cap;
+  polymec_free(t->tet_vertices);
+  polymec_free(t->tet_neighbors);
+  polymec_free(t->tet_marks);
+  t->tet_vertices = T->tet_vertices;
+  t->tet_neighbors = T->tet_neighbors;
+  t->tet_marks = T->tet_marks;
+  t->tet_cap = T->tet_cap;
+  if (t->tet_cap < old_cap)
+  {
+    // Keep the capacity, which the change log relies on.
+    t->tet_cap = old_cap;
+    t->tet_vertices = polymec_realloc(t->tet_vertices, 4*sizeof(int)*t->tet_cap);
+    t->tet_neighbors = polymec_realloc(t->tet_neighbors, 4*sizeof(int)*t->tet_cap);
+    t->tet_marks = polymec_realloc(t->tet_marks, sizeof(int)*t->tet_cap);
+  }
+  t->num_tets = T->num_tets + T->num_ghost_tets;
+  t->last_tet = T->last_tet;
+  T->tet_vertices = T->tet_neighbors = T->tet_marks = NULL;
+  triangulation_free(T);
+  if (t->tet_cap > old_cap)
+  {
+    t->tet_changes = polymec_realloc(t->tet_changes, sizeof(char)*t->tet_cap);
+    memset(&t->tet_changes[old_cap], 0, sizeof(char)*(t->tet_cap-old_cap));
+  }
+  int_array_clear(t->free_tets);
+  for (int tet = 0; tet < t->num_tets; ++tet)
+    log_creation(t, tet);
+}
+
+// Removes the vertex v (a vertex of the tet tau) from the triangulation, 
+// locally if possible.
+static void remove_vertex_from_tet(delaunay_triangulation_t* t, int v, int tau)
+{
+  find_star(t, v, tau, t->cavity);
+  if (!remove_vertex(t, v, t->cavity))
+    rebuild_without_vertex(t, v);
+}
+
+int delaunay_triangulation_insert(delaunay_triangulation_t* t, point_t* x, int hint)
+{
+  allocate_new_vertex(t);
+  int v = t->num_vertices;
+  t->vertices[v] = *x;
+  t->vertex_tets[v] = -1;
+  ++t->num_vertices;
+
+  use_hint(t, hint);
+  int tau = tet_containing_point(t, v);
+  if (!insert_vertex(t, v, tau))
+  {
+    --t->num_vertices;
+    return -1;
+  }
+  return v;
+}
+
+void delaunay_triangulation_remove(delaunay_triangulation_t* t, int v, int hint)
+{
+  ASSERT(v >= 0);
+  ASSERT(v < t->num_vertices);
+  use_hint(t, hint);
+  int tau = tet_with_vertex(t, v);
+  if (tau != -1)
+    remove_vertex_from_tet(t, v, tau);
+}
+
+// Returns true if vertices can be moved to their (new) coordinates without 
+// changing the connectivity of the triangulation, given the union of their 
+// stars. This is the case if the finite tets of the stars stay positively 
+// oriented and their faces stay locally Delaunay, which for the faces of 
+// ghost tets means that the convex hull stays convex.
+static bool can_move_in_place(delaunay_triangulation_t* t, int_array_t* star)
+{
+  for (size_t j = 0; j < star->size; ++j)
+  {
+    int* w = &t->tet_vertices[4*star->data[j]];
+    if (!is_ghost(t, star->data[j]) && (orientation(t, w[0], w[1], w[2], w[3]) <= 0.0))
+      return false;
+  }
+  for (size_t j = 0; j < star->size; ++j)
+  {
+    int tet = star->data[j];
+    for (int i = 0; i < 4; ++i)
+    {
+      int n = t->tet_neighbors[4*tet+i];
+      int apex = t->tet_vertices[4*n+shared_face(t, n, tet)];
+      if ((apex != INFINITE_VERTEX) && in_conflict(t, tet, apex))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Moves the vertices v[0..n) to the points x[0..n) if that leaves the 
+// connectivity alone, logging the changed tets and returning true. 
+// Otherwise returns false, leaving the vertices where they were. tau[i] is 
+// a tet having the vertex v[i]. Either way, the union of the stars of the 
+// vertices is left in t->cavity.
+static bool move_in_place(delaunay_triangulation_t* t, int n, int* v, point_t* x, int* tau)
+{
+  int_array_clear(t->cavity);
+  ++t->mark;
+  point_t x0[n];
+  for (int i = 0; i < n; ++i)
+  {
+    add_star(t, v[i], tau[i], t->cavity);
+    x0[i] = t->vertices[v[i]];
+    t->vertices[v[i]] = x[i];
+  }
+  if (!can_move_in_place(t, t->cavity))
+  {
+    for (int i = 0; i < n; ++i)
+      t->vertices[v[i]] = x0[i];
+    return false;
+  }
+  for (size_t j = 0; j < t->cavity->size; ++j)
+  {
+    log_destruction(t, t->cavity->data[j]);
+    log_creation(t, t->cavity->data[j]);
+  }
+  return true;
+}
+
+void delaunay_triangulation_move(delaunay_triangulation_t* t, int v, point_t* x, int hint)
+{
+  ASSERT(v >= 0);
+  ASSERT(v < t->num_vertices);
+  use_hint(t, hint);
+  int tau = tet_with_vertex(t, v);
+  if (tau != -1)
+  {
+    // If the move leaves the connectivity alone, we're done. Otherwise we 
+    // remove v and insert it at its new position.
+    if (move_in_place(t, 1, &v, x, &tau))
+      return;
+    if (!remove_vertex(t, v, t->cavity))
+      rebuild_without_vertex(t, v);
+  }
+  t->vertices[v] = *x;
+  tau = tet_containing_point(t, v);
+  insert_vertex(t, v, tau);
+}
+
+bool delaunay_triangulation_move_in_place(delaunay_triangulation_t* t, 
+                                          int* vertices, 
+                                          point_t* points, 
+                                          int num_vertices, 
+                                          int hint)
+{
+  use_hint(t, hint);
+  int tau[num_vertices];
+  for (int i = 0; i < num_vertices; ++i)
+  {
+    ASSERT(vertices[i] >= 0);
+    ASSERT(vertices[i] < t->num_vertices);
+    tau[i] = tet_with_vertex(t, vertices[i]);
+    if (tau[i] == -1)
+      return false;
+  }
+  return move_in_place(t, num_vertices, vertices, points, tau);
+}
+
+void delaunay_triangulation_get_changes(delaunay_triangulation_t* t, 
+                                        int_array_t* created_tets, 
+                                        int_array_t* destroyed_tets)
+{
+  for (size_t j = 0; j < t->changed_tets->size; ++j)
+  {
+    int tet = t->changed_tets->data[j];
+    if (t->tet_changes[tet] & TET_CREATED)
+      int_array_append(created_tets, tet);
+    if (t->tet_changes[tet] & TET_DESTROYED)
+      int_array_append(destroyed_tets, tet);
+  }
+}
+
+void delaunay_triangulation_clear_changes(delaunay_triangulation_t* t)
+{
+  for (size_t j = 0; j < t->changed_tets->size; ++j)
+    t->tet_changes[t->changed_tets->data[j]] = 0;
+  int_array_clear(t->changed_tets);
+}
+
+// For each ordered pair (i, j) of the vertices of a tet, the indices (k, l) 
+// of the others such that (i, j, k, l) is an even permutation of (0, 1, 2, 3).
+static const int edge_opposites[4][4][2] = 
+  {{{-1, -1}, {2, 3}, {3, 1}, {1, 2}}, 
+   {{3, 2}, {-1, -1}, {0, 3}, {2, 0}}, 
+   {{1, 3}, {3, 0}, {-1, -1}, {0, 1}}, 
+   {{2, 1}, {0, 2}, {1, 0}, {-1, -1}}};
+
+// Finds the other two vertices c, d of the tet with vertices w that has the 
+// edge (a, b), ordered so that (a, b, c, d) is an even permutation of w 
+// (and hence a positively oriented tet), storing their indices within w in 
+// ic and id.
+static inline void find_edge_opposites(int* w, int a, int b, int* ic, int* id)
+{
+  const int* kl = edge_opposites[vertex_index(w, a)][vertex_index(w, b)];
+  *ic = kl[0];
+  *id = kl[1];
+}
+
+// Reverses the order of the n integers in x.
+static void reverse(int* x, int n)
+{
+  for (int i = 0; i < n/2; ++i)
+  {
+    int tmp = x[i];
+    x[i] = x[n-1-i];
+    x[n-1-i] = tmp;
+  }
+}
+
+delaunay_adjacency_t* delaunay_adjacency_new(delaunay_triangulation_t* t)
+{
+  delaunay_adjacency_t* adj = polymec_malloc(sizeof(delaunay_adjacency_t));
+  int num_vertices = t->num_vertices, num_tets = t->num_finite_tets;
+  adj->num_vertices = num_vertices;
+  adj->num_tets = num_tets;
+
+  // Number the finite tets.
+  int* tet_numbers = polymec_malloc(sizeof(int) * t->num_tets);
+  adj->tet_indices = polymec_malloc(sizeof(int) * num_tets);
+  int i = 0;
+  for (int tet = 0; tet < t->num_tets; ++tet)
+  {
+    if (is_dead(t, tet) || is_ghost(t, tet))
+      tet_numbers[tet] = -1;
+    else
+    {
+      adj->tet_indices[i] = tet;
+      tet_numbers[tet] = i++;
+    }
+  }
+  ASSERT(i == num_tets);
+
+  // Copy their vertices and neighbors.
+  adj->tet_vertices = polymec_malloc(sizeof(int) * 4 * num_tets);
+  adj->tet_neighbors = polymec_malloc(sizeof(int) * 4 * num_tets);
+  for (i = 0; i < num_tets; ++i)
+  {
+    int tet = adj->tet_indices[i];
+    for (int j = 0; j < 4; ++j)
+    {
+      adj->tet_vertices[4*i+j] = t->tet_vertices[4*tet+j];
+      adj->tet_neighbors[4*i+j] = tet_numbers[t->tet_neighbors[4*tet+j]];
+    }
+  }
+  polymec_free(tet_numbers);
+
+  // Gather the tets of each vertex by counting sort.
+  adj->vertex_tet_offsets = polymec_calloc(num_vertices + 1, sizeof(int));
+  for (i = 0; i < 4*num_tets; ++i)
+    ++adj->vertex_tet_offsets[adj->tet_vertices[i]+1];
+  for (int v = 0; v < num_vertices; ++v)
+    adj->vertex_tet_offsets[v+1] += adj->vertex_tet_offsets[v];
+  adj->vertex_tets = polymec_malloc(sizeof(int) * 4 * num_tets);
+  int* next = polymec_malloc(sizeof(int) * num_vertices);
+  memcpy(next, adj->vertex_tet_offsets, sizeof(int) * num_vertices);
+  for (i = 0; i < num_tets; ++i)
+  {
+    for (int j = 0; j < 4; ++j)
+      adj->vertex_tets[next[adj->tet_vertices[4*i+j]]++] = i;
+  }
+
+  // Find the edges from each vertex a to vertices b > a among the tets of a,
+  // marking each b as we find it. Each edge's ring of tets is found by 
+  // turning about it from one of them: the tet (a, b, c, d) is followed by 
+  // the one across its face opposite c, which has d in place of c.
+  int_array_t* edge_vertices = int_array_new();
+  int_array_t* edge_tet_offsets = int_array_new();
+  int_array_t* edge_tets = int_array_new();
+  adj->edge_on_hull = polymec_malloc(sizeof(bool) * MAX(1, 6 * num_tets));
+  int* marks = next;
+  for (int v = 0; v < num_vertices; ++v)
+    marks[v] = -1;
+  int_array_append(edge_tet_offsets, 0);
+  for (int a = 0; a < num_vertices; ++a)
+  {
+    for (int k = adj->vertex_tet_offsets[a]; k < adj->vertex_tet_offsets[a+1]; ++k)
+    {
+      int tet = adj->vertex_tets[k];
+      int* w = &adj->tet_vertices[4*tet];
+      for (int j = 0; j < 4; ++j)
+      {
+        int b = w[j];
+        if ((b <= a) || (marks[b] == a))
+          continue;
+        marks[b] = a;
+        int e = (int)(edge_vertices->size / 2);
+        int_array_append(edge_vertices, a);
+        int_array_append(edge_vertices, b);
+
+        // Turn counterclockwise until we come back to this tet or reach 
+        // the hull.
+        int begin = (int)edge_tets->size, tau = tet, ic, id;
+        do
+        {
+          int_array_append(edge_tets, tau);
+          find_edge_opposites(&adj->tet_vertices[4*tau], a, b, &ic, &id);
+          tau = adj->tet_neighbors[4*tau+ic];
+        }
+        while ((tau != -1) && (tau != tet));
+        adj->edge_on_hull[e] = (tau == -1);
+
+        // If we reached the hull, the tets reached by turning clockwise 
+        // from this one come first.
+        if (adj->edge_on_hull[e])
+        {
+          int num_ccw = (int)edge_tets->size - begin;
+          tau = tet;
+          while (true)
+          {
+            find_edge_opposites(&adj->tet_vertices[4*tau], a, b, &ic, &id);
+            tau = adj->tet_neighbors[4*tau+id];
+            if (tau == -1) break;
+            int_array_append(edge_tets, tau);
+          }
+          int* ring = &edge_tets->data[begin];
+          int num_cw = (int)edge_tets->size - begin - num_ccw;
+          reverse(ring, num_ccw);
+          reverse(ring, num_ccw + num_cw);
+        }
+        int_array_append(edge_tet_offsets, (int)edge_tets->size);
+      }
+    }
+  }
+  polymec_free(next);
+
+  adj->num_edges = (int)(edge_vertices->size / 2);
+  adj->edge_vertices = edge_vertices->data;
+  adj->edge_tet_offsets = edge_tet_offsets->data;
+  adj->edge_tets = edge_tets->data;
+  int_array_release_data_and_free(edge_vertices);
+  int_array_release_data_and_free(edge_tet_offsets);
+  int_array_release_data_and_free(edge_tets);
+  adj->edge_on_hull = polymec_realloc(adj->edge_on_hull, sizeof(bool) * MAX(1, adj->num_edges));
+
+  // Gather the edges of each vertex by counting sort.
+  adj->vertex_edge_offsets = polymec_calloc(num_vertices + 1, sizeof(int));
+  for (int e = 0; e < 2*adj->num_edges; ++e)
+    ++adj->vertex_edge_offsets[adj->edge_vertices[e]+1];
+  for (int v = 0; v < num_vertices; ++v)
+    adj->vertex_edge_offsets[v+1] += adj->vertex_edge_offsets[v];
+  adj->vertex_edges = polymec_malloc(sizeof(int) * 2 * adj->num_edges);
+  next = polymec_malloc(sizeof(int) * num_vertices);
+  memcpy(next, adj->vertex_edge_offsets, sizeof(int) * num_vertices);
+  for (int e = 0; e < adj->num_edges; ++e)
+  {
+    adj->vertex_edges[next[adj->edge_vertices[2*e]]++] = e;
+    adj->vertex_edges[next[adj->edge_vertices[2*e+1]]++] = e;
+  }
+  polymec_free(next);
+
+  return adj;
+}
+
+void delaunay_adjacency_free(delaunay_adjacency_t* adj)
+{
+  polymec_free(adj->edge_on_hull);
+  polymec_free(adj->edge_tets);
+  polymec_free(adj->edge_tet_offsets);
+  polymec_free(adj->edge_vertices);
+  polymec_free(adj->vertex_edges);
+  polymec_free(adj->vertex_edge_offsets);
+  polymec_free(adj->vertex_tets);
+  polymec_free(adj->vertex_tet_offsets);
+  polymec_free(adj->tet_neighbors);
+  polymec_free(adj->tet_vertices);
+  polymec_free(adj->tet_indices);
+  polymec_free(adj);
+}
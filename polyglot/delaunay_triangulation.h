@@ -5,21 +5,43 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-#ifndef POLYMEC_DELAUNAY_TRIANGULATION_H
-#define POLYMEC_DELAUNAY_TRIANGULATION_H
+#ifndef POLYGLOT_DELAUNAY_TRIANGULATION_H
+#define POLYGLOT_DELAUNAY_TRIANGULATION_H
 
+#include "core/array.h"
 #include "core/point.h"
 
 // This class represents a Delaunay triangulation in 3D.
 typedef struct delaunay_triangulation_t delaunay_triangulation_t;
 
+// Algorithms for constructing Delaunay triangulations.
+typedef enum
+{
+  BOWYER_WATSON,      // Incremental insertion by cavity retriangulation.
+  INCREMENTAL_FLIP,   // Incremental insertion by bistellar flips (Ledoux).
+  DIVIDE_AND_CONQUER  // Divide and conquer: the halves on either side of 
+                      // each cutting plane are triangulated in parallel, 
+                      // and each merge re-triangulates the vertices of the 
+                      // tets along the plane serially with Bowyer-Watson, 
+                      // so the merge at the top of the tree runs on a 
+                      // single thread.
+} delaunay_triangulation_algorithm_t;
+
 // Creates a new Delaunay triangulation from the given set of points.
 delaunay_triangulation_t* delaunay_triangulation_new(point_t* points, int num_points);
 
+// Creates a new Delaunay triangulation from the given set of points using 
+// the given algorithm. Cospherical points are resolved consistently, so all 
+// algorithms produce the same tets.
+delaunay_triangulation_t* delaunay_triangulation_new_with_algorithm(point_t* points, 
+                                                                    int num_points,
+                                                                    delaunay_triangulation_algorithm_t algorithm);
+
 // Frees the given triangulation.
 void delaunay_triangulation_free(delaunay_triangulation_t* t);
 
-// Returns the number of vertices in the triangulation.
+// Returns the number of vertices in the triangulation. This includes 
+// vertices that have been removed, which keep their indices.
 int delaunay_triangulation_num_vertices(delaunay_triangulation_t* t);
 
 // Retrieves the coordinates of the vertices with the given indices from 
@@ -35,5 +57,109 @@ int delaunay_triangulation_num_tetrahedra(delaunay_triangulation_t* t);
 bool delaunay_triangulation_next(delaunay_triangulation_t* t,
                                  int* pos, int* v1, int* v2, int* v3, int* v4);
 
+// Retrieves the vertices of the tetrahedron with the given index, returning 
+// false if there is no such tetrahedron. A tetrahedron keeps its index until 
+// it is destroyed, after which the index may be reused.
+bool delaunay_triangulation_get_tet(delaunay_triangulation_t* t, 
+                                    int tet, 
+                                    int* v1, int* v2, int* v3, int* v4);
+
+// Retrieves the number of merges of sibling triangulations performed while 
+// the triangulation was constructed by divide and conquer, and the number 
+// of those that failed (whose points were triangulated serially instead). 
+// Both are 0 for the other algorithms.
+void delaunay_triangulation_get_merge_counts(delaunay_triangulation_t* t, 
+                                             int* num_merges, 
+                                             int* num_failed_merges);
+
+// The following functions change the triangulation locally. Each searches 
+// for the tets it changes starting from the tetrahedron with index hint, or 
+// from the most recently created one if hint is -1.
+
+// Inserts a vertex at the point x into the triangulation, returning its 
+// index, or -1 (leaving the triangulation unchanged) if x coincides with 
+// one of its vertices.
+int delaunay_triangulation_insert(delaunay_triangulation_t* t, point_t* x, int hint);
+
+// Removes the vertex v from the triangulation. v and the other vertices 
+// keep their indices. Does nothing if v is not in the triangulation.
+void delaunay_triangulation_remove(delaunay_triangulation_t* t, int v, int hint);
+
+// Moves the vertex v to the point x. If x coincides with another vertex, v 
+// is left out of the triangulation.
+void delaunay_triangulation_move(delaunay_triangulation_t* t, int v, point_t* x, int hint);
+
+// Moves the given vertices to the given points together if this leaves the 
+// tets of the triangulation as they are (so that only their shapes change), 
+// returning true if so. Otherwise returns false and leaves the vertices 
+// where they were. This is much cheaper than delaunay_triangulation_move 
+// for small motions, and vertices whose motions keep them cospherical (like 
+// points and their mirror images) can be moved in place together when 
+// they couldn't be moved one at a time.
+bool delaunay_triangulation_move_in_place(delaunay_triangulation_t* t, 
+                                          int* vertices, 
+                                          point_t* points, 
+                                          int num_vertices, 
+                                          int hint);
+
+// Appends the indices of the tetrahedra created by insertions, removals, 
+// and moves since the triangulation was constructed (or its changes were 
+// last cleared) to created_tets, and those of the tetrahedra destroyed to 
+// destroyed_tets. Tetrahedra that were both created and destroyed in that 
+// time appear in neither, and a tetrahedron whose vertex has moved appears 
+// in both.
+void delaunay_triangulation_get_changes(delaunay_triangulation_t* t, 
+                                        int_array_t* created_tets, 
+                                        int_array_t* destroyed_tets);
+
+// Clears the record of the triangulation's changes.
+void delaunay_triangulation_clear_changes(delaunay_triangulation_t* t);
+
+// This type exposes the adjacency of the tetrahedra in a Delaunay 
+// triangulation in compressed row storage, so that dual structures (like 
+// Voronoi diagrams) can be built from it without searching. Its tetrahedra 
+// are numbered from 0 to num_tets-1 in the order in which 
+// delaunay_triangulation_next visits them.
+typedef struct
+{
+  int num_vertices, num_tets, num_edges;
+
+  // The ith tet has the index tet_indices[i] within the triangulation, and 
+  // the vertices tet_vertices[4*i] ... tet_vertices[4*i+3].
+  int* tet_indices;
+  int* tet_vertices;
+
+  // tet_neighbors[4*i+j] is the tet across the face of the ith tet opposite 
+  // its jth vertex, or -1 if that face lies on the convex hull.
+  int* tet_neighbors;
+
+  // The tets having the vertex v are vertex_tets[vertex_tet_offsets[v]] 
+  // through vertex_tets[vertex_tet_offsets[v+1]-1], and its edges are 
+  // given by vertex_edge_offsets and vertex_edges in the same way.
+  int* vertex_tet_offsets;
+  int* vertex_tets;
+  int* vertex_edge_offsets;
+  int* vertex_edges;
+
+  // The eth edge joins the vertices edge_vertices[2*e] < edge_vertices[2*e+1].
+  // The tets around it are edge_tets[edge_tet_offsets[e]] through 
+  // edge_tets[edge_tet_offsets[e+1]-1], in the order in which they are 
+  // encountered turning counterclockwise about the edge (looking from its 
+  // second vertex toward its first), so each shares a face with the next. 
+  // The ring is closed unless edge_on_hull[e] is true, in which case the 
+  // first and last tets have faces on the convex hull.
+  int* edge_vertices;
+  int* edge_tet_offsets;
+  int* edge_tets;
+  bool* edge_on_hull;
+} delaunay_adjacency_t;
+
+// Computes the adjacency of the tetrahedra in the given triangulation. The 
+// adjacency does not track later changes to the triangulation.
+delaunay_adjacency_t* delaunay_adjacency_new(delaunay_triangulation_t* t);
+
+// Frees the given adjacency.
+void delaunay_adjacency_free(delaunay_adjacency_t* adj);
+
 #endif
 
@@ -0,0 +1,739 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include "core/array.h"
+#include "core/thread_pool.h"
+#include "polyglot/exodus_diff.h"
+
+#if POLYMEC_HAVE_MPI
+#include "mpi.h"
+#endif
+
+// Default number of values read from each file at once.
+#define DEFAULT_CHUNK_SIZE 1048576
+
+// Chunks smaller than this (per thread) are compared by a single thread.
+#define MIN_VALUES_PER_THREAD 4096
+
+DEFINE_ARRAY(diff_result_array, exodus_diff_result_t)
+
+struct exodus_diff_t
+{
+  MPI_Comm comm;
+  int rank, nprocs;
+  real_t abs_tol, rel_tol;
+  size_t chunk_size;
+
+  // Threads used to compare chunks (NULL if we compare serially).
+  thread_pool_t* threads;
+  int num_threads;
+
+  // Names and results for compared quantities, in the order they were
+  // compared. These lists are identical on all processes.
+  string_array_t* names;
+  diff_result_array_t* results;
+
+  // Descriptions of structural mismatches.
+  string_array_t* mismatches;
+
+  // Counter used to assign tasks to processes.
+  int task;
+
+  // Chunk buffers for each file.
+  real_t *values1, *values2;
+  int *ints1, *ints2;
+};
+
+exodus_diff_t* exodus_diff_new(MPI_Comm comm, real_t abs_tol, real_t rel_tol)
+{
+  ASSERT(abs_tol >= 0.0);
+  ASSERT(rel_tol >= 0.0);
+  exodus_diff_t* diff = polymec_malloc(sizeof(exodus_diff_t));
+  diff->comm = comm;
+  MPI_Comm_rank(comm, &diff->rank);
+  MPI_Comm_size(comm, &diff->nprocs);
+  diff->abs_tol = abs_tol;
+  diff->rel_tol = rel_tol;
+  diff->chunk_size = DEFAULT_CHUNK_SIZE;
+  diff->threads = NULL;
+  diff->num_threads = 1;
+  diff->names = string_array_new();
+  diff->results = diff_result_array_new();
+  diff->mismatches = string_array_new();
+  diff->task = 0;
+  diff->values1 = diff->values2 = NULL;
+  diff->ints1 = diff->ints2 = NULL;
+  return diff;
+}
+
+void exodus_diff_free(exodus_diff_t* diff)
+{
+  if (diff->threads != NULL)
+    thread_pool_free(diff->threads);
+  string_array_free(diff->names);
+  diff_result_array_free(diff->results);
+  string_array_free(diff->mismatches);
+  polymec_free(diff);
+}
+
+void exodus_diff_set_chunk_size(exodus_diff_t* diff, size_t chunk_size)
+{
+  ASSERT(chunk_size > 0);
+  diff->chunk_size = chunk_size;
+}
+
+void exodus_diff_set_num_threads(exodus_diff_t* diff, int num_threads)
+{
+  ASSERT(num_threads > 0);
+  if (diff->threads != NULL)
+  {
+    thread_pool_free(diff->threads);
+    diff->threads = NULL;
+  }
+  diff->num_threads = num_threads;
+  if (num_threads > 1)
+    diff->threads = thread_pool_with_threads(num_threads);
+}
+
+// Records a structural mismatch between the two files.
+static void add_mismatch(exodus_diff_t* diff, const char* format, ...)
+{
+  char description[1024];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(description, 1024, format, args);
+  va_end(args);
+  string_array_append_with_dtor(diff->mismatches, string_dup(description), string_free);
+}
+
+// Adds a quantity to the comparison, returning its index. Every process
+// adds the same quantities in the same order.
+static int add_quantity(exodus_diff_t* diff, const char* format, ...)
+{
+  char name[1024];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(name, 1024, format, args);
+  va_end(args);
+  string_array_append_with_dtor(diff->names, string_dup(name), string_free);
+  exodus_diff_result_t result = {.max_abs_diff = 0.0, .max_rel_diff = 0.0,
+                                 .time_index = 0, .entity_index = 0,
+                                 .num_values = 0, .num_failures = 0};
+  diff_result_array_append(diff->results, result);
+  return (int)(diff->results->size - 1);
+}
+
+// Returns true if the next task belongs to this process. Tasks are dealt
+// out to processes in round-robin fashion.
+static bool owns_next_task(exodus_diff_t* diff)
+{
+  int task = diff->task++;
+  return ((task % diff->nprocs) == diff->rank);
+}
+
+// Returns true if the difference d1 is larger than d2. NaN is larger than 
+// any number.
+static inline bool larger_diff(real_t d1, real_t d2)
+{
+  return isnan(d1) ? !isnan(d2) : (d1 > d2);
+}
+
+// Merges the result in src into that in dest. The location of the largest
+// difference is chosen independently of the order of the merge, so that
+// results are reproducible for any number of processes and threads.
+static void merge_results(exodus_diff_result_t* dest,
+                          exodus_diff_result_t* src)
+{
+  bool same_diff = (src->max_abs_diff == dest->max_abs_diff) || 
+                   (isnan(src->max_abs_diff) && isnan(dest->max_abs_diff));
+  if (larger_diff(src->max_abs_diff, dest->max_abs_diff) ||
+      (same_diff && (src->num_values > 0) &&
+       ((dest->num_values == 0) ||
+        (src->time_index < dest->time_index) ||
+        ((src->time_index == dest->time_index) && (src->entity_index < dest->entity_index)))))
+  {
+    dest->max_abs_diff = src->max_abs_diff;
+    dest->time_index = src->time_index;
+    dest->entity_index = src->entity_index;
+  }
+  if (larger_diff(src->max_rel_diff, dest->max_rel_diff))
+    dest->max_rel_diff = src->max_rel_diff;
+  dest->num_values += src->num_values;
+  dest->num_failures += src->num_failures;
+}
+
+// This type describes a piece of a chunk of values compared by one thread.
+typedef struct
+{
+  const real_t* values1;
+  const real_t* values2;
+  size_t num_values;
+  real_t abs_tol, rel_tol;
+
+  // Values are either a series in time (starting at first_time_index) or
+  // values_per_entity values for each of a range of entities (starting
+  // at first_entity) at a single time index.
+  bool time_series;
+  int first_time_index;
+  int first_entity;
+  int values_per_entity;
+
+  exodus_diff_result_t result;
+} compare_piece_t;
+
+static void compare_piece(void* context)
+{
+  compare_piece_t* piece = context;
+  exodus_diff_result_t* result = &piece->result;
+  result->max_abs_diff = result->max_rel_diff = 0.0;
+  result->time_index = piece->first_time_index;
+  result->entity_index = piece->first_entity;
+  result->num_values = piece->num_values;
+  result->num_failures = 0;
+
+  size_t i_max = 0;
+  for (size_t i = 0; i < piece->num_values; ++i)
+  {
+    // Equal values (including infinities and NaNs) don't differ. A NaN in 
+    // only one file gives a NaN difference, which is always a failure.
+    real_t a = piece->values1[i], b = piece->values2[i];
+    real_t abs_diff = 0.0, rel_diff = 0.0;
+    if ((a != b) && !(isnan(a) && isnan(b)))
+    {
+      abs_diff = fabs(a - b);
+      real_t scale = MAX(fabs(a), fabs(b));
+      rel_diff = (scale > 0.0) ? abs_diff / scale : 0.0;
+    }
+    if (larger_diff(abs_diff, result->max_abs_diff))
+    {
+      result->max_abs_diff = abs_diff;
+      i_max = i;
+    }
+    if (larger_diff(rel_diff, result->max_rel_diff))
+      result->max_rel_diff = rel_diff;
+    if (isnan(abs_diff) || isnan(rel_diff) || 
+        ((abs_diff > piece->abs_tol) && (rel_diff > piece->rel_tol)))
+      ++result->num_failures;
+  }
+
+  if (piece->time_series)
+    result->time_index = piece->first_time_index + (int)i_max;
+  else
+    result->entity_index = piece->first_entity + (int)(i_max / piece->values_per_entity);
+}
+
+// Compares a chunk of values from each file, accumulating the result for
+// the given quantity.
+static void compare_chunk(exodus_diff_t* diff,
+                          int quantity,
+                          const real_t* values1,
+                          const real_t* values2,
+                          size_t num_values,
+                          bool time_series,
+                          int first_time_index,
+                          int first_entity,
+                          int values_per_entity)
+{
+  // Divide the chunk into pieces on entity boundaries.
+  size_t num_entities = num_values / values_per_entity;
+  int num_pieces = 1;
+  if ((diff->threads != NULL) && (num_values >= MIN_VALUES_PER_THREAD * diff->num_threads))
+    num_pieces = diff->num_threads;
+  compare_piece_t pieces[num_pieces];
+  size_t entities_per_piece = num_entities / num_pieces;
+  for (int p = 0; p < num_pieces; ++p)
+  {
+    size_t first = p * entities_per_piece;
+    size_t last = (p == num_pieces-1) ? num_entities : first + entities_per_piece;
+    pieces[p].values1 = &values1[first * values_per_entity];
+    pieces[p].values2 = &values2[first * values_per_entity];
+    pieces[p].num_values = (last - first) * values_per_entity;
+    pieces[p].abs_tol = diff->abs_tol;
+    pieces[p].rel_tol = diff->rel_tol;
+    pieces[p].time_series = time_series;
+    pieces[p].first_time_index = time_series ? first_time_index + (int)first : first_time_index;
+    pieces[p].first_entity = time_series ? first_entity : first_entity + (int)first;
+    pieces[p].values_per_entity = values_per_entity;
+  }
+
+  if (num_pieces == 1)
+    compare_piece(&pieces[0]);
+  else
+  {
+    for (int p = 0; p < num_pieces; ++p)
+      thread_pool_schedule(diff->threads, &pieces[p], compare_piece);
+    thread_pool_execute(diff->threads);
+  }
+
+  for (int p = 0; p < num_pieces; ++p)
+    merge_results(&diff->results->data[quantity], &pieces[p].result);
+}
+
+// Records values present in only one of the files as failures.
+static void add_unmatched_values(exodus_diff_t* diff,
+                                 int quantity,
+                                 size_t num_values)
+{
+  diff->results->data[quantity].num_failures += num_values;
+}
+
+static void compare_node_positions(exodus_diff_t* diff,
+                                   exodus_file_t* file1,
+                                   exodus_file_t* file2)
+{
+  int num_nodes = exodus_file_num_nodes(file1);
+  if (num_nodes != exodus_file_num_nodes(file2))
+  {
+    add_mismatch(diff, "Number of nodes differs: %d vs %d",
+                 num_nodes, exodus_file_num_nodes(file2));
+    return;
+  }
+
+  int q = add_quantity(diff, "node positions");
+  int chunk_nodes = (int)MAX(diff->chunk_size / 3, 1);
+  point_t* x1 = (point_t*)diff->values1;
+  point_t* x2 = (point_t*)diff->values2;
+  for (int n = 0; n < num_nodes; n += chunk_nodes)
+  {
+    if (!owns_next_task(diff)) continue;
+    int count = MIN(chunk_nodes, num_nodes - n);
+    exodus_file_read_node_positions(file1, n, count, x1);
+    exodus_file_read_node_positions(file2, n, count, x2);
+    compare_chunk(diff, q, (real_t*)x1, (real_t*)x2, 3*count,
+                  false, 0, n, 3);
+  }
+}
+
+static void compare_element_blocks(exodus_diff_t* diff,
+                                   exodus_file_t* file1,
+                                   exodus_file_t* file2)
+{
+  int num_blocks = exodus_file_num_element_blocks(file1);
+  if (num_blocks != exodus_file_num_element_blocks(file2))
+  {
+    add_mismatch(diff, "Number of element blocks differs: %d vs %d",
+                 num_blocks, exodus_file_num_element_blocks(file2));
+    return;
+  }
+
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    int num_elem1, num_nodes1, num_elem2, num_nodes2;
+    exodus_file_get_element_block(file1, b, &num_elem1, &num_nodes1);
+    exodus_file_get_element_block(file2, b, &num_elem2, &num_nodes2);
+    if ((num_elem1 != num_elem2) || (num_nodes1 != num_nodes2))
+    {
+      add_mismatch(diff, "Element block %d differs: %d elements with %d nodes vs %d elements with %d nodes",
+                   b+1, num_elem1, num_nodes1, num_elem2, num_nodes2);
+      continue;
+    }
+
+    // We only compare element->node connectivity; polyhedral blocks are
+    // compared by size only.
+    if (num_nodes1 == 0) continue;
+
+    int q = add_quantity(diff, "connectivity (block %d)", b+1);
+    int chunk_elems = (int)MAX(diff->chunk_size / num_nodes1, 1);
+    for (int e = 0; e < num_elem1; e += chunk_elems)
+    {
+      if (!owns_next_task(diff)) continue;
+      int count = MIN(chunk_elems, num_elem1 - e);
+      exodus_file_read_element_block_nodes(file1, b, e, count, diff->ints1);
+      exodus_file_read_element_block_nodes(file2, b, e, count, diff->ints2);
+      for (int i = 0; i < count * num_nodes1; ++i)
+      {
+        diff->values1[i] = (real_t)diff->ints1[i];
+        diff->values2[i] = (real_t)diff->ints2[i];
+      }
+      compare_chunk(diff, q, diff->values1, diff->values2, count * num_nodes1,
+                    false, 0, e, num_nodes1);
+    }
+  }
+}
+
+static void compare_sets(exodus_diff_t* diff,
+                         exodus_file_t* file1,
+                         exodus_file_t* file2)
+{
+  static const char* set_type_names[] = {"node set", "edge set", "face set",
+                                         "element set", "side set"};
+  exodus_set_t set_types[] = {EXODUS_NODE_SET, EXODUS_EDGE_SET, EXODUS_FACE_SET,
+                              EXODUS_ELEMENT_SET, EXODUS_SIDE_SET};
+  for (int t = 0; t < 5; ++t)
+  {
+    int num_sets = exodus_file_num_sets(file1, set_types[t]);
+    if (num_sets != exodus_file_num_sets(file2, set_types[t]))
+    {
+      add_mismatch(diff, "Number of %ss differs: %d vs %d", set_type_names[t],
+                   num_sets, exodus_file_num_sets(file2, set_types[t]));
+      continue;
+    }
+
+    // Sets are read whole, since Exodus stores them much more compactly
+    // than fields.
+    for (int s = 0; s < num_sets; ++s)
+    {
+      int q = add_quantity(diff, "%s %d", set_type_names[t], s+1);
+      if (!owns_next_task(diff)) continue;
+      size_t size1, size2;
+      int* set1 = exodus_file_read_set(file1, set_types[t], s, NULL, &size1);
+      int* set2 = exodus_file_read_set(file2, set_types[t], s, NULL, &size2);
+      size_t size = MIN(size1, size2);
+      // Side sets hold (element, side) pairs, which we keep together in 
+      // chunks so that mismatches are reported by entry.
+      size_t values_per_entry = (set_types[t] == EXODUS_SIDE_SET) ? 2 : 1;
+      size_t chunk_size = MAX(diff->chunk_size / values_per_entry, 1) * values_per_entry;
+      for (size_t i = 0; i < size; i += chunk_size)
+      {
+        size_t count = MIN(chunk_size, size - i);
+        for (size_t j = 0; j < count; ++j)
+        {
+          diff->values1[j] = (real_t)set1[i+j];
+          diff->values2[j] = (real_t)set2[i+j];
+        }
+        compare_chunk(diff, q, diff->values1, diff->values2, count,
+                      false, 0, (int)(i / values_per_entry), (int)values_per_entry);
+      }
+      if (size1 != size2)
+        add_unmatched_values(diff, q, MAX(size1, size2) - size);
+      polymec_free(set1);
+      polymec_free(set2);
+    }
+  }
+}
+
+static void compare_times(exodus_diff_t* diff,
+                          exodus_file_t* file1,
+                          exodus_file_t* file2)
+{
+  int num_times1 = exodus_file_num_times(file1);
+  int num_times2 = exodus_file_num_times(file2);
+  if (num_times1 != num_times2)
+  {
+    add_mismatch(diff, "Number of times differs: %d vs %d",
+                 num_times1, num_times2);
+  }
+  int num_times = MIN(num_times1, num_times2);
+  if (num_times == 0) return;
+
+  int q = add_quantity(diff, "time");
+  if (!owns_next_task(diff)) return;
+  real_t* times1 = polymec_malloc(sizeof(real_t) * num_times);
+  real_t* times2 = polymec_malloc(sizeof(real_t) * num_times);
+  int pos1 = 0, pos2 = 0, index;
+  for (int i = 0; i < num_times; ++i)
+  {
+    exodus_file_next_time(file1, &pos1, &index, &times1[i]);
+    exodus_file_next_time(file2, &pos2, &index, &times2[i]);
+  }
+  compare_chunk(diff, q, times1, times2, num_times, true, 1, 0, 1);
+  polymec_free(times1);
+  polymec_free(times2);
+}
+
+// Returns true if the given name appears in the given list.
+static bool has_name(string_array_t* names, const char* name)
+{
+  for (int i = 0; i < names->size; ++i)
+  {
+    if (strcmp(names->data[i], name) == 0)
+      return true;
+  }
+  return false;
+}
+
+// Records a mismatch for each name that appears in one list but not the other.
+static void find_missing_names(exodus_diff_t* diff,
+                               const char* kind,
+                               string_array_t* names1,
+                               string_array_t* names2)
+{
+  for (int i = 0; i < names1->size; ++i)
+  {
+    if (!has_name(names2, names1->data[i]))
+      add_mismatch(diff, "%s %s is only in the first file", kind, names1->data[i]);
+  }
+  for (int i = 0; i < names2->size; ++i)
+  {
+    if (!has_name(names1, names2->data[i]))
+      add_mismatch(diff, "%s %s is only in the second file", kind, names2->data[i]);
+  }
+}
+
+// Gathers names traversed by the given function into an array.
+static string_array_t* gather_names(exodus_file_t* file,
+                                    bool (*next_name)(exodus_file_t*, int*, char**))
+{
+  string_array_t* names = string_array_new();
+  int pos = 0;
+  char* name;
+  while (next_name(file, &pos, &name))
+    string_array_append(names, name);
+  return names;
+}
+
+static void compare_global_vars(exodus_diff_t* diff,
+                                exodus_file_t* file1,
+                                exodus_file_t* file2)
+{
+  string_array_t* names1 = gather_names(file1, exodus_file_next_global_var);
+  string_array_t* names2 = gather_names(file2, exodus_file_next_global_var);
+  find_missing_names(diff, "Global variable", names1, names2);
+  for (int v = 0; v < names1->size; ++v)
+  {
+    char* name = names1->data[v];
+    if (!has_name(names2, name)) continue;
+    int q = add_quantity(diff, "global variable %s", name);
+    if (!owns_next_task(diff)) continue;
+
+    int num_times1, num_times2;
+    real_t* history1 = exodus_file_read_global_var_history(file1, name, &num_times1);
+    real_t* history2 = exodus_file_read_global_var_history(file2, name, &num_times2);
+    if ((history1 != NULL) && (history2 != NULL))
+    {
+      int num_times = MIN(num_times1, num_times2);
+      compare_chunk(diff, q, history1, history2, num_times, true, 1, 0, 1);
+      add_unmatched_values(diff, q, MAX(num_times1, num_times2) - num_times);
+    }
+    if (history1 != NULL)
+      polymec_free(history1);
+    if (history2 != NULL)
+      polymec_free(history2);
+  }
+  string_array_free(names1);
+  string_array_free(names2);
+}
+
+static void compare_node_fields(exodus_diff_t* diff,
+                                exodus_file_t* file1,
+                                exodus_file_t* file2)
+{
+  string_array_t* names1 = gather_names(file1, exodus_file_next_node_field);
+  string_array_t* names2 = gather_names(file2, exodus_file_next_node_field);
+  find_missing_names(diff, "Node field", names1, names2);
+  int num_nodes = exodus_file_num_nodes(file1);
+  int num_times = MIN(exodus_file_num_times(file1), exodus_file_num_times(file2));
+  if (num_nodes == exodus_file_num_nodes(file2))
+  {
+    for (int v = 0; v < names1->size; ++v)
+    {
+      char* name = names1->data[v];
+      if (!has_name(names2, name)) continue;
+      int q = add_quantity(diff, "node field %s", name);
+
+      // Each time step is a separate task, read in chunks.
+      for (int t = 1; t <= num_times; ++t)
+      {
+        if (!owns_next_task(diff)) continue;
+        for (int n = 0; n < num_nodes; n += (int)diff->chunk_size)
+        {
+          int count = MIN((int)diff->chunk_size, num_nodes - n);
+          bool read1 = exodus_file_read_node_field_values(file1, t, name, n, count, diff->values1);
+          bool read2 = exodus_file_read_node_field_values(file2, t, name, n, count, diff->values2);
+          if (read1 && read2)
+            compare_chunk(diff, q, diff->values1, diff->values2, count, false, t, n, 1);
+          else if (read1 != read2)
+            add_unmatched_values(diff, q, count);
+        }
+      }
+    }
+  }
+  string_array_free(names1);
+  string_array_free(names2);
+}
+
+static void compare_element_fields(exodus_diff_t* diff,
+                                   exodus_file_t* file1,
+                                   exodus_file_t* file2)
+{
+  string_array_t* names1 = gather_names(file1, exodus_file_next_element_field);
+  string_array_t* names2 = gather_names(file2, exodus_file_next_element_field);
+  find_missing_names(diff, "Element field", names1, names2);
+
+  // We can only compare element fields if the blocks match.
+  int num_blocks = exodus_file_num_element_blocks(file1);
+  bool blocks_match = (num_blocks == exodus_file_num_element_blocks(file2));
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    if (!blocks_match) break;
+    int num_elem1, num_nodes1, num_elem2, num_nodes2;
+    exodus_file_get_element_block(file1, b, &num_elem1, &num_nodes1);
+    exodus_file_get_element_block(file2, b, &num_elem2, &num_nodes2);
+    blocks_match = (num_elem1 == num_elem2);
+  }
+
+  int num_times = MIN(exodus_file_num_times(file1), exodus_file_num_times(file2));
+  if (blocks_match)
+  {
+    for (int v = 0; v < names1->size; ++v)
+    {
+      char* name = names1->data[v];
+      if (!has_name(names2, name)) continue;
+      int q = add_quantity(diff, "element field %s", name);
+
+      // Each time step is a separate task, read block by block in chunks.
+      // Elements are numbered consecutively across blocks.
+      for (int t = 1; t <= num_times; ++t)
+      {
+        if (!owns_next_task(diff)) continue;
+        int offset = 0;
+        for (int b = 0; b < num_blocks; ++b)
+        {
+          int num_elem, num_nodes_per_elem;
+          exodus_file_get_element_block(file1, b, &num_elem, &num_nodes_per_elem);
+          for (int e = 0; e < num_elem; e += (int)diff->chunk_size)
+          {
+            int count = MIN((int)diff->chunk_size, num_elem - e);
+            bool read1 = exodus_file_read_element_field_values(file1, t, name, b, e, count, diff->values1);
+            bool read2 = exodus_file_read_element_field_values(file2, t, name, b, e, count, diff->values2);
+            if (read1 && read2)
+              compare_chunk(diff, q, diff->values1, diff->values2, count, false, t, offset + e, 1);
+            else if (read1 != read2)
+              add_unmatched_values(diff, q, count);
+          }
+          offset += num_elem;
+        }
+      }
+    }
+  }
+  string_array_free(names1);
+  string_array_free(names2);
+}
+
+#if POLYMEC_HAVE_MPI
+static void reduce_results(void* in, void* inout, int* len, MPI_Datatype* type)
+{
+  exodus_diff_result_t* src = in;
+  exodus_diff_result_t* dest = inout;
+  for (int i = 0; i < *len; ++i)
+    merge_results(&dest[i], &src[i]);
+}
+#endif
+
+bool exodus_diff_compare(exodus_diff_t* diff,
+                         const char* filename1,
+                         const char* filename2)
+{
+  // Clear out the results of any previous comparison.
+  string_array_clear(diff->names);
+  diff_result_array_clear(diff->results);
+  string_array_clear(diff->mismatches);
+  diff->task = 0;
+
+  if (!file_exists(filename1) || !file_exists(filename2))
+  {
+    add_mismatch(diff, "Could not find %s", file_exists(filename1) ? filename2 : filename1);
+    return false;
+  }
+
+  // Each process reads the files independently.
+  exodus_file_t* file1 = exodus_file_open(MPI_COMM_SELF, filename1);
+  exodus_file_t* file2 = exodus_file_open(MPI_COMM_SELF, filename2);
+  if ((file1 == NULL) || (file2 == NULL))
+  {
+    add_mismatch(diff, "Could not open %s", (file1 == NULL) ? filename1 : filename2);
+    if (file1 != NULL)
+      exodus_file_close(file1);
+    if (file2 != NULL)
+      exodus_file_close(file2);
+    return false;
+  }
+
+  // Allocate chunk buffers, which must be able to hold at least one node 
+  // position or one element's connectivity (at most 27 nodes).
+  size_t buffer_size = MAX(diff->chunk_size, 27);
+  diff->values1 = polymec_malloc(sizeof(real_t) * buffer_size);
+  diff->values2 = polymec_malloc(sizeof(real_t) * buffer_size);
+  diff->ints1 = polymec_malloc(sizeof(int) * buffer_size);
+  diff->ints2 = polymec_malloc(sizeof(int) * buffer_size);
+
+  compare_node_positions(diff, file1, file2);
+  compare_element_blocks(diff, file1, file2);
+  compare_sets(diff, file1, file2);
+  compare_times(diff, file1, file2);
+  compare_global_vars(diff, file1, file2);
+  compare_node_fields(diff, file1, file2);
+  compare_element_fields(diff, file1, file2);
+
+  polymec_free(diff->values1);
+  polymec_free(diff->values2);
+  polymec_free(diff->ints1);
+  polymec_free(diff->ints2);
+  diff->values1 = diff->values2 = NULL;
+  diff->ints1 = diff->ints2 = NULL;
+  exodus_file_close(file1);
+  exodus_file_close(file2);
+
+#if POLYMEC_HAVE_MPI
+  // Combine the results from all processes.
+  if ((diff->nprocs > 1) && (diff->results->size > 0))
+  {
+    MPI_Datatype result_type;
+    MPI_Type_contiguous((int)sizeof(exodus_diff_result_t), MPI_BYTE, &result_type);
+    MPI_Type_commit(&result_type);
+    MPI_Op reduce_op;
+    MPI_Op_create(reduce_results, 1, &reduce_op);
+    MPI_Allreduce(MPI_IN_PLACE, diff->results->data, (int)diff->results->size,
+                  result_type, reduce_op, diff->comm);
+    MPI_Op_free(&reduce_op);
+    MPI_Type_free(&result_type);
+  }
+#endif
+
+  bool equal = (diff->mismatches->size == 0);
+  for (int i = 0; i < diff->results->size; ++i)
+  {
+    if (diff->results->data[i].num_failures > 0)
+      equal = false;
+  }
+  return equal;
+}
+
+bool exodus_diff_next_result(exodus_diff_t* diff,
+                             int* pos,
+                             char** quantity_name,
+                             exodus_diff_result_t* result)
+{
+  if (*pos >= diff->results->size)
+    return false;
+  *quantity_name = diff->names->data[*pos];
+  *result = diff->results->data[*pos];
+  ++(*pos);
+  return true;
+}
+
+bool exodus_diff_next_mismatch(exodus_diff_t* diff,
+                               int* pos,
+                               char** description)
+{
+  if (*pos >= diff->mismatches->size)
+    return false;
+  *description = diff->mismatches->data[*pos];
+  ++(*pos);
+  return true;
+}
+
+void exodus_diff_fprintf(exodus_diff_t* diff, FILE* stream)
+{
+  if (stream == NULL) return;
+  fprintf(stream, "Exodus comparison (absolute tolerance: %g, relative tolerance: %g):\n",
+          diff->abs_tol, diff->rel_tol);
+  for (int i = 0; i < diff->mismatches->size; ++i)
+    fprintf(stream, " MISMATCH: %s\n", diff->mismatches->data[i]);
+  for (int i = 0; i < diff->results->size; ++i)
+  {
+    exodus_diff_result_t* result = &diff->results->data[i];
+    fprintf(stream, " %s %s: max abs diff %g (time index %d, index %d), max rel diff %g",
+            (result->num_failures > 0) ? "FAIL" : "ok  ", diff->names->data[i],
+            result->max_abs_diff, result->time_index, result->entity_index,
+            result->max_rel_diff);
+    if (result->num_failures > 0)
+      fprintf(stream, ", %zd of %zd values differ", result->num_failures, result->num_values);
+    fprintf(stream, "\n");
+  }
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYGLOT_EXODUS_DIFF_H
+#define POLYGLOT_EXODUS_DIFF_H
+
+#include "polyglot/exodus_file.h"
+
+// The Exodus diff class compares the contents of two Exodus files: node
+// positions, element connectivity, entity sets, times, global variables, and
+// node and element fields. Data is read from both files in bounded-size
+// chunks, so files of any size can be compared. The work is divided among
+// the processes in a communicator (each of which opens both files for
+// independent reading), and the comparison of each chunk can be further
+// divided among threads.
+
+// This type holds the result of comparing a single quantity (node positions,
+// a field, etc) within two Exodus files.
+typedef struct
+{
+  real_t max_abs_diff; // Largest absolute difference between values (NaN
+                       // if a value is NaN in only one file).
+  real_t max_rel_diff; // Largest relative difference between values.
+  int time_index;      // Time index of the largest absolute difference
+                       // (0 for time-independent quantities).
+  int entity_index;    // Index of the node, element, or set entry with the
+                       // largest absolute difference.
+  size_t num_values;   // Number of values compared.
+  size_t num_failures; // Number of values that differ by more than the
+                       // absolute AND relative tolerance, or that are NaN
+                       // in only one file.
+} exodus_diff_result_t;
+
+// This type compares pairs of Exodus files.
+typedef struct exodus_diff_t exodus_diff_t;
+
+// Creates a new Exodus file comparison that divides its work among the
+// processes in the given communicator. Two values a and b are considered
+// equal if |a - b| <= abs_tol or if |a - b| <= rel_tol * max(|a|, |b|).
+exodus_diff_t* exodus_diff_new(MPI_Comm comm, real_t abs_tol, real_t rel_tol);
+
+// Destroys the given Exodus file comparison.
+void exodus_diff_free(exodus_diff_t* diff);
+
+// Sets the maximum number of values read from each file at once. This
+// bounds the memory used by the comparison. By default, 1048576 values are
+// read at once.
+void exodus_diff_set_chunk_size(exodus_diff_t* diff, size_t chunk_size);
+
+// Sets the number of threads used by each process to compare chunks of
+// data. By default, chunks are compared by a single thread.
+void exodus_diff_set_num_threads(exodus_diff_t* diff, int num_threads);
+
+// Compares the contents of the two Exodus files with the given names,
+// returning true if they are equal within the given tolerances, false if
+// not. This is a collective operation, and its results are available on
+// every process.
+bool exodus_diff_compare(exodus_diff_t* diff,
+                         const char* filename1,
+                         const char* filename2);
+
+// Traverses the results of the most recent comparison, returning true if
+// the traversal should continue and false if not, and storing the name of
+// the compared quantity and its result in the given pointers. Set *pos to
+// 0 to reset the iteration.
+bool exodus_diff_next_result(exodus_diff_t* diff,
+                             int* pos,
+                             char** quantity_name,
+                             exodus_diff_result_t* result);
+
+// Traverses descriptions of the structural differences (differing numbers
+// of nodes, missing fields, etc) found by the most recent comparison,
+// returning true if the traversal should continue and false if not. Set
+// *pos to 0 to reset the iteration.
+bool exodus_diff_next_mismatch(exodus_diff_t* diff,
+                               int* pos,
+                               char** description);
+
+// Writes a summary of the most recent comparison to the given stream.
+void exodus_diff_fprintf(exodus_diff_t* diff, FILE* stream);
+
+#endif
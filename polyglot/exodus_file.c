@@ -102,9 +102,24 @@ struct exodus_file_t
   string_array_t *node_var_names, *node_set_var_names,
                  *edge_var_names, *edge_set_var_names,
                  *face_var_names, *face_set_var_names,
-                 *elem_var_names, *elem_set_var_names, *side_set_var_names;
+                 *elem_var_names, *elem_set_var_names, *side_set_var_names,
+                 *glob_var_names;
+
+  // Global variable output is buffered: each record holds the values of 
+  // all global variables at one time index, and the buffer is written in 
+  // a single batch every glob_buffer_cap records (or on close).
+  int glob_var_id;        // NetCDF ID of the global variable values (or -1).
+  int glob_buffer_cap;    // Maximum number of buffered records.
+  int glob_buffer_size;   // Number of buffered records.
+  int* glob_buffer_times; // Time index for each buffered record.
+  real_t* glob_buffer;    // Record-major buffered values.
+  int glob_max_flushed;   // Largest time index of a record in the file.
 };
 
+// Default number of time steps for which global variables are buffered 
+// before they are written to the file.
+#define DEFAULT_GLOBAL_VAR_BUFFER_SIZE 64
+
 bool exodus_file_query(const char* filename,
                        size_t* real_size,
                        float* version,
@@ -243,6 +258,7 @@ static void fetch_all_variable_names(exodus_file_t* file)
   fetch_variable_names(file->ex_id, EX_ELEM_BLOCK, file->elem_var_names);
   fetch_variable_names(file->ex_id, EX_ELEM_SET, file->elem_set_var_names);
   fetch_variable_names(file->ex_id, EX_SIDE_SET, file->side_set_var_names);
+  fetch_variable_names(file->ex_id, EX_GLOBAL, file->glob_var_names);
 }
 
 static void free_all_variable_names(exodus_file_t* file)
@@ -256,6 +272,7 @@ static void free_all_variable_names(exodus_file_t* file)
   string_array_free(file->elem_var_names);
   string_array_free(file->elem_set_var_names);
   string_array_free(file->side_set_var_names);
+  string_array_free(file->glob_var_names);
 }
 
 static exodus_file_t* open_exodus_file(MPI_Comm comm,
@@ -325,6 +342,14 @@ static exodus_file_t* open_exodus_file(MPI_Comm comm,
     file->elem_var_names = string_array_new();
     file->elem_set_var_names = string_array_new();
     file->side_set_var_names = string_array_new();
+    file->glob_var_names = string_array_new();
+
+    file->glob_var_id = -1;
+    file->glob_buffer_cap = DEFAULT_GLOBAL_VAR_BUFFER_SIZE;
+    file->glob_buffer_size = 0;
+    file->glob_buffer_times = NULL;
+    file->glob_buffer = NULL;
+    file->glob_max_flushed = 0;
 
     if (!file->writing)
     {
@@ -359,6 +384,9 @@ static exodus_file_t* open_exodus_file(MPI_Comm comm,
         file->num_node_sets = (int)mesh_info.num_node_sets;
         file->num_side_sets = (int)mesh_info.num_side_sets;
       }
+
+      // Times are traversed up to the last one stored in the file.
+      file->last_time_index = (int)ex_inquire_int(file->ex_id, EX_INQ_TIME);
     }
     else
     {
@@ -404,10 +432,53 @@ exodus_file_t* exodus_file_open(MPI_Comm comm,
   return open_exodus_file(comm, filename, EX_READ);
 }
 
+// This helper writes all buffered global variable records to the file, 
+// batching runs of consecutive time indices into single hyperslab writes.
+static void flush_global_vars(exodus_file_t* file)
+{
+  if (file->glob_buffer_size == 0) 
+    return;
+  ASSERT(file->glob_var_id != -1);
+
+  size_t num_vars = file->glob_var_names->size;
+  int r = 0;
+  while (r < file->glob_buffer_size)
+  {
+    // Find the run of records with consecutive time indices starting at r.
+    int run = 1;
+    while (((r + run) < file->glob_buffer_size) && 
+           (file->glob_buffer_times[r+run] == file->glob_buffer_times[r] + run))
+      ++run;
+
+    // Exodus time indices are 1-based.
+    size_t start[2] = {(size_t)(file->glob_buffer_times[r] - 1), 0};
+    size_t count[2] = {(size_t)run, num_vars};
+    real_t* values = &file->glob_buffer[num_vars * r];
+#if POLYMEC_HAVE_DOUBLE_PRECISION
+    int err = nc_put_vara_double(file->ex_id, file->glob_var_id, start, count, values);
+#else
+    int err = nc_put_vara_float(file->ex_id, file->glob_var_id, start, count, values);
+#endif
+    if (err != NC_NOERR)
+    {
+      polymec_error("exodus_file: Error writing global variables for time indices %d-%d: %s", 
+                    file->glob_buffer_times[r], file->glob_buffer_times[r] + run - 1, 
+                    nc_strerror(err));
+    }
+    file->glob_max_flushed = MAX(file->glob_max_flushed, 
+                                 file->glob_buffer_times[r] + run - 1);
+    r += run;
+  }
+  file->glob_buffer_size = 0;
+}
+
 void exodus_file_close(exodus_file_t* file)
 {
   if (file->writing)
   {
+    // Write out any buffered global variable data.
+    flush_global_vars(file);
+
     // Write a QA record.
     char* qa_record[1][4];
     qa_record[0][0] = string_dup(polymec_executable_name());
@@ -434,6 +505,10 @@ void exodus_file_close(exodus_file_t* file)
   if (file->edge_block_ids != NULL)
     polymec_free(file->edge_block_ids);
   free_all_variable_names(file);
+  if (file->glob_buffer_times != NULL)
+    polymec_free(file->glob_buffer_times);
+  if (file->glob_buffer != NULL)
+    polymec_free(file->glob_buffer);
 #if POLYMEC_HAVE_MPI
   MPI_Info_free(&file->mpi_info);
 #endif
@@ -1166,3 +1241,707 @@ bool exodus_file_contains_node_field(exodus_file_t* file,
   return false;
 }
 
+void exodus_file_define_global_vars(exodus_file_t* file,
+                                    int num_vars,
+                                    const char** var_names)
+{
+  ASSERT(file->writing);
+  ASSERT(num_vars > 0);
+  ASSERT(var_names != NULL);
+  if (file->glob_var_id != -1)
+    polymec_error("exodus_file_define_global_vars: Global variables are already defined.");
+
+  // Define the variables and their names.
+  int status = ex_put_variable_param(file->ex_id, EX_GLOBAL, num_vars);
+  if (status < 0)
+    polymec_error("exodus_file_define_global_vars: Could not define %d global variables.", num_vars);
+  char* names[num_vars];
+  for (int i = 0; i < num_vars; ++i)
+  {
+    names[i] = string_dup(var_names[i]);
+    string_array_append_with_dtor(file->glob_var_names, string_dup(var_names[i]), string_free);
+  }
+  ex_put_variable_names(file->ex_id, EX_GLOBAL, num_vars, names);
+  for (int i = 0; i < num_vars; ++i)
+    string_free(names[i]);
+
+  // We write the values directly to the NetCDF variable that Exodus uses 
+  // to store them, so that buffered records can be written in one go.
+  int err = nc_inq_varid(file->ex_id, VAR_GLO_VAR, &file->glob_var_id);
+  if (err != NC_NOERR)
+    polymec_error("exodus_file_define_global_vars: Could not find global variable storage: %s", nc_strerror(err));
+
+  // Allocate the record buffer.
+  file->glob_buffer_times = polymec_malloc(sizeof(int) * file->glob_buffer_cap);
+  file->glob_buffer = polymec_malloc(sizeof(real_t) * num_vars * file->glob_buffer_cap);
+}
+
+void exodus_file_set_global_var_buffer_size(exodus_file_t* file, 
+                                            int num_time_steps)
+{
+  ASSERT(file->writing);
+  ASSERT(num_time_steps > 0);
+
+  // Changing the size of the buffer flushes its contents.
+  flush_global_vars(file);
+  file->glob_buffer_cap = num_time_steps;
+  if (file->glob_var_id != -1)
+  {
+    size_t num_vars = file->glob_var_names->size;
+    file->glob_buffer_times = polymec_realloc(file->glob_buffer_times, sizeof(int) * num_time_steps);
+    file->glob_buffer = polymec_realloc(file->glob_buffer, sizeof(real_t) * num_vars * num_time_steps);
+  }
+}
+
+int exodus_file_num_global_vars(exodus_file_t* file)
+{
+  return (int)file->glob_var_names->size;
+}
+
+// Returns the index of the given global variable, or -1 if it isn't found.
+static int global_var_index(exodus_file_t* file, const char* var_name)
+{
+  for (int i = 0; i < file->glob_var_names->size; ++i)
+  {
+    if (strcmp(var_name, file->glob_var_names->data[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool exodus_file_contains_global_var(exodus_file_t* file, 
+                                     const char* var_name)
+{
+  return (global_var_index(file, var_name) != -1);
+}
+
+// Returns the buffered record for the given time index, creating it 
+// (and flushing the buffer if it's full) if it doesn't exist. A new record 
+// starts with the values already in the file for its time index, if any, 
+// so that writing some of its variables leaves the others as they were.
+static real_t* global_var_record(exodus_file_t* file, int time_index)
+{
+  size_t num_vars = file->glob_var_names->size;
+
+  // Records are usually written in order, so we search from the back.
+  for (int r = file->glob_buffer_size - 1; r >= 0; --r)
+  {
+    if (file->glob_buffer_times[r] == time_index)
+      return &file->glob_buffer[num_vars * r];
+  }
+
+  if (file->glob_buffer_size == file->glob_buffer_cap)
+    flush_global_vars(file);
+  int r = file->glob_buffer_size;
+  file->glob_buffer_times[r] = time_index;
+  real_t* record = &file->glob_buffer[num_vars * r];
+  if (time_index <= file->glob_max_flushed)
+  {
+    size_t start[2] = {(size_t)(time_index - 1), 0};
+    size_t count[2] = {1, num_vars};
+#if POLYMEC_HAVE_DOUBLE_PRECISION
+    int err = nc_get_vara_double(file->ex_id, file->glob_var_id, start, count, record);
+#else
+    int err = nc_get_vara_float(file->ex_id, file->glob_var_id, start, count, record);
+#endif
+    if (err != NC_NOERR)
+    {
+      polymec_error("exodus_file: Error reading global variables for time index %d: %s", 
+                    time_index, nc_strerror(err));
+    }
+  }
+  else
+    memset(record, 0, sizeof(real_t) * num_vars);
+  ++file->glob_buffer_size;
+  return record;
+}
+
+void exodus_file_write_global_var(exodus_file_t* file,
+                                  int time_index,
+                                  const char* var_name,
+                                  real_t value)
+{
+  ASSERT(file->writing);
+  ASSERT(time_index > 0);
+
+  int index = global_var_index(file, var_name);
+  if (index == -1)
+    polymec_error("exodus_file_write_global_var: Undefined global variable: %s", var_name);
+
+  real_t* record = global_var_record(file, time_index);
+  record[index] = value;
+}
+
+void exodus_file_write_global_vars(exodus_file_t* file,
+                                   int time_index,
+                                   real_t* values)
+{
+  ASSERT(file->writing);
+  ASSERT(time_index > 0);
+  ASSERT(file->glob_var_id != -1);
+
+  real_t* record = global_var_record(file, time_index);
+  memcpy(record, values, sizeof(real_t) * file->glob_var_names->size);
+}
+
+void exodus_file_flush_global_vars(exodus_file_t* file)
+{
+  ASSERT(file->writing);
+  flush_global_vars(file);
+}
+
+bool exodus_file_read_global_var(exodus_file_t* file,
+                                 int time_index,
+                                 const char* var_name,
+                                 real_t* value)
+{
+  int index = global_var_index(file, var_name);
+  if (index == -1)
+    return false;
+
+  // Make sure anything we've buffered is in the file.
+  if (file->writing)
+    flush_global_vars(file);
+
+  int status = ex_get_var(file->ex_id, time_index, EX_GLOBAL, index+1, 1, 1, value);
+  return (status >= 0);
+}
+
+real_t* exodus_file_read_global_var_history(exodus_file_t* file,
+                                            const char* var_name,
+                                            int* num_times)
+{
+  int index = global_var_index(file, var_name);
+  if (index == -1)
+    return NULL;
+
+  if (file->writing)
+    flush_global_vars(file);
+
+  // Read the values at all times in a single call.
+  *num_times = (int)ex_inquire_int(file->ex_id, EX_INQ_TIME);
+  real_t* history = polymec_malloc(sizeof(real_t) * MAX(*num_times, 1));
+  if (*num_times > 0)
+  {
+    int status = ex_get_var_time(file->ex_id, EX_GLOBAL, index+1, 1, 
+                                 1, *num_times, history);
+    if (status < 0)
+    {
+      polymec_free(history);
+      return NULL;
+    }
+  }
+  return history;
+}
+
+int exodus_file_num_nodes(exodus_file_t* file)
+{
+  return file->num_nodes;
+}
+
+int exodus_file_num_elements(exodus_file_t* file)
+{
+  return file->num_elem;
+}
+
+int exodus_file_num_times(exodus_file_t* file)
+{
+  return file->last_time_index;
+}
+
+int exodus_file_num_element_blocks(exodus_file_t* file)
+{
+  return file->num_elem_blocks;
+}
+
+void exodus_file_get_element_block(exodus_file_t* file,
+                                   int block_index,
+                                   int* num_elem,
+                                   int* num_nodes_per_elem)
+{
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  char elem_type_name[MAX_NAME_LENGTH+1];
+  int num_faces_per_elem;
+  ex_get_block(file->ex_id, EX_ELEM_BLOCK, file->elem_block_ids[block_index], 
+               elem_type_name, num_elem, num_nodes_per_elem, NULL,
+               &num_faces_per_elem, NULL);
+  if (get_element_type(elem_type_name) == FE_POLYHEDRON)
+    *num_nodes_per_elem = 0;
+}
+
+void exodus_file_read_node_positions(exodus_file_t* file,
+                                     int first_node,
+                                     int num_nodes,
+                                     point_t* positions)
+{
+  ASSERT(first_node >= 0);
+  ASSERT(first_node + num_nodes <= file->num_nodes);
+  if (num_nodes == 0) return;
+
+  real_t* x = polymec_malloc(sizeof(real_t) * 3 * num_nodes);
+  real_t* y = &x[num_nodes];
+  real_t* z = &x[2*num_nodes];
+  int status = ex_get_partial_coord(file->ex_id, first_node+1, num_nodes, x, y, z);
+  if (status < 0)
+  {
+    polymec_free(x);
+    polymec_error("exodus_file_read_node_positions: Could not read positions of nodes %d-%d.", 
+                  first_node, first_node + num_nodes - 1);
+  }
+  for (int n = 0; n < num_nodes; ++n)
+  {
+    positions[n].x = x[n];
+    positions[n].y = y[n];
+    positions[n].z = z[n];
+  }
+  polymec_free(x);
+}
+
+void exodus_file_read_element_block_nodes(exodus_file_t* file,
+                                          int block_index,
+                                          int first_elem,
+                                          int num_elem,
+                                          int* elem_nodes)
+{
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  ASSERT(first_elem >= 0);
+  if (num_elem == 0) return;
+
+  int elem_block = file->elem_block_ids[block_index];
+  int status = ex_get_partial_conn(file->ex_id, EX_ELEM_BLOCK, elem_block, 
+                                   first_elem+1, num_elem, elem_nodes, NULL, NULL);
+  if (status < 0)
+  {
+    polymec_error("exodus_file_read_element_block_nodes: Could not read connectivity for block %d.", 
+                  elem_block);
+  }
+
+  int num_elem_in_block, num_nodes_per_elem;
+  exodus_file_get_element_block(file, block_index, &num_elem_in_block, &num_nodes_per_elem);
+  for (int i = 0; i < num_elem * num_nodes_per_elem; ++i)
+    elem_nodes[i] -= 1;
+}
+
+// Traverses the given list of variable names.
+static bool next_var_name(string_array_t* var_names, int* pos, char** var_name)
+{
+  if (*pos >= var_names->size)
+    return false;
+  *var_name = var_names->data[*pos];
+  ++(*pos);
+  return true;
+}
+
+bool exodus_file_next_node_field(exodus_file_t* file,
+                                 int* pos,
+                                 char** field_name)
+{
+  return next_var_name(file->node_var_names, pos, field_name);
+}
+
+bool exodus_file_next_element_field(exodus_file_t* file,
+                                    int* pos,
+                                    char** field_name)
+{
+  return next_var_name(file->elem_var_names, pos, field_name);
+}
+
+bool exodus_file_next_global_var(exodus_file_t* file,
+                                 int* pos,
+                                 char** var_name)
+{
+  return next_var_name(file->glob_var_names, pos, var_name);
+}
+
+// Returns the index of the given variable within the list, or -1 if it isn't 
+// found.
+static int var_index(string_array_t* var_names, const char* var_name)
+{
+  for (int i = 0; i < var_names->size; ++i)
+  {
+    if (strcmp(var_name, var_names->data[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool exodus_file_read_node_field_values(exodus_file_t* file,
+                                        int time_index,
+                                        const char* field_name,
+                                        int first_node,
+                                        int num_nodes,
+                                        real_t* values)
+{
+  ASSERT(first_node >= 0);
+  ASSERT(first_node + num_nodes <= file->num_nodes);
+  int index = var_index(file->node_var_names, field_name);
+  if (index == -1)
+    return false;
+  if (num_nodes == 0)
+    return true;
+  int status = ex_get_partial_var(file->ex_id, time_index, EX_NODAL, index+1, 1, 
+                                  first_node+1, num_nodes, values);
+  return (status >= 0);
+}
+
+bool exodus_file_read_element_field_values(exodus_file_t* file,
+                                           int time_index,
+                                           const char* field_name,
+                                           int block_index,
+                                           int first_elem,
+                                           int num_elem,
+                                           real_t* values)
+{
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  ASSERT(first_elem >= 0);
+  int index = var_index(file->elem_var_names, field_name);
+  if (index == -1)
+    return false;
+  if (num_elem == 0)
+    return true;
+  int status = ex_get_partial_var(file->ex_id, time_index, EX_ELEM_BLOCK, index+1, 
+                                  file->elem_block_ids[block_index], 
+                                  first_elem+1, num_elem, values);
+  return (status >= 0);
+}
+
+void exodus_file_get_element_block_name(exodus_file_t* file,
+                                        int block_index,
+                                        char* block_name)
+{
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  int elem_block = file->elem_block_ids[block_index];
+  ex_get_name(file->ex_id, EX_ELEM_BLOCK, elem_block, block_name);
+  if (strlen(block_name) == 0)
+    sprintf(block_name, "block_%d", elem_block);
+}
+
+fe_mesh_element_t exodus_file_element_block_type(exodus_file_t* file,
+                                                 int block_index)
+{
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  char elem_type_name[MAX_NAME_LENGTH+1];
+  int num_elem, num_nodes_per_elem, num_faces_per_elem;
+  ex_get_block(file->ex_id, EX_ELEM_BLOCK, file->elem_block_ids[block_index], 
+               elem_type_name, &num_elem, &num_nodes_per_elem, NULL,
+               &num_faces_per_elem, NULL);
+  return get_element_type(elem_type_name);
+}
+
+void exodus_file_read_node_ids(exodus_file_t* file,
+                               int first_node,
+                               int num_nodes,
+                               int* node_ids)
+{
+  ASSERT(first_node >= 0);
+  ASSERT(first_node + num_nodes <= file->num_nodes);
+  if (num_nodes == 0) return;
+  int status = ex_get_partial_id_map(file->ex_id, EX_NODE_MAP, first_node+1, 
+                                     num_nodes, node_ids);
+  if (status < 0)
+    polymec_error("exodus_file_read_node_ids: Could not read node IDs.");
+}
+
+void exodus_file_read_element_ids(exodus_file_t* file,
+                                  int first_elem,
+                                  int num_elem,
+                                  int* elem_ids)
+{
+  ASSERT(first_elem >= 0);
+  ASSERT(first_elem + num_elem <= file->num_elem);
+  if (num_elem == 0) return;
+  int status = ex_get_partial_id_map(file->ex_id, EX_ELEM_MAP, first_elem+1, 
+                                     num_elem, elem_ids);
+  if (status < 0)
+    polymec_error("exodus_file_read_element_ids: Could not read element IDs.");
+}
+
+// Maps our set types to those of Exodus.
+static ex_entity_type ex_set_type(exodus_set_t set_type)
+{
+  switch (set_type)
+  {
+    case EXODUS_NODE_SET: return EX_NODE_SET;
+    case EXODUS_EDGE_SET: return EX_EDGE_SET;
+    case EXODUS_FACE_SET: return EX_FACE_SET;
+    case EXODUS_ELEMENT_SET: return EX_ELEM_SET;
+    default: return EX_SIDE_SET;
+  }
+}
+
+int exodus_file_num_sets(exodus_file_t* file, exodus_set_t set_type)
+{
+  switch (set_type)
+  {
+    case EXODUS_NODE_SET: return file->num_node_sets;
+    case EXODUS_EDGE_SET: return file->num_edge_sets;
+    case EXODUS_FACE_SET: return file->num_face_sets;
+    case EXODUS_ELEMENT_SET: return file->num_elem_sets;
+    default: return file->num_side_sets;
+  }
+}
+
+int* exodus_file_read_set(exodus_file_t* file, 
+                          exodus_set_t set_type,
+                          int set_index,
+                          char* set_name,
+                          size_t* set_size)
+{
+  ASSERT(set_index >= 0);
+  ASSERT(set_index < exodus_file_num_sets(file, set_type));
+
+  // Sets are numbered consecutively starting at 1, as in exodus_file_write_mesh.
+  ex_entity_type ex_type = ex_set_type(set_type);
+  ex_entity_id set_id = (ex_entity_id)(set_index + 1);
+  if (set_name != NULL)
+    ex_get_name(file->ex_id, ex_type, set_id, set_name);
+  int num_entries, num_dist_factors;
+  ex_get_set_param(file->ex_id, ex_type, set_id, &num_entries, &num_dist_factors);
+
+  int* set;
+  if (set_type == EXODUS_SIDE_SET)
+  {
+    *set_size = 2 * (size_t)num_entries;
+    set = polymec_malloc(sizeof(int) * MAX(*set_size, 1));
+    int* elems = polymec_malloc(sizeof(int) * MAX(num_entries, 1));
+    int* faces = polymec_malloc(sizeof(int) * MAX(num_entries, 1));
+    ex_get_set(file->ex_id, ex_type, set_id, elems, faces);
+    for (int i = 0; i < num_entries; ++i)
+    {
+      set[2*i] = elems[i];
+      set[2*i+1] = faces[i];
+    }
+    polymec_free(elems);
+    polymec_free(faces);
+  }
+  else
+  {
+    *set_size = (size_t)num_entries;
+    set = polymec_malloc(sizeof(int) * MAX(*set_size, 1));
+    ex_get_set(file->ex_id, ex_type, set_id, set, NULL);
+  }
+  return set;
+}
+
+void exodus_file_define_mesh(exodus_file_t* file,
+                             int num_nodes,
+                             int num_blocks,
+                             const char** block_names,
+                             fe_mesh_element_t* elem_types,
+                             int* num_elem,
+                             int* num_nodes_per_elem)
+{
+  ASSERT(file->writing);
+  ASSERT(num_nodes > 0);
+  ASSERT(num_blocks > 0);
+
+  file->num_nodes = num_nodes;
+  file->num_elem = 0;
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    if (!element_is_supported(elem_types[b], num_nodes_per_elem[b]))
+      polymec_error("exodus_file_define_mesh: Block %s has an invalid element type.", block_names[b]);
+    file->num_elem += num_elem[b];
+  }
+
+  ex_init_params params;
+  memset(&params, 0, sizeof(ex_init_params));
+  strcpy(params.title, file->title);
+  params.num_dim = 3;
+  params.num_nodes = file->num_nodes;
+  params.num_elem = file->num_elem;
+  params.num_elem_blk = num_blocks;
+  ex_put_init_ext(file->ex_id, &params);
+
+  // Element blocks are numbered consecutively starting at 1, as in 
+  // exodus_file_write_mesh.
+  file->num_elem_blocks = num_blocks;
+  file->elem_block_ids = polymec_malloc(sizeof(int) * num_blocks);
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    int elem_block = file->elem_block_ids[b] = b + 1;
+    char elem_type_name[MAX_NAME_LENGTH+1];
+    get_elem_name(elem_types[b], elem_type_name);
+    ex_put_block(file->ex_id, EX_ELEM_BLOCK, elem_block, elem_type_name, 
+                 num_elem[b], num_nodes_per_elem[b], 0, 0, 0);
+    ex_put_name(file->ex_id, EX_ELEM_BLOCK, elem_block, block_names[b]);
+  }
+
+  char* coord_names[3] = {"x", "y", "z"};
+  ex_put_coord_names(file->ex_id, coord_names);
+}
+
+void exodus_file_write_node_positions(exodus_file_t* file,
+                                      int first_node,
+                                      int num_nodes,
+                                      point_t* positions)
+{
+  ASSERT(file->writing);
+  ASSERT(first_node >= 0);
+  ASSERT(first_node + num_nodes <= file->num_nodes);
+  if (num_nodes == 0) return;
+
+  real_t* x = polymec_malloc(sizeof(real_t) * 3 * num_nodes);
+  real_t* y = &x[num_nodes];
+  real_t* z = &x[2*num_nodes];
+  for (int n = 0; n < num_nodes; ++n)
+  {
+    x[n] = positions[n].x;
+    y[n] = positions[n].y;
+    z[n] = positions[n].z;
+  }
+  int status = ex_put_partial_coord(file->ex_id, first_node+1, num_nodes, x, y, z);
+  polymec_free(x);
+  if (status < 0)
+  {
+    polymec_error("exodus_file_write_node_positions: Could not write positions of nodes %d-%d.", 
+                  first_node, first_node + num_nodes - 1);
+  }
+}
+
+void exodus_file_write_element_block_nodes(exodus_file_t* file,
+                                           int block_index,
+                                           int first_elem,
+                                           int num_elem,
+                                           int* elem_nodes)
+{
+  ASSERT(file->writing);
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  ASSERT(first_elem >= 0);
+  if (num_elem == 0) return;
+
+  int num_elem_in_block, num_nodes_per_elem;
+  exodus_file_get_element_block(file, block_index, &num_elem_in_block, &num_nodes_per_elem);
+  ASSERT(first_elem + num_elem <= num_elem_in_block);
+  int conn_size = num_elem * num_nodes_per_elem;
+  int* conn = polymec_malloc(sizeof(int) * conn_size);
+  for (int i = 0; i < conn_size; ++i)
+    conn[i] = elem_nodes[i] + 1;
+  int elem_block = file->elem_block_ids[block_index];
+  int status = ex_put_partial_elem_conn(file->ex_id, elem_block, first_elem+1, num_elem, conn);
+  polymec_free(conn);
+  if (status < 0)
+  {
+    polymec_error("exodus_file_write_element_block_nodes: Could not write connectivity for block %d.", 
+                  elem_block);
+  }
+}
+
+void exodus_file_write_node_ids(exodus_file_t* file,
+                                int first_node,
+                                int num_nodes,
+                                int* node_ids)
+{
+  ASSERT(file->writing);
+  ASSERT(first_node >= 0);
+  ASSERT(first_node + num_nodes <= file->num_nodes);
+  if (num_nodes == 0) return;
+  int status = ex_put_partial_id_map(file->ex_id, EX_NODE_MAP, first_node+1, 
+                                     num_nodes, node_ids);
+  if (status < 0)
+    polymec_error("exodus_file_write_node_ids: Could not write node IDs.");
+}
+
+void exodus_file_write_element_ids(exodus_file_t* file,
+                                   int first_elem,
+                                   int num_elem,
+                                   int* elem_ids)
+{
+  ASSERT(file->writing);
+  ASSERT(first_elem >= 0);
+  ASSERT(first_elem + num_elem <= file->num_elem);
+  if (num_elem == 0) return;
+  int status = ex_put_partial_id_map(file->ex_id, EX_ELEM_MAP, first_elem+1, 
+                                     num_elem, elem_ids);
+  if (status < 0)
+    polymec_error("exodus_file_write_element_ids: Could not write element IDs.");
+}
+
+// Defines the variables of the given type and adds their names to the list.
+static void define_vars(exodus_file_t* file, 
+                        ex_entity_type var_type,
+                        int num_vars,
+                        const char** var_names,
+                        string_array_t* names)
+{
+  ASSERT(file->writing);
+  ASSERT(num_vars > 0);
+  if (names->size > 0)
+    polymec_error("exodus_file: Variables of this type are already defined.");
+  int status = ex_put_variable_param(file->ex_id, var_type, num_vars);
+  if (status < 0)
+    polymec_error("exodus_file: Could not define %d variables.", num_vars);
+  char* ex_names[num_vars];
+  for (int i = 0; i < num_vars; ++i)
+  {
+    ex_names[i] = string_dup(var_names[i]);
+    string_array_append_with_dtor(names, string_dup(var_names[i]), string_free);
+  }
+  ex_put_variable_names(file->ex_id, var_type, num_vars, ex_names);
+  for (int i = 0; i < num_vars; ++i)
+    string_free(ex_names[i]);
+}
+
+void exodus_file_define_node_fields(exodus_file_t* file,
+                                    int num_fields,
+                                    const char** field_names)
+{
+  define_vars(file, EX_NODAL, num_fields, field_names, file->node_var_names);
+}
+
+void exodus_file_define_element_fields(exodus_file_t* file,
+                                       int num_fields,
+                                       const char** field_names)
+{
+  define_vars(file, EX_ELEM_BLOCK, num_fields, field_names, file->elem_var_names);
+}
+
+void exodus_file_write_node_field_values(exodus_file_t* file,
+                                         int time_index,
+                                         const char* field_name,
+                                         int first_node,
+                                         int num_nodes,
+                                         real_t* values)
+{
+  ASSERT(file->writing);
+  ASSERT(first_node >= 0);
+  ASSERT(first_node + num_nodes <= file->num_nodes);
+  int index = var_index(file->node_var_names, field_name);
+  if (index == -1)
+    polymec_error("exodus_file_write_node_field_values: Undefined node field: %s", field_name);
+  if (num_nodes == 0) return;
+  int status = ex_put_partial_var(file->ex_id, time_index, EX_NODAL, index+1, 1, 
+                                  first_node+1, num_nodes, values);
+  if (status < 0)
+    polymec_error("exodus_file_write_node_field_values: Could not write node field %s.", field_name);
+}
+
+void exodus_file_write_element_field_values(exodus_file_t* file,
+                                            int time_index,
+                                            const char* field_name,
+                                            int block_index,
+                                            int first_elem,
+                                            int num_elem,
+                                            real_t* values)
+{
+  ASSERT(file->writing);
+  ASSERT(block_index >= 0);
+  ASSERT(block_index < file->num_elem_blocks);
+  ASSERT(first_elem >= 0);
+  int index = var_index(file->elem_var_names, field_name);
+  if (index == -1)
+    polymec_error("exodus_file_write_element_field_values: Undefined element field: %s", field_name);
+  if (num_elem == 0) return;
+  int status = ex_put_partial_var(file->ex_id, time_index, EX_ELEM_BLOCK, index+1, 
+                                  file->elem_block_ids[block_index], 
+                                  first_elem+1, num_elem, values);
+  if (status < 0)
+    polymec_error("exodus_file_write_element_field_values: Could not write element field %s.", field_name);
+}
+
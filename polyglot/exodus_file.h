@@ -14,6 +14,10 @@
 // files which are NetCDF files that follow the Exodus II finite element 
 // conventions.
 
+// Maximum length of names (of blocks, sets, variables) in Exodus files.
+// This matches MAX_NAME_LENGTH in the Exodus library.
+#define POLYGLOT_EXODUS_MAX_NAME 32
+
 // This type provides the interface for Exodus II files.
 typedef struct exodus_file_t exodus_file_t;
 
@@ -148,4 +152,275 @@ bool exodus_file_contains_node_field(exodus_file_t* file,
                                      int time_index,
                                      const char* field_name);
 
+// Defines the global (scalar) variables stored in the given Exodus file, 
+// which must be opened for writing. Global variables hold one value per time 
+// (energies, residuals, probe values, etc.), and must be defined (once) 
+// before any of their values are written.
+void exodus_file_define_global_vars(exodus_file_t* file,
+                                    int num_vars,
+                                    const char** var_names);
+
+// Sets the number of time steps for which global variable values are held 
+// in memory before being written to the file in a single batch. Buffered 
+// values are also written when the file is closed or flushed. By default, 
+// 64 time steps are buffered.
+void exodus_file_set_global_var_buffer_size(exodus_file_t* file, 
+                                            int num_time_steps);
+
+// Returns the number of global variables in the given Exodus file.
+int exodus_file_num_global_vars(exodus_file_t* file);
+
+// Returns true if the given Exodus file contains a global variable with the 
+// given name, false otherwise.
+bool exodus_file_contains_global_var(exodus_file_t* file, 
+                                     const char* var_name);
+
+// Writes the value of the named global variable at the time identified by 
+// the given time index. The value is buffered and written later. Other 
+// global variables keep any values already written at that time index 
+// (and are otherwise zero).
+void exodus_file_write_global_var(exodus_file_t* file,
+                                  int time_index,
+                                  const char* var_name,
+                                  real_t value);
+
+// Writes the values of all global variables (in the order in which they 
+// were defined) at the time identified by the given time index. The values 
+// are buffered and written later.
+void exodus_file_write_global_vars(exodus_file_t* file,
+                                   int time_index,
+                                   real_t* values);
+
+// Writes any buffered global variable values to the given Exodus file.
+void exodus_file_flush_global_vars(exodus_file_t* file);
+
+// Reads the value of the named global variable at the time identified by the 
+// given time index, storing it in *value. Returns true if the value was read, 
+// false if the variable was not found.
+bool exodus_file_read_global_var(exodus_file_t* file,
+                                 int time_index,
+                                 const char* var_name,
+                                 real_t* value);
+
+// Reads the values of the named global variable at every time in the file, 
+// returning a newly-allocated array and storing its length in *num_times, 
+// or returning NULL if the variable was not found.
+real_t* exodus_file_read_global_var_history(exodus_file_t* file,
+                                            const char* var_name,
+                                            int* num_times);
+
+// Streaming access: the following functions read pieces of the mesh and 
+// field data in an Exodus file without reading the whole mesh, so that 
+// arbitrarily large files can be processed in bounded-size chunks.
+
+// Returns the number of nodes in the mesh stored in the Exodus file.
+int exodus_file_num_nodes(exodus_file_t* file);
+
+// Returns the number of elements in the mesh stored in the Exodus file.
+int exodus_file_num_elements(exodus_file_t* file);
+
+// Returns the number of times stored in the Exodus file.
+int exodus_file_num_times(exodus_file_t* file);
+
+// Returns the number of element blocks in the mesh stored in the Exodus file.
+int exodus_file_num_element_blocks(exodus_file_t* file);
+
+// Retrieves the number of elements and the number of nodes per element in 
+// the element block with the given (0-based) index. Polyhedral blocks have 
+// no element->node connectivity, so *num_nodes_per_elem is set to 0 for them.
+void exodus_file_get_element_block(exodus_file_t* file,
+                                   int block_index,
+                                   int* num_elem,
+                                   int* num_nodes_per_elem);
+
+// Reads the positions of num_nodes nodes, starting at (0-based) first_node, 
+// into the given array.
+void exodus_file_read_node_positions(exodus_file_t* file,
+                                     int first_node,
+                                     int num_nodes,
+                                     point_t* positions);
+
+// Reads the (0-based) element->node connectivity for num_elem elements of 
+// the given (non-polyhedral) element block, starting at (0-based) 
+// first_elem, into elem_nodes, which must be able to hold 
+// num_elem * num_nodes_per_elem entries.
+void exodus_file_read_element_block_nodes(exodus_file_t* file,
+                                          int block_index,
+                                          int first_elem,
+                                          int num_elem,
+                                          int* elem_nodes);
+
+// Traverses the names of the node fields in the Exodus file, returning true 
+// if the traversal should continue and false if not. Set *pos to 0 to reset 
+// the iteration.
+bool exodus_file_next_node_field(exodus_file_t* file,
+                                 int* pos,
+                                 char** field_name);
+
+// Traverses the names of the element fields in the Exodus file, returning 
+// true if the traversal should continue and false if not. Set *pos to 0 to 
+// reset the iteration.
+bool exodus_file_next_element_field(exodus_file_t* file,
+                                    int* pos,
+                                    char** field_name);
+
+// Traverses the names of the global variables in the Exodus file, returning 
+// true if the traversal should continue and false if not. Set *pos to 0 to 
+// reset the iteration.
+bool exodus_file_next_global_var(exodus_file_t* file,
+                                 int* pos,
+                                 char** var_name);
+
+// Reads num_nodes values of the named node field at the given time index, 
+// starting at (0-based) first_node, into the given array. Returns true if 
+// the values were read, false if the field was not found.
+bool exodus_file_read_node_field_values(exodus_file_t* file,
+                                        int time_index,
+                                        const char* field_name,
+                                        int first_node,
+                                        int num_nodes,
+                                        real_t* values);
+
+// Reads num_elem values of the named element field at the given time index 
+// for the given element block, starting at (0-based) first_elem within that 
+// block, into the given array. Returns true if the values were read, false 
+// if the field was not found or is not defined on the block.
+bool exodus_file_read_element_field_values(exodus_file_t* file,
+                                           int time_index,
+                                           const char* field_name,
+                                           int block_index,
+                                           int first_elem,
+                                           int num_elem,
+                                           real_t* values);
+
+// Retrieves the name of the element block with the given (0-based) index, 
+// storing it in block_name, which must be able to hold 
+// POLYGLOT_EXODUS_MAX_NAME+1 characters.
+void exodus_file_get_element_block_name(exodus_file_t* file,
+                                        int block_index,
+                                        char* block_name);
+
+// Returns the type of element in the element block with the given (0-based) 
+// index.
+fe_mesh_element_t exodus_file_element_block_type(exodus_file_t* file,
+                                                 int block_index);
+
+// Reads the global (1-based) IDs of num_nodes nodes, starting at (0-based) 
+// first_node, into the given array. If the file has no node ID map, the 
+// IDs are 1-based node indices.
+void exodus_file_read_node_ids(exodus_file_t* file,
+                               int first_node,
+                               int num_nodes,
+                               int* node_ids);
+
+// Reads the global (1-based) IDs of num_elem elements, starting at (0-based)
+// first_elem, into the given array. Elements are numbered consecutively 
+// across element blocks. If the file has no element ID map, the IDs are 
+// 1-based element indices.
+void exodus_file_read_element_ids(exodus_file_t* file,
+                                  int first_elem,
+                                  int num_elem,
+                                  int* elem_ids);
+
+// Types of entity sets stored in Exodus files.
+typedef enum
+{
+  EXODUS_NODE_SET,
+  EXODUS_EDGE_SET,
+  EXODUS_FACE_SET,
+  EXODUS_ELEMENT_SET,
+  EXODUS_SIDE_SET
+} exodus_set_t;
+
+// Returns the number of sets of the given type in the Exodus file.
+int exodus_file_num_sets(exodus_file_t* file, exodus_set_t set_type);
+
+// Reads the set of the given type with the given (0-based) index, returning 
+// a newly-allocated array of entity indices and storing its length 
+// in *set_size. Side sets are stored as (element, face) pairs, as they are 
+// in fe_mesh. If set_name is non-NULL, it must be able to hold 
+// POLYGLOT_EXODUS_MAX_NAME+1 characters.
+int* exodus_file_read_set(exodus_file_t* file, 
+                          exodus_set_t set_type,
+                          int set_index,
+                          char* set_name,
+                          size_t* set_size);
+
+// Streaming output: the following functions define a mesh in an Exodus file 
+// opened for writing and write its data piece by piece, so that a mesh need 
+// not be assembled in memory before it is written.
+
+// Defines the mesh in the Exodus file, which must be opened for writing, in 
+// terms of its number of nodes and its (non-polyhedral) element blocks, 
+// each of which has a name, an element type, a number of elements, and a 
+// number of nodes per element.
+void exodus_file_define_mesh(exodus_file_t* file,
+                             int num_nodes,
+                             int num_blocks,
+                             const char** block_names,
+                             fe_mesh_element_t* elem_types,
+                             int* num_elem,
+                             int* num_nodes_per_elem);
+
+// Writes the positions of num_nodes nodes, starting at (0-based) first_node.
+void exodus_file_write_node_positions(exodus_file_t* file,
+                                      int first_node,
+                                      int num_nodes,
+                                      point_t* positions);
+
+// Writes the (0-based) element->node connectivity for num_elem elements of 
+// the given element block, starting at (0-based) first_elem.
+void exodus_file_write_element_block_nodes(exodus_file_t* file,
+                                           int block_index,
+                                           int first_elem,
+                                           int num_elem,
+                                           int* elem_nodes);
+
+// Writes the global (1-based) IDs of num_nodes nodes, starting at (0-based) 
+// first_node.
+void exodus_file_write_node_ids(exodus_file_t* file,
+                                int first_node,
+                                int num_nodes,
+                                int* node_ids);
+
+// Writes the global (1-based) IDs of num_elem elements, starting at 
+// (0-based) first_elem.
+void exodus_file_write_element_ids(exodus_file_t* file,
+                                   int first_elem,
+                                   int num_elem,
+                                   int* elem_ids);
+
+// Defines the node fields stored in the Exodus file. This must be done 
+// (once) before values are written with exodus_file_write_node_field_values.
+void exodus_file_define_node_fields(exodus_file_t* file,
+                                    int num_fields,
+                                    const char** field_names);
+
+// Defines the element fields stored in the Exodus file. This must be done 
+// (once) before values are written with 
+// exodus_file_write_element_field_values.
+void exodus_file_define_element_fields(exodus_file_t* file,
+                                       int num_fields,
+                                       const char** field_names);
+
+// Writes num_nodes values of the named node field at the given time index, 
+// starting at (0-based) first_node.
+void exodus_file_write_node_field_values(exodus_file_t* file,
+                                         int time_index,
+                                         const char* field_name,
+                                         int first_node,
+                                         int num_nodes,
+                                         real_t* values);
+
+// Writes num_elem values of the named element field at the given time index 
+// for the given element block, starting at (0-based) first_elem within that 
+// block.
+void exodus_file_write_element_field_values(exodus_file_t* file,
+                                            int time_index,
+                                            const char* field_name,
+                                            int block_index,
+                                            int first_elem,
+                                            int num_elem,
+                                            real_t* values);
+
 #endif
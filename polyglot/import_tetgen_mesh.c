@@ -5,18 +5,23 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-#include "core/unordered_map.h"
-#include "core/unordered_set.h"
-#include "core/text_buffer.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include "core/array.h"
 #include "core/array_utils.h"
+#include "core/exchanger.h"
 #include "core/partition_mesh.h"
+#include "core/thread_pool.h"
 #include "polyglot/import_tetgen_mesh.h"
 
 typedef struct
 {
   int num_nodes; // 4 for order 1, 10 for order 2.
   int nodes[10];  
-  int attribute; // 0 for none, positive for actual attribute.
+  int attribute; // -1 for none, non-negative for actual attribute.
   int neighbors[4]; // Neighboring tetrahedra.
 } tet_t;
 
@@ -24,140 +29,640 @@ typedef struct
 {
   int num_nodes; // 3 for order 1, 6 for order 2.
   int nodes[6];  
-  int boundary_marker; // 0 for none, positive for actual attribute.
+  int boundary_marker; // -1 for none, non-negative for actual marker.
 } tet_face_t;
 
-static point_t* read_nodes(const char* node_file, int* num_nodes)
+//------------------------------------------------------------------------
+// TetGen files for large meshes are very large, so instead of reading them 
+// line by line with sscanf, we map each file into memory, split its body 
+// into line-aligned chunks, and parse the chunks in parallel with a simple 
+// tokenizer. Records are numbered by counting the lines in each chunk 
+// before parsing, so every thread knows where its records go.
+//------------------------------------------------------------------------
+
+// Files smaller than this many bytes per chunk are parsed by a single thread.
+#define MIN_CHUNK_SIZE (1 << 20)
+
+// Boundary markers and tet attributes below this number become tags.
+#define MAX_NUM_TAGS 1024
+
+// A read-only memory-mapped file.
+typedef struct
+{
+  const char* data;
+  size_t size;
+} mapped_file_t;
+
+// Maps the given file into memory, returning NULL if it can't be opened.
+static mapped_file_t* mapped_file_new(const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  mapped_file_t* file = polymec_malloc(sizeof(mapped_file_t));
+  file->data = NULL;
+  file->size = (size_t)st.st_size;
+  if (file->size > 0)
+  {
+    void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+      polymec_error("Could not map TetGen file '%s' into memory.", filename);
+    file->data = data;
+  }
+  close(fd);
+  return file;
+}
+
+static void mapped_file_free(mapped_file_t* file)
+{
+  if (file->size > 0)
+    munmap((void*)file->data, file->size);
+  polymec_free(file);
+}
+
+static inline bool is_space(char c)
+{
+  return ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\v') || (c == '\f'));
+}
+
+static inline bool is_digit(char c)
+{
+  return ((c >= '0') && (c <= '9'));
+}
+
+static inline const char* skip_spaces(const char* p, const char* end)
+{
+  while ((p < end) && is_space(*p)) ++p;
+  return p;
+}
+
+// Returns the end of the line beginning at p (its newline, or end).
+static inline const char* end_of_line(const char* p, const char* end)
+{
+  const char* newline = memchr(p, '\n', end - p);
+  return (newline != NULL) ? newline : end;
+}
+
+// Parses an integer (like %d) from [p, end) into value, returning the 
+// position following it, or NULL if there's no integer there.
+static inline const char* parse_int(const char* p, const char* end, int* value)
+{
+  p = skip_spaces(p, end);
+  bool negative = false;
+  if ((p < end) && ((*p == '-') || (*p == '+')))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+  if ((p == end) || !is_digit(*p))
+    return NULL;
+  long v = 0;
+  while ((p < end) && is_digit(*p))
+  {
+    v = 10*v + (*p - '0');
+    ++p;
+  }
+  *value = (int)((negative) ? -v : v);
+  return p;
+}
+
+// Parses a real number (like %lg) from [p, end) into value, returning the 
+// position following it, or NULL if there's no number there. Numbers with 
+// at most 15 significant digits and small exponents are converted exactly; 
+// anything else is handed to strtod.
+static inline const char* parse_real(const char* p, const char* end, real_t* value)
+{
+  static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 
+                                         1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 
+                                         1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+                                         1e19, 1e20, 1e21, 1e22};
+  p = skip_spaces(p, end);
+  const char* start = p;
+  bool negative = false;
+  if ((p < end) && ((*p == '-') || (*p == '+')))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  // Mantissa.
+  uint64_t mantissa = 0;
+  int num_digits = 0, exponent = 0;
+  bool found_digits = false;
+  while ((p < end) && is_digit(*p))
+  {
+    found_digits = true;
+    if (num_digits < 19)
+    {
+      mantissa = 10*mantissa + (*p - '0');
+      if (mantissa > 0) ++num_digits;
+    }
+    else
+    {
+      ++num_digits;
+      ++exponent;
+    }
+    ++p;
+  }
+  if ((p < end) && (*p == '.'))
+  {
+    ++p;
+    while ((p < end) && is_digit(*p))
+    {
+      found_digits = true;
+      if (num_digits < 19)
+      {
+        mantissa = 10*mantissa + (*p - '0');
+        if (mantissa > 0) ++num_digits;
+        --exponent;
+      }
+      else
+        ++num_digits;
+      ++p;
+    }
+  }
+
+  // Exponent (only if it has digits).
+  if (found_digits && (p < end) && ((*p == 'e') || (*p == 'E')))
+  {
+    const char* q = p + 1;
+    bool negative_exp = false;
+    if ((q < end) && ((*q == '-') || (*q == '+')))
+    {
+      negative_exp = (*q == '-');
+      ++q;
+    }
+    if ((q < end) && is_digit(*q))
+    {
+      int e = 0;
+      while ((q < end) && is_digit(*q))
+      {
+        if (e < 100000) 
+          e = 10*e + (*q - '0');
+        ++q;
+      }
+      exponent += (negative_exp) ? -e : e;
+      p = q;
+    }
+  }
+
+  if (found_digits && (num_digits <= 15) && (exponent >= -22) && (exponent <= 22))
+  {
+    double v = (double)mantissa;
+    v = (exponent < 0) ? v / powers_of_ten[-exponent] : v * powers_of_ten[exponent];
+    *value = (real_t)((negative) ? -v : v);
+    return p;
+  }
+
+  // Fall back to strtod for everything else (including inf and nan).
+  const char* token_end = start;
+  while ((token_end < end) && !is_space(*token_end) && (*token_end != '\n')) 
+    ++token_end;
+  char token[128];
+  size_t token_length = MIN((size_t)(token_end - start), sizeof(token) - 1);
+  memcpy(token, start, token_length);
+  token[token_length] = '\0';
+  char* endp;
+  double v = strtod(token, &endp);
+  size_t length = endp - token;
+  if (length == 0)
+    return NULL;
+  *value = (real_t)v;
+  return start + length;
+}
+
+// Parses the optional trailing attribute or boundary marker on a line 
+// (whatever follows the last field), storing its integer part in value if 
+// it is a number and leaving value alone otherwise.
+static inline void parse_marker(const char* p, const char* end, int* value)
+{
+  p = skip_spaces(p, end);
+  const char* token_end = p;
+  while ((token_end < end) && !is_space(*token_end)) 
+    ++token_end;
+  if (token_end == p) 
+    return;
+  real_t number;
+  const char* number_end = parse_real(p, token_end, &number);
+  if (number_end == token_end)
+  {
+    if (parse_int(p, token_end, value) == NULL)
+      *value = 0;
+  }
+}
+
+// A function that parses the record on the line [line, end) into the given 
+// (local) index of the array (context), storing its TetGen ID in id. Returns 
+// true if the line is well-formed, false if not.
+typedef bool (*record_parser_t)(const char* line, const char* end, 
+                                void* context, int index, int* id);
+
+// Describes the first bad record in a TetGen file, if any.
+typedef struct
+{
+  int record; // index of the bad record, or -1 if there is none
+  bool bad_id; // true if the record's ID is wrong, false if its line is bad
+  int id; // the bad ID
+  int line; // the (1-based) line of the file holding the bad record
+  const char* position; // the start of that line (on the reading process)
+} record_error_t;
+
+// A line-aligned chunk of a TetGen file parsed by one thread. Records are 
+// numbered globally, starting at base for the first record read by this 
+// process.
+typedef struct
+{
+  const char* begin;
+  const char* end;
+  int base, first_record, num_records, max_records;
+  record_parser_t parse;
+  void* context;
+  record_error_t error;
+} chunk_t;
+
+static void count_chunk_records(void* context)
+{
+  chunk_t* chunk = context;
+  int num_records = 0;
+  const char* p = chunk->begin;
+  while (p < chunk->end)
+  {
+    // Skip lines starting with #.
+    if (*p != '#') 
+      ++num_records;
+    p = end_of_line(p, chunk->end) + 1;
+  }
+  chunk->num_records = num_records;
+}
+
+static void parse_chunk_records(void* context)
+{
+  chunk_t* chunk = context;
+  chunk->error.record = -1;
+  int index = chunk->first_record;
+  const char* p = chunk->begin;
+  while ((p < chunk->end) && (index < chunk->max_records))
+  {
+    const char* line_end = end_of_line(p, chunk->end);
+    if (*p != '#')
+    {
+      int id;
+      if (!chunk->parse(p, line_end, chunk->context, index - chunk->base, &id))
+      {
+        chunk->error.record = index;
+        chunk->error.bad_id = false;
+        chunk->error.position = p;
+        return;
+      }
+      if (id != (index+1))
+      {
+        chunk->error.record = index;
+        chunk->error.bad_id = true;
+        chunk->error.id = id;
+        chunk->error.position = p;
+        return;
+      }
+      ++index;
+    }
+    p = line_end + 1;
+  }
+}
+
+// Copies the first line of the file not starting with # into header 
+// (truncating it to fit), returning the offset of the line that follows it, 
+// or -1 if the file has no such line.
+static long read_header(mapped_file_t* file, char* header, size_t header_size)
+{
+  const char* end = file->data + file->size;
+  const char* p = file->data;
+  while (p < end)
+  {
+    const char* line_end = end_of_line(p, end);
+    if (*p != '#')
+    {
+      size_t length = MIN((size_t)(line_end - p), header_size - 1);
+      memcpy(header, p, length);
+      header[length] = '\0';
+      return (long)(line_end - file->data) + 1;
+    }
+    p = line_end + 1;
+  }
+  return -1;
+}
+
+// Returns the start of the first line beginning at or after p within 
+// [begin, end).
+static inline const char* align_to_line(const char* p, const char* begin, const char* end)
+{
+  if (p <= begin)
+    return begin;
+  return MIN(end_of_line(p-1, end) + 1, end);
+}
+
+// Parses the records (with global indices below max_records) in the 
+// line-aligned portion [begin, end) of the given file, whose first record 
+// has the global index base, returning the number parsed. If a record is 
+// bad, it is described in error, and the records following it are not 
+// parsed.
+static int read_records(mapped_file_t* file,
+                        const char* begin,
+                        const char* end,
+                        int base,
+                        int max_records,
+                        record_parser_t parse,
+                        void* context,
+                        record_error_t* error)
+{
+  error->record = -1;
+  size_t size = end - begin;
+
+  // Split the portion into line-aligned chunks, one or more per thread.
+  thread_pool_t* threads = NULL;
+  int num_chunks = 1;
+  if (size >= 2 * MIN_CHUNK_SIZE)
+  {
+    threads = thread_pool_new();
+    num_chunks = (int)MIN((size_t)(4 * thread_pool_num_threads(threads)), 
+                          size / MIN_CHUNK_SIZE);
+  }
+  chunk_t chunks[num_chunks];
+  const char* chunk_begin = begin;
+  for (int c = 0; c < num_chunks; ++c)
+  {
+    const char* chunk_end = end;
+    if (c < num_chunks - 1)
+      chunk_end = MAX(chunk_begin, align_to_line(begin + (c+1) * (size / num_chunks), begin, end));
+    chunks[c].begin = chunk_begin;
+    chunks[c].end = chunk_end;
+    chunks[c].base = base;
+    chunks[c].max_records = max_records;
+    chunks[c].parse = parse;
+    chunks[c].context = context;
+    chunk_begin = chunk_end;
+  }
+
+  // Count the records in each chunk, and figure out where they go.
+  if (threads != NULL)
+  {
+    for (int c = 0; c < num_chunks; ++c)
+      thread_pool_schedule(threads, &chunks[c], count_chunk_records);
+    thread_pool_execute(threads);
+  }
+  else
+    count_chunk_records(&chunks[0]);
+  int num_records = 0;
+  for (int c = 0; c < num_chunks; ++c)
+  {
+    chunks[c].first_record = base + num_records;
+    num_records += chunks[c].num_records;
+  }
+
+  // Parse them.
+  if (threads != NULL)
+  {
+    for (int c = 0; c < num_chunks; ++c)
+    {
+      if (chunks[c].first_record < max_records)
+        thread_pool_schedule(threads, &chunks[c], parse_chunk_records);
+      else
+        chunks[c].error.record = -1;
+    }
+    thread_pool_execute(threads);
+    thread_pool_free(threads);
+  }
+  else
+    parse_chunk_records(&chunks[0]);
+
+  // Report the first bad record.
+  for (int c = 0; c < num_chunks; ++c)
+  {
+    if (chunks[c].error.record != -1)
+    {
+      *error = chunks[c].error;
+      error->line = 1;
+      for (const char* p = file->data; p < error->position; ++p)
+      {
+        if (*p == '\n')
+          ++error->line;
+      }
+      return error->record - base;
+    }
+  }
+  return MAX(0, MIN(base + num_records, max_records) - base);
+}
+
+// Finds the line-aligned portion [begin, end) of the body of the given file 
+// (starting at offset) that this process reads, along with the global index 
+// of its first record and the number of records it contains. 
+static void find_local_records(MPI_Comm comm,
+                               mapped_file_t* file,
+                               long offset,
+                               const char** begin,
+                               const char** end,
+                               int* first_record,
+                               int* num_records)
+{
+  int rank, nproc;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nproc);
+
+  const char* body_begin = file->data + MIN((size_t)offset, file->size);
+  const char* body_end = file->data + file->size;
+  size_t size = body_end - body_begin;
+  *begin = align_to_line(body_begin + (size_t)(((double)rank / nproc) * size), body_begin, body_end);
+  *end = (rank == nproc-1) ? body_end : 
+         align_to_line(body_begin + (size_t)(((double)(rank+1) / nproc) * size), body_begin, body_end);
+
+  chunk_t chunk = {.begin = *begin, .end = *end};
+  count_chunk_records(&chunk);
+  *num_records = chunk.num_records;
+  *first_record = 0;
+  MPI_Exscan(num_records, first_record, 1, MPI_INT, MPI_SUM, comm);
+  if (rank == 0)
+    *first_record = 0;
+}
+
+// Totals the numbers of records read by all processes, and makes sure every 
+// process has the (globally) first bad record in error.
+static int reduce_records(MPI_Comm comm, int num_read, record_error_t* error)
+{
+  int total;
+  MPI_Allreduce(&num_read, &total, 1, MPI_INT, MPI_SUM, comm);
+
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  struct { int record, rank; } local = {.record = (error->record == -1) ? INT_MAX : error->record, .rank = rank}, first;
+  MPI_Allreduce(&local, &first, 1, MPI_2INT, MPI_MINLOC, comm);
+  if (first.record == INT_MAX)
+    error->record = -1;
+  else
+  {
+    int data[4] = {error->record, (int)error->bad_id, error->id, error->line};
+    MPI_Bcast(data, 4, MPI_INT, first.rank, comm);
+    error->record = data[0];
+    error->bad_id = (bool)data[1];
+    error->id = data[2];
+    error->line = data[3];
+  }
+  return total;
+}
+
+//------------------------------------------------------------------------
+// Each process reads the records in its own portion of each TetGen file.
+//------------------------------------------------------------------------
+
+static bool parse_node(const char* line, const char* end, 
+                       void* context, int index, int* id)
+{
+  point_t* node = &((point_t*)context)[index];
+  line = parse_int(line, end, id);
+  if (line != NULL) line = parse_real(line, end, &node->x);
+  if (line != NULL) line = parse_real(line, end, &node->y);
+  if (line != NULL) line = parse_real(line, end, &node->z);
+  return (line != NULL);
+}
+
+// Reads this process's share of the nodes in the given node file, storing 
+// the global number of nodes, the index of the first local node, and the 
+// number of local nodes.
+static point_t* read_nodes(MPI_Comm comm, 
+                           const char* node_file, 
+                           int* num_nodes,
+                           int* first_node,
+                           int* num_local_nodes)
 {
   *num_nodes = -1;
+  *first_node = *num_local_nodes = 0;
   point_t* nodes = NULL;
 
-  text_buffer_t* buffer = text_buffer_from_file(node_file);
-  if (buffer == NULL)
+  mapped_file_t* file = mapped_file_new(node_file);
+  if (file == NULL)
     polymec_error("TetGen node file '%s' not found.", node_file);
-  int nodes_read = 0, pos = 0, line_length;
-  char* line;
-  while (text_buffer_next(buffer, &pos, &line, &line_length))
+  int nodes_read = 0;
+  char header[1024];
+  long offset = read_header(file, header, 1024);
+  if (offset != -1)
   {
-    // Skip lines starting with #.
-    if (line[0] == '#') continue;
-
-    // Look for the header if we haven't already read it.
-    if (*num_nodes == -1)
-    {
-      int dim, num_attributes, num_boundary_markers; // ignored
-      int num_items = sscanf(line, "%d %d %d %d\n", num_nodes, &dim, 
-                             &num_attributes, &num_boundary_markers);
-      if (num_items != 4)
-        polymec_error("Node file has bad header.");
-      if (*num_nodes <= 0)
-        polymec_error("Node file has bad number of nodes: %d.", *num_nodes);
-      if (dim != 3)
-        polymec_error("Node file is not 3-dimensional.");
-      nodes = polymec_malloc(sizeof(point_t) * (*num_nodes));
-      continue;
-    }
-
-    // Read the coordinates of the next node
-    char garbage[4096];
-    int node_id;
-    int num_items = sscanf(line, "%d %lg %lg %lg%s\n", &node_id, 
-                           &nodes[nodes_read].x, &nodes[nodes_read].y, 
-                           &nodes[nodes_read].z, garbage);
-    if (node_id != (nodes_read+1))
-      polymec_error("Bad node ID after %d nodes read: %d.", nodes_read, node_id);
-    if (num_items < 4)
-      polymec_error("Bad line in nodes file after %d nodes read.", nodes_read);
+    int dim, num_attributes, num_boundary_markers; // ignored
+    int num_items = sscanf(header, "%d %d %d %d\n", num_nodes, &dim, 
+                           &num_attributes, &num_boundary_markers);
+    if (num_items != 4)
+      polymec_error("Node file has bad header.");
     if (*num_nodes <= 0)
       polymec_error("Bad number of nodes in node file: %d.", *num_nodes);
+    if (dim != 3)
+      polymec_error("Node file is not 3-dimensional.");
 
-    ++nodes_read;
-    if (nodes_read == *num_nodes) break;
+    // Read the coordinates of our nodes.
+    const char *begin, *end;
+    int num_records;
+    find_local_records(comm, file, offset, &begin, &end, first_node, &num_records);
+    nodes = polymec_malloc(sizeof(point_t) * MAX(1, MIN(num_records, *num_nodes - *first_node)));
+    record_error_t error;
+    *num_local_nodes = read_records(file, begin, end, *first_node, *num_nodes, 
+                                          parse_node, nodes, &error);
+    nodes_read = reduce_records(comm, *num_local_nodes, &error);
+    if (error.record != -1)
+    {
+      if (error.bad_id)
+        polymec_error("Bad node ID after %d nodes read: %d.", error.record, error.id);
+      else
+        polymec_error("Bad line in nodes file after %d nodes read. (line %d)", 
+                      error.record, error.line);
+    }
   }
-  text_buffer_free(buffer);
+  mapped_file_free(file);
 
   if (nodes_read != *num_nodes)
     polymec_error("Node file claims to contain %d nodes, but %d were read.", *num_nodes, nodes_read);
   return nodes;
 }
 
-static tet_t* read_tets(const char* tet_file, int* num_tets)
+typedef struct
+{
+  tet_t* tets;
+  int nodes_per_tet;
+} tet_parser_t;
+
+static bool parse_tet(const char* line, const char* end, 
+                      void* context, int index, int* id)
+{
+  tet_parser_t* parser = context;
+  tet_t* tet = &parser->tets[index];
+  tet->num_nodes = parser->nodes_per_tet;
+  line = parse_int(line, end, id);
+  for (int n = 0; (n < tet->num_nodes) && (line != NULL); ++n)
+    line = parse_int(line, end, &tet->nodes[n]);
+  if (line == NULL)
+    return false;
+  tet->attribute = -1;
+  parse_marker(line, end, &tet->attribute);
+  return (tet->attribute >= -1);
+}
+
+// Reads this process's share of the tets in the given element file, storing 
+// the global number of tets, the index of the first local tet, the number of 
+// local tets, and the number of nodes per tet.
+static tet_t* read_tets(MPI_Comm comm,
+                        const char* tet_file, 
+                        int* num_tets,
+                        int* first_tet,
+                        int* num_local_tets,
+                        int* nodes_per_tet)
 {
   *num_tets = -1;
+  *first_tet = *num_local_tets = 0;
+  *nodes_per_tet = 4;
   tet_t* tets = NULL;
-  text_buffer_t* buffer = text_buffer_from_file(tet_file);
-  if (buffer == NULL)
+  mapped_file_t* file = mapped_file_new(tet_file);
+  if (file == NULL)
     polymec_error("TetGen element file '%s' not found.", tet_file);
-  int tets_read = 0, nodes_per_tet = 4, region_attribute = 0, pos = 0, line_length;
-  char* line;
-  while (text_buffer_next(buffer, &pos, &line, &line_length))
+  int tets_read = 0, region_attribute = 0;
+  char header[1024];
+  long offset = read_header(file, header, 1024);
+  if (offset != -1)
   {
-    // Skip lines starting with #.
-    if (line[0] == '#') continue;
-
-    // Look for the header if we haven't already read it.
-    if (*num_tets == -1)
-    {
-      int num_items = sscanf(line, "%d %d %d\n", num_tets, 
-                             &nodes_per_tet, &region_attribute);
-      if (num_items != 3)
-        polymec_error("Element file has bad header.");
-      if (*num_tets <= 0)
-        polymec_error("Bad number of tets in element file: %d.", *num_tets);
-      if ((nodes_per_tet != 4) && (nodes_per_tet != 10))
-        polymec_error("Bad number of nodes per tet: %d (must be 4 or 10).", nodes_per_tet);
-      tets = polymec_malloc(sizeof(tet_t) * (*num_tets));
-      continue;
-    }
-
-    // Read the node indices of the next tet.
-    tet_t* tet = &tets[tets_read];
-    char attr_str[128];
-    int tet_id;
-    if (nodes_per_tet == 4)
-    {
-      tet->num_nodes = 4;
-      int num_items = sscanf(line, "%d %d %d %d %d%s\n", &tet_id, 
-                             &tet->nodes[0], &tet->nodes[1], 
-                             &tet->nodes[2], &tet->nodes[3],
-                             attr_str);
-      if (num_items < 5)
-        polymec_error("Bad line in element file after %d tets read.", tets_read);
-      tet->attribute = -1;
-      if (num_items == 6)
-      {
-        if (string_is_number(attr_str))
-          tet->attribute = atoi(attr_str);
-      }
-    }
-    else
+    int num_items = sscanf(header, "%d %d %d\n", num_tets, 
+                           nodes_per_tet, &region_attribute);
+    if (num_items != 3)
+      polymec_error("Element file has bad header.");
+    if (*num_tets <= 0)
+      polymec_error("Bad number of tets in element file: %d.", *num_tets);
+    if ((*nodes_per_tet != 4) && (*nodes_per_tet != 10))
+      polymec_error("Bad number of nodes per tet: %d (must be 4 or 10).", *nodes_per_tet);
+
+    // Read the node indices of our tets.
+    const char *begin, *end;
+    int num_records;
+    find_local_records(comm, file, offset, &begin, &end, first_tet, &num_records);
+    tets = polymec_malloc(sizeof(tet_t) * MAX(1, MIN(num_records, *num_tets - *first_tet)));
+    tet_parser_t parser = {.tets = tets, .nodes_per_tet = *nodes_per_tet};
+    record_error_t error;
+    *num_local_tets = read_records(file, begin, end, *first_tet, *num_tets, 
+                                         parse_tet, &parser, &error);
+    tets_read = reduce_records(comm, *num_local_tets, &error);
+    if (error.record != -1)
     {
-      tet->num_nodes = 10;
-      int num_items = sscanf(line, "%d %d %d %d %d %d %d %d %d %d %d%s\n", 
-                             &tet_id, &tet->nodes[0], &tet->nodes[1], 
-                             &tet->nodes[2], &tet->nodes[3], &tet->nodes[4],
-                             &tet->nodes[5], &tet->nodes[6], &tet->nodes[7],
-                             &tet->nodes[8], &tet->nodes[9], attr_str);
-      if (num_items < 11)
-        polymec_error("Bad line in element file after %d tets read.", tets_read);
-      tet->attribute = -1;
-      if (num_items == 12)
-      {
-        if (string_is_number(attr_str))
-          tet->attribute = atoi(attr_str);
-      }
+      if (error.bad_id)
+        polymec_error("Bad tet ID after %d tets read: %d.", error.record, error.id);
+      else
+        polymec_error("Bad line in element file after %d tets read. (line %d)", 
+                      error.record, error.line);
     }
-    if (tet_id != (tets_read+1))
-      polymec_error("Bad tet ID after %d tets read: %d.", tets_read, tet_id);
-    ++tets_read;
-    if (tets_read == *num_tets) break;
   }
-  text_buffer_free(buffer);
+  mapped_file_free(file);
   if (tets_read != *num_tets)
     polymec_error("Element file claims to contain %d tets, but %d were read.", *num_tets, tets_read);
 
   // TetGen's indices are 1-based, so correct them.
-  for (int t = 0; t < *num_tets; ++t)
+  for (int t = 0; t < *num_local_tets; ++t)
   {
     tet_t* tet = &tets[t];
     for (int n = 0; n < tet->num_nodes; ++n)
@@ -167,76 +672,78 @@ static tet_t* read_tets(const char* tet_file, int* num_tets)
   return tets;
 }
 
-static tet_face_t* read_faces(const char* face_file, int nodes_per_face, int* num_faces)
+typedef struct
+{
+  tet_face_t* faces;
+  int nodes_per_face;
+} face_parser_t;
+
+static bool parse_face(const char* line, const char* end, 
+                       void* context, int index, int* id)
+{
+  face_parser_t* parser = context;
+  tet_face_t* face = &parser->faces[index];
+  face->num_nodes = parser->nodes_per_face;
+  line = parse_int(line, end, id);
+  for (int n = 0; (n < face->num_nodes) && (line != NULL); ++n)
+    line = parse_int(line, end, &face->nodes[n]);
+  if (line == NULL)
+    return false;
+  face->boundary_marker = -1;
+  parse_marker(line, end, &face->boundary_marker);
+  return ((face->boundary_marker >= -1) && (face->boundary_marker < MAX_NUM_TAGS));
+}
+
+// Reads this process's share of the faces in the given face file, storing 
+// the global number of faces and the number of local faces.
+static tet_face_t* read_faces(MPI_Comm comm,
+                              const char* face_file, 
+                              int nodes_per_face, 
+                              int* num_faces,
+                              int* num_local_faces)
 {
   *num_faces = -1;
+  *num_local_faces = 0;
   tet_face_t* faces = NULL;
-  text_buffer_t* buffer = text_buffer_from_file(face_file);
-  if (buffer == NULL)
+  mapped_file_t* file = mapped_file_new(face_file);
+  if (file == NULL)
     polymec_error("TetGen face file '%s' not found.", face_file);
-  int faces_read = 0, boundary_marker = 0, pos = 0, line_length;
-  char* line;
-  while (text_buffer_next(buffer, &pos, &line, &line_length))
+  int faces_read = 0, boundary_marker = 0;
+  char header[1024];
+  long offset = read_header(file, header, 1024);
+  if (offset != -1)
   {
-    // Skip lines starting with #.
-    if (line[0] == '#') continue;
-
-    // Look for the header if we haven't already read it.
-    if (*num_faces == -1)
-    {
-      int num_items = sscanf(line, "%d %d\n", num_faces, &boundary_marker);
-      if (num_items != 2)
-        polymec_error("Face file has bad header.");
-      if (*num_faces <= 0)
-        polymec_error("Bad number of faces in face file: %d.", *num_faces);
-      faces = polymec_malloc(sizeof(tet_face_t) * (*num_faces));
-      continue;
-    }
-
-    // Read the node indices of the next face.
-    tet_face_t* face = &faces[faces_read];
-    char marker_str[128];
-    int face_id;
-    if (nodes_per_face == 3)
-    {
-      face->num_nodes = 3;
-      int num_items = sscanf(line, "%d %d %d %d%s\n", &face_id, 
-                             &face->nodes[0], &face->nodes[1], 
-                             &face->nodes[2], marker_str);
-      if (num_items < 4)
-        polymec_error("Bad line in face file after %d faces read.", faces_read);
-      if (num_items == 5)
-      {
-        if (string_is_number(marker_str))
-          face->boundary_marker = atoi(marker_str);
-      }
-    }
-    else
+    int num_items = sscanf(header, "%d %d\n", num_faces, &boundary_marker);
+    if (num_items != 2)
+      polymec_error("Face file has bad header.");
+    if (*num_faces <= 0)
+      polymec_error("Bad number of faces in face file: %d.", *num_faces);
+
+    // Read the node indices of our faces.
+    const char *begin, *end;
+    int first_face, num_records;
+    find_local_records(comm, file, offset, &begin, &end, &first_face, &num_records);
+    faces = polymec_malloc(sizeof(tet_face_t) * MAX(1, MIN(num_records, *num_faces - first_face)));
+    face_parser_t parser = {.faces = faces, .nodes_per_face = nodes_per_face};
+    record_error_t error;
+    *num_local_faces = read_records(file, begin, end, first_face, *num_faces, 
+                                          parse_face, &parser, &error);
+    faces_read = reduce_records(comm, *num_local_faces, &error);
+    if (error.record != -1)
     {
-      face->num_nodes = 6;
-      int num_items = sscanf(line, "%d %d %d %d %d %d %d%s\n", 
-                             &face_id, &face->nodes[0], &face->nodes[1], 
-                             &face->nodes[2], &face->nodes[3], &face->nodes[4],
-                             &face->nodes[5], marker_str);
-      if (num_items < 7)
-        polymec_error("Bad line in face file after %d faces read.", faces_read);
-      if (num_items == 8)
-      {
-        if (string_is_number(marker_str))
-          face->boundary_marker = atoi(marker_str);
-      }
+      if (error.bad_id)
+        polymec_error("Bad face ID after %d faces read: %d.", error.record, error.id);
+      else
+        polymec_error("Bad line in face file after %d faces read. (line %d)", 
+                      error.record, error.line);
     }
-    if (face_id != (faces_read+1))
-      polymec_error("Bad face ID after %d faces read: %d.", faces_read, face_id);
-    ++faces_read;
-    if (faces_read == *num_faces) break;
   }
-  text_buffer_free(buffer);
+  mapped_file_free(file);
   if (faces_read != *num_faces)
     polymec_error("Face file claims to contain %d faces, but %d were read.", *num_faces, faces_read);
 
   // TetGen's indices are 1-based, so correct them.
-  for (int f = 0; f < *num_faces; ++f)
+  for (int f = 0; f < *num_local_faces; ++f)
   {
     tet_face_t* face = &faces[f];
     for (int n = 0; n < face->num_nodes; ++n)
@@ -246,309 +753,1456 @@ static tet_face_t* read_faces(const char* face_file, int nodes_per_face, int* nu
   return faces;
 }
 
-static void read_neighbors(const char* neigh_file, tet_t* tets, int num_tets)
+//------------------------------------------------------------------------
+// Data is moved between processes in batches of fixed-size items.
+//------------------------------------------------------------------------
+
+// Returns a newly allocated array of nproc+1 offsets whose pth entry is the 
+// global index of the first of the items numbered contiguously across 
+// processes on process p, and whose last entry is the total number of items.
+static int* gather_offsets(MPI_Comm comm, int num_local_items)
 {
-  text_buffer_t* buffer = text_buffer_from_file(neigh_file);
-  if (buffer == NULL)
-    polymec_error("TetGen neighbor file '%s' not found.", neigh_file);
-  int tets_read = 0, pos = 0, line_length, num_entries = -1;
-  char* line;
-  while (text_buffer_next(buffer, &pos, &line, &line_length))
-  {
-    // Skip lines starting with #.
-    if (line[0] == '#') continue;
-
-    // Look for the header if we haven't already read it.
-    if (num_entries == -1)
-    {
-      int four;
-      int num_items = sscanf(line, "%d %d\n", &num_entries, &four);
-      if (num_items != 2)
-        polymec_error("Neighbor file has bad header.");
-      if (num_entries != num_tets)
-        polymec_error("Number of neighbor entries (%d) in neigh file does not match number of tets (%d).", num_entries, num_tets);
-      if (four != 4)
-        polymec_error("Second value in header must be 4.");
-      continue;
-    }
-
-    // Read the neighbor indices of the next tet.
-    tet_t* tet = &tets[tets_read];
-    int tet_id;
-    char junk_str[1024];
-    int num_items = sscanf(line, "%d %d %d %d %d%s\n", &tet_id, 
-                           &tet->neighbors[0], &tet->neighbors[1], 
-                           &tet->neighbors[2], &tet->neighbors[3], 
-                           junk_str);
-    if (num_items < 5)
-        polymec_error("Bad line in neighbors file after %d tets read.", tets_read);
-    if (tet_id != (tets_read+1))
-      polymec_error("Bad tet ID after %d tet read: %d.", tets_read, tet_id);
-    ++tets_read;
-    if (tets_read == num_tets) break;
-  }
-  text_buffer_free(buffer);
-  if (tets_read != num_tets)
-    polymec_error("Neighbor file has %d tets, but needs %d.", tets_read, num_tets);
+  int nproc;
+  MPI_Comm_size(comm, &nproc);
+  int* offsets = polymec_malloc(sizeof(int) * (nproc+1));
+  offsets[0] = 0;
+  MPI_Allgather(&num_local_items, 1, MPI_INT, &offsets[1], 1, MPI_INT, comm);
+  for (int p = 0; p < nproc; ++p)
+    offsets[p+1] += offsets[p];
+  return offsets;
+}
 
-  // TetGen's indices are 1-based, so correct them.
-  for (int t = 0; t < num_tets; ++t)
+// Returns the process that has the item with the given global index.
+static int owning_process(int* offsets, int nproc, int index)
+{
+  int lo = 0, hi = nproc - 1;
+  while (lo < hi)
   {
-    tet_t* tet = &tets[t];
-    for (int n = 0; n < 4; ++n)
-    {
-      if (tet->neighbors[n] > 0)
-        tet->neighbors[n] -= 1;
-    }
+    int mid = (lo + hi + 1) / 2;
+    if (offsets[mid] <= index)
+      lo = mid;
+    else
+      hi = mid - 1;
   }
+  return lo;
 }
 
-static bool face_points_outward(tet_face_t* face,
-                                tet_t* tet,
-                                point_t* nodes)
+// Sends num_items items of the given size to the processes in dest, 
+// returning a newly allocated array of the items received by this process 
+// (ordered by sending process) and storing their number in num_received. If 
+// sources is non-NULL, it is given a newly allocated array of the processes 
+// that sent each received item.
+static void* exchange_items(MPI_Comm comm,
+                            int num_items,
+                            size_t item_size,
+                            void* items,
+                            int* dest,
+                            int* num_received,
+                            int** sources)
 {
-  // Compute the face's center.
-  point_t* n1 = &nodes[face->nodes[0]];
-  point_t* n2 = &nodes[face->nodes[1]];
-  point_t* n3 = &nodes[face->nodes[2]];
-  point_t xf = {.x = (n1->x + n2->x + n3->x)/3.0,
-                .y = (n1->y + n2->y + n3->y)/3.0,
-                .z = (n1->z + n2->z + n3->z)/3.0};
+  int nproc;
+  MPI_Comm_size(comm, &nproc);
+  int* counts = polymec_malloc(sizeof(int) * 5 * nproc);
+  int* send_counts = counts;
+  int* send_displs = &counts[nproc];
+  int* recv_counts = &counts[2*nproc];
+  int* recv_displs = &counts[3*nproc];
+  int* send_pos = &counts[4*nproc];
 
-  // Compute the face's normal vector, assuming that its nodes are ordered 
-  // counterclockwise.
-  vector_t x12, x13, nf;
-  point_displacement(n1, n2, &x12);
-  point_displacement(n1, n3, &x13);
-  vector_cross(&x12, &x13, &nf);
-  ASSERT(vector_mag(&nf) > 0.0);
+  // Figure out how many items go where.
+  memset(send_counts, 0, sizeof(int) * nproc);
+  for (int i = 0; i < num_items; ++i)
+    ++send_counts[dest[i]];
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+  send_displs[0] = recv_displs[0] = 0;
+  for (int p = 1; p < nproc; ++p)
+  {
+    send_displs[p] = send_displs[p-1] + send_counts[p-1];
+    recv_displs[p] = recv_displs[p-1] + recv_counts[p-1];
+  }
+  *num_received = recv_displs[nproc-1] + recv_counts[nproc-1];
+  if (sources != NULL)
+  {
+    *sources = polymec_malloc(sizeof(int) * MAX(1, *num_received));
+    for (int p = 0; p < nproc; ++p)
+      for (int i = 0; i < recv_counts[p]; ++i)
+        (*sources)[recv_displs[p] + i] = p;
+  }
 
-  // Get the remaining tetrahedron node.
-  point_t* n4 = ((tet->nodes[0] != face->nodes[0]) &&
-                 (tet->nodes[0] != face->nodes[1]) && 
-                 (tet->nodes[0] != face->nodes[2])) ? &nodes[tet->nodes[0]] :
-                ((tet->nodes[1] != face->nodes[0]) &&
-                 (tet->nodes[1] != face->nodes[1]) && 
-                 (tet->nodes[1] != face->nodes[2])) ? &nodes[tet->nodes[1]] :
-                ((tet->nodes[2] != face->nodes[0]) &&
-                 (tet->nodes[2] != face->nodes[1]) && 
-                 (tet->nodes[2] != face->nodes[2])) ? &nodes[tet->nodes[2]] :
-                 &nodes[tet->nodes[3]];
+  // Pack the items by destination.
+  char* send_buf = polymec_malloc(item_size * MAX(1, num_items));
+  memcpy(send_pos, send_displs, sizeof(int) * nproc);
+  for (int i = 0; i < num_items; ++i)
+    memcpy(&send_buf[item_size * (send_pos[dest[i]]++)], (char*)items + item_size * i, item_size);
 
-  // Determine whether nf points in the same direction as (xf - n4).
-  vector_t d;
-  point_displacement(n4, &xf, &d);
-  return (vector_dot(&d, &nf) > 0.0);
+  // Send them off.
+  for (int p = 0; p < 4*nproc; ++p)
+    counts[p] *= (int)item_size;
+  char* recv_buf = polymec_malloc(item_size * MAX(1, *num_received));
+  MPI_Alltoallv(send_buf, send_counts, send_displs, MPI_BYTE, 
+                recv_buf, recv_counts, recv_displs, MPI_BYTE, comm);
+  polymec_free(send_buf);
+  polymec_free(counts);
+  return recv_buf;
 }
 
-mesh_t* import_tetgen_mesh(MPI_Comm comm,
-                           const char* node_file,
-                           const char* ele_file,
-                           const char* face_file,
-                           const char* neigh_file)
+// Fetches the values (of the given size) belonging to the items with the 
+// given global indices from the processes that have them, according to 
+// offsets. local_values holds the values of this process's items.
+static void fetch_values(MPI_Comm comm,
+                         int* offsets,
+                         void* local_values,
+                         size_t value_size,
+                         int num_requested,
+                         int* requested,
+                         void* values)
 {
   int rank, nproc;
   MPI_Comm_rank(comm, &rank);
   MPI_Comm_size(comm, &nproc);
 
-  mesh_t* mesh = NULL;
+  // Requests are (item, index) pairs, and replies are (index, value) pairs.
+  int* requests = polymec_malloc(sizeof(int) * 2 * MAX(1, num_requested));
+  int* dest = polymec_malloc(sizeof(int) * MAX(1, num_requested));
+  for (int i = 0; i < num_requested; ++i)
+  {
+    requests[2*i] = requested[i];
+    requests[2*i+1] = i;
+    dest[i] = owning_process(offsets, nproc, requested[i]);
+  }
+  int num_received, *sources;
+  int* received = exchange_items(comm, num_requested, 2*sizeof(int), requests, 
+                                 dest, &num_received, &sources);
+  polymec_free(dest);
+  polymec_free(requests);
 
-  if (rank == 0)
+  size_t reply_size = sizeof(int) + value_size;
+  char* replies = polymec_malloc(reply_size * MAX(1, num_received));
+  for (int i = 0; i < num_received; ++i)
   {
-    // Read the information in the file.
-    int num_nodes;
-    point_t* nodes = read_nodes(node_file, &num_nodes);
+    int item = received[2*i] - offsets[rank];
+    ASSERT((item >= 0) && (item < offsets[rank+1] - offsets[rank]));
+    memcpy(&replies[reply_size*i], &received[2*i+1], sizeof(int));
+    memcpy(&replies[reply_size*i + sizeof(int)], (char*)local_values + value_size * item, value_size);
+  }
+  polymec_free(received);
 
-    int num_tets;
-    tet_t* tets = read_tets(ele_file, &num_tets);
+  int num_replies;
+  char* answers = exchange_items(comm, num_received, reply_size, replies, 
+                                 sources, &num_replies, NULL);
+  ASSERT(num_replies == num_requested);
+  for (int i = 0; i < num_replies; ++i)
+  {
+    int index;
+    memcpy(&index, &answers[reply_size*i], sizeof(int));
+    memcpy((char*)values + value_size * index, &answers[reply_size*i + sizeof(int)], value_size);
+  }
+  polymec_free(answers);
+  polymec_free(replies);
+  polymec_free(sources);
+}
 
-    int num_faces;
-    int nodes_per_face = (tets[0].num_nodes == 4) ? 3 : 6;
-    tet_face_t* faces = read_faces(face_file, nodes_per_face, &num_faces);
+// Sorts the given array and removes its duplicates, returning the number of 
+// unique entries.
+static int sort_unique(int* array, int length)
+{
+  if (length == 0) return 0;
+  int_qsort(array, length);
+  int num_unique = 1;
+  for (int i = 1; i < length; ++i)
+  {
+    if (array[i] != array[num_unique-1])
+      array[num_unique++] = array[i];
+  }
+  return num_unique;
+}
 
-    read_neighbors(neigh_file, tets, num_tets);
+static bool parse_neighbors(const char* line, const char* end, 
+                            void* context, int index, int* id)
+{
+  tet_t* tet = &((tet_t*)context)[index];
+  line = parse_int(line, end, id);
+  for (int n = 0; (n < 4) && (line != NULL); ++n)
+    line = parse_int(line, end, &tet->neighbors[n]);
+  return (line != NULL);
+}
 
-    // Create a mesh full of tetrahedra (4 faces per cell, 3 nodes per face).
-    mesh = mesh_new_with_cell_type(MPI_COMM_SELF, num_tets, 0, num_faces, num_nodes, 4, nodes_per_face);
+// Reads the neighbors of this process's tets from the given neighbor file. 
+// The neighbor records read by this process are sent to the processes 
+// holding their tets, as given by tet_offsets.
+static void read_neighbors(MPI_Comm comm,
+                           const char* neigh_file, 
+                           int* tet_offsets,
+                           tet_t* tets)
+{
+  int rank, nproc;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nproc);
+  int num_tets = tet_offsets[nproc];
 
-    // Copy node coordinates.
-    memcpy(mesh->nodes, nodes, sizeof(point_t) * num_nodes);
+  mapped_file_t* file = mapped_file_new(neigh_file);
+  if (file == NULL)
+    polymec_error("TetGen neighbor file '%s' not found.", neigh_file);
+  int tets_read = 0, num_entries = -1;
+  char header[1024];
+  long offset = read_header(file, header, 1024);
+  if (offset != -1)
+  {
+    int four;
+    int num_items = sscanf(header, "%d %d\n", &num_entries, &four);
+    if (num_items != 2)
+      polymec_error("Neighbor file has bad header.");
+    if (num_entries != num_tets)
+      polymec_error("Number of neighbor entries (%d) in neigh file does not match number of tets (%d).", num_entries, num_tets);
+    if (four != 4)
+      polymec_error("Second value in header must be 4.");
 
-    // Actual connectivity.
-    int_tuple_int_unordered_map_t* face_for_nodes = int_tuple_int_unordered_map_new();
-    for (int f = 0; f < num_faces; ++f)
+    // Read our share of the neighbor records, which are stored in tets 
+    // (with the global tet index in the attribute field).
+    const char *begin, *end;
+    int first_record, num_records;
+    find_local_records(comm, file, offset, &begin, &end, &first_record, &num_records);
+    tet_t* records = polymec_malloc(sizeof(tet_t) * MAX(1, MIN(num_records, num_tets - first_record)));
+    record_error_t error;
+    int num_read = read_records(file, begin, end, first_record, num_tets, 
+                                      parse_neighbors, records, &error);
+    tets_read = reduce_records(comm, num_read, &error);
+    if (error.record != -1)
     {
-      tet_face_t* face = &faces[f];
-      for (int n = 0; n < nodes_per_face; ++n)
-        mesh->face_nodes[nodes_per_face*f+n] = face->nodes[n];
-
-      // Associate the 3 "primal" nodes with this face.
-      int* primal_nodes = int_tuple_new(3);
-      for (int i = 0; i < 3; ++i)
-        primal_nodes[i] = face->nodes[i];
-      int_qsort(primal_nodes, 3);
-      int_tuple_int_unordered_map_insert_with_k_dtor(face_for_nodes, primal_nodes, f, int_tuple_free);
+      if (error.bad_id)
+        polymec_error("Bad tet ID after %d tet read: %d.", error.record, error.id);
+      else
+        polymec_error("Bad line in neighbors file after %d tets read. (line %d)", 
+                      error.record, error.line);
     }
 
-    // Cell <-> face connectivity.
-    for (int c = 0; c < mesh->num_cells; ++c)
+    // Send the records to the processes with the corresponding tets.
+    int* dest = polymec_malloc(sizeof(int) * MAX(1, num_read));
+    for (int i = 0; i < num_read; ++i)
     {
-      for (int f = mesh->cell_face_offsets[c]; f < mesh->cell_face_offsets[c+1]; ++f)
-        mesh->cell_faces[f] = -1;
+      records[i].attribute = first_record + i;
+      dest[i] = owning_process(tet_offsets, nproc, first_record + i);
     }
-    for (int f = 0; f < num_faces; ++f)
+    int num_received;
+    tet_t* received = exchange_items(comm, num_read, sizeof(tet_t), records, 
+                                     dest, &num_received, NULL);
+    for (int i = 0; i < num_received; ++i)
     {
-      mesh->face_cells[2*f]   = -1;
-      mesh->face_cells[2*f+1] = -1;
+      tet_t* tet = &tets[received[i].attribute - tet_offsets[rank]];
+      memcpy(tet->neighbors, received[i].neighbors, 4 * sizeof(int));
     }
-    {
-      // Use a triple for querying faces.
-      int* nodes3 = int_tuple_new(3);
-
-      // Loop over cells and find the faces connecting them to their neighbors.
-      for (int c = 0; c < mesh->num_cells; ++c)
-      {
-        tet_t* t = &tets[c];
-
-        // Tet face-node table.
-        static int tet_face_nodes[4][3] = {{1, 2, 3},  // face 1 has nodes 2, 3, 4
-          {2, 0, 3},  // face 2 has nodes 3, 1, 4
-          {0, 1, 3},  // face 3 has nodes 1, 2, 4
-          {0, 1, 2}}; // face 4 has nodes 1, 2, 3
-
-        // Figure out each of the connections by examining their common nodes.
-        // We use TetGen's indexing scheme (see TetGen documentation), which 
-        // states that neighbor n of a tet shares the face of that tet that 
-        // is opposite of node n in the tet.
-        for (int n = 0; n < 4; ++n)
-        {
-          // Nodes of cell c on this face.
-          nodes3[0] = t->nodes[tet_face_nodes[n][0]];
-          nodes3[1] = t->nodes[tet_face_nodes[n][1]];
-          nodes3[2] = t->nodes[tet_face_nodes[n][2]];
-          int_qsort(nodes3, 3);
-
-          // Find the face with these nodes.
-          int* face_p = int_tuple_int_unordered_map_get(face_for_nodes, nodes3);
-          if (face_p == NULL)
-            polymec_error("TetGen files are inconsistent (cell %d does not have a face with nodes %d, %d, %d)", c+1, nodes3[0]+1, nodes3[1]+1, nodes3[2]+1);
-          int face = *face_p;
-
-          // Determine whether the face has an outward or inward normal w.r.t. 
-          // the cell.
-          tet_face_t* tf = &faces[face];
-          bool outward_normal = face_points_outward(tf, t, mesh->nodes);
-
-          // Get the neighbor tet.
-          int cn = t->neighbors[n];
-          if (cn == -1)
-          {
-            // Set up the face.
-            mesh->cell_faces[mesh->cell_face_offsets[c]+n] = outward_normal ? face : ~face;
-            mesh->face_cells[2*face] = c;
-          }
-          else if (cn > c)
-          {
-            tet_t* tn = &tets[cn];
-
-            // Find the neighbor index of c within cn.
-            int n1 = (tn->neighbors[0] == c) ? 0 :
-              (tn->neighbors[1] == c) ? 1 : 
-              (tn->neighbors[2] == c) ? 2 : 3;
-
-            // Associate the face with both of these cells.
-            mesh->cell_faces[mesh->cell_face_offsets[c]+n]  = outward_normal ? face : ~face;
-            mesh->cell_faces[mesh->cell_face_offsets[cn]+n1] = outward_normal ? ~face : face;
-
-            // Associate the cells with the face.
-            mesh->face_cells[2*face]   = c;
-            mesh->face_cells[2*face+1] = cn;
-          }
-        }
-      }
+    polymec_free(received);
+    polymec_free(dest);
+    polymec_free(records);
+  }
+  mapped_file_free(file);
+  if (tets_read != num_tets)
+    polymec_error("Neighbor file has %d tets, but needs %d.", tets_read, num_tets);
 
-      // Clean up.
-      int_tuple_free(nodes3);
+  // TetGen's indices are 1-based, so correct them.
+  for (int t = 0; t < tet_offsets[rank+1] - tet_offsets[rank]; ++t)
+  {
+    tet_t* tet = &tets[t];
+    for (int n = 0; n < 4; ++n)
+    {
+      if (tet->neighbors[n] > 0)
+        tet->neighbors[n] -= 1;
     }
+  }
+}
 
-    // Build edges.
-    mesh_construct_edges(mesh);
+//------------------------------------------------------------------------
+// Tets are assigned to processes by a cheap geometric partition: their 
+// centroids are ordered along a Morton (Z-order) curve, which is split into 
+// pieces of equal weight.
+//------------------------------------------------------------------------
 
-    // Compute the mesh's geometry.
-    mesh_compute_geometry(mesh);
+// Bits per axis in a Morton key, and leading bits used to bucket the keys.
+#define MORTON_BITS 21
+#define BUCKET_BITS 16
 
-    // Set up tags for faces and cells.
-    static const int max_num_attr = 1024;
-    int boundary_markers[max_num_attr], attributes[max_num_attr];
-    for (int i = 0; i < max_num_attr; ++i)
-      boundary_markers[i] = attributes[i] = 0;
-    for (int f = 0; f < num_faces; ++f)
-    {
-      ASSERT(faces[f].boundary_marker < max_num_attr);
-      if (faces[f].boundary_marker != -1)
-        boundary_markers[faces[f].boundary_marker]++;
-    }
-    int* face_tags[max_num_attr];
-    for (int i = 0; i < max_num_attr; ++i)
-    {
-      if (boundary_markers[i] > 0)
-      {
-        char tag_name[16];
-        snprintf(tag_name, 16, "%d", i);
-        face_tags[i] = mesh_create_tag(mesh->face_tags, tag_name, boundary_markers[i]);
-      }
-    }
-    memset(boundary_markers, 0, sizeof(int) * max_num_attr);
-    for (int f = 0; f < num_faces; ++f)
-    {
-      int m = faces[f].boundary_marker;
-      if (m != -1)
+static uint64_t morton_key(point_t* x, bbox_t* bbox)
+{
+  real_t coords[3] = {x->x, x->y, x->z};
+  real_t lo[3] = {bbox->x1, bbox->y1, bbox->z1};
+  real_t hi[3] = {bbox->x2, bbox->y2, bbox->z2};
+  uint32_t ijk[3];
+  for (int d = 0; d < 3; ++d)
+  {
+    real_t s = (hi[d] > lo[d]) ? (coords[d] - lo[d]) / (hi[d] - lo[d]) : 0.0;
+    s = MIN(MAX(s, 0.0), 1.0);
+    ijk[d] = (uint32_t)(s * ((1 << MORTON_BITS) - 1));
+  }
+  uint64_t key = 0;
+  for (int b = MORTON_BITS - 1; b >= 0; --b)
+    for (int d = 0; d < 3; ++d)
+      key = (key << 1) | ((ijk[d] >> b) & 1);
+  return key;
+}
+
+// Returns a newly allocated array holding the process to which each of the 
+// local tets is assigned, given their weights (all 1 if weights is NULL).
+static int* partition_tets(MPI_Comm comm,
+                           tet_t* tets,
+                           int* weights,
+                           int* tet_offsets,
+                           int* node_offsets,
+                           point_t* nodes)
+{
+  int rank, nproc;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nproc);
+  int num_local_tets = tet_offsets[rank+1] - tet_offsets[rank];
+  int* dest = polymec_malloc(sizeof(int) * MAX(1, num_local_tets));
+  if (nproc == 1)
+  {
+    memset(dest, 0, sizeof(int) * num_local_tets);
+    return dest;
+  }
+
+  // Compute the centroids of our tets from their corner nodes.
+  int* corners = polymec_malloc(sizeof(int) * 4 * MAX(1, num_local_tets));
+  for (int t = 0; t < num_local_tets; ++t)
+    for (int n = 0; n < 4; ++n)
+      corners[4*t+n] = tets[t].nodes[n];
+  point_t* x = polymec_malloc(sizeof(point_t) * 4 * MAX(1, num_local_tets));
+  fetch_values(comm, node_offsets, nodes, sizeof(point_t), 
+               4*num_local_tets, corners, x);
+  polymec_free(corners);
+  real_t lo[3] = {REAL_MAX, REAL_MAX, REAL_MAX}, hi[3] = {-REAL_MAX, -REAL_MAX, -REAL_MAX};
+  for (int t = 0; t < num_local_tets; ++t)
+  {
+    // (The centroid of tet t overwrites corners we've already used.)
+    point_t xc = {.x = 0.25 * (x[4*t].x + x[4*t+1].x + x[4*t+2].x + x[4*t+3].x),
+                  .y = 0.25 * (x[4*t].y + x[4*t+1].y + x[4*t+2].y + x[4*t+3].y),
+                  .z = 0.25 * (x[4*t].z + x[4*t+1].z + x[4*t+2].z + x[4*t+3].z)};
+    x[t] = xc;
+    lo[0] = MIN(lo[0], xc.x); hi[0] = MAX(hi[0], xc.x);
+    lo[1] = MIN(lo[1], xc.y); hi[1] = MAX(hi[1], xc.y);
+    lo[2] = MIN(lo[2], xc.z); hi[2] = MAX(hi[2], xc.z);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, lo, 3, MPI_REAL_T, MPI_MIN, comm);
+  MPI_Allreduce(MPI_IN_PLACE, hi, 3, MPI_REAL_T, MPI_MAX, comm);
+  bbox_t bbox = {.x1 = lo[0], .x2 = hi[0], .y1 = lo[1], .y2 = hi[1], .z1 = lo[2], .z2 = hi[2]};
+
+  // Bucket the tets by the leading bits of their Morton keys, and find the 
+  // position of each tet along the curve: the weight of the tets in all 
+  // lower buckets, plus those in its own bucket on lower processes and 
+  // before it on ours. A tet goes to the process whose piece of the curve 
+  // holds its midpoint.
+  int num_buckets = 1 << BUCKET_BITS;
+  int* buckets = polymec_malloc(sizeof(int) * MAX(1, num_local_tets));
+  int64_t* counts = polymec_calloc(3 * num_buckets, sizeof(int64_t));
+  int64_t* preceding = &counts[num_buckets];
+  int64_t* totals = &counts[2*num_buckets];
+  for (int t = 0; t < num_local_tets; ++t)
+  {
+    buckets[t] = (int)(morton_key(&x[t], &bbox) >> (3*MORTON_BITS - BUCKET_BITS));
+    counts[buckets[t]] += (weights != NULL) ? weights[t] : 1;
+  }
+  polymec_free(x);
+  MPI_Exscan(counts, preceding, num_buckets, MPI_INT64_T, MPI_SUM, comm);
+  if (rank == 0)
+    memset(preceding, 0, sizeof(int64_t) * num_buckets);
+  MPI_Allreduce(counts, totals, num_buckets, MPI_INT64_T, MPI_SUM, comm);
+  int64_t start = 0;
+  for (int b = 0; b < num_buckets; ++b)
+  {
+    int64_t count = totals[b];
+    preceding[b] += start;
+    start += count;
+    counts[b] = 0;
+  }
+  double total_weight = (double)MAX(1, start);
+  for (int t = 0; t < num_local_tets; ++t)
+  {
+    int b = buckets[t];
+    int weight = (weights != NULL) ? weights[t] : 1;
+    double position = (double)(preceding[b] + counts[b]) + 0.5 * weight;
+    counts[b] += weight;
+    dest[t] = MIN(nproc - 1, (int)(position * nproc / total_weight));
+  }
+  polymec_free(counts);
+  polymec_free(buckets);
+  return dest;
+}
+
+//------------------------------------------------------------------------
+// The faces in the face file are distributed among processes by hashing 
+// their (sorted) corner nodes, so each process can look up the faces of 
+// its cells without any process having all of them.
+//------------------------------------------------------------------------
+
+// Returns the process holding the face with the given sorted corner nodes.
+static int face_process(int* nodes, int nproc)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < 3; ++i)
+    hash = (hash ^ (uint64_t)(uint32_t)nodes[i]) * 1099511628211ULL;
+  return (int)(hash % (uint64_t)nproc);
+}
+
+// Sorts the three given nodes in place.
+static inline void sort_corners(int* corners)
+{
+  int a = corners[0], b = corners[1], c = corners[2], t;
+  if (a > b) { t = a; a = b; b = t; }
+  if (b > c) { t = b; b = c; c = t; }
+  if (a > b) { t = a; a = b; b = t; }
+  corners[0] = a; corners[1] = b; corners[2] = c;
+}
+
+// Compares (corner, corner, corner, index) tuples by their corners.
+static int corners_cmp(const void* l, const void* r)
+{
+  const int* c1 = l;
+  const int* c2 = r;
+  for (int i = 0; i < 3; ++i)
+  {
+    if (c1[i] != c2[i])
+      return (c1[i] < c2[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+// Looks up the faces of the file with the given sorted corner nodes (3 per 
+// face), storing them in found. Faces that don't exist in the file are 
+// given zero nodes.
+static void find_faces(MPI_Comm comm,
+                       tet_face_t* local_faces,
+                       int num_local_faces,
+                       int num_queries,
+                       int* corners,
+                       tet_face_t* found)
+{
+  int nproc;
+  MPI_Comm_size(comm, &nproc);
+
+  // Send the faces we've read to the processes that hold them.
+  int* dest = polymec_malloc(sizeof(int) * MAX(1, MAX(num_local_faces, num_queries)));
+  for (int f = 0; f < num_local_faces; ++f)
+  {
+    int nodes3[3] = {local_faces[f].nodes[0], local_faces[f].nodes[1], local_faces[f].nodes[2]};
+    sort_corners(nodes3);
+    dest[f] = face_process(nodes3, nproc);
+  }
+  int num_faces;
+  tet_face_t* faces = exchange_items(comm, num_local_faces, sizeof(tet_face_t), 
+                                     local_faces, dest, &num_faces, NULL);
+
+  // Send our queries, which are (corners, index) tuples.
+  int* queries = polymec_malloc(sizeof(int) * 4 * MAX(1, num_queries));
+  for (int q = 0; q < num_queries; ++q)
+  {
+    memcpy(&queries[4*q], &corners[3*q], 3 * sizeof(int));
+    queries[4*q+3] = q;
+    dest[q] = face_process(&corners[3*q], nproc);
+  }
+  int num_received, *sources;
+  int* received = exchange_items(comm, num_queries, 4*sizeof(int), queries, 
+                                 dest, &num_received, &sources);
+  polymec_free(queries);
+  polymec_free(dest);
+
+  // Match the queries we've received to our faces by sorting both by their 
+  // corners and walking through them together. The 4th entry of each tuple 
+  // is the face or query it belongs to.
+  int* face_keys = polymec_malloc(sizeof(int) * 4 * MAX(1, num_faces));
+  for (int f = 0; f < num_faces; ++f)
+  {
+    memcpy(&face_keys[4*f], faces[f].nodes, 3 * sizeof(int));
+    sort_corners(&face_keys[4*f]);
+    face_keys[4*f+3] = f;
+  }
+  qsort(face_keys, num_faces, 4*sizeof(int), corners_cmp);
+  int* query_keys = polymec_malloc(sizeof(int) * 4 * MAX(1, num_received));
+  for (int q = 0; q < num_received; ++q)
+  {
+    memcpy(&query_keys[4*q], &received[4*q], 3 * sizeof(int));
+    query_keys[4*q+3] = q;
+  }
+  qsort(query_keys, num_received, 4*sizeof(int), corners_cmp);
+
+  // Answer the queries with (index, face) pairs.
+  typedef struct
+  {
+    int index;
+    tet_face_t face;
+  } face_reply_t;
+  face_reply_t* replies = polymec_malloc(sizeof(face_reply_t) * MAX(1, num_received));
+  int f = 0;
+  for (int k = 0; k < num_received; ++k)
+  {
+    int* query_key = &query_keys[4*k];
+    while ((f < num_faces) && (corners_cmp(&face_keys[4*f], query_key) < 0))
+      ++f;
+    face_reply_t* reply = &replies[query_key[3]];
+    reply->index = received[4*query_key[3]+3];
+    if ((f < num_faces) && (corners_cmp(&face_keys[4*f], query_key) == 0))
+      reply->face = faces[face_keys[4*f+3]];
+    else
+      reply->face.num_nodes = 0;
+  }
+  polymec_free(query_keys);
+  polymec_free(face_keys);
+  polymec_free(received);
+  polymec_free(faces);
+
+  int num_replies;
+  face_reply_t* answers = exchange_items(comm, num_received, sizeof(face_reply_t), 
+                                         replies, sources, &num_replies, NULL);
+  for (int q = 0; q < num_replies; ++q)
+    found[answers[q].index] = answers[q].face;
+  polymec_free(answers);
+  polymec_free(replies);
+  polymec_free(sources);
+}
+
+// A tet along with its global index.
+typedef struct
+{
+  int index;
+  tet_t tet;
+} tet_record_t;
+
+static int tet_record_cmp(const void* l, const void* r)
+{
+  int i1 = ((tet_record_t*)l)->index, i2 = ((tet_record_t*)r)->index;
+  return (i1 < i2) ? -1 : (i1 > i2) ? 1 : 0;
+}
+
+// Tet face-node table. Face n is opposite node n (so neighbor n of a tet 
+// shares face n, according to TetGen's indexing scheme), and its nodes are 
+// ordered so that its normal points out of a positively oriented tet.
+static const int tet_face_nodes[4][3] = {{1, 2, 3},  // face 1 has nodes 2, 3, 4
+                                         {2, 0, 3},  // face 2 has nodes 3, 1, 4
+                                         {0, 1, 3},  // face 3 has nodes 1, 2, 4
+                                         {0, 2, 1}}; // face 4 has nodes 1, 3, 2
+
+// Returns true if the given tet is positively oriented (if its first three 
+// nodes are counterclockwise when viewed from its fourth), false if not.
+static inline bool tet_is_positive(tet_t* tet, point_t* nodes)
+{
+  vector_t x01, x02, x03, n;
+  point_displacement(&nodes[tet->nodes[0]], &nodes[tet->nodes[1]], &x01);
+  point_displacement(&nodes[tet->nodes[0]], &nodes[tet->nodes[2]], &x02);
+  point_displacement(&nodes[tet->nodes[0]], &nodes[tet->nodes[3]], &x03);
+  vector_cross(&x01, &x02, &n);
+  return (vector_dot(&n, &x03) > 0.0);
+}
+
+// Returns true if (n0, n1, n2) is an even permutation of (a, b, c), so that 
+// both triangles have the same orientation.
+static inline bool same_orientation(int* nodes, int a, int b, int c)
+{
+  return (nodes[0] == a) ? (nodes[1] == b) : 
+         (nodes[0] == b) ? (nodes[1] == c) : (nodes[1] == a);
+}
+
+// Returns the local index of the node with the given global index, or -1 
+// if it's not one of our nodes.
+static inline int local_node(int* node_ids, int num_local_nodes, int node)
+{
+  int* n_p = int_bsearch(node_ids, num_local_nodes, node);
+  return (n_p != NULL) ? (int)(n_p - node_ids) : -1;
+}
+
+// Cells are assembled in parallel, in blocks of at least this many cells.
+#define MIN_CELLS_PER_BLOCK 4096
+
+// A block of consecutive cells assembled by one thread. A face belongs to 
+// the block of the cell that creates it.
+typedef struct
+{
+  int begin, end; // cells in the block
+  int first_face, num_faces; // faces created by the block's cells
+  int bad_cell; // (global index of) a cell with an inconsistent face, or -1
+
+  // Shared data.
+  tet_record_t* cells;
+  int num_cells;
+  int* cell_ids;
+  int num_ghosts;
+  int* ghost_ids;
+  int* neighbors; // local indices of the 4 neighbors of each cell
+  int* face_cell; // creating cell and its face, for each face
+  int* corners; // sorted corner nodes of each face
+  tet_face_t* faces; // records of faces, from the face file
+  int nodes_per_face;
+  int num_nodes;
+  int* node_ids; // sorted global indices of our nodes
+  mesh_t* mesh;
+} cell_block_t;
+
+// Returns true if face n of cell c is created by c: the face connects c to 
+// the boundary, to a ghost cell, or to one of our cells with a higher index.
+static inline bool creates_face(cell_block_t* block, int c, int n)
+{
+  int neighbor = block->neighbors[4*c+n];
+  return ((neighbor == -1) || (neighbor > c));
+}
+
+// Finds the local indices of the neighbors of the block's cells (ghost 
+// cells follow our own cells) and counts the faces they create.
+static void find_block_neighbors(void* context)
+{
+  cell_block_t* block = context;
+  block->num_faces = 0;
+  for (int c = block->begin; c < block->end; ++c)
+  {
+    for (int n = 0; n < 4; ++n)
+    {
+      int neighbor = block->cells[c].tet.neighbors[n];
+      if (neighbor != -1)
+      {
+        int* cn_p = int_bsearch(block->cell_ids, block->num_cells, neighbor);
+        if (cn_p != NULL)
+          neighbor = (int)(cn_p - block->cell_ids);
+        else
+        {
+          int* g_p = int_bsearch(block->ghost_ids, block->num_ghosts, neighbor);
+          ASSERT(g_p != NULL);
+          neighbor = block->num_cells + (int)(g_p - block->ghost_ids);
+        }
+      }
+      block->neighbors[4*c+n] = neighbor;
+      if (creates_face(block, c, n))
+        ++block->num_faces;
+    }
+  }
+}
+
+// Identifies the faces created by the block's cells.
+static void find_block_faces(void* context)
+{
+  cell_block_t* block = context;
+  int face = block->first_face;
+  for (int c = block->begin; c < block->end; ++c)
+  {
+    tet_t* t = &block->cells[c].tet;
+    for (int n = 0; n < 4; ++n)
+    {
+      if (!creates_face(block, c, n)) continue;
+      block->face_cell[2*face] = c;
+      block->face_cell[2*face+1] = n;
+      int* nodes3 = &block->corners[3*face];
+      for (int i = 0; i < 3; ++i)
+        nodes3[i] = t->nodes[tet_face_nodes[n][i]];
+      sort_corners(nodes3);
+      ++face;
+    }
+  }
+}
+
+// Switches the block's cells and faces to local node indices and fills in 
+// their connectivity.
+static void connect_block_faces(void* context)
+{
+  cell_block_t* block = context;
+  mesh_t* mesh = block->mesh;
+  int nodes_per_face = block->nodes_per_face;
+  block->bad_cell = -1;
+
+  for (int c = block->begin; c < block->end; ++c)
+  {
+    tet_t* t = &block->cells[c].tet;
+    for (int n = 0; n < t->num_nodes; ++n)
+      t->nodes[n] = local_node(block->node_ids, block->num_nodes, t->nodes[n]);
+  }
+
+  for (int face = block->first_face; face < block->first_face + block->num_faces; ++face)
+  {
+    int c = block->face_cell[2*face], n = block->face_cell[2*face+1];
+    tet_t* t = &block->cells[c].tet;
+    tet_face_t* tf = &block->faces[face];
+    for (int i = 0; i < nodes_per_face; ++i)
+    {
+      tf->nodes[i] = local_node(block->node_ids, block->num_nodes, tf->nodes[i]);
+      if (tf->nodes[i] == -1)
+        block->bad_cell = block->cells[c].index;
+    }
+    if (block->bad_cell != -1) return;
+    memcpy(&mesh->face_nodes[nodes_per_face*face], tf->nodes, sizeof(int) * nodes_per_face);
+
+    // The face's normal points out of the cell if its nodes are ordered 
+    // like those in the face table and the tet is positively oriented, or 
+    // if neither is true.
+    bool outward_normal = (same_orientation(tf->nodes, 
+                                            t->nodes[tet_face_nodes[n][0]],
+                                            t->nodes[tet_face_nodes[n][1]],
+                                            t->nodes[tet_face_nodes[n][2]]) == 
+                           tet_is_positive(t, mesh->nodes));
+    mesh->cell_faces[mesh->cell_face_offsets[c]+n] = outward_normal ? face : ~face;
+    mesh->face_cells[2*face] = c;
+
+    int cn = block->neighbors[4*c+n];
+    mesh->face_cells[2*face+1] = cn;
+    if ((cn != -1) && (cn < block->num_cells))
+    {
+      // Find the neighbor index of c within cn, and associate the face 
+      // with it.
+      int* neighbors = &block->neighbors[4*cn];
+      int n1 = (neighbors[0] == c) ? 0 :
+               (neighbors[1] == c) ? 1 : 
+               (neighbors[2] == c) ? 2 : 3;
+      mesh->cell_faces[mesh->cell_face_offsets[cn]+n1] = outward_normal ? ~face : face;
+    }
+  }
+}
+
+// Runs the given function on each of the blocks, using the given threads 
+// if there are any.
+static void assemble_blocks(thread_pool_t* threads,
+                            cell_block_t* blocks,
+                            int num_blocks,
+                            void (*assemble)(void*))
+{
+  if (threads != NULL)
+  {
+    for (int b = 0; b < num_blocks; ++b)
+      thread_pool_schedule(threads, &blocks[b], assemble);
+    thread_pool_execute(threads);
+  }
+  else
+  {
+    for (int b = 0; b < num_blocks; ++b)
+      assemble(&blocks[b]);
+  }
+}
+
+// Sets up the exchange of ghost cell data between the given mesh's process 
+// and its neighbors.
+static void set_up_exchanger(mesh_t* mesh,
+                             tet_record_t* cells,
+                             int num_ghosts,
+                             int* ghost_ids,
+                             int* ghost_procs)
+{
+  int nproc;
+  MPI_Comm_size(mesh->comm, &nproc);
+  int* counts = polymec_calloc(4 * nproc, sizeof(int));
+  int* recv_counts = counts;
+  int* recv_offsets = &counts[nproc];
+  int* send_counts = &counts[2*nproc];
+  int* last_sent = &counts[3*nproc];
+
+  // We receive the ghost cells owned by each process, in order of global 
+  // index. Each neighbor sends the cells it owns that are our ghosts, also in 
+  // order of global index, so the lists match.
+  for (int g = 0; g < num_ghosts; ++g)
+    ++recv_counts[ghost_procs[g]];
+  for (int p = 1; p < nproc; ++p)
+    recv_offsets[p] = recv_offsets[p-1] + recv_counts[p-1];
+  int* recv_indices = polymec_malloc(sizeof(int) * MAX(1, num_ghosts));
+  memset(recv_counts, 0, sizeof(int) * nproc);
+  for (int g = 0; g < num_ghosts; ++g)
+  {
+    int p = ghost_procs[g];
+    recv_indices[recv_offsets[p] + recv_counts[p]++] = mesh->num_cells + g;
+  }
+
+  // We send each of our cells (in order of global index) to every process 
+  // that owns one of its neighbors.
+  int_array_t** send_indices = polymec_malloc(sizeof(int_array_t*) * nproc);
+  for (int p = 0; p < nproc; ++p)
+  {
+    send_indices[p] = NULL;
+    last_sent[p] = -1;
+  }
+  for (int c = 0; c < mesh->num_cells; ++c)
+  {
+    for (int n = 0; n < 4; ++n)
+    {
+      int neighbor = cells[c].tet.neighbors[n];
+      if (neighbor == -1) continue;
+      int* g_p = int_bsearch(ghost_ids, num_ghosts, neighbor);
+      if (g_p == NULL) continue;
+      int p = ghost_procs[g_p - ghost_ids];
+      if (last_sent[p] == c) continue;
+      if (send_indices[p] == NULL)
+        send_indices[p] = int_array_new();
+      int_array_append(send_indices[p], c);
+      last_sent[p] = c;
+      ++send_counts[p];
+    }
+  }
+
+  exchanger_t* ex = exchanger_new(mesh->comm);
+  for (int p = 0; p < nproc; ++p)
+  {
+    if (send_indices[p] != NULL)
+    {
+      exchanger_set_send(ex, p, send_indices[p]->data, (int)send_indices[p]->size, true);
+      int_array_free(send_indices[p]);
+    }
+    if (recv_counts[p] > 0)
+      exchanger_set_receive(ex, p, &recv_indices[recv_offsets[p]], recv_counts[p], true);
+  }
+  mesh_set_exchanger(mesh, ex);
+
+  polymec_free(send_indices);
+  polymec_free(recv_indices);
+  polymec_free(counts);
+}
+
+// Returns the weight of the tet with the given global index and attribute.
+static inline int tet_weight(int* tet_weights, 
+                             int num_attributes, 
+                             int* attribute_weights,
+                             int tet, 
+                             int attribute)
+{
+  if (tet_weights != NULL)
+    return tet_weights[tet];
+  else if ((attribute_weights != NULL) && (attribute >= 0) && (attribute < num_attributes))
+    return attribute_weights[attribute];
+  else
+    return 1;
+}
+
+mesh_t* import_tetgen_mesh(MPI_Comm comm,
+                           const char* node_file,
+                           const char* ele_file,
+                           const char* face_file,
+                           const char* neigh_file)
+{
+  return import_tetgen_mesh_with_weights(comm, node_file, ele_file, face_file, 
+                                         neigh_file, TETGEN_SFC_PARTITION, 
+                                         NULL, 0, 0, NULL, 0.05);
+}
+
+mesh_t* import_tetgen_mesh_with_weights(MPI_Comm comm,
+                                        const char* node_file,
+                                        const char* ele_file,
+                                        const char* face_file,
+                                        const char* neigh_file,
+                                        tetgen_partition_t partition,
+                                        int* tet_weights,
+                                        int num_tet_weights,
+                                        int num_attributes,
+                                        int* attribute_weights,
+                                        real_t imbalance_tol)
+{
+  ASSERT(imbalance_tol > 0.0);
+  ASSERT(imbalance_tol < 1.0);
+
+  int rank, nproc;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nproc);
+
+  // Read our share of the information in the files.
+  int num_nodes, first_node, num_local_nodes;
+  point_t* nodes = read_nodes(comm, node_file, &num_nodes, &first_node, &num_local_nodes);
+  int* node_offsets = gather_offsets(comm, num_local_nodes);
+
+  int num_tets, first_tet, num_local_tets, nodes_per_tet;
+  tet_t* tets = read_tets(comm, ele_file, &num_tets, &first_tet, &num_local_tets, &nodes_per_tet);
+  int* tet_offsets = gather_offsets(comm, num_local_tets);
+  if ((tet_weights != NULL) && (num_tet_weights != num_tets))
+    polymec_error("import_tetgen_mesh: %d tet weights were given for %d tets.", num_tet_weights, num_tets);
+  read_neighbors(comm, neigh_file, tet_offsets, tets);
+
+  int num_faces, num_local_faces;
+  int nodes_per_face = (nodes_per_tet == 4) ? 3 : 6;
+  tet_face_t* faces = read_faces(comm, face_file, nodes_per_face, &num_faces, &num_local_faces);
+
+  // Partition the tets and send them to their processes. These are our 
+  // cells, which we order by global index.
+  int* weights = NULL;
+  if ((tet_weights != NULL) || (attribute_weights != NULL))
+  {
+    weights = polymec_malloc(sizeof(int) * MAX(1, num_local_tets));
+    for (int t = 0; t < num_local_tets; ++t)
+    {
+      weights[t] = tet_weight(tet_weights, num_attributes, attribute_weights,
+                              first_tet + t, tets[t].attribute);
+      if (weights[t] < 0)
+        polymec_error("import_tetgen_mesh: Tet %d has negative weight (%d).", first_tet + t + 1, weights[t]);
+    }
+  }
+  int* dest = partition_tets(comm, tets, weights, tet_offsets, node_offsets, nodes);
+  if (weights != NULL)
+    polymec_free(weights);
+  tet_record_t* records = polymec_malloc(sizeof(tet_record_t) * MAX(1, num_local_tets));
+  for (int t = 0; t < num_local_tets; ++t)
+  {
+    records[t].index = first_tet + t;
+    records[t].tet = tets[t];
+  }
+  polymec_free(tets);
+  int num_cells;
+  tet_record_t* cells = exchange_items(comm, num_local_tets, sizeof(tet_record_t), 
+                                       records, dest, &num_cells, NULL);
+  polymec_free(records);
+  qsort(cells, num_cells, sizeof(tet_record_t), tet_record_cmp);
+  int* cell_ids = polymec_malloc(sizeof(int) * MAX(1, num_cells));
+  for (int c = 0; c < num_cells; ++c)
+    cell_ids[c] = cells[c].index;
+
+  // Our ghost cells are the neighbors of our cells that we don't own. Find 
+  // out who owns them.
+  int num_ghosts = 0;
+  int* ghost_ids = polymec_malloc(sizeof(int) * 4 * MAX(1, num_cells));
+  for (int c = 0; c < num_cells; ++c)
+  {
+    for (int n = 0; n < 4; ++n)
+    {
+      int neighbor = cells[c].tet.neighbors[n];
+      if ((neighbor != -1) && (int_bsearch(cell_ids, num_cells, neighbor) == NULL))
+        ghost_ids[num_ghosts++] = neighbor;
+    }
+  }
+  num_ghosts = sort_unique(ghost_ids, num_ghosts);
+  int* ghost_procs = polymec_malloc(sizeof(int) * MAX(1, num_ghosts));
+  fetch_values(comm, tet_offsets, dest, sizeof(int), num_ghosts, ghost_ids, ghost_procs);
+  polymec_free(dest);
+  polymec_free(tet_offsets);
+
+  // Fetch the nodes of our cells.
+  int num_cell_nodes = 0;
+  int* node_ids = polymec_malloc(sizeof(int) * nodes_per_tet * MAX(1, num_cells));
+  for (int c = 0; c < num_cells; ++c)
+    for (int n = 0; n < nodes_per_tet; ++n)
+      node_ids[num_cell_nodes++] = cells[c].tet.nodes[n];
+  num_cell_nodes = sort_unique(node_ids, num_cell_nodes);
+
+  // Our faces connect each of our cells to the boundary, to ghost cells, and 
+  // to those of our cells with higher indices. Cells are assembled in blocks.
+  thread_pool_t* threads = NULL;
+  int num_blocks = 1;
+  if (num_cells >= 2 * MIN_CELLS_PER_BLOCK)
+  {
+    threads = thread_pool_new();
+    num_blocks = MIN(4 * thread_pool_num_threads(threads), num_cells / MIN_CELLS_PER_BLOCK);
+  }
+  int* neighbors = polymec_malloc(sizeof(int) * 4 * MAX(1, num_cells));
+  cell_block_t blocks[num_blocks];
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    cell_block_t* block = &blocks[b];
+    block->begin = (int)(((size_t)num_cells * b) / num_blocks);
+    block->end = (int)(((size_t)num_cells * (b+1)) / num_blocks);
+    block->cells = cells;
+    block->num_cells = num_cells;
+    block->cell_ids = cell_ids;
+    block->num_ghosts = num_ghosts;
+    block->ghost_ids = ghost_ids;
+    block->neighbors = neighbors;
+    block->nodes_per_face = nodes_per_face;
+    block->num_nodes = num_cell_nodes;
+    block->node_ids = node_ids;
+  }
+
+  // Find neighbors and count faces, then identify the faces.
+  assemble_blocks(threads, blocks, num_blocks, find_block_neighbors);
+  int num_cell_faces = 0;
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    blocks[b].first_face = num_cell_faces;
+    num_cell_faces += blocks[b].num_faces;
+  }
+  int* face_cell = polymec_malloc(sizeof(int) * 2 * MAX(1, num_cell_faces));
+  int* corners = polymec_malloc(sizeof(int) * 3 * MAX(1, num_cell_faces));
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    blocks[b].face_cell = face_cell;
+    blocks[b].corners = corners;
+  }
+  assemble_blocks(threads, blocks, num_blocks, find_block_faces);
+
+  // Find the faces in the face file.
+  tet_face_t* cell_faces = polymec_malloc(sizeof(tet_face_t) * MAX(1, num_cell_faces));
+  find_faces(comm, faces, num_local_faces, num_cell_faces, corners, cell_faces);
+  polymec_free(faces);
+  for (int f = 0; f < num_cell_faces; ++f)
+  {
+    if (cell_faces[f].num_nodes == 0)
+    {
+      int* nodes3 = &corners[3*f];
+      polymec_error("TetGen files are inconsistent (cell %d does not have a face with nodes %d, %d, %d)", cells[face_cell[2*f]].index+1, nodes3[0]+1, nodes3[1]+1, nodes3[2]+1);
+    }
+  }
+  polymec_free(corners);
+
+  // Create a mesh full of tetrahedra (4 faces per cell, 3 nodes per face).
+  mesh_t* mesh = mesh_new_with_cell_type(comm, num_cells, num_ghosts, num_cell_faces, 
+                                         num_cell_nodes, 4, nodes_per_face);
+
+  // Node coordinates.
+  fetch_values(comm, node_offsets, nodes, sizeof(point_t), num_cell_nodes, 
+               node_ids, mesh->nodes);
+  polymec_free(nodes);
+  polymec_free(node_offsets);
+
+  // Cell <-> face connectivity.
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    blocks[b].faces = cell_faces;
+    blocks[b].mesh = mesh;
+  }
+  assemble_blocks(threads, blocks, num_blocks, connect_block_faces);
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    if (blocks[b].bad_cell != -1)
+      polymec_error("TetGen files are inconsistent (a face of cell %d has a node that is not in the cell).", blocks[b].bad_cell+1);
+  }
+  if (threads != NULL)
+    thread_pool_free(threads);
+  polymec_free(neighbors);
+  polymec_free(face_cell);
+  polymec_free(node_ids);
+  polymec_free(cell_ids);
+
+  // Set up the exchange of ghost cell data.
+  if (nproc > 1)
+    set_up_exchanger(mesh, cells, num_ghosts, ghost_ids, ghost_procs);
+  polymec_free(ghost_ids);
+  polymec_free(ghost_procs);
+
+  // Build edges.
+  mesh_construct_edges(mesh);
+
+  // Compute the mesh's geometry.
+  mesh_compute_geometry(mesh);
+
+  // Set up tags for faces and cells. Every process creates the tags that 
+  // exist on any process, even if it has none of their faces or cells.
+  static const int max_num_attr = MAX_NUM_TAGS;
+  int boundary_markers[max_num_attr], attributes[max_num_attr], present[max_num_attr];
+  for (int i = 0; i < max_num_attr; ++i)
+    boundary_markers[i] = attributes[i] = 0;
+  for (int f = 0; f < num_cell_faces; ++f)
+  {
+    // Boundary markers were checked when the face file was read.
+    if (cell_faces[f].boundary_marker != -1)
+      boundary_markers[cell_faces[f].boundary_marker]++;
+  }
+  MPI_Allreduce(boundary_markers, present, max_num_attr, MPI_INT, MPI_MAX, comm);
+  int* face_tags[max_num_attr];
+  for (int i = 0; i < max_num_attr; ++i)
+  {
+    if (present[i] > 0)
+    {
+      char tag_name[16];
+      snprintf(tag_name, 16, "%d", i);
+      face_tags[i] = mesh_create_tag(mesh->face_tags, tag_name, boundary_markers[i]);
+    }
+  }
+  memset(boundary_markers, 0, sizeof(int) * max_num_attr);
+  for (int f = 0; f < num_cell_faces; ++f)
+  {
+    int m = cell_faces[f].boundary_marker;
+    if (m != -1)
+    {
+      face_tags[m][boundary_markers[m]] = f;
+      boundary_markers[m]++;
+    }
+  }
+
+  for (int c = 0; c < num_cells; ++c)
+  {
+    // If this is a "normal" attribute, we assign it to a tag.
+    int a = cells[c].tet.attribute;
+    if ((a >= 0) && (a < max_num_attr))
+      attributes[a]++;
+    // Otherwise it's probably something to do with adaptive resolution.
+  }
+  MPI_Allreduce(attributes, present, max_num_attr, MPI_INT, MPI_MAX, comm);
+  int* cell_tags[max_num_attr];
+  for (int i = 0; i < max_num_attr; ++i)
+  {
+    if (present[i] > 0)
+    {
+      char tag_name[16];
+      snprintf(tag_name, 16, "%d", i);
+      cell_tags[i] = mesh_create_tag(mesh->cell_tags, tag_name, attributes[i]);
+    }
+  }
+  memset(attributes, 0, sizeof(int) * max_num_attr);
+  for (int c = 0; c < num_cells; ++c)
+  {
+    int a = cells[c].tet.attribute;
+    if ((a >= 0) && (a < max_num_attr))
+    {
+      cell_tags[a][attributes[a]] = c;
+      attributes[a]++;
+    }
+  }
+
+  // Refine the partition with a graph partitioner if we've been asked to.
+  if ((partition == TETGEN_GRAPH_PARTITION) && (nproc > 1))
+  {
+    int* cell_weights = NULL;
+    if ((tet_weights != NULL) || (attribute_weights != NULL))
+    {
+      cell_weights = polymec_malloc(sizeof(int) * MAX(1, num_cells));
+      for (int c = 0; c < num_cells; ++c)
       {
-        face_tags[m][boundary_markers[m]] = f;
-        boundary_markers[m]++;
+        cell_weights[c] = tet_weight(tet_weights, num_attributes, attribute_weights,
+                                     cells[c].index, cells[c].tet.attribute);
       }
     }
+    migrator_t* migrator = repartition_mesh(&mesh, cell_weights, imbalance_tol);
+    migrator_free(migrator);
+    if (cell_weights != NULL)
+      polymec_free(cell_weights);
+  }
+
+  // Clean up.
+  polymec_free(cell_faces);
+  polymec_free(cells);
 
-    for (int t = 0; t < num_tets; ++t)
+  mesh_add_feature(mesh, MESH_IS_TETRAHEDRAL);
+  return mesh;
+}
+
+//------------------------------------------------------------------------
+// Imported meshes can be cached in binary files (one per process), so that 
+// repeated imports of the same TetGen files skip parsing, partitioning, and 
+// the construction of edges and geometry. A cache file is a header followed 
+// by the mesh's arrays in a fixed order, each padded to a multiple of 8 
+// bytes so that every array is aligned when the file is mapped into memory.
+//------------------------------------------------------------------------
+
+// Increment this whenever the layout of cache files changes.
+#define TETGEN_CACHE_VERSION 1
+
+static const char tetgen_cache_magic[8] = {'P', 'G', 'T', 'E', 'T', 'G', 'E', 'N'};
+
+typedef struct
+{
+  char magic[8];
+  int32_t version;
+  int32_t int_size, real_size; // sizes of int and real_t in bytes
+  int32_t nproc, rank; // partition stored in the cache
+  int64_t file_sizes[4], file_times[4]; // sizes and mtimes of TetGen files
+  int32_t num_cells, num_ghost_cells, num_faces, num_edges, num_nodes;
+  int32_t num_face_tags, num_cell_tags;
+  int64_t size; // total size of the cache file in bytes
+} tetgen_cache_header_t;
+
+// Returns the number of bytes occupied by an array of the given size in a 
+// cache file.
+static inline size_t cache_size(size_t size)
+{
+  return (size + 7) & ~((size_t)7);
+}
+
+// Fills in the header of a cache for the given TetGen files, returning 
+// false if any of the files can't be found.
+static bool get_cache_header(MPI_Comm comm,
+                             const char* files[4],
+                             tetgen_cache_header_t* header)
+{
+  memset(header, 0, sizeof(tetgen_cache_header_t));
+  memcpy(header->magic, tetgen_cache_magic, 8);
+  header->version = TETGEN_CACHE_VERSION;
+  header->int_size = (int32_t)sizeof(int);
+  header->real_size = (int32_t)sizeof(real_t);
+  int nproc, rank;
+  MPI_Comm_size(comm, &nproc);
+  MPI_Comm_rank(comm, &rank);
+  header->nproc = nproc;
+  header->rank = rank;
+  for (int i = 0; i < 4; ++i)
+  {
+    struct stat st;
+    if (stat(files[i], &st) != 0)
+      return false;
+    header->file_sizes[i] = (int64_t)st.st_size;
+    header->file_times[i] = (int64_t)st.st_mtime;
+  }
+  return true;
+}
+
+// Returns true if the given cache file is valid for the given header.
+static bool cache_is_valid(mapped_file_t* file, tetgen_cache_header_t* header)
+{
+  if ((file == NULL) || (file->size < sizeof(tetgen_cache_header_t)))
+    return false;
+  const tetgen_cache_header_t* h = (const tetgen_cache_header_t*)file->data;
+  return ((memcmp(h->magic, header->magic, 8) == 0) && 
+          (h->version == header->version) && 
+          (h->int_size == header->int_size) && 
+          (h->real_size == header->real_size) &&
+          (h->nproc == header->nproc) && 
+          (h->rank == header->rank) &&
+          (memcmp(h->file_sizes, header->file_sizes, sizeof(header->file_sizes)) == 0) &&
+          (memcmp(h->file_times, header->file_times, sizeof(header->file_times)) == 0) &&
+          (h->size == (int64_t)file->size));
+}
+
+// Writes an array to a cache file, padding it to a multiple of 8 bytes.
+static void write_cache_array(FILE* f, const void* data, size_t size)
+{
+  static const char padding[8] = {0};
+  if (size > 0)
+    fwrite(data, 1, size, f);
+  fwrite(padding, 1, cache_size(size) - size, f);
+}
+
+// Writes the tags in the given tagger to a cache file: the length of each 
+// tag's name and its number of indices, followed by the names and then the 
+// indices.
+static int write_cache_tags(FILE* f, tagger_t* tagger)
+{
+  int num_tags = 0, pos = 0, *indices;
+  char* name;
+  size_t size;
+  while (mesh_next_tag(tagger, &pos, &name, &indices, &size))
+    ++num_tags;
+
+  int sizes[2*MAX(1, num_tags)];
+  pos = 0;
+  for (int t = 0; mesh_next_tag(tagger, &pos, &name, &indices, &size); ++t)
+  {
+    sizes[2*t] = (int)strlen(name) + 1;
+    sizes[2*t+1] = (int)size;
+  }
+  write_cache_array(f, sizes, sizeof(int) * 2 * num_tags);
+  pos = 0;
+  while (mesh_next_tag(tagger, &pos, &name, &indices, &size))
+    write_cache_array(f, name, strlen(name) + 1);
+  pos = 0;
+  while (mesh_next_tag(tagger, &pos, &name, &indices, &size))
+    write_cache_array(f, indices, sizeof(int) * size);
+  return num_tags;
+}
+
+// Writes the given mesh to the given cache file.
+static void write_cache(mesh_t* mesh, 
+                        const char* cache_file, 
+                        tetgen_cache_header_t* header)
+{
+  // We write to a temporary file and move it into place when it's complete, 
+  // so that a partially-written cache is never read.
+  char temp_file[FILENAME_MAX];
+  snprintf(temp_file, FILENAME_MAX, "%s.tmp", cache_file);
+  FILE* f = fopen(temp_file, "wb");
+  if (f == NULL)
+  {
+    log_urgent("import_tetgen_mesh: Could not write cache file %s.", cache_file);
+    return;
+  }
+
+  // Reserve space for the header, which we write last.
+  write_cache_array(f, header, sizeof(tetgen_cache_header_t));
+
+  // Connectivity.
+  int num_cells = mesh->num_cells, num_faces = mesh->num_faces;
+  write_cache_array(f, mesh->cell_face_offsets, sizeof(int) * (num_cells+1));
+  write_cache_array(f, mesh->cell_faces, sizeof(int) * mesh->cell_face_offsets[num_cells]);
+  write_cache_array(f, mesh->face_node_offsets, sizeof(int) * (num_faces+1));
+  write_cache_array(f, mesh->face_nodes, sizeof(int) * mesh->face_node_offsets[num_faces]);
+  write_cache_array(f, mesh->face_edge_offsets, sizeof(int) * (num_faces+1));
+  write_cache_array(f, mesh->face_edges, sizeof(int) * mesh->face_edge_offsets[num_faces]);
+  write_cache_array(f, mesh->face_cells, sizeof(int) * 2 * num_faces);
+  write_cache_array(f, mesh->edge_nodes, sizeof(int) * 2 * mesh->num_edges);
+
+  // Geometry.
+  write_cache_array(f, mesh->nodes, sizeof(point_t) * mesh->num_nodes);
+  write_cache_array(f, mesh->cell_volumes, sizeof(real_t) * num_cells);
+  write_cache_array(f, mesh->cell_centers, sizeof(point_t) * num_cells);
+  write_cache_array(f, mesh->face_centers, sizeof(point_t) * num_faces);
+  write_cache_array(f, mesh->face_areas, sizeof(real_t) * num_faces);
+  write_cache_array(f, mesh->face_normals, sizeof(vector_t) * num_faces);
+
+  // Tags.
+  header->num_face_tags = write_cache_tags(f, mesh->face_tags);
+  header->num_cell_tags = write_cache_tags(f, mesh->cell_tags);
+
+  // The exchange of ghost cell data: the number of cells sent to and 
+  // received from each process, followed by their indices.
+  int nproc = header->nproc;
+  int counts[2*nproc];
+  memset(counts, 0, sizeof(int) * 2 * nproc);
+  exchanger_t* ex = (nproc > 1) ? mesh_exchanger(mesh) : NULL;
+  int pos, proc, *indices, num_indices;
+  if (ex != NULL)
+  {
+    pos = 0;
+    while (exchanger_next_send(ex, &pos, &proc, &indices, &num_indices))
+      counts[proc] = num_indices;
+    pos = 0;
+    while (exchanger_next_receive(ex, &pos, &proc, &indices, &num_indices))
+      counts[nproc+proc] = num_indices;
+  }
+  write_cache_array(f, counts, sizeof(int) * 2 * nproc);
+  for (int p = 0; p < nproc; ++p)
+  {
+    pos = 0;
+    while ((counts[p] > 0) && exchanger_next_send(ex, &pos, &proc, &indices, &num_indices))
     {
-      // If this is a "normal" attribute, we assign it to a tag.
-      if ((tets[t].attribute < max_num_attr) && (tets[t].attribute != -1))
-        attributes[tets[t].attribute]++;
-      // Otherwise it's probably something to do with adaptive resolution.
+      if (proc == p)
+        write_cache_array(f, indices, sizeof(int) * num_indices);
     }
-    int* cell_tags[max_num_attr];
-    for (int i = 0; i < max_num_attr; ++i)
+  }
+  for (int p = 0; p < nproc; ++p)
+  {
+    pos = 0;
+    while ((counts[nproc+p] > 0) && exchanger_next_receive(ex, &pos, &proc, &indices, &num_indices))
+    {
+      if (proc == p)
+        write_cache_array(f, indices, sizeof(int) * num_indices);
+    }
+  }
+
+  // Now the header.
+  header->num_cells = num_cells;
+  header->num_ghost_cells = mesh->num_ghost_cells;
+  header->num_faces = num_faces;
+  header->num_edges = mesh->num_edges;
+  header->num_nodes = mesh->num_nodes;
+  header->size = (int64_t)ftell(f);
+  fseek(f, 0, SEEK_SET);
+  fwrite(header, sizeof(tetgen_cache_header_t), 1, f);
+  bool written = (ferror(f) == 0);
+  written = (fclose(f) == 0) && written;
+  if (!written || (rename(temp_file, cache_file) != 0))
+  {
+    log_urgent("import_tetgen_mesh: Could not write cache file %s.", cache_file);
+    remove(temp_file);
+  }
+}
+
+// Returns the next array of the given size in a (valid) cache file, 
+// advancing the given offset past it.
+static inline const void* next_cache_array(mapped_file_t* file, 
+                                           size_t* offset, 
+                                           size_t size)
+{
+  const void* data = file->data + *offset;
+  *offset += cache_size(size);
+  ASSERT(*offset <= file->size);
+  return data;
+}
+
+// Reads the tags in a cache file into the given tagger.
+static void read_cache_tags(mapped_file_t* file, 
+                            size_t* offset, 
+                            int num_tags, 
+                            tagger_t* tagger)
+{
+  const int* sizes = next_cache_array(file, offset, sizeof(int) * 2 * num_tags);
+  const char* names[MAX(1, num_tags)];
+  for (int t = 0; t < num_tags; ++t)
+    names[t] = next_cache_array(file, offset, sizes[2*t]);
+  for (int t = 0; t < num_tags; ++t)
+  {
+    int* tag = mesh_create_tag(tagger, names[t], sizes[2*t+1]);
+    memcpy(tag, next_cache_array(file, offset, sizeof(int) * sizes[2*t+1]), 
+           sizeof(int) * sizes[2*t+1]);
+  }
+}
+
+// Creates a mesh from the given (valid) cache file.
+static mesh_t* read_cache(MPI_Comm comm, mapped_file_t* file)
+{
+  const tetgen_cache_header_t* header = (const tetgen_cache_header_t*)file->data;
+  int num_cells = header->num_cells, num_faces = header->num_faces;
+  size_t offset = cache_size(sizeof(tetgen_cache_header_t));
+
+  // Connectivity.
+  const int* cell_face_offsets = next_cache_array(file, &offset, sizeof(int) * (num_cells+1));
+  const int* cell_faces = next_cache_array(file, &offset, sizeof(int) * cell_face_offsets[num_cells]);
+  const int* face_node_offsets = next_cache_array(file, &offset, sizeof(int) * (num_faces+1));
+  const int* face_nodes = next_cache_array(file, &offset, sizeof(int) * face_node_offsets[num_faces]);
+  mesh_t* mesh = mesh_new_with_cell_type(comm, num_cells, header->num_ghost_cells, 
+                                         num_faces, header->num_nodes, 
+                                         cell_face_offsets[1], face_node_offsets[1]);
+  memcpy(mesh->cell_faces, cell_faces, sizeof(int) * cell_face_offsets[num_cells]);
+  memcpy(mesh->face_nodes, face_nodes, sizeof(int) * face_node_offsets[num_faces]);
+  mesh->face_edge_offsets = polymec_realloc(mesh->face_edge_offsets, sizeof(int) * (num_faces+1));
+  memcpy(mesh->face_edge_offsets, next_cache_array(file, &offset, sizeof(int) * (num_faces+1)), 
+         sizeof(int) * (num_faces+1));
+  size_t num_face_edges = mesh->face_edge_offsets[num_faces];
+  mesh->face_edges = polymec_realloc(mesh->face_edges, sizeof(int) * num_face_edges);
+  memcpy(mesh->face_edges, next_cache_array(file, &offset, sizeof(int) * num_face_edges), 
+         sizeof(int) * num_face_edges);
+  memcpy(mesh->face_cells, next_cache_array(file, &offset, sizeof(int) * 2 * num_faces), 
+         sizeof(int) * 2 * num_faces);
+  mesh->num_edges = header->num_edges;
+  mesh->edge_nodes = polymec_realloc(mesh->edge_nodes, sizeof(int) * 2 * mesh->num_edges);
+  memcpy(mesh->edge_nodes, next_cache_array(file, &offset, sizeof(int) * 2 * mesh->num_edges), 
+         sizeof(int) * 2 * mesh->num_edges);
+
+  // Geometry.
+  memcpy(mesh->nodes, next_cache_array(file, &offset, sizeof(point_t) * mesh->num_nodes), 
+         sizeof(point_t) * mesh->num_nodes);
+  memcpy(mesh->cell_volumes, next_cache_array(file, &offset, sizeof(real_t) * num_cells), 
+         sizeof(real_t) * num_cells);
+  memcpy(mesh->cell_centers, next_cache_array(file, &offset, sizeof(point_t) * num_cells), 
+         sizeof(point_t) * num_cells);
+  memcpy(mesh->face_centers, next_cache_array(file, &offset, sizeof(point_t) * num_faces), 
+         sizeof(point_t) * num_faces);
+  memcpy(mesh->face_areas, next_cache_array(file, &offset, sizeof(real_t) * num_faces), 
+         sizeof(real_t) * num_faces);
+  memcpy(mesh->face_normals, next_cache_array(file, &offset, sizeof(vector_t) * num_faces), 
+         sizeof(vector_t) * num_faces);
+
+  // Tags.
+  read_cache_tags(file, &offset, header->num_face_tags, mesh->face_tags);
+  read_cache_tags(file, &offset, header->num_cell_tags, mesh->cell_tags);
+
+  // The exchange of ghost cell data.
+  int nproc = header->nproc;
+  const int* counts = next_cache_array(file, &offset, sizeof(int) * 2 * nproc);
+  if (nproc > 1)
+  {
+    exchanger_t* ex = exchanger_new(comm);
+    for (int p = 0; p < nproc; ++p)
     {
-      if (attributes[i] > 0)
+      if (counts[p] > 0)
       {
-        char tag_name[16];
-        snprintf(tag_name, 16, "%d", i);
-        cell_tags[i] = mesh_create_tag(mesh->cell_tags, tag_name, attributes[i]);
+        const int* indices = next_cache_array(file, &offset, sizeof(int) * counts[p]);
+        exchanger_set_send(ex, p, (int*)indices, counts[p], true);
       }
     }
-    memset(attributes, 0, sizeof(int) * max_num_attr);
-    for (int t = 0; t < num_tets; ++t)
+    for (int p = 0; p < nproc; ++p)
     {
-      int a = tets[t].attribute;
-      if ((a < max_num_attr) && (a != -1))
+      if (counts[nproc+p] > 0)
       {
-        cell_tags[a][attributes[a]] = t;
-        attributes[a]++;
+        const int* indices = next_cache_array(file, &offset, sizeof(int) * counts[nproc+p]);
+        exchanger_set_receive(ex, p, (int*)indices, counts[nproc+p], true);
       }
     }
-
-    // Clean up.
-    polymec_free(nodes);
-    polymec_free(faces);
-    polymec_free(tets);
-    int_tuple_int_unordered_map_free(face_for_nodes);
+    mesh_set_exchanger(mesh, ex);
   }
 
-  // Partition the mesh (without weights).
-  migrator_t* distributor = partition_mesh(&mesh, comm, NULL, 0.05);
-  migrator_free(distributor);
-  
   mesh_add_feature(mesh, MESH_IS_TETRAHEDRAL);
   return mesh;
 }
 
+mesh_t* import_tetgen_mesh_with_cache(MPI_Comm comm, 
+                                      const char* node_file,
+                                      const char* ele_file,
+                                      const char* face_file,
+                                      const char* neigh_file,
+                                      const char* cache_prefix)
+{
+  tetgen_cache_header_t header;
+  const char* files[4] = {node_file, ele_file, face_file, neigh_file};
+  bool found_files = get_cache_header(comm, files, &header);
+  char cache_file[FILENAME_MAX];
+  snprintf(cache_file, FILENAME_MAX, "%s.%d.%d", cache_prefix, header.nproc, header.rank);
+
+  // We use the cache only if every process has a valid one.
+  mapped_file_t* file = found_files ? mapped_file_new(cache_file) : NULL;
+  int valid = cache_is_valid(file, &header), all_valid;
+  MPI_Allreduce(&valid, &all_valid, 1, MPI_INT, MPI_MIN, comm);
+  mesh_t* mesh;
+  if (all_valid)
+  {
+    log_detail("import_tetgen_mesh: Reading mesh from cache %s.", cache_file);
+    mesh = read_cache(comm, file);
+  }
+  else
+  {
+    mesh = import_tetgen_mesh(comm, node_file, ele_file, face_file, neigh_file);
+    if (found_files)
+      write_cache(mesh, cache_file, &header);
+  }
+  if (file != NULL)
+    mapped_file_free(file);
+  return mesh;
+}
@@ -12,14 +12,66 @@
 #include "core/point.h"
 
 // This function imports a mesh using .node, .ele, .face, and .neigh files 
-// created by TetGen. A global mesh is constructed on process 0 and is then 
-// partitioned onto the given communicator using an unweighted partitioning 
-// algorithm with a maximum load imbalance ratio of 0.05.
+// created by TetGen. No process reads the entire mesh: each process in the 
+// given communicator parses its own portion of each file, the tets are 
+// assigned to processes by splitting a space-filling curve through their 
+// centroids into equal pieces, and each process builds its own partition 
+// (with ghost cells) directly. The .face file must contain every face of 
+// the mesh (generate it with TetGen's -f option).
 mesh_t* import_tetgen_mesh(MPI_Comm comm, 
                            const char* node_file,
                            const char* ele_file,
                            const char* face_file,
                            const char* neigh_file);
 
+// Methods for partitioning an imported TetGen mesh.
+typedef enum
+{
+  TETGEN_SFC_PARTITION,  // Splits a space-filling curve through the tets 
+                         // into pieces of equal weight. This is fast, but 
+                         // cuts more faces than a graph partition.
+  TETGEN_GRAPH_PARTITION // Refines the space-filling curve partition with a 
+                         // graph partitioner, which reduces the number of 
+                         // cut faces but costs more time.
+} tetgen_partition_t;
+
+// This function works like import_tetgen_mesh, but balances the weights of 
+// the tets (rather than their numbers) across processes, partitioning them 
+// with the given method. If tet_weights is non-NULL, it holds the 
+// (non-negative) weight of each tet in the .ele file, in order, on every 
+// process, and num_tet_weights must be the number of tets. Otherwise, if 
+// attribute_weights is non-NULL, a tet with region attribute a (for 
+// 0 <= a < num_attributes) has weight attribute_weights[a]. All other tets 
+// have weight 1. imbalance_tol is the load imbalance tolerated by the graph 
+// partitioner: the space-filling curve partition balances weights to within 
+// the weight of a single tet. import_tetgen_mesh uses TETGEN_SFC_PARTITION 
+// with unit weights.
+mesh_t* import_tetgen_mesh_with_weights(MPI_Comm comm, 
+                                        const char* node_file,
+                                        const char* ele_file,
+                                        const char* face_file,
+                                        const char* neigh_file,
+                                        tetgen_partition_t partition,
+                                        int* tet_weights,
+                                        int num_tet_weights,
+                                        int num_attributes,
+                                        int* attribute_weights,
+                                        real_t imbalance_tol);
+
+// This function works like import_tetgen_mesh, but caches the imported mesh 
+// in binary files so that later imports of the same files (on the same 
+// number of processes) are fast. Each process stores its partition of the 
+// mesh (connectivity, geometry, tags, and ghost cell exchange) in the file 
+// <cache_prefix>.<nproc>.<rank>. A cache is used only if the sizes and 
+// modification times of the TetGen files match those recorded in it; 
+// otherwise the mesh is imported from the TetGen files and the cache is 
+// written.
+mesh_t* import_tetgen_mesh_with_cache(MPI_Comm comm, 
+                                      const char* node_file,
+                                      const char* ele_file,
+                                      const char* face_file,
+                                      const char* neigh_file,
+                                      const char* cache_prefix);
+
 #endif
 
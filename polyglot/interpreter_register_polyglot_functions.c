@@ -5,7 +5,9 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <limits.h>
 #include "polyglot/import_tetgen_mesh.h"
+#include "polyglot/create_voronoi_mesh.h"
 #include "polyglot/interpreter_register_polyglot_functions.h"
 #include "polyglot/exodus_file.h"
 
@@ -21,10 +23,15 @@ static int mesh_factory_tetgen(lua_State* lua)
 {
   // Check the arguments.
   int num_args = lua_gettop(lua);
-  if ((num_args != 1) || !lua_isstring(lua, 1))
+  if (((num_args != 1) && (num_args != 2)) || !lua_isstring(lua, 1) || 
+      ((num_args == 2) && !lua_istable(lua, 2)))
   {
     return luaL_error(lua, "Invalid argument(s). Usage:\n"
-                      "mesh = mesh_factory.tetgen(mesh_prefix).");
+                      "mesh = mesh_factory.tetgen(mesh_prefix) OR\n"
+                      "mesh = mesh_factory.tetgen(mesh_prefix, {partitioner = 'sfc' | 'graph',\n"
+                      "                                         weights = {w1, w2, ...},\n"
+                      "                                         region_weights = {[a1] = w1, ...},\n"
+                      "                                         imbalance_tol = tol}).");
   }
 
   // Use the mesh prefix to generate filenames.
@@ -34,8 +41,180 @@ static int mesh_factory_tetgen(lua_State* lua)
   snprintf(ele_file, 512, "%s.ele", mesh_prefix);
   snprintf(face_file, 512, "%s.face", mesh_prefix);
   snprintf(neigh_file, 512, "%s.neigh", mesh_prefix);
-  mesh_t* mesh = import_tetgen_mesh(MPI_COMM_WORLD, node_file, ele_file, 
-                                    face_file, neigh_file);
+
+  // Partitioning options.
+  tetgen_partition_t partition = TETGEN_SFC_PARTITION;
+  int* tet_weights = NULL;
+  int num_tet_weights = 0, num_attributes = 0;
+  int* attribute_weights = NULL;
+  real_t imbalance_tol = 0.05;
+  if (num_args == 2)
+  {
+    lua_getfield(lua, 2, "partitioner");
+    if (!lua_isnil(lua, -1))
+    {
+      const char* partitioner = lua_tostring(lua, -1);
+      if ((partitioner != NULL) && (strcmp(partitioner, "graph") == 0))
+        partition = TETGEN_GRAPH_PARTITION;
+      else if ((partitioner == NULL) || (strcmp(partitioner, "sfc") != 0))
+        return luaL_error(lua, "partitioner must be 'sfc' or 'graph'.");
+    }
+    lua_pop(lua, 1);
+
+    lua_getfield(lua, 2, "imbalance_tol");
+    if (!lua_isnil(lua, -1))
+    {
+      if (!lua_isnumber(lua, -1))
+        return luaL_error(lua, "imbalance_tol must be a number.");
+      imbalance_tol = (real_t)lua_tonumber(lua, -1);
+      if ((imbalance_tol <= 0.0) || (imbalance_tol >= 1.0))
+        return luaL_error(lua, "imbalance_tol must be between 0 and 1.");
+    }
+    lua_pop(lua, 1);
+
+    lua_getfield(lua, 2, "weights");
+    if (!lua_isnil(lua, -1))
+    {
+      if (!lua_issequence(lua, -1))
+        return luaL_error(lua, "weights must be a sequence of tet weights.");
+      real_t* weights = lua_tosequence(lua, -1, &num_tet_weights);
+      for (int i = 0; i < num_tet_weights; ++i)
+      {
+        if ((weights[i] < 0.0) || (weights[i] > INT_MAX) || (weights[i] != floor(weights[i])))
+        {
+          polymec_free(weights);
+          return luaL_error(lua, "weights must be non-negative integers (weight %d is %g).", 
+                            i+1, weights[i]);
+        }
+      }
+      tet_weights = polymec_malloc(sizeof(int) * MAX(1, num_tet_weights));
+      for (int i = 0; i < num_tet_weights; ++i)
+        tet_weights[i] = (int)weights[i];
+      polymec_free(weights);
+    }
+    lua_pop(lua, 1);
+
+    lua_getfield(lua, 2, "region_weights");
+    if (!lua_isnil(lua, -1))
+    {
+      if (!lua_istable(lua, -1))
+      {
+        if (tet_weights != NULL)
+          polymec_free(tet_weights);
+        return luaL_error(lua, "region_weights must be a table mapping region attributes to weights.");
+      }
+
+      // Find the largest attribute, then fill in the weights.
+      lua_pushnil(lua);
+      while (lua_next(lua, -2))
+      {
+        // Key is at index -2, value is at -1.
+        if (!lua_isnumber(lua, -2) || !lua_isnumber(lua, -1) || (lua_tonumber(lua, -2) < 0) || 
+            (lua_tonumber(lua, -1) < 0) || (lua_tonumber(lua, -1) > INT_MAX) || 
+            (lua_tonumber(lua, -1) != floor(lua_tonumber(lua, -1))))
+        {
+          if (tet_weights != NULL)
+            polymec_free(tet_weights);
+          return luaL_error(lua, "region_weights must map non-negative region attributes to non-negative integer weights.");
+        }
+        num_attributes = MAX(num_attributes, (int)lua_tonumber(lua, -2) + 1);
+        lua_pop(lua, 1);
+      }
+      attribute_weights = polymec_malloc(sizeof(int) * MAX(1, num_attributes));
+      for (int a = 0; a < num_attributes; ++a)
+        attribute_weights[a] = 1;
+      lua_pushnil(lua);
+      while (lua_next(lua, -2))
+      {
+        attribute_weights[(int)lua_tonumber(lua, -2)] = (int)lua_tonumber(lua, -1);
+        lua_pop(lua, 1);
+      }
+    }
+    lua_pop(lua, 1);
+  }
+
+  mesh_t* mesh = import_tetgen_mesh_with_weights(MPI_COMM_WORLD, node_file, ele_file, 
+                                                 face_file, neigh_file, partition, 
+                                                 tet_weights, num_tet_weights, num_attributes, 
+                                                 attribute_weights, imbalance_tol);
+  if (tet_weights != NULL)
+    polymec_free(tet_weights);
+  if (attribute_weights != NULL)
+    polymec_free(attribute_weights);
+
+  // Push the mesh onto the stack.
+  lua_pushmesh(lua, mesh);
+  return 1;
+}
+
+// CVT mesh factory method.
+static int mesh_factory_cvt(lua_State* lua)
+{
+  // Check the arguments.
+  int num_args = lua_gettop(lua);
+  if (((num_args != 2) && (num_args != 3)) || !lua_ispointlist(lua, 1) || 
+      !lua_isboundingbox(lua, 2) || ((num_args == 3) && !lua_istable(lua, 3)))
+  {
+    return luaL_error(lua, "Invalid argument(s). Usage:\n"
+                      "mesh = mesh_factory.cvt(generators, bounding_box) OR\n"
+                      "mesh = mesh_factory.cvt(generators, bounding_box, {iteration_method = 'lloyd',\n"
+                      "                                                  num_iterations = n,\n"
+                      "                                                  energy_tol = tol,\n"
+                      "                                                  displacement_tol = tol}).");
+  }
+
+  // Iteration options.
+  int num_iterations = 100;
+  real_t energy_tol = 1e-6, displacement_tol = 0.0;
+  if (num_args == 3)
+  {
+    lua_getfield(lua, 3, "iteration_method");
+    if (!lua_isnil(lua, -1))
+    {
+      const char* method = lua_tostring(lua, -1);
+      if ((method == NULL) || (strcmp(method, "lloyd") != 0))
+        return luaL_error(lua, "iteration_method must be 'lloyd'.");
+    }
+    lua_pop(lua, 1);
+
+    lua_getfield(lua, 3, "num_iterations");
+    if (!lua_isnil(lua, -1))
+    {
+      if (!lua_isnumber(lua, -1) || (lua_tonumber(lua, -1) < 0))
+        return luaL_error(lua, "num_iterations must be a non-negative number.");
+      num_iterations = (int)lua_tonumber(lua, -1);
+    }
+    lua_pop(lua, 1);
+
+    lua_getfield(lua, 3, "energy_tol");
+    if (!lua_isnil(lua, -1))
+    {
+      if (!lua_isnumber(lua, -1) || (lua_tonumber(lua, -1) < 0))
+        return luaL_error(lua, "energy_tol must be a non-negative number.");
+      energy_tol = (real_t)lua_tonumber(lua, -1);
+    }
+    lua_pop(lua, 1);
+
+    lua_getfield(lua, 3, "displacement_tol");
+    if (!lua_isnil(lua, -1))
+    {
+      if (!lua_isnumber(lua, -1) || (lua_tonumber(lua, -1) < 0))
+        return luaL_error(lua, "displacement_tol must be a non-negative number.");
+      displacement_tol = (real_t)lua_tonumber(lua, -1);
+    }
+    lua_pop(lua, 1);
+  }
+
+  // Iterate, and mesh the resulting generators.
+  int num_generators;
+  point_t* generators = lua_topointlist(lua, 1, &num_generators);
+  bbox_t* bbox = lua_toboundingbox(lua, 2);
+  cvt_iterator_t* cvt = cvt_iterator_new(generators, num_generators, bbox, NULL);
+  polymec_free(generators);
+  cvt_iterator_run(cvt, num_iterations, energy_tol, displacement_tol);
+  generators = cvt_iterator_generators(cvt, &num_generators);
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_WORLD, generators, num_generators, bbox);
+  cvt_iterator_free(cvt);
 
   // Push the mesh onto the stack.
   lua_pushmesh(lua, mesh);
@@ -269,6 +448,7 @@ void interpreter_register_polyglot_functions(interpreter_t* interp)
   if (!interpreter_has_global_table(interp, "mesh_factory"))
     interpreter_register_global_table(interp, "mesh_factory", NULL);
   interpreter_register_global_method(interp, "mesh_factory", "tetgen", mesh_factory_tetgen, NULL);
+  interpreter_register_global_method(interp, "mesh_factory", "cvt", mesh_factory_cvt, NULL);
 //  interpreter_register_global_method(interp, "mesh_factory", "pebi", mesh_factory_pebi, NULL);
 //  interpreter_register_global_method(interp, "mesh_factory", "dual", mesh_factory_dual, NULL);
   interpreter_register_function(interp, "read_exodus_mesh", lua_read_exodus_mesh, NULL);
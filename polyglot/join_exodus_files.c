@@ -0,0 +1,934 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <limits.h>
+#include "core/array.h"
+#include "polyglot/join_exodus_files.h"
+
+#if POLYMEC_HAVE_MPI
+#include "mpi.h"
+#endif
+
+// Number of entities read from (or written to) a file at once.
+#define CHUNK_SIZE 65536
+
+// Largest number of nodes per element we can join.
+#define MAX_NODES_PER_ELEM 27
+
+// Size in bytes of the largest datum we transfer for a single entity (the 
+// connectivity of an element).
+#define MAX_DATUM_SIZE (sizeof(int) * MAX_NODES_PER_ELEM)
+
+// Size in bytes of the header (task and chunk) of a chunk sent to the 
+// first process.
+#define CHUNK_HEADER_SIZE (2 * sizeof(int))
+
+// Number of node records buffered for each chunk of joined nodes when 
+// spilling node data.
+#define SPILL_BUFFER_SIZE 128
+
+// This type holds information about a single input file.
+typedef struct
+{
+  exodus_file_t* file; // Opened when first needed.
+  int num_nodes;
+  int* block_offsets; // Index of the first element of each block in the file.
+  int* block_sizes;   // Number of elements in each block in the file.
+  int* joined_offsets;// Index of the file's first element in each joined block.
+} join_input_t;
+
+// This type holds the state of a join.
+typedef struct
+{
+  MPI_Comm comm;
+  int rank, nprocs;
+  const char** filenames;
+  int num_inputs;
+  join_input_t* inputs;
+
+  // Joined mesh.
+  int num_nodes, num_elem, num_blocks;
+  char** block_names;
+  fe_mesh_element_t* elem_types;
+  int* block_sizes;
+  int* block_offsets;
+  int* num_nodes_per_elem;
+
+  // Numbers of chunks of joined nodes and elements. Each chunk of nodes has 
+  // a region of a spill file with a record for every input node that maps 
+  // to it, starting at the given record.
+  int num_node_chunks, num_elem_chunks;
+  int_array_t* node_chunk_counts;
+  size_t* node_chunk_offsets;
+
+  // Times and fields.
+  int num_times;
+  string_array_t* node_fields;
+  string_array_t* elem_fields;
+
+  // The node IDs of a single input file, used to map its connectivity.
+  int node_ids_input;
+  int* node_ids;
+
+  // Buffers for node IDs and data read from an input file, each holding a 
+  // single chunk, and for a chunk of assembled data (values), which follows 
+  // its header in a message.
+  int* ids;
+  char* chunk;
+  char* message;
+  char* values;
+} joiner_t;
+
+static void joiner_free(joiner_t* joiner)
+{
+  for (int f = 0; f < joiner->num_inputs; ++f)
+  {
+    join_input_t* input = &joiner->inputs[f];
+    if (input->file != NULL)
+      exodus_file_close(input->file);
+    if (input->block_offsets != NULL)
+    {
+      polymec_free(input->block_offsets);
+      polymec_free(input->block_sizes);
+      polymec_free(input->joined_offsets);
+    }
+  }
+  polymec_free(joiner->inputs);
+  if (joiner->block_names != NULL)
+  {
+    for (int b = 0; b < joiner->num_blocks; ++b)
+    {
+      if (joiner->block_names[b] != NULL)
+        string_free(joiner->block_names[b]);
+    }
+    polymec_free(joiner->block_names);
+    polymec_free(joiner->elem_types);
+    polymec_free(joiner->block_sizes);
+    polymec_free(joiner->block_offsets);
+    polymec_free(joiner->num_nodes_per_elem);
+  }
+  if (joiner->node_chunk_counts != NULL)
+    int_array_free(joiner->node_chunk_counts);
+  if (joiner->node_chunk_offsets != NULL)
+    polymec_free(joiner->node_chunk_offsets);
+  if (joiner->node_fields != NULL)
+    string_array_free(joiner->node_fields);
+  if (joiner->elem_fields != NULL)
+    string_array_free(joiner->elem_fields);
+  if (joiner->node_ids != NULL)
+    polymec_free(joiner->node_ids);
+  if (joiner->ids != NULL)
+  {
+    polymec_free(joiner->ids);
+    polymec_free(joiner->chunk);
+    polymec_free(joiner->message);
+  }
+}
+
+// Returns the given input file, opening it if we haven't already. Files 
+// that have been checked are expected to open.
+static exodus_file_t* input_file(joiner_t* joiner, int f)
+{
+  join_input_t* input = &joiner->inputs[f];
+  if (input->file == NULL)
+  {
+    input->file = exodus_file_open(MPI_COMM_SELF, joiner->filenames[f]);
+    if (input->file == NULL)
+      polymec_error("join_exodus_files: Could not open %s.", joiner->filenames[f]);
+  }
+  return input->file;
+}
+
+// Gathers the field names traversed by the given function.
+static string_array_t* field_names(exodus_file_t* file,
+                                   bool (*next_field)(exodus_file_t*, int*, char**))
+{
+  string_array_t* names = string_array_new();
+  int pos = 0;
+  char* name;
+  while (next_field(file, &pos, &name))
+    string_array_append_with_dtor(names, string_dup(name), string_free);
+  return names;
+}
+
+// Returns true if the two lists of names are identical.
+static bool names_match(string_array_t* names1, string_array_t* names2)
+{
+  if (names1->size != names2->size)
+    return false;
+  for (int i = 0; i < names1->size; ++i)
+  {
+    if (strcmp(names1->data[i], names2->data[i]) != 0)
+      return false;
+  }
+  return true;
+}
+
+// Opens the given input file, returning false (after logging the reason) if 
+// it can't be.
+static bool open_input(joiner_t* joiner, int f)
+{
+  const char* filename = joiner->filenames[f];
+  if (!file_exists(filename))
+  {
+    log_urgent("join_exodus_files: %s does not exist.", filename);
+    return false;
+  }
+  joiner->inputs[f].file = exodus_file_open(MPI_COMM_SELF, filename);
+  if (joiner->inputs[f].file == NULL)
+  {
+    log_urgent("join_exodus_files: Could not open %s.", filename);
+    return false;
+  }
+  return true;
+}
+
+// Reads the blocks, times, and fields of the joined mesh from the first 
+// input file. Returns false (after logging the reason) if it can't.
+static bool read_definitions(joiner_t* joiner)
+{
+  if (!open_input(joiner, 0))
+    return false;
+
+  exodus_file_t* file0 = joiner->inputs[0].file;
+  joiner->num_blocks = exodus_file_num_element_blocks(file0);
+  joiner->block_names = polymec_calloc(joiner->num_blocks, sizeof(char*));
+  joiner->elem_types = polymec_malloc(sizeof(fe_mesh_element_t) * joiner->num_blocks);
+  joiner->block_sizes = polymec_malloc(sizeof(int) * joiner->num_blocks);
+  joiner->block_offsets = polymec_malloc(sizeof(int) * joiner->num_blocks);
+  joiner->num_nodes_per_elem = polymec_malloc(sizeof(int) * joiner->num_blocks);
+  for (int b = 0; b < joiner->num_blocks; ++b)
+  {
+    char block_name[POLYGLOT_EXODUS_MAX_NAME+1];
+    exodus_file_get_element_block_name(file0, b, block_name);
+    joiner->block_names[b] = string_dup(block_name);
+    joiner->elem_types[b] = exodus_file_element_block_type(file0, b);
+    int num_elem;
+    exodus_file_get_element_block(file0, b, &num_elem, &joiner->num_nodes_per_elem[b]);
+    if (joiner->num_nodes_per_elem[b] == 0)
+    {
+      log_urgent("join_exodus_files: Can't join polyhedral block %s.", block_name);
+      return false;
+    }
+    if (joiner->num_nodes_per_elem[b] > MAX_NODES_PER_ELEM)
+    {
+      log_urgent("join_exodus_files: Block %s has more than %d nodes per element.", 
+                 block_name, MAX_NODES_PER_ELEM);
+      return false;
+    }
+    joiner->block_sizes[b] = 0;
+  }
+  joiner->num_times = exodus_file_num_times(file0);
+  joiner->node_fields = field_names(file0, exodus_file_next_node_field);
+  joiner->elem_fields = field_names(file0, exodus_file_next_element_field);
+  return true;
+}
+
+// Checks the given input file against the first, storing its number of 
+// nodes, its largest node index, and the sizes of its blocks in info, and 
+// counting its nodes in each chunk of joined nodes. Returns false (after 
+// logging the reason) if it can't be joined.
+static bool check_input(joiner_t* joiner, int f, int* info)
+{
+  const char** filenames = joiner->filenames;
+  if ((joiner->inputs[f].file == NULL) && !open_input(joiner, f))
+    return false;
+  exodus_file_t* file = joiner->inputs[f].file;
+  if (exodus_file_num_element_blocks(file) != joiner->num_blocks)
+  {
+    log_urgent("join_exodus_files: %s has %d element blocks (expected %d).",
+               filenames[f], exodus_file_num_element_blocks(file), joiner->num_blocks);
+    return false;
+  }
+  if (exodus_file_num_times(file) != joiner->num_times)
+  {
+    log_urgent("join_exodus_files: %s has %d times (expected %d).",
+               filenames[f], exodus_file_num_times(file), joiner->num_times);
+    return false;
+  }
+  string_array_t* node_fields = field_names(file, exodus_file_next_node_field);
+  string_array_t* elem_fields = field_names(file, exodus_file_next_element_field);
+  bool fields_match = names_match(node_fields, joiner->node_fields) &&
+                      names_match(elem_fields, joiner->elem_fields);
+  string_array_free(node_fields);
+  string_array_free(elem_fields);
+  if (!fields_match)
+  {
+    log_urgent("join_exodus_files: %s has different fields than %s.",
+               filenames[f], filenames[0]);
+    return false;
+  }
+
+  // Element blocks.
+  for (int b = 0; b < joiner->num_blocks; ++b)
+  {
+    char block_name[POLYGLOT_EXODUS_MAX_NAME+1];
+    exodus_file_get_element_block_name(file, b, block_name);
+    int num_nodes_per_elem;
+    exodus_file_get_element_block(file, b, &info[2+b], &num_nodes_per_elem);
+    if ((strcmp(block_name, joiner->block_names[b]) != 0) ||
+        ((info[2+b] > 0) && (num_nodes_per_elem != joiner->num_nodes_per_elem[b])))
+    {
+      log_urgent("join_exodus_files: Block %d in %s doesn't match that in %s.",
+                 b+1, filenames[f], filenames[0]);
+      return false;
+    }
+  }
+
+  // Node IDs, which identify shared nodes.
+  int_array_t* counts = joiner->node_chunk_counts;
+  int num_nodes = exodus_file_num_nodes(file);
+  info[0] = num_nodes;
+  info[1] = -1;
+  for (int n = 0; n < num_nodes; n += CHUNK_SIZE)
+  {
+    int count = MIN(CHUNK_SIZE, num_nodes - n);
+    exodus_file_read_node_ids(file, n, count, joiner->ids);
+    for (int i = 0; i < count; ++i)
+    {
+      if (joiner->ids[i] <= 0)
+      {
+        log_urgent("join_exodus_files: %s has an invalid node ID.", filenames[f]);
+        return false;
+      }
+      int node = joiner->ids[i] - 1, k = node / CHUNK_SIZE;
+      info[1] = MAX(info[1], node);
+      while (counts->size <= k)
+        int_array_append(counts, 0);
+      ++counts->data[k];
+    }
+  }
+  return true;
+}
+
+// Checks the input files, dividing them among the processes, and fills in 
+// the layout of the joined mesh. All processes return false (after the 
+// reason is logged) if the files can't be joined.
+static bool check_inputs(joiner_t* joiner)
+{
+  // Every process reads the definitions from the first file, so they all 
+  // agree on whether it's usable.
+  if (!read_definitions(joiner))
+    return false;
+
+  // Each process checks its share of the files. The information for the 
+  // files checked elsewhere is left at INT_MIN so that we can combine it 
+  // by taking maxima.
+  int info_size = 2 + joiner->num_blocks;
+  int* info = polymec_malloc(sizeof(int) * joiner->num_inputs * info_size);
+  for (int i = 0; i < joiner->num_inputs * info_size; ++i)
+    info[i] = INT_MIN;
+  bool ok = true;
+  for (int f = joiner->rank; f < joiner->num_inputs; f += joiner->nprocs)
+  {
+    ok = check_input(joiner, f, &info[info_size*f]);
+    if (!ok) break;
+  }
+#if POLYMEC_HAVE_MPI
+  if (joiner->nprocs > 1)
+  {
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_C_BOOL, MPI_LAND, joiner->comm);
+    if (ok)
+    {
+      MPI_Allreduce(MPI_IN_PLACE, info, joiner->num_inputs * info_size, 
+                    MPI_INT, MPI_MAX, joiner->comm);
+    }
+  }
+#endif
+  if (!ok)
+  {
+    polymec_free(info);
+    return false;
+  }
+
+  joiner->num_nodes = 0;
+  for (int f = 0; f < joiner->num_inputs; ++f)
+  {
+    join_input_t* input = &joiner->inputs[f];
+    int* file_info = &info[info_size*f];
+    input->num_nodes = file_info[0];
+    joiner->num_nodes = MAX(joiner->num_nodes, file_info[1] + 1);
+
+    input->block_offsets = polymec_malloc(sizeof(int) * joiner->num_blocks);
+    input->block_sizes = polymec_malloc(sizeof(int) * joiner->num_blocks);
+    input->joined_offsets = polymec_malloc(sizeof(int) * joiner->num_blocks);
+    int offset = 0;
+    for (int b = 0; b < joiner->num_blocks; ++b)
+    {
+      input->block_sizes[b] = file_info[2+b];
+      input->block_offsets[b] = offset;
+      offset += input->block_sizes[b];
+      input->joined_offsets[b] = joiner->block_sizes[b];
+      joiner->block_sizes[b] += input->block_sizes[b];
+    }
+  }
+  polymec_free(info);
+
+  joiner->num_elem = 0;
+  joiner->num_elem_chunks = 0;
+  for (int b = 0; b < joiner->num_blocks; ++b)
+  {
+    joiner->block_offsets[b] = joiner->num_elem;
+    joiner->num_elem += joiner->block_sizes[b];
+    joiner->num_elem_chunks += (joiner->block_sizes[b] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  }
+
+  // Lay out the regions of node spill files.
+  int_array_t* counts = joiner->node_chunk_counts;
+  joiner->num_node_chunks = (joiner->num_nodes + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  while (counts->size < joiner->num_node_chunks)
+    int_array_append(counts, 0);
+#if POLYMEC_HAVE_MPI
+  if ((joiner->nprocs > 1) && (joiner->num_node_chunks > 0))
+  {
+    MPI_Allreduce(MPI_IN_PLACE, counts->data, joiner->num_node_chunks, 
+                  MPI_INT, MPI_SUM, joiner->comm);
+  }
+#endif
+  joiner->node_chunk_offsets = polymec_malloc(sizeof(size_t) * (joiner->num_node_chunks + 1));
+  joiner->node_chunk_offsets[0] = 0;
+  for (int k = 0; k < joiner->num_node_chunks; ++k)
+    joiner->node_chunk_offsets[k+1] = joiner->node_chunk_offsets[k] + counts->data[k];
+  return true;
+}
+
+// The joined data are produced in tasks, each of which assembles one kind 
+// of data for all of the joined nodes or elements, a chunk at a time: node 
+// positions, element connectivity, element IDs, and then each node and 
+// element field at each time. Tasks are numbered in this order.
+typedef struct join_task_t join_task_t;
+
+// Functions that read data for a range of nodes in an input file, for a 
+// range of elements in a block of an input file, and that write data for 
+// a range of joined nodes (in which case b is ignored) or elements in a 
+// joined block.
+typedef bool (*node_reader_t)(exodus_file_t* file, join_task_t* task, int start, int count, void* data);
+typedef void (*element_reader_t)(joiner_t* joiner, int f, join_task_t* task, int b, int start, int count, void* data);
+typedef void (*data_writer_t)(exodus_file_t* out, join_task_t* task, int b, int start, int count, void* data);
+
+struct join_task_t
+{
+  joiner_t* joiner;
+  bool nodes;     // True for node data, false for element data.
+  size_t size;    // Size of the datum for each entity (or element node).
+  bool per_node;  // True if elements have a datum for each of their nodes.
+  node_reader_t read_nodes;
+  element_reader_t read_elements;
+  data_writer_t write;
+
+  // The field and time index, for field tasks.
+  const char* field_name;
+  int time_index;
+};
+
+static bool read_node_positions(exodus_file_t* file, join_task_t* task, int start, int count, void* data)
+{
+  exodus_file_read_node_positions(file, start, count, data);
+  return true;
+}
+
+static void write_node_positions(exodus_file_t* out, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_write_node_positions(out, start, count, data);
+}
+
+// Returns the node IDs of the given input file, reading them if they're 
+// not the ones we hold. Elements are joined in order of input file within 
+// each block, so each file's IDs are read once per block.
+static int* input_node_ids(joiner_t* joiner, int f)
+{
+  if (joiner->node_ids_input != f)
+  {
+    join_input_t* input = &joiner->inputs[f];
+    exodus_file_t* file = input_file(joiner, f);
+    joiner->node_ids = polymec_realloc(joiner->node_ids, sizeof(int) * MAX(input->num_nodes, 1));
+    for (int n = 0; n < input->num_nodes; n += CHUNK_SIZE)
+    {
+      int count = MIN(CHUNK_SIZE, input->num_nodes - n);
+      exodus_file_read_node_ids(file, n, count, &joiner->node_ids[n]);
+    }
+    joiner->node_ids_input = f;
+  }
+  return joiner->node_ids;
+}
+
+// Reads the connectivity of elements in a block of an input file, mapping 
+// their nodes to joined ones with the file's node IDs.
+static void read_element_nodes(joiner_t* joiner, int f, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_t* file = input_file(joiner, f);
+  int* nodes = data;
+  exodus_file_read_element_block_nodes(file, b, start, count, nodes);
+  int* ids = input_node_ids(joiner, f);
+  int num_entries = count * joiner->num_nodes_per_elem[b];
+  for (int i = 0; i < num_entries; ++i)
+  {
+    ASSERT((nodes[i] >= 0) && (nodes[i] < joiner->inputs[f].num_nodes));
+    nodes[i] = ids[nodes[i]] - 1;
+  }
+}
+
+static void write_element_nodes(exodus_file_t* out, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_write_element_block_nodes(out, b, start, count, data);
+}
+
+static void read_element_ids(joiner_t* joiner, int f, join_task_t* task, int b, int start, int count, void* data)
+{
+  join_input_t* input = &joiner->inputs[f];
+  exodus_file_read_element_ids(input_file(joiner, f), input->block_offsets[b] + start, count, data);
+}
+
+static void write_element_ids(exodus_file_t* out, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_write_element_ids(out, task->joiner->block_offsets[b] + start, count, data);
+}
+
+static bool read_node_field(exodus_file_t* file, join_task_t* task, int start, int count, void* data)
+{
+  return exodus_file_read_node_field_values(file, task->time_index, task->field_name, 
+                                            start, count, data);
+}
+
+static void write_node_field(exodus_file_t* out, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_write_node_field_values(out, task->time_index, task->field_name, 
+                                      start, count, data);
+}
+
+// Fields not defined on a block are left zero.
+static void read_element_field(joiner_t* joiner, int f, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_read_element_field_values(input_file(joiner, f), task->time_index, 
+                                        task->field_name, b, start, count, data);
+}
+
+static void write_element_field(exodus_file_t* out, join_task_t* task, int b, int start, int count, void* data)
+{
+  exodus_file_write_element_field_values(out, task->time_index, task->field_name, 
+                                         b, start, count, data);
+}
+
+// Returns the number of tasks in the join.
+static int num_tasks(joiner_t* joiner)
+{
+  int num_fields = (int)(joiner->node_fields->size + joiner->elem_fields->size);
+  return 3 + joiner->num_times * num_fields;
+}
+
+// Returns the process that performs the given task. If we have more than 
+// one process, the first writes the joined file while the others perform 
+// the tasks in turn.
+static int task_owner(joiner_t* joiner, int t)
+{
+  return (joiner->nprocs == 1) ? 0 : 1 + t % (joiner->nprocs - 1);
+}
+
+// Fills in the given task.
+static void get_task(joiner_t* joiner, int t, join_task_t* task)
+{
+  memset(task, 0, sizeof(join_task_t));
+  task->joiner = joiner;
+  if (t == 0)
+  {
+    task->nodes = true;
+    task->size = sizeof(point_t);
+    task->read_nodes = read_node_positions;
+    task->write = write_node_positions;
+  }
+  else if (t == 1)
+  {
+    task->size = sizeof(int);
+    task->per_node = true;
+    task->read_elements = read_element_nodes;
+    task->write = write_element_nodes;
+  }
+  else if (t == 2)
+  {
+    task->size = sizeof(int);
+    task->read_elements = read_element_ids;
+    task->write = write_element_ids;
+  }
+  else
+  {
+    int num_node_fields = (int)joiner->node_fields->size;
+    int num_fields = num_node_fields + (int)joiner->elem_fields->size;
+    int i = (t - 3) % num_fields;
+    task->time_index = 1 + (t - 3) / num_fields;
+    task->size = sizeof(real_t);
+    if (i < num_node_fields)
+    {
+      task->nodes = true;
+      task->field_name = joiner->node_fields->data[i];
+      task->read_nodes = read_node_field;
+      task->write = write_node_field;
+    }
+    else
+    {
+      task->field_name = joiner->elem_fields->data[i - num_node_fields];
+      task->read_elements = read_element_field;
+      task->write = write_element_field;
+    }
+  }
+}
+
+// Returns the number of chunks of data assembled for the given task.
+static int num_task_chunks(joiner_t* joiner, join_task_t* task)
+{
+  return (task->nodes) ? joiner->num_node_chunks : joiner->num_elem_chunks;
+}
+
+// Finds the kth chunk of the joined nodes.
+static void find_node_chunk(joiner_t* joiner, int k, int* start, int* count)
+{
+  *start = k * CHUNK_SIZE;
+  *count = MIN(CHUNK_SIZE, joiner->num_nodes - *start);
+}
+
+// Finds the kth chunk of the joined elements, which lies within block *b 
+// and starts at its element *start. Chunks don't span blocks.
+static void find_element_chunk(joiner_t* joiner, int k, int* b, int* start, int* count)
+{
+  for (int bb = 0; bb < joiner->num_blocks; ++bb)
+  {
+    int num_chunks = (joiner->block_sizes[bb] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (k < num_chunks)
+    {
+      *b = bb;
+      *start = k * CHUNK_SIZE;
+      *count = MIN(CHUNK_SIZE, joiner->block_sizes[bb] - *start);
+      return;
+    }
+    k -= num_chunks;
+  }
+  ASSERT(false);
+}
+
+// Returns the size in bytes of the kth chunk of data for the given task, 
+// storing its block (for elements), first entity, and number of entities.
+static size_t find_task_chunk(joiner_t* joiner, join_task_t* task, int k, int* b, int* start, int* count)
+{
+  if (task->nodes)
+  {
+    *b = -1;
+    find_node_chunk(joiner, k, start, count);
+    return task->size * (*count);
+  }
+  find_element_chunk(joiner, k, b, start, count);
+  size_t elem_size = (task->per_node) ? task->size * joiner->num_nodes_per_elem[*b] : task->size;
+  ASSERT(elem_size <= MAX_DATUM_SIZE);
+  return elem_size * (*count);
+}
+
+// Hands the assembled kth chunk of task t (in joiner->values) to the first 
+// process, or writes it if we are the first process.
+static void deliver_chunk(joiner_t* joiner, exodus_file_t* out, int t, join_task_t* task, int k)
+{
+  int b, start, count;
+  size_t size = find_task_chunk(joiner, task, k, &b, &start, &count);
+  if (joiner->rank == 0)
+    task->write(out, task, b, start, count, joiner->values);
+#if POLYMEC_HAVE_MPI
+  else
+  {
+    int* header = (int*)joiner->message;
+    header[0] = t;
+    header[1] = k;
+    MPI_Send(joiner->message, (int)(CHUNK_HEADER_SIZE + size), MPI_BYTE, 0, 0, joiner->comm);
+  }
+#endif
+}
+
+// Writes the records buffered for the kth chunk of joined nodes to its 
+// region of the given spill file.
+static void flush_spill_buffer(joiner_t* joiner, 
+                               FILE* spill, 
+                               size_t record_size, 
+                               int k, 
+                               char* buffer, 
+                               int* num_buffered, 
+                               size_t* num_written)
+{
+  if (num_buffered[k] == 0) return;
+  long offset = (long)(record_size * (joiner->node_chunk_offsets[k] + num_written[k]));
+  if ((fseek(spill, offset, SEEK_SET) != 0) || 
+      (fwrite(buffer, record_size, num_buffered[k], spill) != (size_t)num_buffered[k]))
+    polymec_error("join_exodus_files: Could not write temporary node data.");
+  num_written[k] += num_buffered[k];
+  num_buffered[k] = 0;
+}
+
+// Joins node data for a task. Each input file is read once, in order, and 
+// a record (joined node, datum) for each of its nodes is written to the 
+// region of a spill file for the chunk of joined nodes that holds it. 
+// Each chunk is then assembled from its region, so shared nodes take their 
+// data from the last file that has them, and nodes that appear in no file 
+// are zeroed.
+static void join_node_task(joiner_t* joiner, exodus_file_t* out, int t, join_task_t* task)
+{
+  ASSERT(task->size <= MAX_DATUM_SIZE);
+  int num_chunks = joiner->num_node_chunks;
+  if (num_chunks == 0) return;
+  FILE* spill = tmpfile();
+  if (spill == NULL)
+    polymec_error("join_exodus_files: Could not create a temporary file.");
+  size_t size = task->size, record_size = sizeof(int) + size;
+  size_t buffer_size = record_size * SPILL_BUFFER_SIZE;
+  char* buffers = polymec_malloc(buffer_size * num_chunks);
+  int* num_buffered = polymec_calloc(num_chunks, sizeof(int));
+  size_t* num_written = polymec_calloc(num_chunks, sizeof(size_t));
+
+  for (int f = 0; f < joiner->num_inputs; ++f)
+  {
+    join_input_t* input = &joiner->inputs[f];
+    exodus_file_t* file = input_file(joiner, f);
+    for (int n = 0; n < input->num_nodes; n += CHUNK_SIZE)
+    {
+      int count = MIN(CHUNK_SIZE, input->num_nodes - n);
+      if (!task->read_nodes(file, task, n, count, joiner->chunk))
+        continue;
+      exodus_file_read_node_ids(file, n, count, joiner->ids);
+      for (int i = 0; i < count; ++i)
+      {
+        int node = joiner->ids[i] - 1, k = node / CHUNK_SIZE;
+        char* record = &buffers[buffer_size * k + record_size * num_buffered[k]];
+        memcpy(record, &node, sizeof(int));
+        memcpy(&record[sizeof(int)], &joiner->chunk[size * i], size);
+        if (++num_buffered[k] == SPILL_BUFFER_SIZE)
+          flush_spill_buffer(joiner, spill, record_size, k, &buffers[buffer_size * k], num_buffered, num_written);
+      }
+    }
+  }
+  for (int k = 0; k < num_chunks; ++k)
+    flush_spill_buffer(joiner, spill, record_size, k, &buffers[buffer_size * k], num_buffered, num_written);
+  polymec_free(buffers);
+  polymec_free(num_buffered);
+
+  // Assemble the chunks.
+  size_t max_records = (MAX_DATUM_SIZE * CHUNK_SIZE) / record_size;
+  for (int k = 0; k < num_chunks; ++k)
+  {
+    int start, count;
+    find_node_chunk(joiner, k, &start, &count);
+    memset(joiner->values, 0, size * count);
+    long offset = (long)(record_size * joiner->node_chunk_offsets[k]);
+    if (fseek(spill, offset, SEEK_SET) != 0)
+      polymec_error("join_exodus_files: Could not read temporary node data.");
+    for (size_t r = 0; r < num_written[k]; r += max_records)
+    {
+      size_t num_records = MIN(max_records, num_written[k] - r);
+      if (fread(joiner->chunk, record_size, num_records, spill) != num_records)
+        polymec_error("join_exodus_files: Could not read temporary node data.");
+      for (size_t i = 0; i < num_records; ++i)
+      {
+        char* record = &joiner->chunk[record_size * i];
+        int node;
+        memcpy(&node, record, sizeof(int));
+        memcpy(&joiner->values[size * (node - start)], &record[sizeof(int)], size);
+      }
+    }
+    deliver_chunk(joiner, out, t, task, k);
+  }
+  polymec_free(num_written);
+  fclose(spill);
+}
+
+// Joins element data for a task. Each chunk of joined elements is assembled 
+// from the input files that hold some of them.
+static void join_element_task(joiner_t* joiner, exodus_file_t* out, int t, join_task_t* task)
+{
+  for (int k = 0; k < joiner->num_elem_chunks; ++k)
+  {
+    int b, start, count;
+    size_t size = find_task_chunk(joiner, task, k, &b, &start, &count);
+    size_t elem_size = size / count;
+    memset(joiner->values, 0, size);
+    for (int f = 0; f < joiner->num_inputs; ++f)
+    {
+      join_input_t* input = &joiner->inputs[f];
+      int first = MAX(start, input->joined_offsets[b]);
+      int last = MIN(start + count, input->joined_offsets[b] + input->block_sizes[b]);
+      if (first < last)
+      {
+        task->read_elements(joiner, f, task, b, first - input->joined_offsets[b], last - first, 
+                            &joiner->values[elem_size * (first - start)]);
+      }
+    }
+    deliver_chunk(joiner, out, t, task, k);
+  }
+}
+
+// Receives the chunks assembled by the other processes and writes them, in 
+// whatever order they arrive.
+static void receive_chunks(joiner_t* joiner, exodus_file_t* out)
+{
+#if POLYMEC_HAVE_MPI
+  int num_chunks = 0, n = num_tasks(joiner);
+  join_task_t task;
+  for (int t = 0; t < n; ++t)
+  {
+    get_task(joiner, t, &task);
+    num_chunks += num_task_chunks(joiner, &task);
+  }
+  int max_size = (int)(CHUNK_HEADER_SIZE + MAX_DATUM_SIZE * CHUNK_SIZE);
+  for (int i = 0; i < num_chunks; ++i)
+  {
+    MPI_Recv(joiner->message, max_size, MPI_BYTE, MPI_ANY_SOURCE, 0, 
+             joiner->comm, MPI_STATUS_IGNORE);
+    int* header = (int*)joiner->message;
+    get_task(joiner, header[0], &task);
+    int b, start, count;
+    find_task_chunk(joiner, &task, header[1], &b, &start, &count);
+    task.write(out, &task, b, start, count, joiner->values);
+  }
+#endif
+}
+
+// Writes the joined mesh definition and node IDs to the given file.
+static void write_mesh(joiner_t* joiner, exodus_file_t* out)
+{
+  exodus_file_define_mesh(out, joiner->num_nodes, joiner->num_blocks,
+                          (const char**)joiner->block_names, joiner->elem_types,
+                          joiner->block_sizes, joiner->num_nodes_per_elem);
+  for (int n = 0; n < joiner->num_nodes; n += CHUNK_SIZE)
+  {
+    int count = MIN(CHUNK_SIZE, joiner->num_nodes - n);
+    for (int i = 0; i < count; ++i)
+      joiner->ids[i] = n + i + 1;
+    exodus_file_write_node_ids(out, n, count, joiner->ids);
+  }
+}
+
+// Writes the times and global variables (which are the same in every input
+// file) to the joined file.
+static void write_times(joiner_t* joiner, exodus_file_t* out)
+{
+  exodus_file_t* file0 = joiner->inputs[0].file;
+  int pos = 0, time_index;
+  real_t time;
+  while (exodus_file_next_time(file0, &pos, &time_index, &time))
+    exodus_file_write_time(out, time);
+
+  int num_vars = exodus_file_num_global_vars(file0);
+  if (num_vars > 0)
+  {
+    const char* var_names[num_vars];
+    real_t* histories[num_vars];
+    char* name;
+    int num_times;
+    pos = 0;
+    for (int v = 0; v < num_vars; ++v)
+    {
+      exodus_file_next_global_var(file0, &pos, &name);
+      var_names[v] = name;
+      histories[v] = exodus_file_read_global_var_history(file0, name, &num_times);
+    }
+    exodus_file_define_global_vars(out, num_vars, var_names);
+    real_t values[num_vars];
+    for (int t = 0; t < joiner->num_times; ++t)
+    {
+      for (int v = 0; v < num_vars; ++v)
+        values[v] = histories[v][t];
+      exodus_file_write_global_vars(out, t+1, values);
+    }
+    for (int v = 0; v < num_vars; ++v)
+      polymec_free(histories[v]);
+  }
+}
+
+bool join_exodus_files(MPI_Comm comm,
+                       int num_files,
+                       const char** filenames,
+                       const char* joined_filename)
+{
+  ASSERT(num_files > 0);
+
+  joiner_t joiner;
+  memset(&joiner, 0, sizeof(joiner_t));
+  joiner.comm = comm;
+  joiner.rank = 0;
+  joiner.nprocs = 1;
+  MPI_Comm_rank(comm, &joiner.rank);
+  MPI_Comm_size(comm, &joiner.nprocs);
+  joiner.filenames = filenames;
+  joiner.num_inputs = num_files;
+  joiner.inputs = polymec_calloc(num_files, sizeof(join_input_t));
+  joiner.node_chunk_counts = int_array_new();
+  joiner.node_ids_input = -1;
+  joiner.ids = polymec_malloc(sizeof(int) * CHUNK_SIZE);
+  joiner.chunk = polymec_malloc(MAX_DATUM_SIZE * CHUNK_SIZE);
+  joiner.message = polymec_malloc(CHUNK_HEADER_SIZE + MAX_DATUM_SIZE * CHUNK_SIZE);
+  joiner.values = joiner.message + CHUNK_HEADER_SIZE;
+
+  // The processes check the input files between them, so all processes
+  // agree on whether they can be joined.
+  bool ok = check_inputs(&joiner);
+
+  // The first process creates the joined file and writes the mesh 
+  // definition and times, and defines the fields.
+  exodus_file_t* out = NULL;
+  if (ok && (joiner.rank == 0))
+  {
+    out = exodus_file_new(MPI_COMM_SELF, joined_filename);
+    if (out != NULL)
+    {
+      exodus_file_set_title(out, exodus_file_title(joiner.inputs[0].file));
+      write_mesh(&joiner, out);
+      write_times(&joiner, out);
+      if (joiner.node_fields->size > 0)
+      {
+        exodus_file_define_node_fields(out, (int)joiner.node_fields->size,
+                                       (const char**)joiner.node_fields->data);
+      }
+      if (joiner.elem_fields->size > 0)
+      {
+        exodus_file_define_element_fields(out, (int)joiner.elem_fields->size,
+                                          (const char**)joiner.elem_fields->data);
+      }
+    }
+    else
+    {
+      log_urgent("join_exodus_files: Could not create %s.", joined_filename);
+      ok = false;
+    }
+  }
+#if POLYMEC_HAVE_MPI
+  if (joiner.nprocs > 1)
+    MPI_Bcast(&ok, 1, MPI_C_BOOL, 0, comm);
+#endif
+  if (!ok)
+  {
+    joiner_free(&joiner);
+    return false;
+  }
+
+  // Now we perform the tasks: the node positions, connectivity, and element 
+  // IDs, then the fields time step by time step. With several processes, 
+  // the others work on different tasks (and so different time steps) at 
+  // once while the first writes their chunks.
+  if ((joiner.nprocs > 1) && (joiner.rank == 0))
+    receive_chunks(&joiner, out);
+  else
+  {
+    int n = num_tasks(&joiner);
+    for (int t = 0; t < n; ++t)
+    {
+      if (task_owner(&joiner, t) != joiner.rank) continue;
+      join_task_t task;
+      get_task(&joiner, t, &task);
+      if (task.nodes)
+        join_node_task(&joiner, out, t, &task);
+      else
+        join_element_task(&joiner, out, t, &task);
+    }
+  }
+
+  if (out != NULL)
+    exodus_file_close(out);
+  joiner_free(&joiner);
+  return true;
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYGLOT_JOIN_EXODUS_FILES_H
+#define POLYGLOT_JOIN_EXODUS_FILES_H
+
+#include "polyglot/exodus_file.h"
+
+// Joins a set of Exodus files, each of which holds the portion of a
+// distributed mesh (and its fields) belonging to one process, into a single
+// Exodus file with the given name. Nodes shared by several files are
+// identified by their global node IDs, which must number the nodes of the
+// whole mesh from 1 to N. Elements are written block by block, in the order
+// of the input files, and keep their global element IDs. Every input file
+// must have the same (non-polyhedral) element blocks, times, and fields.
+// Entity sets are not joined.
+//
+// The input files are checked by the processes in the given communicator
+// in turn. The joined data are then assembled in tasks (the node positions,
+// the connectivity, the element IDs, and each field at each time), which
+// the processes other than the first take in turn, so that different time
+// steps are assembled at once. Each task reads every input file once, in
+// fixed-size chunks, and sends the joined data in chunks to the first
+// process, which writes them. Node data are routed to their joined nodes
+// through a temporary file, and connectivity is mapped with the node IDs
+// of one input file at a time, so memory use grows only with the size of
+// the largest input file and the number of chunks. Returns true if the
+// files were joined, false if they could not be.
+bool join_exodus_files(MPI_Comm comm,
+                       int num_files,
+                       const char** filenames,
+                       const char* joined_filename);
+
+#endif
@@ -0,0 +1,846 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <unistd.h>
+#include "core/array.h"
+#include "core/thread_pool.h"
+#include "polyglot/latlon_regridder.h"
+
+// Targets handled by each thread when a regridder is applied.
+#define MIN_TARGETS_PER_THREAD 1024
+
+// Identifies regridder cache files.
+static const char cache_magic[8] = {'P', 'G', 'R', 'E', 'G', 'R', 'I', 'D'};
+#define CACHE_VERSION 1
+
+struct latlon_regridder_t
+{
+  uint64_t fingerprint;
+  int num_sources, num_targets;
+
+  // The remap matrix, stored in compressed row format: the weights for
+  // target i are weights[offsets[i]..offsets[i+1]-1], and apply to the
+  // grid points with the corresponding (lat-major) indices in columns.
+  int* offsets;
+  int* columns;
+  real_t* weights;
+
+  // Threads used to apply the regridder (NULL if we apply it serially).
+  thread_pool_t* threads;
+  int num_threads;
+};
+
+// Computes the 64-bit FNV-1a hash of the given bytes, starting from the
+// given hash.
+static uint64_t fnv1a(uint64_t hash, const void* bytes, size_t num_bytes)
+{
+  const unsigned char* b = bytes;
+  for (size_t i = 0; i < num_bytes; ++i)
+  {
+    hash ^= (uint64_t)b[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t compute_fingerprint(latlon_regrid_method_t method,
+                                    int num_lat_points,
+                                    real_t* lat_points,
+                                    int num_lon_points,
+                                    real_t* lon_points,
+                                    int num_targets,
+                                    point_t* target_points,
+                                    bbox_t* target_cells,
+                                    int* polygon_offsets,
+                                    point_t* polygon_vertices)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  int m = (int)method;
+  hash = fnv1a(hash, &m, sizeof(int));
+  hash = fnv1a(hash, &num_lat_points, sizeof(int));
+  hash = fnv1a(hash, lat_points, sizeof(real_t) * num_lat_points);
+  hash = fnv1a(hash, &num_lon_points, sizeof(int));
+  hash = fnv1a(hash, lon_points, sizeof(real_t) * num_lon_points);
+  hash = fnv1a(hash, &num_targets, sizeof(int));
+  for (int i = 0; i < num_targets; ++i)
+  {
+    if (method == LATLON_REGRID_BILINEAR)
+    {
+      real_t xy[2] = {target_points[i].x, target_points[i].y};
+      hash = fnv1a(hash, xy, 2 * sizeof(real_t));
+    }
+    else if (polygon_offsets != NULL)
+    {
+      int n = polygon_offsets[i+1] - polygon_offsets[i];
+      hash = fnv1a(hash, &n, sizeof(int));
+      for (int v = polygon_offsets[i]; v < polygon_offsets[i+1]; ++v)
+      {
+        real_t xy[2] = {polygon_vertices[v].x, polygon_vertices[v].y};
+        hash = fnv1a(hash, xy, 2 * sizeof(real_t));
+      }
+    }
+    else
+    {
+      real_t box[4] = {target_cells[i].x1, target_cells[i].x2,
+                       target_cells[i].y1, target_cells[i].y2};
+      hash = fnv1a(hash, box, 4 * sizeof(real_t));
+    }
+  }
+  return hash;
+}
+
+// The geometry of a lat-lon grid, arranged for searching.
+typedef struct
+{
+  int nlat, nlon;
+
+  // Latitudes in increasing order, and the grid index of each.
+  real_t* lat;
+  int* lat_index;
+
+  // Longitudes (which increase with index).
+  real_t* lon;
+
+  // True if the longitudes wrap around the globe, and the longitudinal
+  // spacing across the seam if so.
+  bool periodic;
+  real_t seam_gap;
+
+  // Cell edges (midpoints between points), with nlat+1 and nlon+1 entries.
+  real_t* lat_edges;
+  real_t* lon_edges;
+} grid_t;
+
+static void grid_init(grid_t* grid,
+                      int nlat, real_t* lat,
+                      int nlon, real_t* lon)
+{
+  ASSERT(nlat >= 2);
+  ASSERT(nlon >= 2);
+  grid->nlat = nlat;
+  grid->nlon = nlon;
+
+  // Latitudes may be stored in either order.
+  bool descending = (lat[nlat-1] < lat[0]);
+  grid->lat = polymec_malloc(sizeof(real_t) * nlat);
+  grid->lat_index = polymec_malloc(sizeof(int) * nlat);
+  for (int j = 0; j < nlat; ++j)
+  {
+    int jj = (descending) ? nlat-1-j : j;
+    grid->lat[j] = lat[jj];
+    grid->lat_index[j] = jj;
+  }
+  grid->lon = lon;
+
+  // The grid is periodic if the gap across the seam is no larger than
+  // (about) the average spacing.
+  real_t spacing = (lon[nlon-1] - lon[0]) / (nlon - 1);
+  grid->seam_gap = lon[0] + 360.0 - lon[nlon-1];
+  grid->periodic = ((grid->seam_gap > 0.0) && (grid->seam_gap < 1.5 * spacing));
+
+  grid->lat_edges = polymec_malloc(sizeof(real_t) * (nlat+1));
+  grid->lat_edges[0] = grid->lat[0] - 0.5 * (grid->lat[1] - grid->lat[0]);
+  for (int j = 1; j < nlat; ++j)
+    grid->lat_edges[j] = 0.5 * (grid->lat[j-1] + grid->lat[j]);
+  grid->lat_edges[nlat] = grid->lat[nlat-1] + 0.5 * (grid->lat[nlat-1] - grid->lat[nlat-2]);
+  for (int j = 0; j <= nlat; ++j)
+    grid->lat_edges[j] = MAX(-90.0, MIN(90.0, grid->lat_edges[j]));
+
+  grid->lon_edges = polymec_malloc(sizeof(real_t) * (nlon+1));
+  for (int i = 1; i < nlon; ++i)
+    grid->lon_edges[i] = 0.5 * (lon[i-1] + lon[i]);
+  if (grid->periodic)
+  {
+    grid->lon_edges[0] = lon[0] - 0.5 * grid->seam_gap;
+    grid->lon_edges[nlon] = lon[nlon-1] + 0.5 * grid->seam_gap;
+  }
+  else
+  {
+    grid->lon_edges[0] = lon[0] - 0.5 * (lon[1] - lon[0]);
+    grid->lon_edges[nlon] = lon[nlon-1] + 0.5 * (lon[nlon-1] - lon[nlon-2]);
+  }
+}
+
+static void grid_cleanup(grid_t* grid)
+{
+  polymec_free(grid->lat);
+  polymec_free(grid->lat_index);
+  polymec_free(grid->lat_edges);
+  polymec_free(grid->lon_edges);
+}
+
+// Returns the largest index i in [0, n-1) with x[i] <= y (or 0 if there is
+// none), for increasing values x.
+static int bracket(real_t* x, int n, real_t y)
+{
+  int lo = 0, hi = n-1;
+  while (hi - lo > 1)
+  {
+    int mid = (lo + hi) / 2;
+    if (x[mid] <= y)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Shifts the longitude x by multiples of 360 degrees into the range
+// [x0, x0 + 360).
+static real_t wrap_lon(real_t x, real_t x0)
+{
+  real_t y = fmod(x - x0, 360.0);
+  if (y < 0.0) y += 360.0;
+  return x0 + y;
+}
+
+// Appends the weight for a grid point to the current row.
+static void add_weight(grid_t* grid, int lat, int lon, real_t w,
+                       int_array_t* columns, real_array_t* weights)
+{
+  if (w == 0.0) return;
+  int_array_append(columns, grid->lat_index[lat] * grid->nlon + lon);
+  real_array_append(weights, w);
+}
+
+static void compute_bilinear_weights(grid_t* grid, point_t* x,
+                                     int_array_t* columns, real_array_t* weights)
+{
+  // Latitude (clamped to the grid).
+  real_t y = MAX(grid->lat[0], MIN(grid->lat[grid->nlat-1], x->y));
+  int j0 = bracket(grid->lat, grid->nlat, y), j1 = j0 + 1;
+  real_t u = (y - grid->lat[j0]) / (grid->lat[j1] - grid->lat[j0]);
+
+  // Longitude (wrapped across the seam, or clamped to the grid).
+  int i0, i1;
+  real_t t;
+  real_t* lon = grid->lon;
+  int nlon = grid->nlon;
+  if (grid->periodic)
+  {
+    real_t xx = wrap_lon(x->x, lon[0]);
+    if (xx >= lon[nlon-1])
+    {
+      i0 = nlon-1;
+      i1 = 0;
+      t = (xx - lon[nlon-1]) / grid->seam_gap;
+    }
+    else
+    {
+      i0 = bracket(lon, nlon, xx);
+      i1 = i0 + 1;
+      t = (xx - lon[i0]) / (lon[i1] - lon[i0]);
+    }
+  }
+  else
+  {
+    // Use the copy of the longitude closest to the middle of the grid.
+    real_t mid = 0.5 * (lon[0] + lon[nlon-1]);
+    real_t xx = wrap_lon(x->x, mid - 180.0);
+    xx = MAX(lon[0], MIN(lon[nlon-1], xx));
+    i0 = bracket(lon, nlon, xx);
+    i1 = i0 + 1;
+    t = (xx - lon[i0]) / (lon[i1] - lon[i0]);
+  }
+
+  add_weight(grid, j0, i0, (1.0 - u) * (1.0 - t), columns, weights);
+  add_weight(grid, j0, i1, (1.0 - u) * t, columns, weights);
+  add_weight(grid, j1, i0, u * (1.0 - t), columns, weights);
+  add_weight(grid, j1, i1, u * t, columns, weights);
+}
+
+// Polygons in the (longitude, sine of latitude) plane, in which areas are 
+// those on the unit sphere (with longitudes in degrees). Vertices are stored 
+// as (u, v) pairs.
+
+// Replaces the n vertices (u[0], u[1]) of the given polygon with those of 
+// their convex hull, in counterclockwise order, returning their number.
+static int convex_hull_2d(int n, real_t* p)
+{
+  // Sort the vertices by u and then v.
+  for (int i = 1; i < n; ++i)
+  {
+    real_t u = p[2*i], v = p[2*i+1];
+    int j = i;
+    for (; (j > 0) && ((p[2*j-2] > u) || ((p[2*j-2] == u) && (p[2*j-1] > v))); --j)
+    {
+      p[2*j] = p[2*j-2];
+      p[2*j+1] = p[2*j-1];
+    }
+    p[2*j] = u;
+    p[2*j+1] = v;
+  }
+
+  // Build the lower and upper hulls (Andrew's monotone chain).
+  real_t hull[4*n+2];
+  int h = 0;
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    int start = h;
+    for (int k = 0; k < n; ++k)
+    {
+      int i = (pass == 0) ? k : n-1-k;
+      while ((h >= start + 2) && 
+             ((hull[2*h-2] - hull[2*h-4]) * (p[2*i+1] - hull[2*h-3]) - 
+              (hull[2*h-1] - hull[2*h-3]) * (p[2*i] - hull[2*h-4]) <= 0.0))
+        --h;
+      hull[2*h] = p[2*i];
+      hull[2*h+1] = p[2*i+1];
+      ++h;
+    }
+    --h; // The last vertex starts the other hull.
+  }
+  if (h < 3) 
+    return 0;
+  memcpy(p, hull, sizeof(real_t) * 2 * h);
+  return h;
+}
+
+// Clips the n vertices of the convex polygon p to the half plane in which 
+// the coordinate c (0 for u, 1 for v) times sign is at most sign * bound, 
+// storing the vertices of the result in q and returning their number.
+static int clip_polygon(int n, real_t* p, int c, real_t sign, real_t bound, real_t* q)
+{
+  int m = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    real_t* a = &p[2*i];
+    real_t* b = &p[2*((i+1)%n)];
+    real_t da = sign * (a[c] - bound), db = sign * (b[c] - bound);
+    if (da <= 0.0)
+    {
+      q[2*m] = a[0];
+      q[2*m+1] = a[1];
+      ++m;
+    }
+    if (((da < 0.0) && (db > 0.0)) || ((da > 0.0) && (db < 0.0)))
+    {
+      real_t t = da / (da - db);
+      q[2*m] = a[0] + t * (b[0] - a[0]);
+      q[2*m+1] = a[1] + t * (b[1] - a[1]);
+      q[2*m+c] = bound;
+      ++m;
+    }
+  }
+  return m;
+}
+
+// Clips the n vertices of the convex polygon p to the strip lo <= (u or v) 
+// <= hi, storing the vertices of the result in q (which needs room for n+2 
+// of them), and returning their number.
+static int clip_to_strip(int n, real_t* p, int c, real_t lo, real_t hi, real_t* q)
+{
+  real_t r[2*(n+1)];
+  int m = clip_polygon(n, p, c, -1.0, lo, r);
+  return clip_polygon(m, r, c, 1.0, hi, q);
+}
+
+static real_t polygon_area(int n, real_t* p)
+{
+  real_t a = 0.0;
+  for (int i = 0; i < n; ++i)
+  {
+    int j = (i+1) % n;
+    a += p[2*i] * p[2*j+1] - p[2*j] * p[2*i+1];
+  }
+  return 0.5 * fabs(a);
+}
+
+// Computes the weights for the target cell whose vertices (in degrees) 
+// have the given longitudes and latitudes. The cell is the convex hull of 
+// its vertices in the (longitude, sine of latitude) plane, and each weight 
+// is the area in which it overlaps a grid cell, so the weights of cells 
+// that tile a region add up to the area of the region in each grid cell.
+static void compute_conservative_weights(grid_t* grid, int num_vertices, 
+                                         real_t* lons, real_t* lats,
+                                         int_array_t* columns, real_array_t* weights)
+{
+  size_t first = weights->size;
+  real_t deg = M_PI / 180.0;
+
+  real_t cell[2*num_vertices];
+  real_t x1 = REAL_MAX, x2 = -REAL_MAX, y1 = REAL_MAX, y2 = -REAL_MAX;
+  for (int v = 0; v < num_vertices; ++v)
+  {
+    real_t lat = MAX(-90.0, MIN(90.0, lats[v]));
+    cell[2*v] = lons[v];
+    cell[2*v+1] = sin(lat * deg);
+    x1 = MIN(x1, lons[v]);
+    x2 = MAX(x2, lons[v]);
+    y1 = MIN(y1, lat);
+    y2 = MAX(y2, lat);
+  }
+  int n = convex_hull_2d(num_vertices, cell);
+  if (n == 0) return;
+
+  // Latitude bands overlapping the cell.
+  y1 = MAX(grid->lat_edges[0], y1);
+  y2 = MIN(grid->lat_edges[grid->nlat], y2);
+  if (y2 <= y1) return;
+  int j_first = bracket(grid->lat_edges, grid->nlat+1, y1);
+
+  // Copies of the grid's longitudes that overlap the cell (several, if the 
+  // cell crosses the seam of a periodic grid). On a grid that isn't 
+  // periodic, we use the copy of the cell whose center is closest to the 
+  // middle of the grid, as for bilinear weights.
+  real_t* edges = grid->lon_edges;
+  int nlon = grid->nlon;
+  int k1 = 0, k2 = 0;
+  if (grid->periodic)
+  {
+    k1 = (int)floor((edges[0] - x2) / 360.0);
+    k2 = (int)ceil((edges[nlon] - x1) / 360.0);
+  }
+  else
+  {
+    real_t mid = 0.5 * (grid->lon[0] + grid->lon[nlon-1]);
+    real_t center = 0.5 * (x1 + x2);
+    real_t shift = wrap_lon(center, mid - 180.0) - center;
+    for (int v = 0; v < n; ++v)
+      cell[2*v] += shift;
+    x1 += shift;
+    x2 += shift;
+  }
+
+  real_t band[2*(n+2)], piece[2*(n+4)];
+  for (int j = j_first; (j < grid->nlat) && (grid->lat_edges[j] < y2); ++j)
+  {
+    int nb = clip_to_strip(n, cell, 1, sin(grid->lat_edges[j] * deg), 
+                           sin(grid->lat_edges[j+1] * deg), band);
+    if (nb < 3) continue;
+    for (int k = k1; k <= k2; ++k)
+    {
+      real_t a = MAX(x1 + 360.0 * k, edges[0]);
+      real_t b = MIN(x2 + 360.0 * k, edges[nlon]);
+      if (b <= a) continue;
+      for (int i = bracket(edges, nlon+1, a); (i < nlon) && (edges[i] < b); ++i)
+      {
+        int np = clip_to_strip(nb, band, 0, edges[i] - 360.0 * k, 
+                               edges[i+1] - 360.0 * k, piece);
+        if (np >= 3)
+          add_weight(grid, j, i, polygon_area(np, piece) * deg, columns, weights);
+      }
+    }
+  }
+
+  // Normalize by the covered area.
+  real_t area = 0.0;
+  for (size_t w = first; w < weights->size; ++w)
+    area += weights->data[w];
+  if (area > 0.0)
+  {
+    for (size_t w = first; w < weights->size; ++w)
+      weights->data[w] /= area;
+  }
+}
+
+static latlon_regridder_t* regridder_alloc(uint64_t fingerprint,
+                                           int num_sources,
+                                           int num_targets)
+{
+  latlon_regridder_t* r = polymec_malloc(sizeof(latlon_regridder_t));
+  r->fingerprint = fingerprint;
+  r->num_sources = num_sources;
+  r->num_targets = num_targets;
+  r->offsets = polymec_malloc(sizeof(int) * (num_targets+1));
+  r->columns = NULL;
+  r->weights = NULL;
+  r->threads = NULL;
+  r->num_threads = 1;
+  return r;
+}
+
+static void compute_weights(latlon_regridder_t* r,
+                            latlon_regrid_method_t method,
+                            int num_lat_points,
+                            real_t* lat_points,
+                            int num_lon_points,
+                            real_t* lon_points,
+                            point_t* target_points,
+                            bbox_t* target_cells,
+                            int* polygon_offsets,
+                            point_t* polygon_vertices)
+{
+  grid_t grid;
+  grid_init(&grid, num_lat_points, lat_points, num_lon_points, lon_points);
+  int_array_t* columns = int_array_new();
+  real_array_t* weights = real_array_new();
+  r->offsets[0] = 0;
+  for (int i = 0; i < r->num_targets; ++i)
+  {
+    if (method == LATLON_REGRID_BILINEAR)
+      compute_bilinear_weights(&grid, &target_points[i], columns, weights);
+    else if (polygon_offsets != NULL)
+    {
+      int n = polygon_offsets[i+1] - polygon_offsets[i];
+      real_t lons[n], lats[n];
+      for (int v = 0; v < n; ++v)
+      {
+        point_t* x = &polygon_vertices[polygon_offsets[i] + v];
+        lons[v] = x->x;
+        lats[v] = x->y;
+      }
+      compute_conservative_weights(&grid, n, lons, lats, columns, weights);
+    }
+    else
+    {
+      bbox_t* cell = &target_cells[i];
+      real_t lons[4] = {cell->x1, cell->x2, cell->x2, cell->x1};
+      real_t lats[4] = {cell->y1, cell->y1, cell->y2, cell->y2};
+      compute_conservative_weights(&grid, 4, lons, lats, columns, weights);
+    }
+    r->offsets[i+1] = (int)weights->size;
+  }
+  grid_cleanup(&grid);
+
+  // Steal the arrays' data.
+  r->columns = columns->data;
+  r->weights = weights->data;
+  int_array_release_data_and_free(columns);
+  real_array_release_data_and_free(weights);
+}
+
+// Header for regridder cache files.
+typedef struct
+{
+  char magic[8];
+  int version;
+  int real_size;
+  uint64_t fingerprint;
+  int num_sources, num_targets, num_weights;
+} cache_header_t;
+
+static void cache_filename(const char* cache_dir, uint64_t fingerprint, char* filename)
+{
+  snprintf(filename, FILENAME_MAX, "%s/latlon_regrid_%016llx.weights",
+           cache_dir, (unsigned long long)fingerprint);
+}
+
+// Reads weights from the given cache file into the regridder, returning
+// true if they were read, false if the file doesn't exist or doesn't match.
+static bool read_cache(latlon_regridder_t* r, const char* filename)
+{
+  FILE* f = fopen(filename, "rb");
+  if (f == NULL)
+    return false;
+
+  cache_header_t header;
+  bool ok = ((fread(&header, sizeof(cache_header_t), 1, f) == 1) &&
+             (memcmp(header.magic, cache_magic, 8) == 0) &&
+             (header.version == CACHE_VERSION) &&
+             (header.real_size == (int)sizeof(real_t)) &&
+             (header.fingerprint == r->fingerprint) &&
+             (header.num_sources == r->num_sources) &&
+             (header.num_targets == r->num_targets) &&
+             (header.num_weights >= 0));
+  if (ok)
+  {
+    size_t nnz = (size_t)header.num_weights;
+    r->columns = polymec_malloc(sizeof(int) * MAX(nnz, 1));
+    r->weights = polymec_malloc(sizeof(real_t) * MAX(nnz, 1));
+    size_t n = (size_t)(r->num_targets+1);
+    ok = ((fread(r->offsets, sizeof(int), n, f) == n) &&
+          (fread(r->columns, sizeof(int), nnz, f) == nnz) &&
+          (fread(r->weights, sizeof(real_t), nnz, f) == nnz) &&
+          (r->offsets[r->num_targets] == header.num_weights));
+    if (!ok)
+    {
+      polymec_free(r->columns);
+      polymec_free(r->weights);
+      r->columns = NULL;
+      r->weights = NULL;
+    }
+  }
+  fclose(f);
+  if (!ok)
+    log_debug("latlon_regridder: Ignoring invalid cache file %s.", filename);
+  return ok;
+}
+
+// Writes the regridder's weights to the given cache file. The file is
+// written under a temporary name and then renamed, so that readers never
+// see a partial file.
+static void write_cache(latlon_regridder_t* r, const char* filename)
+{
+  char tmp_filename[FILENAME_MAX+16];
+  snprintf(tmp_filename, FILENAME_MAX+16, "%s.%d.tmp", filename, (int)getpid());
+  FILE* f = fopen(tmp_filename, "wb");
+  if (f == NULL)
+  {
+    log_debug("latlon_regridder: Couldn't write cache file %s.", filename);
+    return;
+  }
+
+  cache_header_t header;
+  memset(&header, 0, sizeof(cache_header_t));
+  memcpy(header.magic, cache_magic, 8);
+  header.version = CACHE_VERSION;
+  header.real_size = (int)sizeof(real_t);
+  header.fingerprint = r->fingerprint;
+  header.num_sources = r->num_sources;
+  header.num_targets = r->num_targets;
+  header.num_weights = r->offsets[r->num_targets];
+  size_t n = (size_t)(r->num_targets+1), nnz = (size_t)header.num_weights;
+  bool ok = ((fwrite(&header, sizeof(cache_header_t), 1, f) == 1) &&
+             (fwrite(r->offsets, sizeof(int), n, f) == n) &&
+             (fwrite(r->columns, sizeof(int), nnz, f) == nnz) &&
+             (fwrite(r->weights, sizeof(real_t), nnz, f) == nnz));
+  fclose(f);
+  if (ok)
+    ok = (rename(tmp_filename, filename) == 0);
+  if (!ok)
+  {
+    remove(tmp_filename);
+    log_debug("latlon_regridder: Couldn't write cache file %s.", filename);
+  }
+}
+
+// Creates a regridder for targets given as points, boxes, or polygons 
+// (those arguments that aren't used are NULL).
+static latlon_regridder_t* regridder_new(latlon_regrid_method_t method,
+                                         int num_lat_points,
+                                         real_t* lat_points,
+                                         int num_lon_points,
+                                         real_t* lon_points,
+                                         int num_targets,
+                                         point_t* target_points,
+                                         bbox_t* target_cells,
+                                         int* polygon_offsets,
+                                         point_t* polygon_vertices,
+                                         const char* cache_dir)
+{
+  uint64_t fingerprint = compute_fingerprint(method, num_lat_points, lat_points,
+                                             num_lon_points, lon_points,
+                                             num_targets, target_points,
+                                             target_cells, polygon_offsets,
+                                             polygon_vertices);
+  latlon_regridder_t* r = regridder_alloc(fingerprint,
+                                          num_lat_points * num_lon_points,
+                                          num_targets);
+
+  char filename[FILENAME_MAX];
+  if (cache_dir != NULL)
+  {
+    cache_filename(cache_dir, fingerprint, filename);
+    if (read_cache(r, filename))
+    {
+      log_debug("latlon_regridder: Read weights from %s.", filename);
+      return r;
+    }
+  }
+
+  compute_weights(r, method, num_lat_points, lat_points, num_lon_points,
+                  lon_points, target_points, target_cells, polygon_offsets,
+                  polygon_vertices);
+  if (cache_dir != NULL)
+    write_cache(r, filename);
+  return r;
+}
+
+latlon_regridder_t* latlon_regridder_new(latlon_regrid_method_t method,
+                                         int num_lat_points,
+                                         real_t* lat_points,
+                                         int num_lon_points,
+                                         real_t* lon_points,
+                                         int num_targets,
+                                         point_t* target_points,
+                                         bbox_t* target_cells,
+                                         const char* cache_dir)
+{
+  ASSERT((method != LATLON_REGRID_BILINEAR) || (target_points != NULL) || (num_targets == 0));
+  ASSERT((method != LATLON_REGRID_CONSERVATIVE) || (target_cells != NULL) || (num_targets == 0));
+  ASSERT(num_targets >= 0);
+  return regridder_new(method, num_lat_points, lat_points, num_lon_points, 
+                       lon_points, num_targets, 
+                       (method == LATLON_REGRID_BILINEAR) ? target_points : NULL,
+                       (method == LATLON_REGRID_CONSERVATIVE) ? target_cells : NULL,
+                       NULL, NULL, cache_dir);
+}
+
+latlon_regridder_t* latlon_regridder_new_with_polygons(int num_lat_points,
+                                                       real_t* lat_points,
+                                                       int num_lon_points,
+                                                       real_t* lon_points,
+                                                       int num_targets,
+                                                       int* polygon_offsets,
+                                                       point_t* polygon_vertices,
+                                                       const char* cache_dir)
+{
+  ASSERT(num_targets >= 0);
+  ASSERT(polygon_offsets != NULL);
+
+  // Unwrap the longitudes of each polygon's vertices relative to its first 
+  // vertex, so that a polygon that crosses the seam stays narrow.
+  int num_vertices = polygon_offsets[num_targets];
+  point_t* vertices = polymec_malloc(sizeof(point_t) * MAX(num_vertices, 1));
+  for (int i = 0; i < num_targets; ++i)
+  {
+    ASSERT(polygon_offsets[i+1] > polygon_offsets[i]);
+    real_t x0 = polygon_vertices[polygon_offsets[i]].x;
+    for (int v = polygon_offsets[i]; v < polygon_offsets[i+1]; ++v)
+    {
+      vertices[v] = polygon_vertices[v];
+      vertices[v].x = wrap_lon(vertices[v].x, x0 - 180.0);
+    }
+  }
+  latlon_regridder_t* r = regridder_new(LATLON_REGRID_CONSERVATIVE, 
+                                        num_lat_points, lat_points,
+                                        num_lon_points, lon_points,
+                                        num_targets, NULL, NULL, 
+                                        polygon_offsets, vertices, cache_dir);
+  polymec_free(vertices);
+  return r;
+}
+
+latlon_regridder_t* latlon_regridder_from_fe_mesh(latlon_regrid_method_t method,
+                                                  int num_lat_points,
+                                                  real_t* lat_points,
+                                                  int num_lon_points,
+                                                  real_t* lon_points,
+                                                  fe_mesh_t* mesh,
+                                                  const char* cache_dir)
+{
+  point_t* X = fe_mesh_node_positions(mesh);
+  if (method == LATLON_REGRID_BILINEAR)
+  {
+    return latlon_regridder_new(method, num_lat_points, lat_points,
+                                num_lon_points, lon_points,
+                                fe_mesh_num_nodes(mesh), X, NULL, cache_dir);
+  }
+
+  // Each element's cell is the polygon spanned by the positions of its 
+  // nodes.
+  int num_elem = fe_mesh_num_elements(mesh);
+  int* offsets = polymec_malloc(sizeof(int) * (num_elem+1));
+  offsets[0] = 0;
+  for (int e = 0; e < num_elem; ++e)
+  {
+    int num_nodes = fe_mesh_num_element_nodes(mesh, e);
+    ASSERT(num_nodes > 0);
+    offsets[e+1] = offsets[e] + num_nodes;
+  }
+  int* nodes = polymec_malloc(sizeof(int) * MAX(offsets[num_elem], 1));
+  point_t* vertices = polymec_malloc(sizeof(point_t) * MAX(offsets[num_elem], 1));
+  for (int e = 0; e < num_elem; ++e)
+  {
+    fe_mesh_get_element_nodes(mesh, e, &nodes[offsets[e]]);
+    for (int v = offsets[e]; v < offsets[e+1]; ++v)
+      vertices[v] = X[nodes[v]];
+  }
+  polymec_free(nodes);
+
+  latlon_regridder_t* r = latlon_regridder_new_with_polygons(num_lat_points, lat_points,
+                                                             num_lon_points, lon_points,
+                                                             num_elem, offsets, vertices, 
+                                                             cache_dir);
+  polymec_free(vertices);
+  polymec_free(offsets);
+  return r;
+}
+
+void latlon_regridder_free(latlon_regridder_t* regridder)
+{
+  if (regridder->threads != NULL)
+    thread_pool_free(regridder->threads);
+  polymec_free(regridder->offsets);
+  if (regridder->columns != NULL)
+    polymec_free(regridder->columns);
+  if (regridder->weights != NULL)
+    polymec_free(regridder->weights);
+  polymec_free(regridder);
+}
+
+uint64_t latlon_regridder_fingerprint(latlon_regridder_t* regridder)
+{
+  return regridder->fingerprint;
+}
+
+int latlon_regridder_num_targets(latlon_regridder_t* regridder)
+{
+  return regridder->num_targets;
+}
+
+size_t latlon_regridder_num_weights(latlon_regridder_t* regridder)
+{
+  return (size_t)regridder->offsets[regridder->num_targets];
+}
+
+void latlon_regridder_set_num_threads(latlon_regridder_t* regridder,
+                                      int num_threads)
+{
+  ASSERT(num_threads > 0);
+  if (regridder->threads != NULL)
+  {
+    thread_pool_free(regridder->threads);
+    regridder->threads = NULL;
+  }
+  regridder->num_threads = num_threads;
+  if (num_threads > 1)
+    regridder->threads = thread_pool_with_threads(num_threads);
+}
+
+// A range of targets to which a regridder is applied by one thread.
+typedef struct
+{
+  latlon_regridder_t* regridder;
+  int num_levels;
+  real_t* grid_data;
+  real_t* target_data;
+  int first, last;
+} apply_piece_t;
+
+static void apply_piece(void* context)
+{
+  apply_piece_t* piece = context;
+  latlon_regridder_t* r = piece->regridder;
+  for (int l = 0; l < piece->num_levels; ++l)
+  {
+    real_t* x = &piece->grid_data[(size_t)l * r->num_sources];
+    real_t* y = &piece->target_data[(size_t)l * r->num_targets];
+    for (int i = piece->first; i < piece->last; ++i)
+    {
+      real_t sum = 0.0;
+      for (int k = r->offsets[i]; k < r->offsets[i+1]; ++k)
+        sum += r->weights[k] * x[r->columns[k]];
+      y[i] = sum;
+    }
+  }
+}
+
+void latlon_regridder_apply(latlon_regridder_t* regridder,
+                            int num_levels,
+                            real_t* grid_data,
+                            real_t* target_data)
+{
+  ASSERT(num_levels > 0);
+  int num_pieces = 1;
+  if ((regridder->threads != NULL) &&
+      (regridder->num_targets >= MIN_TARGETS_PER_THREAD * regridder->num_threads))
+    num_pieces = regridder->num_threads;
+
+  apply_piece_t pieces[num_pieces];
+  int targets_per_piece = regridder->num_targets / num_pieces;
+  for (int p = 0; p < num_pieces; ++p)
+  {
+    pieces[p].regridder = regridder;
+    pieces[p].num_levels = num_levels;
+    pieces[p].grid_data = grid_data;
+    pieces[p].target_data = target_data;
+    pieces[p].first = p * targets_per_piece;
+    pieces[p].last = (p == num_pieces-1) ? regridder->num_targets
+                                         : pieces[p].first + targets_per_piece;
+  }
+
+  if (num_pieces == 1)
+    apply_piece(&pieces[0]);
+  else
+  {
+    for (int p = 0; p < num_pieces; ++p)
+      thread_pool_schedule(regridder->threads, &pieces[p], apply_piece);
+    thread_pool_execute(regridder->threads);
+  }
+}
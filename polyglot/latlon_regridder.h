@@ -0,0 +1,120 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYGLOT_LATLON_REGRIDDER_H
+#define POLYGLOT_LATLON_REGRIDDER_H
+
+#include "polyglot/fe_mesh.h"
+
+// The lat-lon regridder maps fields defined on the points of a lat-lon grid
+// (like those in CF files) to a set of target points or cells. Its remap
+// weights are computed once and stored as a sparse matrix, which is applied
+// to each field (or time step) with a (threaded) sparse matrix-vector
+// product. Weights can be cached on disk, keyed by a fingerprint of the
+// grid, the targets, and the method, so that they're computed only once
+// for a given grid and mesh.
+//
+// Target positions are given in degrees, with x holding the longitude and
+// y the latitude. z is ignored. Target longitudes may differ from the
+// grid's by any multiple of 360 degrees.
+
+// Methods for computing remap weights.
+typedef enum
+{
+  LATLON_REGRID_BILINEAR,    // Bilinear interpolation to target points.
+  LATLON_REGRID_CONSERVATIVE // First-order conservative remapping to target
+                             // cells (lon-lat boxes or polygons).
+} latlon_regrid_method_t;
+
+// A conservative weight is the area of the sphere in which a target cell 
+// overlaps a grid cell, divided by the area of the target cell covered by 
+// the grid. Target cells are convex polygons whose edges are straight in 
+// the plane of longitude and the sine of latitude (in which areas are 
+// those on the sphere), so lon-lat boxes are exact, and cells that share 
+// edges don't overlap. Integrals over cells that tile a region are then 
+// conserved to rounding error.
+
+// This type maps fields from a lat-lon grid to a set of targets.
+typedef struct latlon_regridder_t latlon_regridder_t;
+
+// Creates a regridder that maps fields on the lat-lon grid with the given
+// latitude and longitude points (in degrees, with longitudes increasing) to
+// num_targets targets using the given method. For LATLON_REGRID_BILINEAR,
+// target_points holds the target positions and target_cells may be NULL.
+// For LATLON_REGRID_CONSERVATIVE, target_cells holds the lon-lat extents of
+// the target cells and target_points may be NULL. Conservative weights are
+// normalized by the area of each target cell covered by the grid, so
+// constant fields are preserved. If cache_dir is non-NULL, weights are read
+// from a cache file in that directory if one exists for this grid, these
+// targets, and this method, and are written to one otherwise.
+latlon_regridder_t* latlon_regridder_new(latlon_regrid_method_t method,
+                                         int num_lat_points,
+                                         real_t* lat_points,
+                                         int num_lon_points,
+                                         real_t* lon_points,
+                                         int num_targets,
+                                         point_t* target_points,
+                                         bbox_t* target_cells,
+                                         const char* cache_dir);
+
+// Creates a regridder that conservatively maps fields on the given lat-lon 
+// grid to num_targets polygonal cells. The vertices of the ith cell are 
+// polygon_vertices[polygon_offsets[i]] through 
+// polygon_vertices[polygon_offsets[i+1]-1], and the cell is their convex 
+// hull. The longitudes of a cell's vertices are taken within 180 degrees of 
+// its first vertex's, so cells may cross the seam. Caching works as in 
+// latlon_regridder_new.
+latlon_regridder_t* latlon_regridder_new_with_polygons(int num_lat_points,
+                                                       real_t* lat_points,
+                                                       int num_lon_points,
+                                                       real_t* lon_points,
+                                                       int num_targets,
+                                                       int* polygon_offsets,
+                                                       point_t* polygon_vertices,
+                                                       const char* cache_dir);
+
+// Creates a regridder that maps fields on the given lat-lon grid to the
+// given finite element mesh: to its nodes for LATLON_REGRID_BILINEAR, and to
+// its elements (the polygons spanned by their nodes, as in 
+// latlon_regridder_new_with_polygons) for LATLON_REGRID_CONSERVATIVE. 
+// Caching works as in latlon_regridder_new.
+latlon_regridder_t* latlon_regridder_from_fe_mesh(latlon_regrid_method_t method,
+                                                  int num_lat_points,
+                                                  real_t* lat_points,
+                                                  int num_lon_points,
+                                                  real_t* lon_points,
+                                                  fe_mesh_t* mesh,
+                                                  const char* cache_dir);
+
+// Destroys the given regridder.
+void latlon_regridder_free(latlon_regridder_t* regridder);
+
+// Returns the fingerprint identifying the grid, targets, and method for
+// which the regridder's weights were computed.
+uint64_t latlon_regridder_fingerprint(latlon_regridder_t* regridder);
+
+// Returns the number of targets to which the regridder maps fields.
+int latlon_regridder_num_targets(latlon_regridder_t* regridder);
+
+// Returns the number of nonzero weights in the regridder's remap matrix.
+size_t latlon_regridder_num_weights(latlon_regridder_t* regridder);
+
+// Sets the number of threads used to apply the regridder. By default, a
+// single thread is used.
+void latlon_regridder_set_num_threads(latlon_regridder_t* regridder,
+                                      int num_threads);
+
+// Maps a field with num_levels vertical levels from the lat-lon grid to
+// the targets. grid_data is stored in (vertical, lat, lon) order, as it is
+// read from a CF file, and target_data is stored in (vertical, target)
+// order. A surface field has a single level.
+void latlon_regridder_apply(latlon_regridder_t* regridder,
+                            int num_levels,
+                            real_t* grid_data,
+                            real_t* target_data);
+
+#endif
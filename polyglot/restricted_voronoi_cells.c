@@ -0,0 +1,1152 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "core/array.h"
+#include "core/array_utils.h"
+#include "core/thread_pool.h"
+#include "polyglot/delaunay_triangulation.h"
+#include "polyglot/robust_predicates.h"
+#include "polyglot/restricted_voronoi_cells.h"
+
+// Each cell starts out as the bounding box and is clipped by the bisectors 
+// of its generator and the generator's Delaunay neighbors, which leaves the 
+// Voronoi cell clipped to the box: a convex polyhedron P. Clipping P to the 
+// interior of a closed surface would make it non-convex, so instead we 
+// integrate over its part inside the surface by counting crossings. If w is 
+// the winding number of the surface about the generator g, a point x in P 
+// lies inside the surface when w plus the signed number of triangles 
+// crossed by the segment from g to x is 1. The points of P whose segments 
+// cross a triangle t make up the "shadow" of t: the convex polyhedron cut 
+// from P by the planes through g and the edges of t and by the plane of t. 
+// So the volume of the part of P inside the surface (or its first moment, 
+// or the area of any face of P inside the surface) is w times that of P 
+// plus the signed sum of those of the shadows of the triangles that cut P. 
+// If g lies outside the box (and so outside P), triangles between g and P 
+// can have shadows too, so we then consider every triangle that meets the 
+// bounding box of P and g.
+
+// Faces of polyhedra are tagged with the generator on their other side, with 
+// BOX_TAG(f) if they lie on the fth face of the bounding box, or with 
+// SHADOW_TAG if they are faces of shadows that don't lie on a face of P.
+#define BOX_TAG(f) (-1 - (f))
+#define SHADOW_TAG -7
+
+// Cells and faces whose restricted volumes or areas are at most this fraction 
+// of their unrestricted ones are taken to lie outside the surface.
+#define EMPTY_FRACTION 1e-10
+
+// The neighbors of the generators are found by triangulating them unless 
+// there are fewer than this many, in which case every generator is a 
+// neighbor of every other.
+#define MIN_TRIANGULATED_GENERATORS 32
+
+// Cells are computed in parallel in blocks of at least this many cells.
+#define MIN_CELLS_PER_BLOCK 256
+
+// A convex polyhedron, stored as a list of convex polygonal faces whose 
+// vertices turn counterclockwise as seen from outside. The fth face has the 
+// vertices vertices[face_offsets[f]] through vertices[face_offsets[f+1]-1] 
+// and lies in the plane normals[f] * x = offsets[f], whose normal points 
+// outward.
+typedef struct
+{
+  int num_faces, face_capacity;
+  int* face_offsets;
+  int* tags;
+  vector_t* normals;
+  real_t* offsets;
+  int num_vertices, vertex_capacity;
+  point_t* vertices;
+} polyhedron_t;
+
+static void polyhedron_reserve(polyhedron_t* p, int num_faces, int num_vertices)
+{
+  if (num_faces > p->face_capacity)
+  {
+    p->face_capacity = MAX(num_faces, 2 * p->face_capacity);
+    p->face_offsets = polymec_realloc(p->face_offsets, sizeof(int) * (p->face_capacity + 1));
+    p->tags = polymec_realloc(p->tags, sizeof(int) * p->face_capacity);
+    p->normals = polymec_realloc(p->normals, sizeof(vector_t) * p->face_capacity);
+    p->offsets = polymec_realloc(p->offsets, sizeof(real_t) * p->face_capacity);
+  }
+  if (num_vertices > p->vertex_capacity)
+  {
+    p->vertex_capacity = MAX(num_vertices, 2 * p->vertex_capacity);
+    p->vertices = polymec_realloc(p->vertices, sizeof(point_t) * p->vertex_capacity);
+  }
+}
+
+static void polyhedron_clear(polyhedron_t* p)
+{
+  p->num_faces = 0;
+  p->num_vertices = 0;
+  p->face_offsets[0] = 0;
+}
+
+static void polyhedron_destroy(polyhedron_t* p)
+{
+  polymec_free(p->face_offsets);
+  polymec_free(p->tags);
+  polymec_free(p->normals);
+  polymec_free(p->offsets);
+  polymec_free(p->vertices);
+}
+
+// Ends the face of p made up of the vertices added since the last face, 
+// giving it the plane n * x = c and the given tag. Faces with fewer than 3 
+// vertices are dropped.
+static void end_face(polyhedron_t* p, vector_t* n, real_t c, int tag)
+{
+  int f = p->num_faces;
+  if (p->num_vertices - p->face_offsets[f] < 3)
+    p->num_vertices = p->face_offsets[f];
+  else
+  {
+    p->tags[f] = tag;
+    p->normals[f] = *n;
+    p->offsets[f] = c;
+    p->face_offsets[f+1] = p->num_vertices;
+    ++p->num_faces;
+  }
+}
+
+// Makes p the given box.
+static void make_box(polyhedron_t* p, bbox_t* bbox)
+{
+  real_t bounds[6] = {bbox->x1, bbox->x2, bbox->y1, bbox->y2, bbox->z1, bbox->z2};
+  polyhedron_reserve(p, 6, 24);
+  polyhedron_clear(p);
+  for (int f = 0; f < 6; ++f)
+  {
+    // The corners of the face turn counterclockwise about the dth axis in 
+    // this order, since the d1 axis crossed with the d2 axis is the dth.
+    int d = f / 2, d1 = (d + 1) % 3, d2 = (d + 2) % 3;
+    real_t sign = (f % 2 == 0) ? -1.0 : 1.0;
+    for (int k = 0; k < 4; ++k)
+    {
+      int j = (f % 2 == 0) ? 3 - k : k;
+      real_t x[3];
+      x[d] = bounds[f];
+      x[d1] = bounds[2*d1 + (((j == 1) || (j == 2)) ? 1 : 0)];
+      x[d2] = bounds[2*d2 + ((j >= 2) ? 1 : 0)];
+      point_t* y = &p->vertices[p->num_vertices++];
+      y->x = x[0];
+      y->y = x[1];
+      y->z = x[2];
+    }
+    vector_t n = {.x = (d == 0) ? sign : 0.0, 
+                  .y = (d == 1) ? sign : 0.0, 
+                  .z = (d == 2) ? sign : 0.0};
+    end_face(p, &n, sign * bounds[f], BOX_TAG(f));
+  }
+}
+
+// Returns the signed distance (times |n|) of x above the plane n * x = c.
+static inline real_t height(point_t* x, vector_t* n, real_t c)
+{
+  return n->x * x->x + n->y * x->y + n->z * x->z - c;
+}
+
+// Returns the point where the edge (a, b) crosses the plane on which the 
+// heights da and db (of opposite signs) of its endpoints vanish. The result 
+// doesn't depend on the order of a and b, so faces that share the edge 
+// agree on it exactly.
+static point_t edge_point(point_t* a, real_t da, point_t* b, real_t db)
+{
+  if ((a->x > b->x) || 
+      ((a->x == b->x) && ((a->y > b->y) || ((a->y == b->y) && (a->z > b->z)))))
+  {
+    point_t* x = a;
+    a = b;
+    b = x;
+    real_t dx = da;
+    da = db;
+    db = dx;
+  }
+  real_t s = da / (da - db);
+  point_t x = {.x = a->x + s * (b->x - a->x), 
+               .y = a->y + s * (b->y - a->y), 
+               .z = a->z + s * (b->z - a->z)};
+  return x;
+}
+
+// A point on the face that clipping creates, with its angle about the 
+// face's center.
+typedef struct
+{
+  real_t angle;
+  point_t x;
+} cap_point_t;
+
+static int compare_cap_points(const void* l, const void* r)
+{
+  const cap_point_t* a = l;
+  const cap_point_t* b = r;
+  if (a->angle != b->angle)
+    return (a->angle < b->angle) ? -1 : 1;
+  if (a->x.x != b->x.x)
+    return (a->x.x < b->x.x) ? -1 : 1;
+  if (a->x.y != b->x.y)
+    return (a->x.y < b->x.y) ? -1 : 1;
+  return (a->x.z < b->x.z) ? -1 : (a->x.z > b->x.z) ? 1 : 0;
+}
+
+// Scratch space for computing cells. Each block of cells allocates its own, 
+// which is reused for every cell in the block. Its size depends on the 
+// cells, not on the size of the surface.
+typedef struct
+{
+  polyhedron_t polyhedra[3];
+  int cap_capacity;
+  cap_point_t* cap;
+  int polygon_capacity;
+  point_t* polygons[2];
+  int face_capacity;
+  real_t* face_areas;
+  real_t* restricted_areas;
+  vector_t* face_moments;
+  int_array_t* candidates;
+  int_array_t* crossings;
+} scratch_t;
+
+static void scratch_init(scratch_t* s)
+{
+  memset(s, 0, sizeof(scratch_t));
+  for (int i = 0; i < 3; ++i)
+    polyhedron_reserve(&s->polyhedra[i], 32, 128);
+  s->candidates = int_array_new();
+  s->crossings = int_array_new();
+}
+
+static void scratch_destroy(scratch_t* s)
+{
+  for (int i = 0; i < 3; ++i)
+    polyhedron_destroy(&s->polyhedra[i]);
+  polymec_free(s->cap);
+  polymec_free(s->polygons[0]);
+  polymec_free(s->polygons[1]);
+  polymec_free(s->face_areas);
+  polymec_free(s->restricted_areas);
+  polymec_free(s->face_moments);
+  int_array_free(s->candidates);
+  int_array_free(s->crossings);
+}
+
+// Clips the polyhedron p to the half space n * x <= c, storing the result in 
+// q and giving the face it creates the given tag. Returns false (leaving q 
+// alone) if p is empty or already lies within the half space.
+static bool clip(scratch_t* s, 
+                 polyhedron_t* p, 
+                 vector_t* n, 
+                 real_t c, 
+                 int tag, 
+                 polyhedron_t* q)
+{
+  if (p->num_faces == 0)
+    return false;
+  real_t d[p->num_vertices];
+  real_t min_d = REAL_MAX, max_d = -REAL_MAX;
+  for (int i = 0; i < p->num_vertices; ++i)
+  {
+    d[i] = height(&p->vertices[i], n, c);
+    min_d = MIN(min_d, d[i]);
+    max_d = MAX(max_d, d[i]);
+  }
+  if (max_d <= 0.0)
+    return false;
+  polyhedron_reserve(q, p->num_faces + 1, 2 * p->num_vertices + 3 * p->num_faces);
+  polyhedron_clear(q);
+  if (min_d > 0.0)
+    return true;
+
+  // Clip each face, collecting the points on the plane.
+  int max_cap = p->num_vertices + 2 * p->num_faces;
+  if (max_cap > s->cap_capacity)
+  {
+    s->cap_capacity = MAX(max_cap, 2 * s->cap_capacity);
+    s->cap = polymec_realloc(s->cap, sizeof(cap_point_t) * s->cap_capacity);
+  }
+  int num_cap = 0;
+  for (int f = 0; f < p->num_faces; ++f)
+  {
+    int begin = p->face_offsets[f], end = p->face_offsets[f+1];
+    for (int i = begin; i < end; ++i)
+    {
+      int j = (i + 1 < end) ? i + 1 : begin;
+      if (d[i] <= 0.0)
+      {
+        q->vertices[q->num_vertices++] = p->vertices[i];
+        if (d[i] == 0.0)
+          s->cap[num_cap++].x = p->vertices[i];
+      }
+      if (((d[i] < 0.0) && (d[j] > 0.0)) || ((d[i] > 0.0) && (d[j] < 0.0)))
+      {
+        point_t x = edge_point(&p->vertices[i], d[i], &p->vertices[j], d[j]);
+        q->vertices[q->num_vertices++] = x;
+        s->cap[num_cap++].x = x;
+      }
+    }
+    end_face(q, &p->normals[f], p->offsets[f], p->tags[f]);
+  }
+
+  // Sort the points on the plane counterclockwise about n (so that the new 
+  // face faces outward), dropping duplicates.
+  if (num_cap >= 3)
+  {
+    point_t m = {.x = 0.0, .y = 0.0, .z = 0.0};
+    for (int k = 0; k < num_cap; ++k)
+    {
+      m.x += s->cap[k].x.x;
+      m.y += s->cap[k].x.y;
+      m.z += s->cap[k].x.z;
+    }
+    m.x /= num_cap;
+    m.y /= num_cap;
+    m.z /= num_cap;
+    vector_t e = {.x = 0.0, .y = 0.0, .z = 0.0}, u, v;
+    if ((fabs(n->x) <= fabs(n->y)) && (fabs(n->x) <= fabs(n->z)))
+      e.x = 1.0;
+    else if (fabs(n->y) <= fabs(n->z))
+      e.y = 1.0;
+    else
+      e.z = 1.0;
+    vector_cross(n, &e, &u);
+    vector_cross(n, &u, &v);
+    for (int k = 0; k < num_cap; ++k)
+    {
+      vector_t dx;
+      point_displacement(&m, &s->cap[k].x, &dx);
+      s->cap[k].angle = atan2(vector_dot(&dx, &v), vector_dot(&dx, &u));
+    }
+    qsort(s->cap, num_cap, sizeof(cap_point_t), compare_cap_points);
+    int begin = q->num_vertices;
+    for (int k = 0; k < num_cap; ++k)
+    {
+      point_t* x = &s->cap[k].x;
+      if (q->num_vertices > begin)
+      {
+        point_t* y = &q->vertices[q->num_vertices-1];
+        if ((x->x == y->x) && (x->y == y->y) && (x->z == y->z))
+          continue;
+      }
+      q->vertices[q->num_vertices++] = *x;
+    }
+    point_t* x = &q->vertices[begin];
+    point_t* y = &q->vertices[q->num_vertices-1];
+    if ((q->num_vertices - begin > 1) && (x->x == y->x) && (x->y == y->y) && (x->z == y->z))
+      --q->num_vertices;
+  }
+  end_face(q, n, c, tag);
+  return true;
+}
+
+// Clips the convex polygon x with n vertices to the half space 
+// normal * x <= c, storing the result in y and returning its number of 
+// vertices.
+static int clip_polygon(point_t* x, int n, vector_t* normal, real_t c, point_t* y)
+{
+  real_t d[n];
+  for (int i = 0; i < n; ++i)
+    d[i] = height(&x[i], normal, c);
+  int m = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    int j = (i + 1 < n) ? i + 1 : 0;
+    if (d[i] <= 0.0)
+      y[m++] = x[i];
+    if (((d[i] < 0.0) && (d[j] > 0.0)) || ((d[i] > 0.0) && (d[j] < 0.0)))
+      y[m++] = edge_point(&x[i], d[i], &x[j], d[j]);
+  }
+  return m;
+}
+
+// Computes the area and first moment of the convex polygon x with n vertices.
+static void integrate_polygon(point_t* x, int n, real_t* area, vector_t* moment)
+{
+  *area = 0.0;
+  moment->x = moment->y = moment->z = 0.0;
+  for (int i = 1; i < n - 1; ++i)
+  {
+    vector_t u, v, w;
+    point_displacement(&x[0], &x[i], &u);
+    point_displacement(&x[0], &x[i+1], &v);
+    vector_cross(&u, &v, &w);
+    real_t a = 0.5 * vector_mag(&w);
+    *area += a;
+    moment->x += a * (x[0].x + x[i].x + x[i+1].x) / 3.0;
+    moment->y += a * (x[0].y + x[i].y + x[i+1].y) / 3.0;
+    moment->z += a * (x[0].z + x[i].z + x[i+1].z) / 3.0;
+  }
+}
+
+// Computes the volume and first moment of the polyhedron p.
+static void integrate_polyhedron(polyhedron_t* p, real_t* volume, vector_t* moment)
+{
+  *volume = 0.0;
+  moment->x = moment->y = moment->z = 0.0;
+  if (p->num_faces == 0)
+    return;
+  point_t r = {.x = 0.0, .y = 0.0, .z = 0.0};
+  for (int i = 0; i < p->num_vertices; ++i)
+  {
+    r.x += p->vertices[i].x;
+    r.y += p->vertices[i].y;
+    r.z += p->vertices[i].z;
+  }
+  r.x /= p->num_vertices;
+  r.y /= p->num_vertices;
+  r.z /= p->num_vertices;
+  for (int f = 0; f < p->num_faces; ++f)
+  {
+    point_t* x = &p->vertices[p->face_offsets[f]];
+    int n = p->face_offsets[f+1] - p->face_offsets[f];
+    for (int i = 1; i < n - 1; ++i)
+    {
+      vector_t u, v, w;
+      point_displacement(&r, &x[0], &u);
+      point_displacement(&r, &x[i], &v);
+      point_displacement(&r, &x[i+1], &w);
+      vector_t vxw;
+      vector_cross(&v, &w, &vxw);
+      real_t V = fabs(vector_dot(&u, &vxw)) / 6.0;
+      *volume += V;
+      moment->x += V * (r.x + x[0].x + x[i].x + x[i+1].x) / 4.0;
+      moment->y += V * (r.y + x[0].y + x[i].y + x[i+1].y) / 4.0;
+      moment->z += V * (r.z + x[0].z + x[i].z + x[i+1].z) / 4.0;
+    }
+  }
+}
+
+// A closed triangulated surface, with its triangles sorted into the bins of 
+// a uniform grid over its bounding box.
+typedef struct
+{
+  point_t* vertices;
+  int* triangles;
+  int num_triangles;
+  real_t lo[3], hi[3];
+  int num_bins[3];
+  int* bin_offsets;
+  int* bin_triangles;
+} surface_t;
+
+static inline real_t coord(point_t* x, int d)
+{
+  return (d == 0) ? x->x : (d == 1) ? x->y : x->z;
+}
+
+// Returns the index along the dth axis of the bin containing the coordinate x.
+static int bin_index(surface_t* s, int d, real_t x)
+{
+  if (s->hi[d] <= s->lo[d])
+    return 0;
+  real_t r = s->num_bins[d] * (x - s->lo[d]) / (s->hi[d] - s->lo[d]);
+  if (r <= 0.0)
+    return 0;
+  else if (r >= s->num_bins[d])
+    return s->num_bins[d] - 1;
+  else
+    return (int)r;
+}
+
+static surface_t* surface_new(point_t* vertices, int* triangles, int num_triangles)
+{
+  surface_t* s = polymec_malloc(sizeof(surface_t));
+  s->vertices = vertices;
+  s->triangles = triangles;
+  s->num_triangles = num_triangles;
+  for (int d = 0; d < 3; ++d)
+  {
+    s->lo[d] = REAL_MAX;
+    s->hi[d] = -REAL_MAX;
+  }
+  for (int i = 0; i < 3*num_triangles; ++i)
+  {
+    for (int d = 0; d < 3; ++d)
+    {
+      s->lo[d] = MIN(s->lo[d], coord(&vertices[triangles[i]], d));
+      s->hi[d] = MAX(s->hi[d], coord(&vertices[triangles[i]], d));
+    }
+  }
+
+  // The triangles of a surface fill about n*n of n*n*n bins, so we aim for 
+  // a few of them per bin.
+  int n = MAX(1, MIN(128, (int)(0.5 * sqrt(num_triangles))));
+  for (int d = 0; d < 3; ++d)
+    s->num_bins[d] = n;
+  int num_bins = n * n * n;
+  s->bin_offsets = polymec_calloc(num_bins + 1, sizeof(int));
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    int counts[num_bins];
+    memset(counts, 0, sizeof(int) * num_bins);
+    for (int t = 0; t < num_triangles; ++t)
+    {
+      int lo[3], hi[3];
+      for (int d = 0; d < 3; ++d)
+      {
+        real_t x1 = REAL_MAX, x2 = -REAL_MAX;
+        for (int k = 0; k < 3; ++k)
+        {
+          x1 = MIN(x1, coord(&vertices[triangles[3*t+k]], d));
+          x2 = MAX(x2, coord(&vertices[triangles[3*t+k]], d));
+        }
+        lo[d] = bin_index(s, d, x1);
+        hi[d] = bin_index(s, d, x2);
+      }
+      for (int i = lo[0]; i <= hi[0]; ++i)
+      {
+        for (int j = lo[1]; j <= hi[1]; ++j)
+        {
+          for (int k = lo[2]; k <= hi[2]; ++k)
+          {
+            int bin = (i * n + j) * n + k;
+            if (pass == 1)
+              s->bin_triangles[s->bin_offsets[bin] + counts[bin]] = t;
+            ++counts[bin];
+          }
+        }
+      }
+    }
+    if (pass == 0)
+    {
+      for (int bin = 0; bin < num_bins; ++bin)
+        s->bin_offsets[bin+1] = s->bin_offsets[bin] + counts[bin];
+      s->bin_triangles = polymec_malloc(sizeof(int) * s->bin_offsets[num_bins]);
+    }
+  }
+  return s;
+}
+
+static void surface_free(surface_t* s)
+{
+  polymec_free(s->bin_offsets);
+  polymec_free(s->bin_triangles);
+  polymec_free(s);
+}
+
+// Returns the orientation of the projection of x onto the yz plane relative 
+// to that of the edge (a, b). Swapping a and b exactly negates the result, 
+// so triangles that share an edge agree on which side of it x lies.
+static real_t yz_orientation(point_t* a, point_t* b, point_t* x)
+{
+  real_t sign = 1.0;
+  if ((a->y > b->y) || ((a->y == b->y) && (a->z > b->z)))
+  {
+    point_t* c = a;
+    a = b;
+    b = c;
+    sign = -1.0;
+  }
+  return sign * ((b->y - a->y) * (x->z - a->z) - (b->z - a->z) * (x->y - a->y));
+}
+
+// Returns the winding number of the surface about x, found by summing the 
+// solid angles of its triangles.
+static int solid_angle_winding_number(surface_t* s, point_t* x)
+{
+  real_t omega = 0.0;
+  for (int t = 0; t < s->num_triangles; ++t)
+  {
+    vector_t a, b, c, bxc;
+    point_displacement(x, &s->vertices[s->triangles[3*t]], &a);
+    point_displacement(x, &s->vertices[s->triangles[3*t+1]], &b);
+    point_displacement(x, &s->vertices[s->triangles[3*t+2]], &c);
+    real_t la = vector_mag(&a), lb = vector_mag(&b), lc = vector_mag(&c);
+    real_t den = la * lb * lc + vector_dot(&a, &b) * lc +
+                 vector_dot(&a, &c) * lb + vector_dot(&b, &c) * la;
+    vector_cross(&b, &c, &bxc);
+    omega += 2.0 * atan2(vector_dot(&a, &bxc), den);
+  }
+  return (int)floor(omega / (4.0 * M_PI) + 0.5);
+}
+
+// Returns the winding number of the surface about x, found by counting the 
+// triangles crossed by the ray from x in the +x direction. If the ray 
+// grazes an edge of a triangle, we sum solid angles instead.
+static int winding_number(surface_t* s, point_t* x)
+{
+  if ((x->x > s->hi[0]) || (x->y < s->lo[1]) || (x->y > s->hi[1]) || 
+      (x->z < s->lo[2]) || (x->z > s->hi[2]))
+    return 0;
+  int j = bin_index(s, 1, x->y), k = bin_index(s, 2, x->z);
+  int w = 0;
+  for (int i = bin_index(s, 0, x->x); i < s->num_bins[0]; ++i)
+  {
+    int bin = (i * s->num_bins[1] + j) * s->num_bins[2] + k;
+    for (int l = s->bin_offsets[bin]; l < s->bin_offsets[bin+1]; ++l)
+    {
+      int t = s->bin_triangles[l];
+      point_t* a = &s->vertices[s->triangles[3*t]];
+      point_t* b = &s->vertices[s->triangles[3*t+1]];
+      point_t* c = &s->vertices[s->triangles[3*t+2]];
+      real_t oa = yz_orientation(b, c, x), 
+             ob = yz_orientation(c, a, x), 
+             oc = yz_orientation(a, b, x);
+      if (((oa < 0.0) || (ob < 0.0) || (oc < 0.0)) && 
+          ((oa > 0.0) || (ob > 0.0) || (oc > 0.0)))
+        continue;
+      if ((oa == 0.0) || (ob == 0.0) || (oc == 0.0))
+        return solid_angle_winding_number(s, x);
+
+      // The ray crosses the triangle at hx. We count each crossing only in 
+      // the bin that contains it, since the triangle may lie in several.
+      real_t hx = (oa * a->x + ob * b->x + oc * c->x) / (oa + ob + oc);
+      if (hx == x->x)
+        return solid_angle_winding_number(s, x);
+      if ((hx > x->x) && (bin_index(s, 0, hx) == i))
+        w += (oa > 0.0) ? 1 : -1;
+    }
+  }
+  return w;
+}
+
+// A face of a cell.
+typedef struct
+{
+  int cell, boundary;
+  real_t area;
+  point_t center;
+} cell_face_t;
+
+// Data shared by all blocks of cells.
+typedef struct
+{
+  point_t* generators;
+  int num_generators;
+  bbox_t* bbox;
+  delaunay_adjacency_t* adj;
+  surface_t* surface;
+  real_t* volumes;
+  point_t* centers;
+  int* face_counts;
+} cells_context_t;
+
+// A block of cells computed by one thread, with the faces it finds.
+typedef struct
+{
+  cells_context_t* context;
+  int begin, end;
+  int num_faces, face_capacity;
+  cell_face_t* faces;
+} cell_block_t;
+
+static void append_face(cell_block_t* block, 
+                        int cell, 
+                        int boundary, 
+                        real_t area, 
+                        vector_t* moment)
+{
+  if (block->num_faces == block->face_capacity)
+  {
+    block->face_capacity = MAX(64, 2 * block->face_capacity);
+    block->faces = polymec_realloc(block->faces, sizeof(cell_face_t) * block->face_capacity);
+  }
+  cell_face_t* face = &block->faces[block->num_faces++];
+  face->cell = cell;
+  face->boundary = boundary;
+  face->area = area;
+  face->center.x = moment->x / area;
+  face->center.y = moment->y / area;
+  face->center.z = moment->z / area;
+}
+
+// Clips p by the bisector of the generators g and h, storing the result in q 
+// if it changes.
+static bool clip_bisector(scratch_t* s, 
+                          point_t* generators, 
+                          int g, 
+                          int h, 
+                          polyhedron_t* p, 
+                          polyhedron_t* q)
+{
+  point_t* x = &generators[g];
+  point_t* y = &generators[h];
+  vector_t n;
+  point_displacement(x, y, &n);
+  real_t c = 0.5 * (n.x * (x->x + y->x) + n.y * (x->y + y->y) + n.z * (x->z + y->z));
+  return clip(s, p, &n, c, h, q);
+}
+
+// Clips the cell p to the shadow of the triangle (a, b, c) as seen from x, 
+// using q and r for scratch space. Returns the shadow (which may be p 
+// itself), and stores in sign the change in the winding number across the 
+// triangle going away from x, or 0 if x lies in its plane.
+static polyhedron_t* shadow(scratch_t* s, 
+                            polyhedron_t* p, 
+                            point_t* x, 
+                            point_t* a, point_t* b, point_t* c, 
+                            polyhedron_t* q, 
+                            polyhedron_t* r, 
+                            int* sign)
+{
+  vector_t u, v, n;
+  point_displacement(a, b, &u);
+  point_displacement(a, c, &v);
+  vector_cross(&u, &v, &n);
+  real_t h = height(x, &n, height(a, &n, 0.0));
+  if (h == 0.0)
+  {
+    *sign = 0;
+    return p;
+  }
+
+  // The planes through x and the edges of the triangle, oriented away from 
+  // the vertices opposite them, and then the plane of the triangle, 
+  // oriented toward x.
+  vector_t normals[4];
+  real_t offsets[4];
+  point_t* corners[3] = {a, b, c};
+  for (int i = 0; i < 3; ++i)
+  {
+    point_t* y = corners[i];
+    point_t* z = corners[(i+1)%3];
+    point_t* w = corners[(i+2)%3];
+    point_displacement(x, y, &u);
+    point_displacement(x, z, &v);
+    vector_cross(&u, &v, &normals[i]);
+    offsets[i] = height(x, &normals[i], 0.0);
+    if (height(w, &normals[i], offsets[i]) > 0.0)
+    {
+      vector_scale(&normals[i], -1.0);
+      offsets[i] = -offsets[i];
+    }
+  }
+  normals[3] = n;
+  offsets[3] = height(a, &n, 0.0);
+  *sign = 1;
+  if (h < 0.0)
+  {
+    vector_scale(&normals[3], -1.0);
+    offsets[3] = -offsets[3];
+    *sign = -1;
+  }
+
+  polyhedron_t* shadow = p;
+  for (int i = 0; (i < 4) && (shadow->num_faces > 0); ++i)
+  {
+    polyhedron_t* next = (shadow == q) ? r : q;
+    if (clip(s, shadow, &normals[i], offsets[i], SHADOW_TAG, next))
+      shadow = next;
+  }
+  return shadow;
+}
+
+// Computes the restricted cell of the generator g, appending its faces to 
+// those of the block.
+static void compute_cell(cell_block_t* block, scratch_t* s, int g)
+{
+  cells_context_t* context = block->context;
+  point_t* generators = context->generators;
+  polyhedron_t* p = &s->polyhedra[0];
+  polyhedron_t* q = &s->polyhedra[1];
+  polyhedron_t* r = &s->polyhedra[2];
+
+  // Clip the box by the bisectors.
+  make_box(p, context->bbox);
+  if (context->adj != NULL)
+  {
+    delaunay_adjacency_t* adj = context->adj;
+    for (int k = adj->vertex_edge_offsets[g]; k < adj->vertex_edge_offsets[g+1]; ++k)
+    {
+      int e = adj->vertex_edges[k];
+      int h = (adj->edge_vertices[2*e] == g) ? adj->edge_vertices[2*e+1] : adj->edge_vertices[2*e];
+      if (clip_bisector(s, generators, g, h, p, q))
+      {
+        polyhedron_t* tmp = p;
+        p = q;
+        q = tmp;
+      }
+    }
+  }
+  else
+  {
+    for (int h = 0; h < context->num_generators; ++h)
+    {
+      if ((h != g) && clip_bisector(s, generators, g, h, p, q))
+      {
+        polyhedron_t* tmp = p;
+        p = q;
+        q = tmp;
+      }
+    }
+  }
+
+  // Integrate over the clipped cell.
+  if (p->num_faces > s->face_capacity)
+  {
+    s->face_capacity = MAX(p->num_faces, 2 * s->face_capacity);
+    s->face_areas = polymec_realloc(s->face_areas, sizeof(real_t) * s->face_capacity);
+    s->restricted_areas = polymec_realloc(s->restricted_areas, sizeof(real_t) * s->face_capacity);
+    s->face_moments = polymec_realloc(s->face_moments, sizeof(vector_t) * s->face_capacity);
+  }
+  real_t cell_volume, volume;
+  vector_t moment;
+  integrate_polyhedron(p, &cell_volume, &moment);
+  for (int f = 0; f < p->num_faces; ++f)
+  {
+    int n = p->face_offsets[f+1] - p->face_offsets[f];
+    integrate_polygon(&p->vertices[p->face_offsets[f]], n, &s->face_areas[f], &s->face_moments[f]);
+    s->restricted_areas[f] = s->face_areas[f];
+  }
+  volume = cell_volume;
+
+  // Restrict it to the surface.
+  real_t surface_area = 0.0;
+  vector_t surface_moment = {.x = 0.0, .y = 0.0, .z = 0.0};
+  surface_t* surface = context->surface;
+  if ((surface != NULL) && (p->num_faces > 0))
+  {
+    // Find the triangles in the bins that the cell (and its generator, if 
+    // it lies outside the cell) overlaps.
+    bbox_t* bbox = context->bbox;
+    point_t* xg = &generators[g];
+    bool outside = (xg->x < bbox->x1) || (xg->x > bbox->x2) || 
+                   (xg->y < bbox->y1) || (xg->y > bbox->y2) || 
+                   (xg->z < bbox->z1) || (xg->z > bbox->z2);
+    real_t lo[3] = {REAL_MAX, REAL_MAX, REAL_MAX}, hi[3] = {-REAL_MAX, -REAL_MAX, -REAL_MAX};
+    for (int i = 0; i < p->num_vertices; ++i)
+    {
+      for (int d = 0; d < 3; ++d)
+      {
+        lo[d] = MIN(lo[d], coord(&p->vertices[i], d));
+        hi[d] = MAX(hi[d], coord(&p->vertices[i], d));
+      }
+    }
+    if (outside)
+    {
+      for (int d = 0; d < 3; ++d)
+      {
+        lo[d] = MIN(lo[d], coord(xg, d));
+        hi[d] = MAX(hi[d], coord(xg, d));
+      }
+    }
+    int_array_clear(s->candidates);
+    if ((lo[0] <= surface->hi[0]) && (hi[0] >= surface->lo[0]) && 
+        (lo[1] <= surface->hi[1]) && (hi[1] >= surface->lo[1]) && 
+        (lo[2] <= surface->hi[2]) && (hi[2] >= surface->lo[2]))
+    {
+      int bins[3][2];
+      for (int d = 0; d < 3; ++d)
+      {
+        bins[d][0] = bin_index(surface, d, lo[d]);
+        bins[d][1] = bin_index(surface, d, hi[d]);
+      }
+      for (int i = bins[0][0]; i <= bins[0][1]; ++i)
+      {
+        for (int j = bins[1][0]; j <= bins[1][1]; ++j)
+        {
+          for (int k = bins[2][0]; k <= bins[2][1]; ++k)
+          {
+            int bin = (i * surface->num_bins[1] + j) * surface->num_bins[2] + k;
+            for (int l = surface->bin_offsets[bin]; l < surface->bin_offsets[bin+1]; ++l)
+              int_array_append(s->candidates, surface->bin_triangles[l]);
+          }
+        }
+      }
+
+      // A triangle that spans several bins is listed in each of them.
+      int_qsort(s->candidates->data, s->candidates->size);
+      size_t num_candidates = 0;
+      for (size_t l = 0; l < s->candidates->size; ++l)
+      {
+        if ((l == 0) || (s->candidates->data[l] != s->candidates->data[l-1]))
+          s->candidates->data[num_candidates++] = s->candidates->data[l];
+      }
+      int_array_resize(s->candidates, num_candidates);
+    }
+
+    // Clip each candidate to the cell, keeping those that cut it, or all of 
+    // them if the generator lies outside the cell (in which case those whose 
+    // shadows are empty are skipped below).
+    int polygon_size = 3 + p->num_faces;
+    if (polygon_size > s->polygon_capacity)
+    {
+      s->polygon_capacity = MAX(polygon_size, 2 * s->polygon_capacity);
+      s->polygons[0] = polymec_realloc(s->polygons[0], sizeof(point_t) * s->polygon_capacity);
+      s->polygons[1] = polymec_realloc(s->polygons[1], sizeof(point_t) * s->polygon_capacity);
+    }
+    int_array_clear(s->crossings);
+    for (size_t l = 0; l < s->candidates->size; ++l)
+    {
+      int t = s->candidates->data[l];
+      point_t* x = s->polygons[0];
+      point_t* y = s->polygons[1];
+      for (int k = 0; k < 3; ++k)
+        x[k] = surface->vertices[surface->triangles[3*t+k]];
+      int n = 3;
+      for (int f = 0; (f < p->num_faces) && (n >= 3); ++f)
+      {
+        n = clip_polygon(x, n, &p->normals[f], p->offsets[f], y);
+        point_t* tmp = x;
+        x = y;
+        y = tmp;
+      }
+      bool cuts = false;
+      if (n >= 3)
+      {
+        real_t area;
+        vector_t m;
+        integrate_polygon(x, n, &area, &m);
+        if (area > 0.0)
+        {
+          surface_area += area;
+          surface_moment.x += m.x;
+          surface_moment.y += m.y;
+          surface_moment.z += m.z;
+          cuts = true;
+        }
+      }
+      if (cuts || outside)
+        int_array_append(s->crossings, t);
+    }
+
+    // Weight the cell by the winding number about its generator and add the 
+    // signed contributions of the shadows of the triangles that cut it.
+    int w = winding_number(surface, &generators[g]);
+    volume = w * cell_volume;
+    moment.x *= w;
+    moment.y *= w;
+    moment.z *= w;
+    for (int f = 0; f < p->num_faces; ++f)
+    {
+      s->restricted_areas[f] = w * s->face_areas[f];
+      s->face_moments[f].x *= w;
+      s->face_moments[f].y *= w;
+      s->face_moments[f].z *= w;
+    }
+    for (size_t l = 0; l < s->crossings->size; ++l)
+    {
+      int t = s->crossings->data[l];
+      int sign;
+      polyhedron_t* sh = shadow(s, p, &generators[g], 
+                                &surface->vertices[surface->triangles[3*t]], 
+                                &surface->vertices[surface->triangles[3*t+1]], 
+                                &surface->vertices[surface->triangles[3*t+2]], 
+                                q, r, &sign);
+      if ((sign == 0) || (sh->num_faces == 0))
+        continue;
+      real_t V;
+      vector_t M;
+      integrate_polyhedron(sh, &V, &M);
+      volume += sign * V;
+      moment.x += sign * M.x;
+      moment.y += sign * M.y;
+      moment.z += sign * M.z;
+      for (int f = 0; f < sh->num_faces; ++f)
+      {
+        if (sh->tags[f] == SHADOW_TAG)
+          continue;
+        int pf = 0;
+        while ((pf < p->num_faces) && (p->tags[pf] != sh->tags[f]))
+          ++pf;
+        ASSERT(pf < p->num_faces);
+        real_t A;
+        int n = sh->face_offsets[f+1] - sh->face_offsets[f];
+        integrate_polygon(&sh->vertices[sh->face_offsets[f]], n, &A, &M);
+        s->restricted_areas[pf] += sign * A;
+        s->face_moments[pf].x += sign * M.x;
+        s->face_moments[pf].y += sign * M.y;
+        s->face_moments[pf].z += sign * M.z;
+      }
+    }
+  }
+
+  // Record the cell and its faces.
+  if (volume > EMPTY_FRACTION * cell_volume)
+  {
+    context->volumes[g] = volume;
+    context->centers[g].x = moment.x / volume;
+    context->centers[g].y = moment.y / volume;
+    context->centers[g].z = moment.z / volume;
+  }
+  else
+  {
+    context->volumes[g] = 0.0;
+    context->centers[g] = generators[g];
+  }
+  int num_faces = block->num_faces;
+  for (int f = 0; f < p->num_faces; ++f)
+  {
+    if (s->restricted_areas[f] > EMPTY_FRACTION * s->face_areas[f])
+    {
+      int tag = p->tags[f];
+      append_face(block, (tag >= 0) ? tag : -1, (tag >= 0) ? -1 : -1 - tag, 
+                  s->restricted_areas[f], &s->face_moments[f]);
+    }
+  }
+  if (surface_area > 0.0)
+    append_face(block, -1, RESTRICTED_VORONOI_SURFACE, surface_area, &surface_moment);
+  context->face_counts[g] = block->num_faces - num_faces;
+}
+
+static void compute_cells(void* context)
+{
+  cell_block_t* block = context;
+  scratch_t scratch;
+  scratch_init(&scratch);
+  for (int g = block->begin; g < block->end; ++g)
+    compute_cell(block, &scratch, g);
+  scratch_destroy(&scratch);
+}
+
+// Returns true if the given points don't all lie in one plane.
+static bool span_volume(point_t* points, int num_points)
+{
+  int a = 0, b = 1, c = -1;
+  while ((b < num_points) && (point_distance(&points[a], &points[b]) == 0.0))
+    ++b;
+  for (int i = b+1; i < num_points; ++i)
+  {
+    vector_t u, v, uxv;
+    point_displacement(&points[a], &points[b], &u);
+    point_displacement(&points[a], &points[i], &v);
+    vector_cross(&u, &v, &uxv);
+    if (vector_mag(&uxv) > 0.0)
+    {
+      c = i;
+      break;
+    }
+  }
+  if (c == -1)
+    return false;
+  for (int i = 0; i < num_points; ++i)
+  {
+    if (robust_orientation(&points[a], &points[b], &points[c], &points[i]) != 0.0)
+      return true;
+  }
+  return false;
+}
+
+restricted_voronoi_cells_t* restricted_voronoi_cells_new(point_t* generators, 
+                                                         int num_generators, 
+                                                         bbox_t* bounding_box, 
+                                                         point_t* surface_vertices, 
+                                                         int* surface_triangles, 
+                                                         int num_surface_triangles)
+{
+  ASSERT(num_generators > 0);
+  ASSERT((num_surface_triangles == 0) || (surface_vertices != NULL));
+
+  // Find the neighbors of the generators.
+  delaunay_triangulation_t* t = NULL;
+  delaunay_adjacency_t* adj = NULL;
+  if ((num_generators >= MIN_TRIANGULATED_GENERATORS) && 
+      span_volume(generators, num_generators))
+  {
+    t = delaunay_triangulation_new(generators, num_generators);
+    adj = delaunay_adjacency_new(t);
+    for (int g = 0; g < num_generators; ++g)
+    {
+      if (adj->vertex_tet_offsets[g+1] == adj->vertex_tet_offsets[g])
+        polymec_error("restricted_voronoi_cells_new: generator %d coincides with another.", g);
+    }
+  }
+  else
+  {
+    for (int g = 0; g < num_generators; ++g)
+    {
+      for (int h = g+1; h < num_generators; ++h)
+      {
+        if (point_distance(&generators[g], &generators[h]) == 0.0)
+          polymec_error("restricted_voronoi_cells_new: generator %d coincides with another.", h);
+      }
+    }
+  }
+
+  restricted_voronoi_cells_t* cells = polymec_malloc(sizeof(restricted_voronoi_cells_t));
+  cells->num_cells = num_generators;
+  cells->cell_volumes = polymec_malloc(sizeof(real_t) * num_generators);
+  cells->cell_centers = polymec_malloc(sizeof(point_t) * num_generators);
+  cells->cell_face_offsets = polymec_malloc(sizeof(int) * (num_generators + 1));
+  cells_context_t context = {.generators = generators, 
+                             .num_generators = num_generators, 
+                             .bbox = bounding_box, 
+                             .adj = adj, 
+                             .surface = NULL, 
+                             .volumes = cells->cell_volumes, 
+                             .centers = cells->cell_centers, 
+                             .face_counts = &cells->cell_face_offsets[1]};
+  if (num_surface_triangles > 0)
+    context.surface = surface_new(surface_vertices, surface_triangles, num_surface_triangles);
+
+  // Compute the cells in blocks, each with its own scratch space.
+  thread_pool_t* threads = NULL;
+  int num_blocks = 1;
+  if (num_generators >= 2 * MIN_CELLS_PER_BLOCK)
+  {
+    threads = thread_pool_new();
+    num_blocks = MIN(4 * thread_pool_num_threads(threads), 
+                     num_generators / MIN_CELLS_PER_BLOCK);
+  }
+  cell_block_t blocks[num_blocks];
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    blocks[b].context = &context;
+    blocks[b].begin = (int)(((size_t)num_generators * b) / num_blocks);
+    blocks[b].end = (int)(((size_t)num_generators * (b+1)) / num_blocks);
+    blocks[b].num_faces = 0;
+    blocks[b].face_capacity = 0;
+    blocks[b].faces = NULL;
+  }
+  if (num_blocks > 1)
+  {
+    for (int b = 0; b < num_blocks; ++b)
+      thread_pool_schedule(threads, &blocks[b], compute_cells);
+    thread_pool_execute(threads);
+  }
+  else
+    compute_cells(&blocks[0]);
+  if (threads != NULL)
+    thread_pool_free(threads);
+
+  // Gather the faces, which the blocks found in the order of their cells.
+  cells->cell_face_offsets[0] = 0;
+  for (int g = 0; g < num_generators; ++g)
+    cells->cell_face_offsets[g+1] += cells->cell_face_offsets[g];
+  int num_faces = cells->cell_face_offsets[num_generators];
+  cells->face_cells = polymec_malloc(sizeof(int) * num_faces);
+  cells->face_boundaries = polymec_malloc(sizeof(int) * num_faces);
+  cells->face_areas = polymec_malloc(sizeof(real_t) * num_faces);
+  cells->face_centers = polymec_malloc(sizeof(point_t) * num_faces);
+  int k = 0;
+  for (int b = 0; b < num_blocks; ++b)
+  {
+    for (int f = 0; f < blocks[b].num_faces; ++f, ++k)
+    {
+      cells->face_cells[k] = blocks[b].faces[f].cell;
+      cells->face_boundaries[k] = blocks[b].faces[f].boundary;
+      cells->face_areas[k] = blocks[b].faces[f].area;
+      cells->face_centers[k] = blocks[b].faces[f].center;
+    }
+    if (blocks[b].faces != NULL)
+      polymec_free(blocks[b].faces);
+  }
+  ASSERT(k == num_faces);
+
+  if (context.surface != NULL)
+    surface_free(context.surface);
+  if (adj != NULL)
+  {
+    delaunay_adjacency_free(adj);
+    delaunay_triangulation_free(t);
+  }
+  return cells;
+}
+
+void restricted_voronoi_cells_free(restricted_voronoi_cells_t* cells)
+{
+  polymec_free(cells->cell_volumes);
+  polymec_free(cells->cell_centers);
+  polymec_free(cells->cell_face_offsets);
+  polymec_free(cells->face_cells);
+  polymec_free(cells->face_boundaries);
+  polymec_free(cells->face_areas);
+  polymec_free(cells->face_centers);
+  polymec_free(cells);
+}
+
@@ -0,0 +1,67 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYGLOT_RESTRICTED_VORONOI_CELLS_H
+#define POLYGLOT_RESTRICTED_VORONOI_CELLS_H
+
+#include "core/point.h"
+
+// Boundary faces of restricted Voronoi cells that lie on the surface (rather 
+// than on a face of the bounding box) have this boundary index.
+#define RESTRICTED_VORONOI_SURFACE 6
+
+// This type holds the moments of the Voronoi cells of a set of generators, 
+// restricted to a bounding box and, optionally, to the interior of a closed 
+// triangulated surface: the volumes and centroids of the cells and the 
+// areas and centroids of their faces. Each cell is clipped to the box as it 
+// is constructed, so no unbounded cells are ever built, but its part inside 
+// the surface is integrated without being constructed. So this is a 
+// moments-only API: it doesn't provide the vertices or face polygons of the 
+// restricted cells. The cells are listed by generator.
+typedef struct
+{
+  int num_cells;
+
+  // The volume and centroid of each cell. A cell that lies entirely outside 
+  // the surface has zero volume, and its center is its generator.
+  real_t* cell_volumes;
+  point_t* cell_centers;
+
+  // The faces of the ith cell are faces cell_face_offsets[i] through 
+  // cell_face_offsets[i+1]-1. The kth face is shared with the cell 
+  // face_cells[k], or lies on the boundary if face_cells[k] is -1. In that 
+  // case face_boundaries[k] is the face of the bounding box it lies on 
+  // (0 through 5, in the order x1, x2, y1, y2, z1, z2) or 
+  // RESTRICTED_VORONOI_SURFACE; it is -1 for interior faces. Each cell has 
+  // at most one face on the surface, which lumps together all of the cell's 
+  // boundary on the surface, so it need not be planar or even connected.
+  int* cell_face_offsets;
+  int* face_cells;
+  int* face_boundaries;
+  real_t* face_areas;
+  point_t* face_centers;
+} restricted_voronoi_cells_t;
+
+// Computes the Voronoi cells of the given (distinct) generators restricted 
+// to the bounding box and, if num_surface_triangles is positive, to the 
+// interior of the closed surface whose triangles have the vertices 
+// surface_vertices[surface_triangles[3*i]], ... [surface_triangles[3*i+2]], 
+// listed counterclockwise as seen from outside. Generators may lie outside 
+// the bounding box, though the cells of those are more costly to restrict 
+// to the surface. The cells are computed independently and in parallel.
+restricted_voronoi_cells_t* restricted_voronoi_cells_new(point_t* generators, 
+                                                         int num_generators, 
+                                                         bbox_t* bounding_box, 
+                                                         point_t* surface_vertices, 
+                                                         int* surface_triangles, 
+                                                         int num_surface_triangles);
+
+// Frees the given restricted Voronoi cells.
+void restricted_voronoi_cells_free(restricted_voronoi_cells_t* cells);
+
+#endif
+
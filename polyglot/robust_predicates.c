@@ -0,0 +1,220 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <float.h>
+#include "polyglot/robust_predicates.h"
+
+// We fall back on Shewchuk's exact adaptive predicates when the fast ones
+// can't determine a sign. These use his sign conventions, which are opposite
+// to ours.
+extern real_t orient3d(real_t* pa, real_t* pb, real_t* pc, real_t* pd);
+extern real_t insphere(real_t* pa, real_t* pb, real_t* pc, real_t* pd, real_t* pe);
+
+// Relative error bounds for the floating point determinants below, from
+// Shewchuk's analysis of the first stages of his adaptive predicates. The
+// fast predicates are computed in double precision regardless of real_t.
+#define EPSILON (0.5 * DBL_EPSILON)
+#define ORIENTATION_ERROR_BOUND ((7.0 + 56.0 * EPSILON) * EPSILON)
+#define IN_SPHERE_ERROR_BOUND ((16.0 + 224.0 * EPSILON) * EPSILON)
+
+// Batched tests are evaluated in blocks of this many.
+#define BLOCK_SIZE 32
+
+// Computes the orientation determinant for the tet (a, b, c, d) from the
+// displacements of a, b, c from d, storing a bound on its error in error.
+static inline double orientation_det(double adx, double ady, double adz,
+                                     double bdx, double bdy, double bdz,
+                                     double cdx, double cdy, double cdz,
+                                     double* error)
+{
+  double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+  double cdxady = cdx * ady, adxcdy = adx * cdy;
+  double adxbdy = adx * bdy, bdxady = bdx * ady;
+  double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) +
+               cdz * (adxbdy - bdxady);
+  double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * fabs(adz) +
+                     (fabs(cdxady) + fabs(adxcdy)) * fabs(bdz) +
+                     (fabs(adxbdy) + fabs(bdxady)) * fabs(cdz);
+  *error = ORIENTATION_ERROR_BOUND * permanent;
+  return det;
+}
+
+// Computes the in-sphere determinant for the tet (a, b, c, d) and the point
+// e from the displacements of a, b, c, d from e, storing a bound on its
+// error in error.
+static inline double in_sphere_det(double aex, double aey, double aez,
+                                   double bex, double bey, double bez,
+                                   double cex, double cey, double cez,
+                                   double dex, double dey, double dez,
+                                   double* error)
+{
+  double aexbey = aex * bey, bexaey = bex * aey;
+  double bexcey = bex * cey, cexbey = cex * bey;
+  double cexdey = cex * dey, dexcey = dex * cey;
+  double dexaey = dex * aey, aexdey = aex * dey;
+  double aexcey = aex * cey, cexaey = cex * aey;
+  double bexdey = bex * dey, dexbey = dex * bey;
+  double ab = aexbey - bexaey, bc = bexcey - cexbey, cd = cexdey - dexcey,
+         da = dexaey - aexdey, ac = aexcey - cexaey, bd = bexdey - dexbey;
+
+  double abc = aez * bc - bez * ac + cez * ab;
+  double bcd = bez * cd - cez * bd + dez * bc;
+  double cda = cez * da + dez * ac + aez * cd;
+  double dab = dez * ab + aez * bd + bez * da;
+
+  double alift = aex * aex + aey * aey + aez * aez;
+  double blift = bex * bex + bey * bey + bez * bez;
+  double clift = cex * cex + cey * cey + cez * cez;
+  double dlift = dex * dex + dey * dey + dez * dez;
+  double det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+
+  double aezplus = fabs(aez), bezplus = fabs(bez),
+         cezplus = fabs(cez), dezplus = fabs(dez);
+  double abplus = fabs(aexbey) + fabs(bexaey), bcplus = fabs(bexcey) + fabs(cexbey),
+         cdplus = fabs(cexdey) + fabs(dexcey), daplus = fabs(dexaey) + fabs(aexdey),
+         acplus = fabs(aexcey) + fabs(cexaey), bdplus = fabs(bexdey) + fabs(dexbey);
+  double permanent = (cdplus * bezplus + bdplus * cezplus + bcplus * dezplus) * alift +
+                     (daplus * cezplus + acplus * dezplus + cdplus * aezplus) * blift +
+                     (abplus * dezplus + bdplus * aezplus + daplus * bezplus) * clift +
+                     (bcplus * aezplus + acplus * bezplus + abplus * cezplus) * dlift;
+  *error = IN_SPHERE_ERROR_BOUND * permanent;
+  return det;
+}
+
+// Evaluates the orientation of (a, b, c, d) exactly.
+static real_t exact_orientation(point_t* a, point_t* b, point_t* c, point_t* d)
+{
+  real_t pa[3] = {a->x, a->y, a->z},
+         pb[3] = {b->x, b->y, b->z},
+         pc[3] = {c->x, c->y, c->z},
+         pd[3] = {d->x, d->y, d->z};
+  return -orient3d(pa, pb, pc, pd);
+}
+
+// Evaluates the in-sphere test of e against (a, b, c, d) exactly.
+static real_t exact_in_sphere(point_t* a, point_t* b, point_t* c, point_t* d, point_t* e)
+{
+  real_t pa[3] = {a->x, a->y, a->z},
+         pb[3] = {b->x, b->y, b->z},
+         pc[3] = {c->x, c->y, c->z},
+         pd[3] = {d->x, d->y, d->z},
+         pe[3] = {e->x, e->y, e->z};
+  return -insphere(pa, pb, pc, pd, pe);
+}
+
+real_t robust_orientation(point_t* a, point_t* b, point_t* c, point_t* d)
+{
+  double error;
+  double det = orientation_det(a->x - d->x, a->y - d->y, a->z - d->z,
+                               b->x - d->x, b->y - d->y, b->z - d->z,
+                               c->x - d->x, c->y - d->y, c->z - d->z,
+                               &error);
+  if (fabs(det) > error)
+    return (real_t)(-det);
+  else
+    return exact_orientation(a, b, c, d);
+}
+
+real_t robust_in_sphere(point_t* a, point_t* b, point_t* c, point_t* d, point_t* e)
+{
+  double error;
+  double det = in_sphere_det(a->x - e->x, a->y - e->y, a->z - e->z,
+                             b->x - e->x, b->y - e->y, b->z - e->z,
+                             c->x - e->x, c->y - e->y, c->z - e->z,
+                             d->x - e->x, d->y - e->y, d->z - e->z,
+                             &error);
+  if (fabs(det) > error)
+    return (real_t)(-det);
+  else
+    return exact_in_sphere(a, b, c, d, e);
+}
+
+void robust_orientations(int num_tests,
+                         point_t** a, point_t** b, point_t** c, point_t** d,
+                         real_t* orientations)
+{
+  for (int begin = 0; begin < num_tests; begin += BLOCK_SIZE)
+  {
+    int n = MIN(BLOCK_SIZE, num_tests - begin);
+
+    // Gather the displacements of the points in this block.
+    double adx[BLOCK_SIZE], ady[BLOCK_SIZE], adz[BLOCK_SIZE],
+           bdx[BLOCK_SIZE], bdy[BLOCK_SIZE], bdz[BLOCK_SIZE],
+           cdx[BLOCK_SIZE], cdy[BLOCK_SIZE], cdz[BLOCK_SIZE];
+    for (int i = 0; i < n; ++i)
+    {
+      point_t *xa = a[begin+i], *xb = b[begin+i], *xc = c[begin+i], *xd = d[begin+i];
+      adx[i] = xa->x - xd->x; ady[i] = xa->y - xd->y; adz[i] = xa->z - xd->z;
+      bdx[i] = xb->x - xd->x; bdy[i] = xb->y - xd->y; bdz[i] = xb->z - xd->z;
+      cdx[i] = xc->x - xd->x; cdy[i] = xc->y - xd->y; cdz[i] = xc->z - xd->z;
+    }
+
+    // Evaluate the determinants.
+    double det[BLOCK_SIZE], error[BLOCK_SIZE];
+    for (int i = 0; i < n; ++i)
+    {
+      det[i] = orientation_det(adx[i], ady[i], adz[i],
+                               bdx[i], bdy[i], bdz[i],
+                               cdx[i], cdy[i], cdz[i], &error[i]);
+    }
+
+    // Redo the uncertain ones exactly.
+    for (int i = 0; i < n; ++i)
+    {
+      int j = begin + i;
+      if (fabs(det[i]) > error[i])
+        orientations[j] = (real_t)(-det[i]);
+      else
+        orientations[j] = exact_orientation(a[j], b[j], c[j], d[j]);
+    }
+  }
+}
+
+void robust_in_spheres(int num_tests,
+                       point_t** a, point_t** b, point_t** c, point_t** d,
+                       point_t** e, real_t* in_spheres)
+{
+  for (int begin = 0; begin < num_tests; begin += BLOCK_SIZE)
+  {
+    int n = MIN(BLOCK_SIZE, num_tests - begin);
+
+    // Gather the displacements of the points in this block.
+    double aex[BLOCK_SIZE], aey[BLOCK_SIZE], aez[BLOCK_SIZE],
+           bex[BLOCK_SIZE], bey[BLOCK_SIZE], bez[BLOCK_SIZE],
+           cex[BLOCK_SIZE], cey[BLOCK_SIZE], cez[BLOCK_SIZE],
+           dex[BLOCK_SIZE], dey[BLOCK_SIZE], dez[BLOCK_SIZE];
+    for (int i = 0; i < n; ++i)
+    {
+      point_t *xa = a[begin+i], *xb = b[begin+i], *xc = c[begin+i],
+              *xd = d[begin+i], *xe = e[begin+i];
+      aex[i] = xa->x - xe->x; aey[i] = xa->y - xe->y; aez[i] = xa->z - xe->z;
+      bex[i] = xb->x - xe->x; bey[i] = xb->y - xe->y; bez[i] = xb->z - xe->z;
+      cex[i] = xc->x - xe->x; cey[i] = xc->y - xe->y; cez[i] = xc->z - xe->z;
+      dex[i] = xd->x - xe->x; dey[i] = xd->y - xe->y; dez[i] = xd->z - xe->z;
+    }
+
+    // Evaluate the determinants.
+    double det[BLOCK_SIZE], error[BLOCK_SIZE];
+    for (int i = 0; i < n; ++i)
+    {
+      det[i] = in_sphere_det(aex[i], aey[i], aez[i],
+                             bex[i], bey[i], bez[i],
+                             cex[i], cey[i], cez[i],
+                             dex[i], dey[i], dez[i], &error[i]);
+    }
+
+    // Redo the uncertain ones exactly.
+    for (int i = 0; i < n; ++i)
+    {
+      int j = begin + i;
+      if (fabs(det[i]) > error[i])
+        in_spheres[j] = (real_t)(-det[i]);
+      else
+        in_spheres[j] = exact_in_sphere(a[j], b[j], c[j], d[j], e[j]);
+    }
+  }
+}
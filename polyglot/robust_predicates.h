@@ -0,0 +1,44 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYGLOT_ROBUST_PREDICATES_H
+#define POLYGLOT_ROBUST_PREDICATES_H
+
+#include "core/point.h"
+
+// These functions evaluate the geometric predicates used to construct
+// Delaunay triangulations and convex hulls. Each test is first evaluated in
+// floating point arithmetic and checked against an error bound; only tests
+// whose signs can't be certified this way are handed to Shewchuk's exact
+// adaptive predicates. The sign of every result is therefore exact, though
+// its magnitude is only approximate. The batched versions evaluate many
+// tests at once in loops that the compiler can vectorize.
+
+// Returns a positive number if the tet (a, b, c, d) is positively oriented
+// (d lies on the side of the plane through a, b, c from which they appear
+// counterclockwise), a negative number if it is negatively oriented, and
+// zero if its vertices are coplanar.
+real_t robust_orientation(point_t* a, point_t* b, point_t* c, point_t* d);
+
+// Returns a positive number if e lies inside the circumsphere of the
+// positively oriented tet (a, b, c, d), a negative number if it lies
+// outside, and zero if it lies on the circumsphere.
+real_t robust_in_sphere(point_t* a, point_t* b, point_t* c, point_t* d, point_t* e);
+
+// Computes the orientations of the num_tests tets (a[i], b[i], c[i], d[i]),
+// storing them in orientations.
+void robust_orientations(int num_tests,
+                         point_t** a, point_t** b, point_t** c, point_t** d,
+                         real_t* orientations);
+
+// Computes the in-sphere tests of the num_tests points e[i] against the tets
+// (a[i], b[i], c[i], d[i]), storing them in in_spheres.
+void robust_in_spheres(int num_tests,
+                       point_t** a, point_t** b, point_t** c, point_t** d,
+                       point_t** e, real_t* in_spheres);
+
+#endif
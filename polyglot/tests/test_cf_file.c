@@ -10,11 +10,13 @@
 #include <setjmp.h>
 #include <string.h>
 #include "cmocka.h"
+#include "netcdf.h"
+#include "geometry/create_uniform_mesh.h"
 #include "polyglot/cf_file.h"
 
 static void test_cf_file_open(void** state)
 {
-  cf_file_t* cf = cf_file_open(CMAKE_CURRENT_SOURCE_DIR "/cf_test_data.nc");
+  cf_file_t* cf = cf_file_open(MPI_COMM_WORLD, CMAKE_CURRENT_SOURCE_DIR "/cf_test_data.nc");
   int major, minor, patch;
   cf_file_get_version(cf, &major, &minor, &patch);
   assert_int_equal(1, major);
@@ -31,7 +33,7 @@ static void test_cf_file_open(void** state)
 
 static void test_cf_file_write(void** state)
 {
-  cf_file_t* cf = cf_file_new("cf_test_write.nc");
+  cf_file_t* cf = cf_file_new(MPI_COMM_WORLD, "cf_test_write.nc");
   int major, minor, patch;
   cf_file_get_version(cf, &major, &minor, &patch);
   assert_int_equal(1, major);
@@ -60,21 +62,334 @@ static void test_cf_file_write(void** state)
   cf_file_define_time(cf, "days since 0000-1-1", "noleap");
   assert_true(cf_file_has_time_series(cf));
 
-  cf_file_append_time(cf, 0.0);
-  cf_file_append_time(cf, 1.0);
-  cf_file_append_time(cf, 2.0);
+  cf_file_define_latlon_surface_var(cf, "tas", true, "tas", 
+                                    "Surface Air Temperature", "K");
+  assert_true(cf_file_has_latlon_surface_var(cf, "tas"));
+  assert_false(cf_file_has_latlon_var(cf, "tas"));
+  real_t tas[nlat*nlon];
+  for (int t = 0; t < 3; ++t)
+  {
+    int time_index = cf_file_append_time(cf, 1.0*t);
+    assert_int_equal(t, time_index);
+    for (int i = 0; i < nlat*nlon; ++i)
+      tas[i] = 273.0 + t;
+    cf_file_write_latlon_surface_var(cf, "tas", time_index, tas);
+  }
+  assert_int_equal(3, cf_file_num_times(cf));
+
+  // Overwrite a strided window across the longitude seam in the last slice.
+  cf_latlon_window_t window = {.lat_start = 10, .lat_count = 3, .lat_stride = 2,
+                               .lon_start = nlon-3, .lon_count = 4, .lon_stride = 2};
+  real_t tas_window[3*4];
+  for (int i = 0; i < 3*4; ++i)
+    tas_window[i] = 300.0;
+  cf_file_write_latlon_surface_var_window(cf, "tas", 2, &window, tas_window);
+
+  // A static surface variable whose values encode their indices.
+  cf_file_define_latlon_surface_var(cf, "orog", false, "orog", 
+                                    "Surface Altitude", "m");
+  real_t orog[nlat*nlon];
+  for (int i = 0; i < nlat; ++i)
+    for (int j = 0; j < nlon; ++j)
+      orog[nlon*i+j] = 1000.0*i + j;
+  cf_file_write_latlon_surface_var(cf, "orog", 0, orog);
+
+  // A packed surface variable with a missing value.
+  cf_file_define_packed_latlon_surface_var(cf, "psl", false, 0.01, 1000.0, "psl", 
+                                           "Sea Level Pressure", "hPa");
+  real_t psl[nlat*nlon];
+  for (int i = 0; i < nlat*nlon; ++i)
+    psl[i] = 950.0 + 0.001*i;
+  psl[5] = NAN;
+  cf_file_write_latlon_surface_var(cf, "psl", 0, psl);
 
   cf_file_close(cf);
 
   // Read the file back in and verify its contents.
-  cf = cf_file_open("cf_test_write.nc");
+  cf = cf_file_open(MPI_COMM_WORLD, "cf_test_write.nc");
   cf_file_get_version(cf, &major, &minor, &patch);
   assert_int_equal(1, major);
   assert_int_equal(6, minor);
   assert_int_equal(0, patch);
   assert_true(cf_file_has_latlon_grid(cf));
   assert_true(cf_file_has_time_series(cf));
+  assert_int_equal(3, cf_file_num_times(cf));
+  assert_true(cf_file_has_latlon_surface_var(cf, "tas"));
+  cf_file_read_latlon_surface_var(cf, "tas", 1, tas);
+  for (int i = 0; i < nlat*nlon; ++i)
+    assert_true(fabs(tas[i] - 274.0) < 1e-12);
+
+  // Read a strided window that wraps across the longitude seam.
+  real_t orog_window[3*4];
+  cf_file_read_latlon_surface_var_window(cf, "orog", 0, &window, orog_window);
+  int lons[4] = {nlon-3, nlon-1, 1, 3};
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 4; ++j)
+      assert_true(fabs(orog_window[4*i+j] - (1000.0*(10+2*i) + lons[j])) < 1e-12);
+
+  // Packed values come back to within half the scale factor.
+  real_t scale_factor, add_offset;
+  assert_true(cf_file_get_packing(cf, "psl", &scale_factor, &add_offset));
+  assert_true(fabs(scale_factor - 0.01) < 1e-6);
+  assert_true(fabs(add_offset - 1000.0) < 1e-6);
+  assert_false(cf_file_get_packing(cf, "orog", &scale_factor, &add_offset));
+  cf_file_read_latlon_surface_var(cf, "psl", 0, psl);
+  for (int i = 0; i < nlat*nlon; ++i)
+  {
+    if (i == 5)
+      assert_true(isnan(psl[i]));
+    else
+      assert_true(fabs(psl[i] - (950.0 + 0.001*i)) <= 0.005 + 1e-4);
+  }
+
+  // Check the window written to the last time slice.
+  cf_file_read_latlon_surface_var(cf, "tas", 2, tas);
+  for (int i = 0; i < nlat; ++i)
+  {
+    for (int j = 0; j < nlon; ++j)
+    {
+      bool in_window = ((i >= 10) && (i <= 14) && ((i % 2) == 0) &&
+                        ((j == nlon-3) || (j == nlon-1) || (j == 1) || (j == 3)));
+      real_t expected = (in_window) ? 300.0 : 275.0;
+      assert_true(fabs(tas[nlon*i+j] - expected) < 1e-12);
+    }
+  }
+  cf_file_close(cf);
+}
+
+static void test_cf_file_packed_types(void** state)
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  int nlat = 4, nlon = 8, nlev = 1;
+  real_t lat[nlat], lon[nlon], lev[nlev];
+  for (int i = 0; i < nlat; ++i)
+    lat[i] = -67.5 + 45.0*i;
+  for (int i = 0; i < nlon; ++i)
+    lon[i] = 45.0*i;
+  lev[0] = 0.0;
+  cf_file_t* cf = cf_file_new(MPI_COMM_WORLD, "cf_test_packed_types.nc");
+  cf_file_define_latlon_grid(cf, 
+                             nlat, "degree_north",
+                             nlon, "degree_east",
+                             nlev, "level", "up");
+  cf_file_write_latlon_grid(cf, lat, lon, lev);
+  cf_file_close(cf);
+
+  // Add variables packed the way other tools pack them: a float variable 
+  // with only a scale factor, and a byte variable with a fill value and a 
+  // missing value.
+  if (rank == 0)
+  {
+    int file_id, lat_dim, lon_dim, sf_id, pb_id;
+    assert_int_equal(NC_NOERR, nc_open("cf_test_packed_types.nc", NC_WRITE, &file_id));
+    assert_int_equal(NC_NOERR, nc_redef(file_id));
+    assert_int_equal(NC_NOERR, nc_inq_dimid(file_id, "lat", &lat_dim));
+    assert_int_equal(NC_NOERR, nc_inq_dimid(file_id, "lon", &lon_dim));
+    int dims[2] = {lat_dim, lon_dim};
+    assert_int_equal(NC_NOERR, nc_def_var(file_id, "sf", NC_FLOAT, 2, dims, &sf_id));
+    float scale = 0.5f;
+    assert_int_equal(NC_NOERR, nc_put_att_float(file_id, sf_id, "scale_factor", NC_FLOAT, 1, &scale));
+    assert_int_equal(NC_NOERR, nc_def_var(file_id, "pb", NC_BYTE, 2, dims, &pb_id));
+    float byte_packing[2] = {2.0f, 100.0f};
+    signed char byte_fill[2] = {-128, 127};
+    assert_int_equal(NC_NOERR, nc_put_att_float(file_id, pb_id, "scale_factor", NC_FLOAT, 1, &byte_packing[0]));
+    assert_int_equal(NC_NOERR, nc_put_att_float(file_id, pb_id, "add_offset", NC_FLOAT, 1, &byte_packing[1]));
+    assert_int_equal(NC_NOERR, nc_put_att_schar(file_id, pb_id, "_FillValue", NC_BYTE, 1, &byte_fill[0]));
+    assert_int_equal(NC_NOERR, nc_put_att_schar(file_id, pb_id, "missing_value", NC_BYTE, 1, &byte_fill[1]));
+    assert_int_equal(NC_NOERR, nc_enddef(file_id));
+    float sf[nlat*nlon];
+    signed char pb[nlat*nlon];
+    for (int i = 0; i < nlat*nlon; ++i)
+    {
+      sf[i] = 1.5f*i;
+      pb[i] = (signed char)(4*i - 60);
+    }
+    pb[3] = -128;
+    pb[7] = 127;
+    assert_int_equal(NC_NOERR, nc_put_var_float(file_id, sf_id, sf));
+    assert_int_equal(NC_NOERR, nc_put_var_schar(file_id, pb_id, pb));
+    assert_int_equal(NC_NOERR, nc_close(file_id));
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  cf = cf_file_open(MPI_COMM_WORLD, "cf_test_packed_types.nc");
+  real_t scale_factor, add_offset, values[nlat*nlon];
+  assert_true(cf_file_get_packing(cf, "sf", &scale_factor, &add_offset));
+  assert_true(fabs(scale_factor - 0.5) < 1e-12);
+  assert_true(fabs(add_offset) < 1e-12);
+  cf_file_read_latlon_surface_var(cf, "sf", 0, values);
+  for (int i = 0; i < nlat*nlon; ++i)
+    assert_true(fabs(values[i] - 0.75*i) < 1e-6);
+  assert_true(cf_file_get_packing(cf, "pb", &scale_factor, &add_offset));
+  cf_file_read_latlon_surface_var(cf, "pb", 0, values);
+  for (int i = 0; i < nlat*nlon; ++i)
+  {
+    if ((i == 3) || (i == 7))
+      assert_true(isnan(values[i]));
+    else
+      assert_true(fabs(values[i] - (2.0*(4*i - 60) + 100.0)) < 1e-6);
+  }
+  cf_file_close(cf);
+}
+
+static void test_cf_file_parallel_write(void** state)
+{
+  int nprocs;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+
+  cf_file_t* cf = cf_file_new(MPI_COMM_WORLD, "cf_test_parallel_write.nc");
+  int nlat = 45, nlon = 90, nlev = 5;
+  real_t lat[nlat], lon[nlon], lev[nlev];
+  for (int i = 0; i < nlat; ++i)
+    lat[i] = -90.0 + 180.0*i/(nlat-1);
+  for (int i = 0; i < nlon; ++i)
+    lon[i] = 360.0*i/nlon;
+  for (int i = 0; i < nlev; ++i)
+    lev[i] = 1.0*i;
+  cf_file_define_latlon_grid(cf, 
+                             nlat, "degree_north",
+                             nlon, "degree_east",
+                             nlev, "level", "up");
+  cf_file_write_latlon_grid(cf, lat, lon, lev);
+  cf_file_define_time(cf, "days since 0000-1-1", "noleap");
+  cf_file_define_latlon_var(cf, "ta", true, "ta", "Air Temperature", "K");
+  int time_index = cf_file_append_time(cf, 0.0);
+
+  // Each process writes its own latitude band.
+  cf_latlon_window_t window;
+  cf_file_get_local_latlon_window(cf, 1, &window);
+  assert_int_equal(nlon, window.lon_count);
+  real_t ta[nlev*nlat*nlon];
+  for (int k = 0; k < window.lev_count; ++k)
+    for (int i = 0; i < window.lat_count; ++i)
+      for (int j = 0; j < window.lon_count; ++j)
+        ta[window.lat_count*window.lon_count*k + window.lon_count*i + j] = 
+          1e6*k + 1e3*(window.lat_start+i) + j;
+  cf_file_write_latlon_var_window(cf, "ta", time_index, &window, ta);
+
+  // Append a batch of times and write a surface variable for all of them.
+  real_t times[4] = {1.0, 2.0, 3.0, 4.0};
+  assert_int_equal(1, cf_file_append_times(cf, 4, times));
+  assert_int_equal(5, cf_file_num_times(cf));
+  cf_file_define_latlon_surface_var(cf, "pr", true, "pr", "Precipitation", "kg m-2 s-1");
+  real_t pr[5*nlat*nlon];
+  for (int t = 0; t < 5; ++t)
+    for (int i = 0; i < nlat*nlon; ++i)
+      pr[nlat*nlon*t + i] = 1.0*t + 1e-3*i;
+  cf_file_write_latlon_surface_var_times(cf, "pr", 0, 5, pr);
+  cf_file_close(cf);
+
+  // Every process reads the whole variable back.
+  cf = cf_file_open(MPI_COMM_WORLD, "cf_test_parallel_write.nc");
+  assert_true(cf_file_has_latlon_var(cf, "ta"));
+  cf_file_read_latlon_var(cf, "ta", 0, ta);
+  for (int k = 0; k < nlev; ++k)
+    for (int i = 0; i < nlat; ++i)
+      for (int j = 0; j < nlon; ++j)
+        assert_true(fabs(ta[nlat*nlon*k + nlon*i + j] - (1e6*k + 1e3*i + j)) < 1e-12);
+
+  // Read a batch of time slices and a point time series.
+  assert_int_equal(5, cf_file_num_times(cf));
+  cf_file_read_latlon_surface_var_times(cf, "pr", 2, 3, pr);
+  for (int t = 0; t < 3; ++t)
+    for (int i = 0; i < nlat*nlon; ++i)
+      assert_true(fabs(pr[nlat*nlon*t + i] - (2.0 + t + 1e-3*i)) < 1e-5);
+  real_t pr_series[5];
+  cf_file_read_latlon_surface_var_time_series(cf, "pr", 3, 7, pr_series);
+  for (int t = 0; t < 5; ++t)
+    assert_true(fabs(pr_series[t] - (1.0*t + 1e-3*(nlon*3+7))) < 1e-5);
+
+  // Read 2D tiles if we can.
+  if ((nprocs % 2) == 0)
+  {
+    cf_file_get_local_latlon_window(cf, 2, &window);
+    cf_file_read_latlon_var_window(cf, "ta", 0, &window, ta);
+    for (int k = 0; k < window.lev_count; ++k)
+      for (int i = 0; i < window.lat_count; ++i)
+        for (int j = 0; j < window.lon_count; ++j)
+          assert_true(fabs(ta[window.lat_count*window.lon_count*k + window.lon_count*i + j] - 
+                           (1e6*k + 1e3*(window.lat_start+i) + window.lon_start+j)) < 1e-12);
+  }
+  cf_file_close(cf);
+}
+
+static void test_cf_file_write_mesh(void** state)
+{
+  // Each process writes its own 4x4x4 mesh.
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  mesh_t* mesh = create_uniform_mesh(MPI_COMM_SELF, 4, 4, 4, &bbox);
+  cf_file_t* cf = cf_file_new(MPI_COMM_WORLD, "cf_test_mesh.nc");
+  cf_file_write_mesh(cf, "mesh", mesh, NULL, NULL);
+  cf_file_define_mesh_var(cf, "rho", CF_MESH_CELL, false, "rho", "Density", "kg m-3");
+  int first_node, first_cell;
+  cf_file_get_local_mesh_offsets(cf, &first_node, &first_cell);
+  real_t rho[mesh->num_cells];
+  for (int c = 0; c < mesh->num_cells; ++c)
+    rho[c] = 1.0*(first_cell + c);
+  cf_file_write_mesh_var(cf, "rho", 0, first_cell, mesh->num_cells, rho);
+  cf_file_close(cf);
+
+  // Read it back.
+  cf = cf_file_open(MPI_COMM_WORLD, "cf_test_mesh.nc");
+  assert_true(cf_file_has_mesh(cf));
+  assert_true(cf_file_has_mesh_var(cf, "rho"));
+  int nprocs;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  char mesh_name[POLYGLOT_CF_MAX_NAME+1];
+  int num_nodes, num_faces, num_cells, max_face_nodes, max_cell_nodes, max_cell_faces;
+  cf_file_get_mesh_metadata(cf, mesh_name, &num_nodes, &num_faces, &num_cells,
+                            &max_face_nodes, &max_cell_nodes, &max_cell_faces);
+  assert_int_equal(0, strcmp(mesh_name, "mesh"));
+  assert_int_equal(nprocs*mesh->num_nodes, num_nodes);
+  assert_int_equal(nprocs*mesh->num_faces, num_faces);
+  assert_int_equal(nprocs*mesh->num_cells, num_cells);
+  assert_int_equal(4, max_face_nodes);
+  assert_int_equal(8, max_cell_nodes);
+  assert_int_equal(6, max_cell_faces);
+  point_t nodes[mesh->num_nodes];
+  cf_file_read_mesh_nodes(cf, first_node, mesh->num_nodes, nodes);
+  for (int n = 0; n < mesh->num_nodes; ++n)
+    assert_true(point_distance(&nodes[n], &mesh->nodes[n]) < 1e-12);
+  cf_file_read_mesh_var(cf, "rho", 0, first_cell, mesh->num_cells, rho);
+  for (int c = 0; c < mesh->num_cells; ++c)
+    assert_true(fabs(rho[c] - 1.0*(first_cell + c)) < 1e-12);
+
+  // Each cell is a hexahedron whose top nodes lie one cell width above 
+  // its base nodes in the direction of the base's (inward) normal.
+  int cell_node_offsets[mesh->num_cells+1], cell_nodes[8*mesh->num_cells];
+  cf_mesh_shape_t cell_shapes[mesh->num_cells];
+  cf_file_read_mesh_cell_nodes(cf, first_cell, mesh->num_cells, 
+                               cell_node_offsets, cell_nodes, cell_shapes);
+  for (int c = 0; c < mesh->num_cells; ++c)
+  {
+    assert_int_equal(CF_MESH_HEXAHEDRON, cell_shapes[c]);
+    assert_int_equal(8*c, cell_node_offsets[c]);
+    point_t x[8];
+    for (int n = 0; n < 8; ++n)
+    {
+      int node = cell_nodes[8*c+n] - first_node;
+      assert_true((node >= 0) && (node < mesh->num_nodes));
+      x[n] = nodes[node];
+    }
+    vector_t e1, e2, normal, up;
+    point_displacement(&x[0], &x[1], &e1);
+    point_displacement(&x[0], &x[3], &e2);
+    vector_cross(&e1, &e2, &normal);
+    for (int n = 0; n < 4; ++n)
+    {
+      point_displacement(&x[n], &x[n+4], &up);
+      assert_true(fabs(vector_mag(&up) - 0.25) < 1e-12);
+      assert_true(vector_dot(&normal, &up) > 0.0);
+    }
+  }
+  int cell_face_offsets[mesh->num_cells+1], cell_faces[6*mesh->num_cells];
+  cf_file_read_mesh_cells(cf, first_cell, mesh->num_cells, cell_face_offsets, cell_faces);
+  assert_int_equal(6*mesh->num_cells, cell_face_offsets[mesh->num_cells]);
+  for (int i = 0; i < 6*mesh->num_cells; ++i)
+    assert_true((cell_faces[i] >= 0) && (cell_faces[i] < num_faces));
   cf_file_close(cf);
+  mesh_free(mesh);
 }
 
 int main(int argc, char* argv[]) 
@@ -84,7 +399,10 @@ int main(int argc, char* argv[])
   const struct CMUnitTest tests[] = 
   {
     cmocka_unit_test(test_cf_file_open),
-    cmocka_unit_test(test_cf_file_write)
+    cmocka_unit_test(test_cf_file_write),
+    cmocka_unit_test(test_cf_file_packed_types),
+    cmocka_unit_test(test_cf_file_parallel_write),
+    cmocka_unit_test(test_cf_file_write_mesh)
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,180 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cmocka.h"
+#include "polyglot/robust_predicates.h"
+#include "polyglot/create_convex_hull.h"
+
+// Checks that the faces of the hull form a closed surface with consistent 
+// neighbors and that no point lies beyond any of them.
+static void check_hull(convex_hull_t* hull)
+{
+  assert_int_equal(2 * hull->num_vertices - 4, hull->num_faces);
+  for (int f = 0; f < hull->num_faces; ++f)
+  {
+    int* v = &hull->faces[3*f];
+    for (int j = 0; j < 3; ++j)
+    {
+      // The neighbor across the edge (v1, v2) has the edge (v2, v1).
+      int g = hull->face_neighbors[3*f+j];
+      assert_true((g >= 0) && (g < hull->num_faces) && (g != f));
+      int v1 = v[(j+1)%3], v2 = v[(j+2)%3];
+      bool found = false;
+      for (int k = 0; k < 3; ++k)
+      {
+        if ((hull->faces[3*g+k] == v2) && (hull->faces[3*g+(k+1)%3] == v1))
+        {
+          found = true;
+          assert_int_equal(f, hull->face_neighbors[3*g+(k+2)%3]);
+        }
+      }
+      assert_true(found);
+    }
+    for (int i = 0; i < hull->num_points; ++i)
+    {
+      assert_true(robust_orientation(&hull->points[v[0]], &hull->points[v[1]], 
+                                     &hull->points[v[2]], &hull->points[i]) <= 0.0);
+    }
+  }
+  for (int i = 0; i < hull->num_points; ++i)
+    assert_true(convex_hull_contains(hull, &hull->points[i]));
+}
+
+// Checks that containment tests of random points in and around the bounding 
+// box of the hull agree with tests against all of its faces.
+static void check_contains(convex_hull_t* hull, int num_queries)
+{
+  bbox_t* b = &hull->bbox;
+  for (int q = 0; q < num_queries; ++q)
+  {
+    point_t x = {.x = b->x1 + (1.2 * rand() / RAND_MAX - 0.1) * (b->x2 - b->x1), 
+                 .y = b->y1 + (1.2 * rand() / RAND_MAX - 0.1) * (b->y2 - b->y1), 
+                 .z = b->z1 + (1.2 * rand() / RAND_MAX - 0.1) * (b->z2 - b->z1)};
+    bool inside = true;
+    for (int f = 0; (f < hull->num_faces) && inside; ++f)
+    {
+      int* v = &hull->faces[3*f];
+      inside = (robust_orientation(&hull->points[v[0]], &hull->points[v[1]], 
+                                   &hull->points[v[2]], &x) <= 0.0);
+    }
+    assert_true(convex_hull_contains(hull, &x) == inside);
+  }
+}
+
+static void test_cube(void** state)
+{
+  // The corners of a cube, followed by points inside it, on its faces, and 
+  // on its edges, and duplicates of its corners.
+  int num_points = 8 + 100 + 12 + 8;
+  point_t points[num_points];
+  for (int i = 0; i < 8; ++i)
+  {
+    points[i].x = (real_t)(i / 4);
+    points[i].y = (real_t)((i / 2) % 2);
+    points[i].z = (real_t)(i % 2);
+  }
+  srand(1);
+  for (int i = 8; i < 108; ++i)
+  {
+    points[i].x = (real_t)(rand() % 5) / 4.0;
+    points[i].y = (real_t)(rand() % 5) / 4.0;
+    points[i].z = (real_t)(rand() % 5) / 4.0;
+  }
+  for (int i = 108; i < 120; ++i)
+  {
+    points[i].x = (i % 3 == 0) ? 0.5 : (real_t)(i % 2);
+    points[i].y = (i % 3 == 1) ? 0.5 : (real_t)((i / 2) % 2);
+    points[i].z = (i % 3 == 2) ? 0.5 : (real_t)((i / 4) % 2);
+  }
+  for (int i = 120; i < 128; ++i)
+    points[i] = points[i - 120];
+
+  // Every corner is a vertex of the hull, and no point is duplicated.
+  convex_hull_t* hull = convex_hull_new(points, num_points);
+  int num_corners = 0;
+  for (int i = 0; i < hull->num_vertices; ++i)
+  {
+    point_t* x = &points[hull->vertices[i]];
+    if (((x->x == 0.0) || (x->x == 1.0)) && ((x->y == 0.0) || (x->y == 1.0)) && 
+        ((x->z == 0.0) || (x->z == 1.0)))
+      ++num_corners;
+    for (int j = 0; j < i; ++j)
+      assert_true(point_distance(x, &points[hull->vertices[j]]) > 0.0);
+  }
+  assert_int_equal(8, num_corners);
+  check_hull(hull);
+
+  point_t outside = {.x = 0.5, .y = 0.5, .z = 1.0 + 1.0 / 1024.0};
+  assert_false(convex_hull_contains(hull, &outside));
+  point_t corner = {.x = 1.0, .y = 1.0, .z = 1.0};
+  assert_true(convex_hull_contains(hull, &corner));
+  convex_hull_free(hull);
+
+  // Without the points on its faces and edges, the hull has only its corners.
+  int hull_size;
+  point_t* hull_points = create_convex_hull(points, 8, &hull_size);
+  assert_int_equal(8, hull_size);
+  polymec_free(hull_points);
+}
+
+static void test_sphere(void** state)
+{
+  // Every point on a sphere is a vertex of its hull.
+  int num_points = 1000;
+  point_t points[num_points];
+  srand(2);
+  for (int i = 0; i < num_points; ++i)
+  {
+    real_t z = -1.0 + 2.0 * (rand() + 0.5) / (RAND_MAX + 1.0);
+    real_t phi = 2.0 * M_PI * rand() / (RAND_MAX + 1.0);
+    points[i].x = sqrt(1.0 - z*z) * cos(phi);
+    points[i].y = sqrt(1.0 - z*z) * sin(phi);
+    points[i].z = z;
+  }
+  convex_hull_t* hull = convex_hull_new(points, num_points);
+  assert_int_equal(num_points, hull->num_vertices);
+  check_hull(hull);
+  check_contains(hull, 1000);
+  convex_hull_free(hull);
+}
+
+static void test_random_points(void** state)
+{
+  int num_points = 2000;
+  point_t points[num_points];
+  srand(3);
+  for (int i = 0; i < num_points; ++i)
+  {
+    points[i].x = (rand() + 0.5) / (RAND_MAX + 1.0);
+    points[i].y = (rand() + 0.5) / (RAND_MAX + 1.0);
+    points[i].z = (rand() + 0.5) / (RAND_MAX + 1.0);
+  }
+  convex_hull_t* hull = convex_hull_new(points, num_points);
+  assert_true(hull->num_vertices < num_points);
+  check_hull(hull);
+  point_t outside = {.x = 1.0, .y = 1.0, .z = 1.0};
+  assert_false(convex_hull_contains(hull, &outside));
+  check_contains(hull, 1000);
+  convex_hull_free(hull);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_cube),
+    cmocka_unit_test(test_sphere),
+    cmocka_unit_test(test_random_points)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
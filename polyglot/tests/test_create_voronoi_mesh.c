@@ -0,0 +1,280 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cmocka.h"
+#include "polyglot/create_voronoi_mesh.h"
+
+// Checks that the cells of the given Voronoi mesh are closed polyhedra 
+// that contain their generators and fill the given bounding box, and that 
+// its boundary faces are tagged with the faces of the box they lie on.
+static void check_mesh(mesh_t* mesh, 
+                       point_t* generators, 
+                       int num_generators, 
+                       bbox_t* bbox)
+{
+  assert_int_equal(num_generators, mesh->num_cells);
+  real_t L[3] = {bbox->x2 - bbox->x1, bbox->y2 - bbox->y1, bbox->z2 - bbox->z1};
+  real_t box_volume = L[0] * L[1] * L[2];
+  real_t volume = 0.0;
+  for (int c = 0; c < mesh->num_cells; ++c)
+  {
+    assert_true(mesh->cell_volumes[c] > 0.0);
+    volume += mesh->cell_volumes[c];
+
+    // The face areas sum to zero, and the generator lies behind each face.
+    vector_t A = {.x = 0.0, .y = 0.0, .z = 0.0};
+    for (int k = mesh->cell_face_offsets[c]; k < mesh->cell_face_offsets[c+1]; ++k)
+    {
+      int f = mesh->cell_faces[k];
+      real_t sign = 1.0;
+      if (f < 0)
+      {
+        f = ~f;
+        sign = -1.0;
+        assert_int_equal(c, mesh->face_cells[2*f+1]);
+      }
+      else
+        assert_int_equal(c, mesh->face_cells[2*f]);
+      vector_t* n = &mesh->face_normals[f];
+      A.x += sign * mesh->face_areas[f] * n->x;
+      A.y += sign * mesh->face_areas[f] * n->y;
+      A.z += sign * mesh->face_areas[f] * n->z;
+      vector_t d;
+      point_displacement(&generators[c], &mesh->face_centers[f], &d);
+      assert_true(sign * vector_dot(&d, n) > 0.0);
+    }
+    assert_true(vector_mag(&A) < 1e-12 * L[0] * L[0]);
+    assert_true(bbox_contains(bbox, &mesh->cell_centers[c]));
+  }
+  assert_true(fabs(volume - box_volume) < 1e-12 * box_volume);
+
+  // Boundary faces.
+  const char* tags[6] = {"x1", "x2", "y1", "y2", "z1", "z2"};
+  real_t planes[6] = {bbox->x1, bbox->x2, bbox->y1, bbox->y2, bbox->z1, bbox->z2};
+  int num_boundary_faces = 0;
+  for (int i = 0; i < 6; ++i)
+  {
+    size_t size;
+    int* tag = mesh_tag(mesh->face_tags, tags[i], &size);
+    assert_true(tag != NULL);
+    real_t area = 0.0;
+    for (size_t j = 0; j < size; ++j)
+    {
+      int f = tag[j];
+      assert_int_equal(-1, mesh->face_cells[2*f+1]);
+      area += mesh->face_areas[f];
+      point_t* xf = &mesh->face_centers[f];
+      real_t x = (i < 2) ? xf->x : (i < 4) ? xf->y : xf->z;
+      assert_true(fabs(x - planes[i]) < 1e-12 * L[i/2]);
+    }
+    real_t box_area = box_volume / L[i/2];
+    assert_true(fabs(area - box_area) < 1e-12 * box_area);
+    num_boundary_faces += (int)size;
+  }
+  for (int f = 0; f < mesh->num_faces; ++f)
+  {
+    if (mesh->face_cells[2*f+1] == -1)
+      --num_boundary_faces;
+  }
+  assert_int_equal(0, num_boundary_faces);
+}
+
+static void test_single_generator(void** state)
+{
+  // The one cell is the box itself.
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 2.0, .z1 = 0.0, .z2 = 3.0};
+  point_t generator = {.x = 0.25, .y = 0.5, .z = 0.75};
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_SELF, &generator, 1, &bbox);
+  check_mesh(mesh, &generator, 1, &bbox);
+  assert_int_equal(6, mesh->num_faces);
+  assert_int_equal(8, mesh->num_nodes);
+  mesh_free(mesh);
+}
+
+static void test_random_generators(void** state)
+{
+  int num_generators = 1000;
+  point_t generators[num_generators];
+  srand(1);
+  for (int i = 0; i < num_generators; ++i)
+  {
+    generators[i].x = -1.0 + 2.0 * (rand() + 0.5) / (RAND_MAX + 1.0);
+    generators[i].y = -1.0 + 2.0 * (rand() + 0.5) / (RAND_MAX + 1.0);
+    generators[i].z = -1.0 + 2.0 * (rand() + 0.5) / (RAND_MAX + 1.0);
+  }
+  bbox_t bbox = {.x1 = -1.0, .x2 = 1.0, .y1 = -1.0, .y2 = 1.0, .z1 = -1.0, .z2 = 1.0};
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_SELF, generators, num_generators, &bbox);
+  check_mesh(mesh, generators, num_generators, &bbox);
+  mesh_free(mesh);
+}
+
+static void test_lattice_generators(void** state)
+{
+  // Generators at the centers of the cells of a 4 x 4 x 4 lattice, whose 
+  // Voronoi cells are its (unit) cells despite the degeneracy of their 
+  // Delaunay triangulation.
+  int num_generators = 64;
+  point_t generators[num_generators];
+  for (int i = 0; i < num_generators; ++i)
+  {
+    generators[i].x = 0.5 + (i / 16);
+    generators[i].y = 0.5 + ((i / 4) % 4);
+    generators[i].z = 0.5 + (i % 4);
+  }
+  bbox_t bbox = {.x1 = 0.0, .x2 = 4.0, .y1 = 0.0, .y2 = 4.0, .z1 = 0.0, .z2 = 4.0};
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_SELF, generators, num_generators, &bbox);
+  check_mesh(mesh, generators, num_generators, &bbox);
+  assert_int_equal(5*5*5, mesh->num_nodes);
+  assert_int_equal(3*4*4*5, mesh->num_faces);
+  for (int c = 0; c < num_generators; ++c)
+  {
+    assert_true(fabs(mesh->cell_volumes[c] - 1.0) < 1e-12);
+    assert_true(point_distance(&mesh->cell_centers[c], &generators[c]) < 1e-12);
+    assert_int_equal(6, mesh->cell_face_offsets[c+1] - mesh->cell_face_offsets[c]);
+  }
+  for (int f = 0; f < mesh->num_faces; ++f)
+    assert_int_equal(4, mesh->face_node_offsets[f+1] - mesh->face_node_offsets[f]);
+  mesh_free(mesh);
+}
+
+// Linear density for CVT tests.
+static void linear_density(void* context, point_t* x, real_t* rho)
+{
+  *rho = 1.0 + x->x;
+}
+
+static void test_cvt_single_generator(void** state)
+{
+  // The one cell is the box, whose centroid with respect to the density 
+  // 1 + x is (5/9, 1/2, 1/2).
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  point_t generator = {.x = 0.25, .y = 0.125, .z = 0.75};
+  sp_func_t* density = sp_func_from_func("1 + x", linear_density, SP_INHOMOGENEOUS, 1);
+  cvt_iterator_t* cvt = cvt_iterator_new(&generator, 1, &bbox, density);
+  cvt_iterator_iterate(cvt);
+  int num_generators;
+  point_t* x = cvt_iterator_generators(cvt, &num_generators);
+  assert_int_equal(1, num_generators);
+  assert_true(fabs(x->x - 5.0/9.0) < 1e-14);
+  assert_true(fabs(x->y - 0.5) < 1e-14);
+  assert_true(fabs(x->z - 0.5) < 1e-14);
+  assert_true(cvt_iterator_iterate(cvt) < 1e-14);
+  cvt_iterator_free(cvt);
+}
+
+static void test_cvt_lattice_generators(void** state)
+{
+  // The centers of the cells of a lattice are already a CVT.
+  int num_generators = 64;
+  point_t generators[num_generators];
+  for (int i = 0; i < num_generators; ++i)
+  {
+    generators[i].x = 0.5 + (i / 16);
+    generators[i].y = 0.5 + ((i / 4) % 4);
+    generators[i].z = 0.5 + (i % 4);
+  }
+  bbox_t bbox = {.x1 = 0.0, .x2 = 4.0, .y1 = 0.0, .y2 = 4.0, .z1 = 0.0, .z2 = 4.0};
+  cvt_iterator_t* cvt = cvt_iterator_new(generators, num_generators, &bbox, NULL);
+  assert_true(fabs(cvt_iterator_energy(cvt) - 64.0/4.0) < 1e-12);
+  assert_true(cvt_iterator_iterate(cvt) < 1e-12);
+  cvt_iterator_free(cvt);
+}
+
+static void test_cvt_random_generators(void** state)
+{
+  int num_generators = 200;
+  point_t generators[num_generators];
+  srand(1);
+  for (int i = 0; i < num_generators; ++i)
+  {
+    generators[i].x = (rand() + 0.5) / (RAND_MAX + 1.0);
+    generators[i].y = (rand() + 0.5) / (RAND_MAX + 1.0);
+    generators[i].z = (rand() + 0.5) / (RAND_MAX + 1.0);
+  }
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  cvt_iterator_t* cvt = cvt_iterator_new(generators, num_generators, &bbox, NULL);
+
+  // Lloyd iterations don't increase the energy.
+  real_t energy = cvt_iterator_energy(cvt);
+  for (int i = 0; i < 10; ++i)
+  {
+    cvt_iterator_iterate(cvt);
+    real_t new_energy = cvt_iterator_energy(cvt);
+    assert_true(new_energy <= energy);
+    energy = new_energy;
+  }
+
+  // Iterate until the generators are nearly the centroids of their cells. 
+  // By then most of them move in place, and the repaired triangulation 
+  // agrees with one built from scratch.
+  int num_iterations = cvt_iterator_run(cvt, 1000, 0.0, 1e-3);
+  assert_true(num_iterations < 1000);
+  int n;
+  point_t* x = cvt_iterator_generators(cvt, &n);
+  energy = cvt_iterator_energy(cvt);
+  cvt_iterator_t* cvt1 = cvt_iterator_new(x, n, &bbox, NULL);
+  assert_true(fabs(cvt_iterator_energy(cvt1) - energy) < 1e-12 * energy);
+  cvt_iterator_free(cvt1);
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_SELF, x, n, &bbox);
+  check_mesh(mesh, x, n, &bbox);
+  for (int c = 0; c < n; ++c)
+    assert_true(point_distance(&mesh->cell_centers[c], &x[c]) <= 1e-3);
+  mesh_free(mesh);
+  cvt_iterator_free(cvt);
+}
+
+static void test_partitioned_mesh(void** state)
+{
+  // Each process passes its share of the generators, and each cell lands 
+  // on exactly one process.
+  int rank, nprocs;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  int num_generators = 1000, num_local_generators = 0;
+  point_t generators[num_generators];
+  srand(4);
+  for (int i = 0; i < num_generators; ++i)
+  {
+    point_t x = {.x = (rand() + 0.5) / (RAND_MAX + 1.0),
+                 .y = (rand() + 0.5) / (RAND_MAX + 1.0),
+                 .z = (rand() + 0.5) / (RAND_MAX + 1.0)};
+    if ((i % nprocs) == rank)
+      generators[num_local_generators++] = x;
+  }
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_WORLD, generators, num_local_generators, &bbox);
+  real_t volume = 0.0;
+  for (int c = 0; c < mesh->num_cells; ++c)
+    volume += mesh->cell_volumes[c];
+  int num_cells = mesh->num_cells;
+  MPI_Allreduce(MPI_IN_PLACE, &num_cells, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &volume, 1, MPI_REAL_T, MPI_SUM, MPI_COMM_WORLD);
+  assert_int_equal(num_generators, num_cells);
+  assert_true(fabs(volume - 1.0) < 1e-12);
+  mesh_free(mesh);
+}
+
+int main(int argc, char* argv[]) 
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] = 
+  {
+    cmocka_unit_test(test_single_generator),
+    cmocka_unit_test(test_random_generators),
+    cmocka_unit_test(test_lattice_generators),
+    cmocka_unit_test(test_cvt_single_generator),
+    cmocka_unit_test(test_cvt_lattice_generators),
+    cmocka_unit_test(test_cvt_random_generators),
+    cmocka_unit_test(test_partitioned_mesh)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,673 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "cmocka.h"
+#include "polyglot/delaunay_triangulation.h"
+
+// Returns the (signed) volume of the tet with the given vertices.
+static real_t tet_volume(point_t* x)
+{
+  vector_t a, b, c, axb;
+  point_displacement(&x[0], &x[1], &a);
+  point_displacement(&x[0], &x[2], &b);
+  point_displacement(&x[0], &x[3], &c);
+  vector_cross(&a, &b, &axb);
+  return vector_dot(&axb, &c) / 6.0;
+}
+
+// Returns true if the circumsphere of the tet with the given vertices 
+// contains the point y (up to a relative tolerance).
+static bool circumsphere_contains(point_t* x, point_t* y)
+{
+  // Solve for the circumcenter c: 2 (x[i] - x[0]) . c = |x[i]|^2 - |x[0]|^2.
+  real_t A[3][3], b[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    A[i][0] = 2.0 * (x[i+1].x - x[0].x);
+    A[i][1] = 2.0 * (x[i+1].y - x[0].y);
+    A[i][2] = 2.0 * (x[i+1].z - x[0].z);
+    b[i] = (x[i+1].x*x[i+1].x + x[i+1].y*x[i+1].y + x[i+1].z*x[i+1].z) - 
+           (x[0].x*x[0].x + x[0].y*x[0].y + x[0].z*x[0].z);
+  }
+  real_t det = A[0][0]*(A[1][1]*A[2][2] - A[1][2]*A[2][1]) - 
+               A[0][1]*(A[1][0]*A[2][2] - A[1][2]*A[2][0]) + 
+               A[0][2]*(A[1][0]*A[2][1] - A[1][1]*A[2][0]);
+  point_t c;
+  c.x = (b[0]*(A[1][1]*A[2][2] - A[1][2]*A[2][1]) - 
+         A[0][1]*(b[1]*A[2][2] - A[1][2]*b[2]) + 
+         A[0][2]*(b[1]*A[2][1] - A[1][1]*b[2])) / det;
+  c.y = (A[0][0]*(b[1]*A[2][2] - A[1][2]*b[2]) - 
+         b[0]*(A[1][0]*A[2][2] - A[1][2]*A[2][0]) + 
+         A[0][2]*(A[1][0]*b[2] - b[1]*A[2][0])) / det;
+  c.z = (A[0][0]*(A[1][1]*b[2] - b[1]*A[2][1]) - 
+         A[0][1]*(A[1][0]*b[2] - b[1]*A[2][0]) + 
+         b[0]*(A[1][0]*A[2][1] - A[1][1]*A[2][0])) / det;
+  real_t r = point_distance(&c, &x[0]);
+  return (point_distance(&c, y) < r * (1.0 - 1e-8));
+}
+
+// Checks that the tets of the triangulation are positively oriented, fill 
+// the given volume, and have empty circumspheres.
+static void check_triangulation(delaunay_triangulation_t* t, 
+                                point_t* points, 
+                                int num_points,
+                                real_t volume)
+{
+  assert_int_equal(num_points, delaunay_triangulation_num_vertices(t));
+  assert_true(delaunay_triangulation_num_tetrahedra(t) > 0);
+  int pos = 0, v[4];
+  real_t total_volume = 0.0;
+  while (delaunay_triangulation_next(t, &pos, &v[0], &v[1], &v[2], &v[3]))
+  {
+    point_t x[4];
+    delaunay_triangulation_get_vertices(t, v, 4, x);
+    real_t V = tet_volume(x);
+    assert_true(V > 0.0);
+    total_volume += V;
+    for (int p = 0; p < num_points; ++p)
+    {
+      if ((p != v[0]) && (p != v[1]) && (p != v[2]) && (p != v[3]))
+        assert_false(circumsphere_contains(x, &points[p]));
+    }
+  }
+  assert_true(fabs(total_volume - volume) < 1e-10 * volume);
+}
+
+static void test_random_points(delaunay_triangulation_algorithm_t algorithm)
+{
+  // The corners of a unit cube, plus random points inside it.
+  int num_points = 508;
+  point_t points[num_points];
+  for (int i = 0; i < 8; ++i)
+  {
+    points[i].x = (i & 1) ? 1.0 : 0.0;
+    points[i].y = (i & 2) ? 1.0 : 0.0;
+    points[i].z = (i & 4) ? 1.0 : 0.0;
+  }
+  srand(1);
+  for (int i = 8; i < num_points; ++i)
+  {
+    points[i].x = 1.0 * rand() / RAND_MAX;
+    points[i].y = 1.0 * rand() / RAND_MAX;
+    points[i].z = 1.0 * rand() / RAND_MAX;
+  }
+  delaunay_triangulation_t* t = 
+    delaunay_triangulation_new_with_algorithm(points, num_points, algorithm);
+  check_triangulation(t, points, num_points, 1.0);
+  delaunay_triangulation_free(t);
+}
+
+static void test_lattice(delaunay_triangulation_algorithm_t algorithm)
+{
+  // The points of a 5 x 5 x 5 lattice, whose Delaunay triangulation is 
+  // highly degenerate.
+  int num_points = 125;
+  point_t points[num_points];
+  for (int i = 0; i < 5; ++i)
+  {
+    for (int j = 0; j < 5; ++j)
+    {
+      for (int k = 0; k < 5; ++k)
+      {
+        point_t* x = &points[25*i + 5*j + k];
+        x->x = 1.0*i;
+        x->y = 1.0*j;
+        x->z = 1.0*k;
+      }
+    }
+  }
+  delaunay_triangulation_t* t = 
+    delaunay_triangulation_new_with_algorithm(points, num_points, algorithm);
+  check_triangulation(t, points, num_points, 64.0);
+  delaunay_triangulation_free(t);
+}
+
+static int tet_cmp(const void* l, const void* r)
+{
+  return memcmp(l, r, 4 * sizeof(int));
+}
+
+static int int_cmp(const void* l, const void* r)
+{
+  int i = *((const int*)l), j = *((const int*)r);
+  return (i < j) ? -1 : (i > j) ? 1 : 0;
+}
+
+// Returns a sorted array of the (sorted) vertices of the triangulation's 
+// tets.
+static int* sorted_tets(delaunay_triangulation_t* t)
+{
+  int num_tets = delaunay_triangulation_num_tetrahedra(t);
+  int* tets = malloc(sizeof(int) * 4 * num_tets);
+  int pos = 0, v[4], i = 0;
+  while (delaunay_triangulation_next(t, &pos, &v[0], &v[1], &v[2], &v[3]))
+  {
+    qsort(v, 4, sizeof(int), int_cmp);
+    memcpy(&tets[4*i], v, 4 * sizeof(int));
+    ++i;
+  }
+  qsort(tets, num_tets, 4 * sizeof(int), tet_cmp);
+  return tets;
+}
+
+// Checks that the given algorithm produces the same tets as the 
+// Bowyer-Watson algorithm for the given points.
+static void check_same_tets(point_t* points, 
+                            int num_points,
+                            delaunay_triangulation_algorithm_t algorithm)
+{
+  delaunay_triangulation_t* t1 = 
+    delaunay_triangulation_new_with_algorithm(points, num_points, BOWYER_WATSON);
+  delaunay_triangulation_t* t2 = 
+    delaunay_triangulation_new_with_algorithm(points, num_points, algorithm);
+  int num_tets = delaunay_triangulation_num_tetrahedra(t1);
+  assert_int_equal(num_tets, delaunay_triangulation_num_tetrahedra(t2));
+  int* tets1 = sorted_tets(t1);
+  int* tets2 = sorted_tets(t2);
+  assert_true(memcmp(tets1, tets2, sizeof(int) * 4 * num_tets) == 0);
+  free(tets1);
+  free(tets2);
+  delaunay_triangulation_free(t1);
+  delaunay_triangulation_free(t2);
+}
+
+static void test_bowyer_watson_random_points(void** state)
+{
+  test_random_points(BOWYER_WATSON);
+}
+
+static void test_bowyer_watson_lattice(void** state)
+{
+  test_lattice(BOWYER_WATSON);
+}
+
+static void test_incremental_flip_random_points(void** state)
+{
+  test_random_points(INCREMENTAL_FLIP);
+
+  // Points in a ball, and points on a sphere, all of which lie on the hull.
+  int num_points = 2000;
+  point_t points[num_points];
+  srand(3);
+  for (int i = 0; i < num_points; ++i)
+  {
+    real_t r2;
+    do
+    {
+      points[i].x = 2.0 * rand() / RAND_MAX - 1.0;
+      points[i].y = 2.0 * rand() / RAND_MAX - 1.0;
+      points[i].z = 2.0 * rand() / RAND_MAX - 1.0;
+      r2 = points[i].x*points[i].x + points[i].y*points[i].y + points[i].z*points[i].z;
+    }
+    while ((r2 > 1.0) || (r2 < 1e-6));
+  }
+  check_same_tets(points, num_points, INCREMENTAL_FLIP);
+  for (int i = 0; i < num_points; ++i)
+  {
+    real_t r = sqrt(points[i].x*points[i].x + points[i].y*points[i].y + points[i].z*points[i].z);
+    points[i].x /= r;
+    points[i].y /= r;
+    points[i].z /= r;
+  }
+  check_same_tets(points, num_points, INCREMENTAL_FLIP);
+
+  // A pyramid whose base is nearly flat, so that the tets along the base 
+  // have circumspheres far larger than the points' extent.
+  num_points = 300;
+  for (int i = 0; i < num_points-1; ++i)
+  {
+    points[i].x = 1.0 * rand() / RAND_MAX;
+    points[i].y = 1.0 * rand() / RAND_MAX;
+    points[i].z = -1e-12 * rand() / RAND_MAX;
+  }
+  points[num_points-1].x = 0.5;
+  points[num_points-1].y = 0.5;
+  points[num_points-1].z = 1.0;
+  check_same_tets(points, num_points, INCREMENTAL_FLIP);
+}
+
+static void test_incremental_flip_lattice(void** state)
+{
+  test_lattice(INCREMENTAL_FLIP);
+
+  // A lattice whose hull has many coplanar points on each face.
+  int num_points = 8*8*8;
+  point_t points[num_points];
+  for (int i = 0; i < num_points; ++i)
+  {
+    points[i].x = 1.0*(i / 64);
+    points[i].y = 1.0*((i / 8) % 8);
+    points[i].z = 1.0*(i % 8);
+  }
+  check_same_tets(points, num_points, INCREMENTAL_FLIP);
+}
+
+static void test_divide_and_conquer_random_points(void** state)
+{
+  test_random_points(DIVIDE_AND_CONQUER);
+
+  // Enough points to be split and merged.
+  int num_points = 5000;
+  point_t points[num_points];
+  srand(2);
+  for (int i = 0; i < num_points; ++i)
+  {
+    points[i].x = 1.0 * rand() / RAND_MAX;
+    points[i].y = 1.0 * rand() / RAND_MAX;
+    points[i].z = 1.0 * rand() / RAND_MAX;
+  }
+  check_same_tets(points, num_points, DIVIDE_AND_CONQUER);
+
+  // The triangulations of the pieces were all merged, rather than redone 
+  // serially.
+  delaunay_triangulation_t* t = 
+    delaunay_triangulation_new_with_algorithm(points, num_points, DIVIDE_AND_CONQUER);
+  int num_merges, num_failed_merges;
+  delaunay_triangulation_get_merge_counts(t, &num_merges, &num_failed_merges);
+  assert_true(num_merges > 0);
+  assert_int_equal(0, num_failed_merges);
+  delaunay_triangulation_free(t);
+}
+
+static void test_divide_and_conquer_lattice(void** state)
+{
+  test_lattice(DIVIDE_AND_CONQUER);
+
+  // A 15 x 15 x 15 lattice, with some of its points duplicated.
+  int num_points = 15*15*15 + 100;
+  point_t points[num_points];
+  for (int i = 0; i < 15*15*15; ++i)
+  {
+    points[i].x = 1.0*(i / 225);
+    points[i].y = 1.0*((i / 15) % 15);
+    points[i].z = 1.0*(i % 15);
+  }
+  for (int i = 15*15*15; i < num_points; ++i)
+    points[i] = points[(37*i) % (15*15*15)];
+  check_same_tets(points, num_points, DIVIDE_AND_CONQUER);
+}
+
+// Checks that the triangulation t has the same tets as a new triangulation 
+// of its present vertices, which are those for which present is true.
+static void check_same_as_new(delaunay_triangulation_t* t, bool* present)
+{
+  int num_vertices = delaunay_triangulation_num_vertices(t);
+  int num_points = 0, indices[num_vertices];
+  for (int v = 0; v < num_vertices; ++v)
+  {
+    if (present[v])
+      indices[num_points++] = v;
+  }
+  point_t points[num_points];
+  delaunay_triangulation_get_vertices(t, indices, num_points, points);
+  delaunay_triangulation_t* t1 = delaunay_triangulation_new(points, num_points);
+  int num_tets = delaunay_triangulation_num_tetrahedra(t1);
+  assert_int_equal(num_tets, delaunay_triangulation_num_tetrahedra(t));
+
+  // Map the vertices of the new triangulation back to those of t.
+  int* tets1 = malloc(sizeof(int) * 4 * num_tets);
+  int pos = 0, v[4], i = 0;
+  while (delaunay_triangulation_next(t1, &pos, &v[0], &v[1], &v[2], &v[3]))
+  {
+    for (int j = 0; j < 4; ++j)
+      tets1[4*i+j] = indices[v[j]];
+    qsort(&tets1[4*i], 4, sizeof(int), int_cmp);
+    ++i;
+  }
+  qsort(tets1, num_tets, 4 * sizeof(int), tet_cmp);
+  int* tets = sorted_tets(t);
+  assert_true(memcmp(tets, tets1, sizeof(int) * 4 * num_tets) == 0);
+  free(tets);
+  free(tets1);
+  delaunay_triangulation_free(t1);
+}
+
+// Checks that the changes recorded by the triangulation t, applied to the 
+// tets it had before (stored by index in old_tets, with -1 marking missing 
+// tets), give the tets it has now.
+static void check_changes(delaunay_triangulation_t* t, 
+                          int* old_tets, 
+                          int num_old_tets)
+{
+  int_array_t* created = int_array_new();
+  int_array_t* destroyed = int_array_new();
+  delaunay_triangulation_get_changes(t, created, destroyed);
+  for (size_t i = 0; i < destroyed->size; ++i)
+  {
+    int tet = destroyed->data[i];
+    assert_true(tet < num_old_tets);
+    assert_true(old_tets[4*tet] != -1);
+    old_tets[4*tet] = -1;
+  }
+  int num_tets = 0;
+  for (int tet = 0; tet < num_old_tets; ++tet)
+  {
+    if (old_tets[4*tet] != -1)
+    {
+      int v[4];
+      assert_true(delaunay_triangulation_get_tet(t, tet, &v[0], &v[1], &v[2], &v[3]));
+      assert_true(memcmp(v, &old_tets[4*tet], 4 * sizeof(int)) == 0);
+      ++num_tets;
+    }
+  }
+  for (size_t i = 0; i < created->size; ++i)
+  {
+    int tet = created->data[i], v[4];
+    assert_true((tet >= num_old_tets) || (old_tets[4*tet] == -1));
+    assert_true(delaunay_triangulation_get_tet(t, tet, &v[0], &v[1], &v[2], &v[3]));
+    ++num_tets;
+  }
+  assert_int_equal(num_tets, delaunay_triangulation_num_tetrahedra(t));
+  int_array_free(created);
+  int_array_free(destroyed);
+}
+
+// Stores the vertices of the tets of t by index in tets, marking missing 
+// tets with -1, and returns the number of indices stored.
+static int get_tets_by_index(delaunay_triangulation_t* t, int* tets, int max_tets)
+{
+  int num_tets = 0;
+  for (int tet = 0; tet < max_tets; ++tet)
+  {
+    int* v = &tets[4*tet];
+    if (delaunay_triangulation_get_tet(t, tet, &v[0], &v[1], &v[2], &v[3]))
+      num_tets = tet + 1;
+    else
+      v[0] = -1;
+  }
+  return num_tets;
+}
+
+// A linear congruential generator, so that tests that need particular 
+// sequences of points don't depend on the C library's rand().
+static uint32_t random_state = 1;
+
+static void random_seed(uint32_t seed)
+{
+  random_state = seed;
+}
+
+// Returns a pseudorandom number in [0, 1].
+static real_t random_real(void)
+{
+  random_state = 1664525u * random_state + 1013904223u;
+  return (random_state >> 8) / 16777215.0;
+}
+
+static void test_insert_remove_move(void** state)
+{
+  // The corners of a unit cube, plus random points inside it.
+  int num_points = 208;
+  point_t points[num_points];
+  for (int i = 0; i < 8; ++i)
+  {
+    points[i].x = (i & 1) ? 1.0 : 0.0;
+    points[i].y = (i & 2) ? 1.0 : 0.0;
+    points[i].z = (i & 4) ? 1.0 : 0.0;
+  }
+  random_seed(3);
+  for (int i = 8; i < num_points; ++i)
+  {
+    points[i].x = random_real();
+    points[i].y = random_real();
+    points[i].z = random_real();
+  }
+  delaunay_triangulation_t* t = delaunay_triangulation_new(points, num_points);
+  int max_tets = 16 * num_points;
+  int* tets = malloc(sizeof(int) * 4 * max_tets);
+  int num_tets = get_tets_by_index(t, tets, max_tets);
+  bool present[num_points + 50];
+  for (int i = 0; i < num_points + 50; ++i)
+    present[i] = true;
+
+  // Remove some of the interior points.
+  for (int i = 8; i < 58; ++i)
+  {
+    delaunay_triangulation_remove(t, i, -1);
+    present[i] = false;
+  }
+  check_same_as_new(t, present);
+  check_changes(t, tets, num_tets);
+  delaunay_triangulation_clear_changes(t);
+  num_tets = get_tets_by_index(t, tets, max_tets);
+
+  // Insert some new ones.
+  for (int i = 0; i < 50; ++i)
+  {
+    point_t x = {.x = random_real(), 
+                 .y = random_real(), 
+                 .z = random_real()};
+    assert_int_equal(num_points + i, delaunay_triangulation_insert(t, &x, -1));
+  }
+  assert_int_equal(-1, delaunay_triangulation_insert(t, &points[100], -1));
+  check_same_as_new(t, present);
+  check_changes(t, tets, num_tets);
+  delaunay_triangulation_clear_changes(t);
+  num_tets = get_tets_by_index(t, tets, max_tets);
+
+  // Move some a little and some a lot.
+  for (int i = 58; i < 158; ++i)
+  {
+    real_t scale = (i < 108) ? 0.001 : 0.2;
+    point_t x;
+    delaunay_triangulation_get_vertices(t, &i, 1, &x);
+    x.x = MAX(0.0, MIN(1.0, x.x + scale * (random_real() - 0.5)));
+    x.y = MAX(0.0, MIN(1.0, x.y + scale * (random_real() - 0.5)));
+    x.z = MAX(0.0, MIN(1.0, x.z + scale * (random_real() - 0.5)));
+    delaunay_triangulation_move(t, i, &x, -1);
+  }
+  check_same_as_new(t, present);
+  check_changes(t, tets, num_tets);
+  delaunay_triangulation_clear_changes(t);
+  num_tets = get_tets_by_index(t, tets, max_tets);
+
+  // Move pairs of them in place: most of them by a tiny bit, which almost 
+  // always works, and one of them by a lot, which doesn't. Pairs that move 
+  // leave the tets as they were.
+  int num_moved = 0;
+  int* tets_before = sorted_tets(t);
+  for (int i = 158; i < 208; i += 2)
+  {
+    real_t scale = (i < 206) ? 1e-9 : 0.5;
+    int v[2] = {i, i+1};
+    point_t x[2], x0[2];
+    delaunay_triangulation_get_vertices(t, v, 2, x0);
+    for (int j = 0; j < 2; ++j)
+    {
+      x[j].x = x0[j].x + scale * (random_real() - 0.5);
+      x[j].y = x0[j].y + scale * (random_real() - 0.5);
+      x[j].z = x0[j].z + scale * (random_real() - 0.5);
+    }
+    if (delaunay_triangulation_move_in_place(t, v, x, 2, -1))
+    {
+      ++num_moved;
+      int* tets_after = sorted_tets(t);
+      assert_true(memcmp(tets_before, tets_after, 
+                         sizeof(int) * 4 * delaunay_triangulation_num_tetrahedra(t)) == 0);
+      free(tets_after);
+    }
+    else
+    {
+      point_t x1[2];
+      delaunay_triangulation_get_vertices(t, v, 2, x1);
+      assert_true(memcmp(x0, x1, 2 * sizeof(point_t)) == 0);
+    }
+  }
+  free(tets_before);
+  assert_true(num_moved > 0);
+  check_same_as_new(t, present);
+  check_changes(t, tets, num_tets);
+
+  free(tets);
+  delaunay_triangulation_free(t);
+}
+
+static void test_remove_with_degenerate_link(void** state)
+{
+  // A square pyramid with a point below its base. The vertices neighboring 
+  // the apex are coplanar, so its removal can't be done locally.
+  point_t points[6] = {{0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, 
+                       {1.0, 1.0, 0.0}, {0.5, 0.5, 1.0}, {0.5, 0.5, -1.0}};
+  delaunay_triangulation_t* t = delaunay_triangulation_new(points, 6);
+  bool present[6] = {true, true, true, true, true, true};
+  int tets[4*64];
+  int num_tets = get_tets_by_index(t, tets, 64);
+  delaunay_triangulation_remove(t, 4, -1);
+  present[4] = false;
+  check_same_as_new(t, present);
+  check_changes(t, tets, num_tets);
+  delaunay_triangulation_free(t);
+}
+
+// Returns true if the tets i and j in the given adjacency are neighbors.
+static bool are_neighbors(delaunay_adjacency_t* adj, int i, int j)
+{
+  int* n = &adj->tet_neighbors[4*i];
+  return ((n[0] == j) || (n[1] == j) || (n[2] == j) || (n[3] == j));
+}
+
+// Returns true if the ith tet in the given adjacency has the vertex v.
+static bool has_vertex(delaunay_adjacency_t* adj, int i, int v)
+{
+  int* w = &adj->tet_vertices[4*i];
+  return ((w[0] == v) || (w[1] == v) || (w[2] == v) || (w[3] == v));
+}
+
+static void test_adjacency(void** state)
+{
+  // Random points in a unit cube, some of which we remove to make holes in 
+  // the numbering of the tets.
+  int num_points = 500;
+  point_t points[num_points];
+  srand(4);
+  for (int i = 0; i < num_points; ++i)
+  {
+    points[i].x = 1.0 * rand() / RAND_MAX;
+    points[i].y = 1.0 * rand() / RAND_MAX;
+    points[i].z = 1.0 * rand() / RAND_MAX;
+  }
+  delaunay_triangulation_t* t = delaunay_triangulation_new(points, num_points);
+  for (int i = 0; i < 20; ++i)
+    delaunay_triangulation_remove(t, 25*i, -1);
+  delaunay_adjacency_t* adj = delaunay_adjacency_new(t);
+  assert_int_equal(num_points, adj->num_vertices);
+  assert_int_equal(delaunay_triangulation_num_tetrahedra(t), adj->num_tets);
+
+  // Tets and their neighbors.
+  int pos = 0, v[4], num_hull_faces = 0;
+  for (int i = 0; i < adj->num_tets; ++i)
+  {
+    assert_true(delaunay_triangulation_next(t, &pos, &v[0], &v[1], &v[2], &v[3]));
+    assert_int_equal(pos - 1, adj->tet_indices[i]);
+    assert_true(memcmp(v, &adj->tet_vertices[4*i], 4 * sizeof(int)) == 0);
+    for (int j = 0; j < 4; ++j)
+    {
+      int n = adj->tet_neighbors[4*i+j];
+      if (n == -1)
+        ++num_hull_faces;
+      else
+      {
+        assert_true(are_neighbors(adj, n, i));
+        assert_false(has_vertex(adj, n, v[j]));
+        for (int k = 0; k < 4; ++k)
+          assert_true((k == j) || has_vertex(adj, n, v[k]));
+      }
+    }
+  }
+  assert_false(delaunay_triangulation_next(t, &pos, &v[0], &v[1], &v[2], &v[3]));
+
+  // Tets of vertices.
+  assert_int_equal(4*adj->num_tets, adj->vertex_tet_offsets[num_points]);
+  for (int p = 0; p < num_points; ++p)
+  {
+    int num_vertex_tets = adj->vertex_tet_offsets[p+1] - adj->vertex_tet_offsets[p];
+    assert_true((p % 25 == 0) ? (num_vertex_tets == 0) : (num_vertex_tets > 0));
+    for (int k = adj->vertex_tet_offsets[p]; k < adj->vertex_tet_offsets[p+1]; ++k)
+      assert_true(has_vertex(adj, adj->vertex_tets[k], p));
+  }
+
+  // Edges and their rings of tets, which we check using Euler's formula 
+  // V - E + F - T = 1 and the fact that each tet has 6 edges.
+  int num_present = num_points - 20, num_faces = (4*adj->num_tets + num_hull_faces) / 2;
+  assert_int_equal(num_present + num_faces - adj->num_tets - 1, adj->num_edges);
+  assert_int_equal(6*adj->num_tets, adj->edge_tet_offsets[adj->num_edges]);
+  assert_int_equal(2*adj->num_edges, adj->vertex_edge_offsets[num_points]);
+  int num_hull_edges = 0;
+  for (int e = 0; e < adj->num_edges; ++e)
+  {
+    int a = adj->edge_vertices[2*e], b = adj->edge_vertices[2*e+1];
+    assert_true(a < b);
+    int* ring = &adj->edge_tets[adj->edge_tet_offsets[e]];
+    int ring_size = adj->edge_tet_offsets[e+1] - adj->edge_tet_offsets[e];
+    assert_true(ring_size >= (adj->edge_on_hull[e] ? 1 : 3));
+    for (int k = 0; k < ring_size; ++k)
+    {
+      assert_true(has_vertex(adj, ring[k], a));
+      assert_true(has_vertex(adj, ring[k], b));
+      if (k < ring_size - 1)
+        assert_true(are_neighbors(adj, ring[k], ring[k+1]));
+      else if (!adj->edge_on_hull[e])
+        assert_true(are_neighbors(adj, ring[k], ring[0]));
+    }
+
+    // The tets turn counterclockwise about the edge as seen from b.
+    if (ring_size > 1)
+    {
+      point_t x[4];
+      delaunay_triangulation_get_vertices(t, &a, 1, &x[0]);
+      delaunay_triangulation_get_vertices(t, &b, 1, &x[1]);
+      for (int j = 0; j < 4; ++j)
+      {
+        int u = adj->tet_vertices[4*ring[0]+j];
+        if ((u != a) && (u != b) && has_vertex(adj, ring[1], u))
+          delaunay_triangulation_get_vertices(t, &u, 1, &x[3]);
+        else if ((u != a) && (u != b))
+          delaunay_triangulation_get_vertices(t, &u, 1, &x[2]);
+      }
+      assert_true(tet_volume(x) > 0.0);
+    }
+
+    if (adj->edge_on_hull[e])
+      ++num_hull_edges;
+    for (int k = adj->vertex_edge_offsets[a]; k < adj->vertex_edge_offsets[a+1]; ++k)
+    {
+      if (adj->vertex_edges[k] == e)
+        a = -1;
+    }
+    assert_int_equal(-1, a);
+  }
+
+  // Each hull face has 3 hull edges, each shared by 2 hull faces.
+  assert_int_equal(3*num_hull_faces/2, num_hull_edges);
+
+  delaunay_adjacency_free(adj);
+  delaunay_triangulation_free(t);
+}
+
+int main(int argc, char* argv[]) 
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] = 
+  {
+    cmocka_unit_test(test_bowyer_watson_random_points),
+    cmocka_unit_test(test_bowyer_watson_lattice),
+    cmocka_unit_test(test_incremental_flip_random_points),
+    cmocka_unit_test(test_incremental_flip_lattice),
+    cmocka_unit_test(test_divide_and_conquer_random_points),
+    cmocka_unit_test(test_divide_and_conquer_lattice),
+    cmocka_unit_test(test_insert_remove_move),
+    cmocka_unit_test(test_remove_with_degenerate_link),
+    cmocka_unit_test(test_adjacency)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polyglot/exodus_diff.h"
+
+// Writes a single tet with a short history of a global variable, displacing
+// its third node by the given amount and giving the last entry of its side
+// set the given side.
+static void write_tet(const char* filename, real_t displacement, int last_side)
+{
+  fe_mesh_t* mesh = fe_mesh_new(MPI_COMM_SELF, 4);
+  int elem_node_indices[] = {0, 1, 2, 3};
+  fe_block_t* block = fe_block_new(1, FE_TETRAHEDRON, 4, elem_node_indices);
+  fe_mesh_add_block(mesh, "block_1", block);
+  point_t* X = fe_mesh_node_positions(mesh);
+  X[0].x = 0.0; X[0].y = 0.0; X[0].z = 0.0;
+  X[1].x = 1.0; X[1].y = 0.0; X[1].z = 0.0;
+  X[2].x = 0.0; X[2].y = 1.0 + displacement; X[2].z = 0.0;
+  X[3].x = 0.0; X[3].y = 0.0; X[3].z = 1.0;
+  int* ns = fe_mesh_create_node_set(mesh, "nset_1", 2);
+  ns[0] = 1; ns[1] = 2;
+  int* ss = fe_mesh_create_side_set(mesh, "sset_1", 3);
+  ss[0] = 0; ss[1] = 0;
+  ss[2] = 0; ss[3] = 1;
+  ss[4] = 0; ss[5] = last_side;
+
+  exodus_file_t* file = exodus_file_new(MPI_COMM_SELF, filename);
+  assert_true(file != NULL);
+  exodus_file_write_mesh(file, mesh);
+  const char* var_names[] = {"energy"};
+  exodus_file_define_global_vars(file, 1, var_names);
+  for (int i = 0; i < 5; ++i)
+  {
+    int time_index = exodus_file_write_time(file, 0.1*i);
+    exodus_file_write_global_var(file, time_index, "energy", 1.0*i);
+  }
+  exodus_file_close(file);
+  fe_mesh_free(mesh);
+}
+
+static void test_exodus_diff(void** state)
+{
+  // Each run of the test (with a given number of processes) has its own 
+  // files.
+  int rank, nprocs;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  char filenames[4][FILENAME_MAX];
+  for (int i = 0; i < 4; ++i)
+    snprintf(filenames[i], FILENAME_MAX, "test-diff-%d-%d.exo", nprocs, i+1);
+  if (rank == 0)
+  {
+    write_tet(filenames[0], 0.0, 2);
+    write_tet(filenames[1], 0.0, 2);
+    write_tet(filenames[2], 1e-3, 3);
+    write_tet(filenames[3], NAN, 2);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Use tiny chunks so that data is streamed and spread over processes.
+  exodus_diff_t* diff = exodus_diff_new(MPI_COMM_WORLD, 1e-8, 1e-8);
+  exodus_diff_set_chunk_size(diff, 3);
+  exodus_diff_set_num_threads(diff, 2);
+  assert_true(exodus_diff_compare(diff, filenames[0], filenames[1]));
+
+  // Node 2 is displaced in the third file, and the side of the third side 
+  // set entry differs.
+  assert_false(exodus_diff_compare(diff, filenames[0], filenames[2]));
+  exodus_diff_fprintf(diff, stdout);
+  int pos = 0;
+  char* name;
+  exodus_diff_result_t result;
+  bool found_positions = false, found_sides = false;
+  while (exodus_diff_next_result(diff, &pos, &name, &result))
+  {
+    if (strcmp(name, "node positions") == 0)
+    {
+      found_positions = true;
+      assert_true(fabs(result.max_abs_diff - 1e-3) < 1e-8);
+      assert_int_equal(2, result.entity_index);
+      assert_int_equal(12, result.num_values);
+      assert_int_equal(1, result.num_failures);
+    }
+    else if (strcmp(name, "side set 1") == 0)
+    {
+      found_sides = true;
+      assert_int_equal(2, result.entity_index);
+      assert_int_equal(6, result.num_values);
+      assert_int_equal(1, result.num_failures);
+    }
+    else
+      assert_int_equal(0, result.num_failures);
+  }
+  assert_true(found_positions);
+  assert_true(found_sides);
+  pos = 0;
+  assert_false(exodus_diff_next_mismatch(diff, &pos, &name));
+
+  // A NaN in one file is a failure, and is reported as the largest 
+  // difference. NaNs in both files match.
+  assert_false(exodus_diff_compare(diff, filenames[0], filenames[3]));
+  found_positions = false;
+  pos = 0;
+  while (exodus_diff_next_result(diff, &pos, &name, &result))
+  {
+    if (strcmp(name, "node positions") == 0)
+    {
+      found_positions = true;
+      assert_true(isnan(result.max_abs_diff));
+      assert_int_equal(2, result.entity_index);
+      assert_int_equal(1, result.num_failures);
+    }
+    else
+      assert_int_equal(0, result.num_failures);
+  }
+  assert_true(found_positions);
+  assert_true(exodus_diff_compare(diff, filenames[3], filenames[3]));
+  exodus_diff_free(diff);
+
+  // A looser tolerance accepts the displacement.
+  diff = exodus_diff_new(MPI_COMM_WORLD, 1e-2, 1e-8);
+  assert_true(exodus_diff_compare(diff, filenames[0], filenames[2]));
+  exodus_diff_free(diff);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_exodus_diff)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
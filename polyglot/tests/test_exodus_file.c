@@ -287,6 +287,60 @@ static void test_write_poly_exodus_file(void** state)
   fe_mesh_free(mesh);
 }
 
+static void test_exodus_file_global_vars(void** state)
+{
+  // Write a single tet along with a history of some global diagnostics.
+  fe_mesh_t* mesh = fe_mesh_new(MPI_COMM_WORLD, 4);
+  int elem_node_indices[] = {0, 1, 2, 3};
+  fe_block_t* block = fe_block_new(1, FE_TETRAHEDRON, 4, elem_node_indices);
+  fe_mesh_add_block(mesh, "block_1", block);
+  point_t* X = fe_mesh_node_positions(mesh);
+  X[0].x = 0.0; X[0].y = 0.0; X[0].z = 0.0;
+  X[1].x = 1.0; X[1].y = 0.0; X[1].z = 0.0;
+  X[2].x = 0.0; X[2].y = 1.0; X[2].z = 0.0;
+  X[3].x = 0.0; X[3].y = 0.0; X[3].z = 1.0;
+
+  exodus_file_t* file = exodus_file_new(MPI_COMM_WORLD, "test-globals.exo");
+  assert_true(file != NULL);
+  exodus_file_write_mesh(file, mesh);
+  const char* var_names[] = {"energy", "residual"};
+  exodus_file_define_global_vars(file, 2, var_names);
+  exodus_file_set_global_var_buffer_size(file, 3); // forces several flushes
+  assert_int_equal(2, exodus_file_num_global_vars(file));
+  assert_true(exodus_file_contains_global_var(file, "energy"));
+  assert_false(exodus_file_contains_global_var(file, "momentum"));
+  for (int i = 0; i < 10; ++i)
+  {
+    int time_index = exodus_file_write_time(file, 0.1*i);
+    exodus_file_write_global_var(file, time_index, "energy", 1.0*i);
+    exodus_file_write_global_var(file, time_index, "residual", 1.0/(i+1));
+  }
+
+  // Rewriting one variable in a record that has already been flushed 
+  // leaves the others alone.
+  exodus_file_write_global_var(file, 2, "energy", 42.0);
+  exodus_file_close(file);
+  fe_mesh_free(mesh);
+
+  // Read the diagnostics back in.
+  file = exodus_file_open(MPI_COMM_WORLD, "test-globals.exo");
+  assert_true(file != NULL);
+  assert_int_equal(2, exodus_file_num_global_vars(file));
+  real_t value;
+  assert_true(exodus_file_read_global_var(file, 5, "energy", &value));
+  assert_true(fabs(value - 4.0) < 1e-6);
+  assert_false(exodus_file_read_global_var(file, 5, "momentum", &value));
+  assert_true(exodus_file_read_global_var(file, 2, "energy", &value));
+  assert_true(fabs(value - 42.0) < 1e-6);
+  int num_times;
+  real_t* residuals = exodus_file_read_global_var_history(file, "residual", &num_times);
+  assert_int_equal(10, num_times);
+  for (int i = 0; i < 10; ++i)
+    assert_true(fabs(residuals[i] - 1.0/(i+1)) < 1e-6);
+  polymec_free(residuals);
+  exodus_file_close(file);
+}
+
 int main(int argc, char* argv[]) 
 {
   polymec_init(argc, argv);
@@ -297,7 +351,8 @@ int main(int argc, char* argv[])
     cmocka_unit_test(test_write_exodus_file),
     cmocka_unit_test(test_read_exodus_file),
     cmocka_unit_test(test_read_poly_exodus_file),
-    cmocka_unit_test(test_write_poly_exodus_file)
+    cmocka_unit_test(test_write_poly_exodus_file),
+    cmocka_unit_test(test_exodus_file_global_vars)
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
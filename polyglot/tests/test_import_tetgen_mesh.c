@@ -9,6 +9,7 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <string.h>
+#include <stdlib.h>
 #include "cmocka.h"
 #include "core/silo_file.h"
 #include "polyglot/import_tetgen_mesh.h"
@@ -50,6 +51,311 @@ static void test_import_tetgen_mesh(void** state)
   mesh_free(mesh);
 }
 
+// Reads the centroids of the tets in tetgen_example.1.* in order.
+static void read_tet_centroids(point_t* centroids)
+{
+  char line[1024];
+  point_t nodes[304];
+  int num_nodes = 0, num_tets = 0;
+  FILE* f = fopen(CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.node", "r");
+  assert_true(f != NULL);
+  fgets(line, 1024, f);
+  while ((fgets(line, 1024, f) != NULL) && (num_nodes < 304))
+  {
+    int id;
+    double x, y, z;
+    if ((line[0] != '#') && (sscanf(line, "%d %lf %lf %lf", &id, &x, &y, &z) == 4))
+    {
+      nodes[num_nodes].x = (real_t)x;
+      nodes[num_nodes].y = (real_t)y;
+      nodes[num_nodes].z = (real_t)z;
+      ++num_nodes;
+    }
+  }
+  fclose(f);
+  assert_int_equal(304, num_nodes);
+
+  f = fopen(CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.ele", "r");
+  assert_true(f != NULL);
+  fgets(line, 1024, f);
+  while ((fgets(line, 1024, f) != NULL) && (num_tets < 1020))
+  {
+    int id, n[4];
+    if ((line[0] != '#') && (sscanf(line, "%d %d %d %d %d", &id, &n[0], &n[1], &n[2], &n[3]) == 5))
+    {
+      point_t* x = &centroids[num_tets++];
+      x->x = x->y = x->z = 0.0;
+      for (int i = 0; i < 4; ++i)
+      {
+        x->x += 0.25 * nodes[n[i]-1].x;
+        x->y += 0.25 * nodes[n[i]-1].y;
+        x->z += 0.25 * nodes[n[i]-1].z;
+      }
+    }
+  }
+  fclose(f);
+  assert_int_equal(1020, num_tets);
+}
+
+static int real_cmp(const void* l, const void* r)
+{
+  real_t x = *((const real_t*)l), y = *((const real_t*)r);
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void test_import_tetgen_mesh_with_weights(void** state)
+{
+  // Make the tets on one side of a plane 10 times as expensive as the 
+  // others. The plane passes through the widest gap between tet centroids 
+  // near the middle of the mesh, so that the cells' centers fall on the same 
+  // sides of it as the centroids.
+  point_t centroids[1020];
+  read_tet_centroids(centroids);
+  real_t xs[1020];
+  for (int t = 0; t < 1020; ++t)
+    xs[t] = centroids[t].x;
+  qsort(xs, 1020, sizeof(real_t), real_cmp);
+  real_t x0 = 0.0, widest_gap = -1.0;
+  for (int t = 255; t < 765; ++t)
+  {
+    if (xs[t+1] - xs[t] > widest_gap)
+    {
+      widest_gap = xs[t+1] - xs[t];
+      x0 = 0.5 * (xs[t] + xs[t+1]);
+    }
+  }
+  int weights[1020], total_weight = 0;
+  for (int t = 0; t < 1020; ++t)
+  {
+    weights[t] = (centroids[t].x < x0) ? 10 : 1;
+    total_weight += weights[t];
+  }
+
+  // Balance the weights along a space-filling curve.
+  mesh_t* mesh = import_tetgen_mesh_with_weights(MPI_COMM_WORLD, 
+                                                 CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.node", 
+                                                 CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.ele", 
+                                                 CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.face", 
+                                                 CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.neigh",
+                                                 TETGEN_SFC_PARTITION, weights, 1020, 0, NULL, 0.05);
+  assert_true(mesh_verify_topology(mesh, polymec_error));
+  int num_cells;
+  MPI_Allreduce(&mesh->num_cells, &num_cells, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  assert_int_equal(1020, num_cells);
+
+  // Each process's weight is within that of a single tet of its share.
+  int weight = 0;
+  for (int c = 0; c < mesh->num_cells; ++c)
+    weight += (mesh->cell_centers[c].x < x0) ? 10 : 1;
+  int sum;
+  MPI_Allreduce(&weight, &sum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  assert_int_equal(total_weight, sum);
+  int nprocs;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  assert_true(fabs(weight - 1.0 * total_weight / nprocs) <= 10.0);
+  mesh_free(mesh);
+}
+
+static void test_import_tetgen_mesh_with_cache(void** state)
+{
+  // Import the mesh twice: the first import writes the cache, and the 
+  // second reads it.
+  mesh_t* meshes[2];
+  for (int i = 0; i < 2; ++i)
+  {
+    meshes[i] = import_tetgen_mesh_with_cache(MPI_COMM_WORLD, 
+                                              CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.node", 
+                                              CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.ele", 
+                                              CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.face", 
+                                              CMAKE_CURRENT_SOURCE_DIR "/tetgen_example.1.neigh",
+                                              "tetgen_example_cache");
+    assert_true(mesh_verify_topology(meshes[i], polymec_error));
+  }
+
+  // The meshes should be identical.
+  mesh_t* mesh = meshes[0];
+  mesh_t* cached_mesh = meshes[1];
+  assert_int_equal(mesh->num_cells, cached_mesh->num_cells);
+  assert_int_equal(mesh->num_ghost_cells, cached_mesh->num_ghost_cells);
+  assert_int_equal(mesh->num_faces, cached_mesh->num_faces);
+  assert_int_equal(mesh->num_edges, cached_mesh->num_edges);
+  assert_int_equal(mesh->num_nodes, cached_mesh->num_nodes);
+  assert_true(memcmp(mesh->cell_faces, cached_mesh->cell_faces, sizeof(int) * 4 * mesh->num_cells) == 0);
+  assert_true(memcmp(mesh->face_nodes, cached_mesh->face_nodes, sizeof(int) * 3 * mesh->num_faces) == 0);
+  assert_true(memcmp(mesh->face_cells, cached_mesh->face_cells, sizeof(int) * 2 * mesh->num_faces) == 0);
+  assert_true(memcmp(mesh->edge_nodes, cached_mesh->edge_nodes, sizeof(int) * 2 * mesh->num_edges) == 0);
+  assert_true(memcmp(mesh->cell_volumes, cached_mesh->cell_volumes, sizeof(real_t) * mesh->num_cells) == 0);
+  assert_true(memcmp(mesh->face_areas, cached_mesh->face_areas, sizeof(real_t) * mesh->num_faces) == 0);
+  int pos = 0, *indices;
+  char* tag_name;
+  size_t size, cached_size;
+  while (mesh_next_tag(mesh->face_tags, &pos, &tag_name, &indices, &size))
+  {
+    int* cached_indices = mesh_tag(cached_mesh->face_tags, tag_name, &cached_size);
+    assert_true(cached_indices != NULL);
+    assert_int_equal(size, cached_size);
+    assert_true(memcmp(indices, cached_indices, sizeof(int) * size) == 0);
+  }
+
+  // Clean up.
+  int rank, nprocs;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  char cache_file[FILENAME_MAX];
+  snprintf(cache_file, FILENAME_MAX, "tetgen_example_cache.%d.%d", nprocs, rank);
+  remove(cache_file);
+  mesh_free(mesh);
+  mesh_free(cached_mesh);
+}
+
+// Writes the given real number token (like "-11.43" or "1.5e-16") to f, 
+// spelled in one of four equivalent ways: as is, with a positive exponent 
+// ("-0.1143E+2"), with a negative exponent ("-1143e-2"), or with a mantissa 
+// too long to be converted without strtod ("-11.430000000000000000000000").
+static void write_respelled_real(FILE* f, const char* token, int spelling)
+{
+  const char* sign = (token[0] == '-') ? "-" : "";
+  if ((token[0] == '-') || (token[0] == '+'))
+    ++token;
+  int mantissa_length = (int)strcspn(token, "eE");
+  int exponent = (token[mantissa_length] != '\0') ? atoi(&token[mantissa_length+1]) : 0;
+  int int_length = (int)strcspn(token, ".eE");
+  const char* frac = &token[int_length+1];
+  int frac_length = (token[int_length] == '.') ? mantissa_length - int_length - 1 : 0;
+  if (spelling == 1)
+    fprintf(f, "%s0.%.*s%.*sE%+d", sign, int_length, token, frac_length, frac, int_length + exponent);
+  else if (spelling == 2)
+    fprintf(f, "%s%.*s%.*se%d", sign, int_length, token, frac_length, frac, exponent - frac_length);
+  else if (spelling == 3)
+  {
+    fprintf(f, "%s%.*s.%.*s000000000000000000000000", sign, int_length, token, frac_length, frac);
+    if (exponent != 0)
+      fprintf(f, "e%d", exponent);
+  }
+  else
+    fprintf(f, "%s%s", sign, token);
+}
+
+// Copies the TetGen file src to dest with CRLF line endings, tabs, extra
+// comments, and enough padding after the first field of each record that
+// the file is split into several chunks (with boundaries falling inside
+// records). If respell_reals is true, every field after the first is
+// respelled with write_respelled_real.
+static void write_messy_tetgen_file(const char* src, const char* dest, bool respell_reals)
+{
+  FILE* in = fopen(src, "r");
+  assert_true(in != NULL);
+  FILE* out = fopen(dest, "w");
+  assert_true(out != NULL);
+  char line[1024];
+  int num_records = 0;
+  bool header = true;
+  while (fgets(line, 1024, in) != NULL)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if ((line[0] == '#') || header)
+    {
+      if (header)
+        sscanf(line, "%d", &num_records);
+      header = false;
+      fprintf(out, "%s\r\n# (this line is a comment)\r\n", line);
+      continue;
+    }
+    int field = 0, id = 0;
+    for (char* token = strtok(line, " \t"); token != NULL; token = strtok(NULL, " \t"))
+    {
+      if (field == 0)
+      {
+        id = atoi(token);
+        if ((id % 17) == 0)
+          fprintf(out, "# a comment in the middle of the file\r\n");
+        int padding = (9 << 19) / num_records + (131 * id) % 257;
+        fprintf(out, "%s%*s", token, padding, "");
+      }
+      else if (respell_reals)
+      {
+        fprintf(out, "\t");
+        write_respelled_real(out, token, (id + field) % 4);
+      }
+      else
+        fprintf(out, " \t%s", token);
+      ++field;
+    }
+    fprintf(out, " \r\n");
+  }
+  fclose(out);
+  fclose(in);
+}
+
+static void test_import_messy_tetgen_mesh(void** state)
+{
+  // Write a copy of the example mesh with exponents, long mantissas, CRLF
+  // line endings, and records that straddle chunk boundaries.
+  static const char* suffixes[4] = {"node", "ele", "face", "neigh"};
+  char src[4][FILENAME_MAX], dest[4][FILENAME_MAX];
+  for (int i = 0; i < 4; ++i)
+  {
+    snprintf(src[i], FILENAME_MAX, "%s/tetgen_example.1.%s", CMAKE_CURRENT_SOURCE_DIR, suffixes[i]);
+    snprintf(dest[i], FILENAME_MAX, "tetgen_messy_example.1.%s", suffixes[i]);
+  }
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+  {
+    for (int i = 0; i < 4; ++i)
+      write_messy_tetgen_file(src[i], dest[i], (i == 0));
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // The copy should give exactly the same mesh as the original. (In 
+  // parallel, the processes read different records from the two copies, so 
+  // their partitions may differ, and we just compare totals.)
+  mesh_t* mesh = import_tetgen_mesh(MPI_COMM_WORLD, src[0], src[1], src[2], src[3]);
+  mesh_t* messy_mesh = import_tetgen_mesh(MPI_COMM_WORLD, dest[0], dest[1], dest[2], dest[3]);
+  assert_true(mesh_verify_topology(messy_mesh, polymec_error));
+  int nprocs;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  if (nprocs == 1)
+  {
+    assert_int_equal(mesh->num_cells, messy_mesh->num_cells);
+    assert_int_equal(mesh->num_faces, messy_mesh->num_faces);
+    assert_int_equal(mesh->num_nodes, messy_mesh->num_nodes);
+    assert_true(memcmp(mesh->nodes, messy_mesh->nodes, sizeof(point_t) * mesh->num_nodes) == 0);
+    assert_true(memcmp(mesh->cell_faces, messy_mesh->cell_faces, sizeof(int) * 4 * mesh->num_cells) == 0);
+    assert_true(memcmp(mesh->face_nodes, messy_mesh->face_nodes, sizeof(int) * 3 * mesh->num_faces) == 0);
+    assert_true(memcmp(mesh->face_cells, messy_mesh->face_cells, sizeof(int) * 2 * mesh->num_faces) == 0);
+    int pos = 0, *indices;
+    char* tag_name;
+    size_t size, messy_size;
+    while (mesh_next_tag(mesh->face_tags, &pos, &tag_name, &indices, &size))
+    {
+      int* messy_indices = mesh_tag(messy_mesh->face_tags, tag_name, &messy_size);
+      assert_true(messy_indices != NULL);
+      assert_int_equal(size, messy_size);
+      assert_true(memcmp(indices, messy_indices, sizeof(int) * size) == 0);
+    }
+  }
+  else
+  {
+    int counts[3] = {messy_mesh->num_cells, messy_mesh->num_faces, messy_mesh->num_nodes};
+    int totals[3];
+    MPI_Allreduce(counts, totals, 3, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    assert_int_equal(1020, totals[0]);
+    assert_true(totals[1] >= 2286);
+    assert_true(totals[2] >= 304);
+  }
+
+  // Clean up.
+  mesh_free(mesh);
+  mesh_free(messy_mesh);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0)
+  {
+    for (int i = 0; i < 4; ++i)
+      remove(dest[i]);
+  }
+}
+
 static void test_plot_tetgen_mesh(void** state)
 {
   // Create a TetGen mesh from the tetgen_example.* files.
@@ -79,6 +385,9 @@ int main(int argc, char* argv[])
   const struct CMUnitTest tests[] = 
   {
     cmocka_unit_test(test_import_tetgen_mesh),
+    cmocka_unit_test(test_import_tetgen_mesh_with_weights),
+    cmocka_unit_test(test_import_tetgen_mesh_with_cache),
+    cmocka_unit_test(test_import_messy_tetgen_mesh),
     cmocka_unit_test(test_plot_tetgen_mesh)
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,195 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polyglot/join_exodus_files.h"
+
+// Positions of the 5 nodes of a pair of tets that share a face.
+static point_t node_positions[5] = {{0.0, 0.0, 0.0}, {1.0, 0.0, 0.0},
+                                    {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0},
+                                    {1.0, 1.0, 1.0}};
+
+// Writes one of the tets to the given file, along with a node field and an
+// element field at 2 times.
+static void write_tet(const char* filename, int* node_ids, int elem_id)
+{
+  exodus_file_t* file = exodus_file_new(MPI_COMM_SELF, filename);
+  assert_true(file != NULL);
+  const char* block_names[] = {"block_1"};
+  fe_mesh_element_t elem_types[] = {FE_TETRAHEDRON};
+  int num_elem[] = {1};
+  int num_nodes_per_elem[] = {4};
+  exodus_file_define_mesh(file, 4, 1, block_names, elem_types, num_elem, num_nodes_per_elem);
+
+  point_t X[4];
+  real_t T[4];
+  for (int n = 0; n < 4; ++n)
+  {
+    X[n] = node_positions[node_ids[n]-1];
+    T[n] = 1.0 * node_ids[n];
+  }
+  exodus_file_write_node_positions(file, 0, 4, X);
+  int elem_nodes[] = {0, 1, 2, 3};
+  exodus_file_write_element_block_nodes(file, 0, 0, 1, elem_nodes);
+  exodus_file_write_node_ids(file, 0, 4, node_ids);
+  exodus_file_write_element_ids(file, 0, 1, &elem_id);
+
+  const char* node_fields[] = {"T"};
+  exodus_file_define_node_fields(file, 1, node_fields);
+  const char* elem_fields[] = {"rho"};
+  exodus_file_define_element_fields(file, 1, elem_fields);
+  for (int t = 0; t < 2; ++t)
+  {
+    int time_index = exodus_file_write_time(file, 1.0*t);
+    exodus_file_write_node_field_values(file, time_index, "T", 0, 4, T);
+    real_t rho = 10.0 * elem_id + t;
+    exodus_file_write_element_field_values(file, time_index, "rho", 0, 0, 1, &rho);
+  }
+  exodus_file_close(file);
+}
+
+static void test_join_exodus_files(void** state)
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+  {
+    int node_ids1[] = {1, 2, 3, 4};
+    write_tet("test-join.exo.2.0", node_ids1, 1);
+    int node_ids2[] = {2, 3, 4, 5};
+    write_tet("test-join.exo.2.1", node_ids2, 2);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  const char* filenames[] = {"test-join.exo.2.0", "test-join.exo.2.1"};
+  assert_true(join_exodus_files(MPI_COMM_WORLD, 2, filenames, "test-join.exo"));
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Shared nodes appear only once in the joined file.
+  exodus_file_t* file = exodus_file_open(MPI_COMM_SELF, "test-join.exo");
+  assert_true(file != NULL);
+  assert_int_equal(5, exodus_file_num_nodes(file));
+  assert_int_equal(2, exodus_file_num_elements(file));
+  assert_int_equal(2, exodus_file_num_times(file));
+
+  point_t X[5];
+  exodus_file_read_node_positions(file, 0, 5, X);
+  for (int n = 0; n < 5; ++n)
+    assert_true(point_distance(&X[n], &node_positions[n]) < 1e-12);
+
+  int elem_nodes[8];
+  exodus_file_read_element_block_nodes(file, 0, 0, 2, elem_nodes);
+  assert_int_equal(0, elem_nodes[0]);
+  assert_int_equal(3, elem_nodes[3]);
+  assert_int_equal(1, elem_nodes[4]);
+  assert_int_equal(4, elem_nodes[7]);
+
+  real_t T[5], rho[2];
+  assert_true(exodus_file_read_node_field_values(file, 2, "T", 0, 5, T));
+  for (int n = 0; n < 5; ++n)
+    assert_true(fabs(T[n] - (n+1)) < 1e-12);
+  assert_true(exodus_file_read_element_field_values(file, 2, "rho", 0, 0, 2, rho));
+  assert_true(fabs(rho[0] - 11.0) < 1e-12);
+  assert_true(fabs(rho[1] - 21.0) < 1e-12);
+  exodus_file_close(file);
+}
+
+// Writes a file holding one node for each of the given IDs (in that order) 
+// and a single tet on its first 4 nodes, with a node field at 3 times.
+static void write_scattered_file(const char* filename, int num_nodes, int* node_ids, int elem_id)
+{
+  exodus_file_t* file = exodus_file_new(MPI_COMM_SELF, filename);
+  assert_true(file != NULL);
+  const char* block_names[] = {"block_1"};
+  fe_mesh_element_t elem_types[] = {FE_TETRAHEDRON};
+  int num_elem[] = {1};
+  int num_nodes_per_elem[] = {4};
+  exodus_file_define_mesh(file, num_nodes, 1, block_names, elem_types, num_elem, num_nodes_per_elem);
+
+  point_t X[num_nodes];
+  for (int n = 0; n < num_nodes; ++n)
+    X[n] = (point_t){.x = 1.0 * node_ids[n], .y = 0.0, .z = 0.0};
+  exodus_file_write_node_positions(file, 0, num_nodes, X);
+  int elem_nodes[] = {0, 1, 2, 3};
+  exodus_file_write_element_block_nodes(file, 0, 0, 1, elem_nodes);
+  exodus_file_write_node_ids(file, 0, num_nodes, node_ids);
+  exodus_file_write_element_ids(file, 0, 1, &elem_id);
+
+  const char* node_fields[] = {"T"};
+  exodus_file_define_node_fields(file, 1, node_fields);
+  real_t T[num_nodes];
+  for (int t = 0; t < 3; ++t)
+  {
+    int time_index = exodus_file_write_time(file, 1.0*t);
+    for (int n = 0; n < num_nodes; ++n)
+      T[n] = 100.0 * t + node_ids[n];
+    exodus_file_write_node_field_values(file, time_index, "T", 0, num_nodes, T);
+  }
+  exodus_file_close(file);
+}
+
+static void test_join_scattered_node_ids(void** state)
+{
+  // Each file's nodes are scattered through the joined nodes, and some 
+  // are shared.
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+  {
+    int node_ids1[] = {12, 1, 7, 4, 10};
+    write_scattered_file("test-join-scattered.exo.3.0", 5, node_ids1, 1);
+    int node_ids2[] = {3, 11, 7, 9, 6, 2};
+    write_scattered_file("test-join-scattered.exo.3.1", 6, node_ids2, 2);
+    int node_ids3[] = {8, 5, 12, 3};
+    write_scattered_file("test-join-scattered.exo.3.2", 4, node_ids3, 3);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  const char* filenames[] = {"test-join-scattered.exo.3.0", "test-join-scattered.exo.3.1", 
+                             "test-join-scattered.exo.3.2"};
+  assert_true(join_exodus_files(MPI_COMM_WORLD, 3, filenames, "test-join-scattered.exo"));
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  exodus_file_t* file = exodus_file_open(MPI_COMM_SELF, "test-join-scattered.exo");
+  assert_true(file != NULL);
+  assert_int_equal(12, exodus_file_num_nodes(file));
+  assert_int_equal(3, exodus_file_num_elements(file));
+  point_t X[12];
+  exodus_file_read_node_positions(file, 0, 12, X);
+  for (int n = 0; n < 12; ++n)
+    assert_true(fabs(X[n].x - (n+1)) < 1e-12);
+
+  int elem_nodes[12];
+  int expected_nodes[12] = {11, 0, 6, 3, 2, 10, 6, 8, 7, 4, 11, 2};
+  exodus_file_read_element_block_nodes(file, 0, 0, 3, elem_nodes);
+  for (int i = 0; i < 12; ++i)
+    assert_int_equal(expected_nodes[i], elem_nodes[i]);
+
+  real_t T[12];
+  for (int t = 1; t <= 3; ++t)
+  {
+    assert_true(exodus_file_read_node_field_values(file, t, "T", 0, 12, T));
+    for (int n = 0; n < 12; ++n)
+      assert_true(fabs(T[n] - (100.0*(t-1) + n+1)) < 1e-12);
+  }
+  exodus_file_close(file);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_join_exodus_files),
+    cmocka_unit_test(test_join_scattered_node_ids)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,271 @@
+// Copyright (c) 2015-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polyglot/latlon_regridder.h"
+
+// A global 10 degree grid, with latitudes stored from north to south.
+#define NLAT 18
+#define NLON 36
+static real_t lat[NLAT], lon[NLON];
+
+static void set_up_grid()
+{
+  for (int j = 0; j < NLAT; ++j)
+    lat[j] = 85.0 - 10.0*j;
+  for (int i = 0; i < NLON; ++i)
+    lon[i] = 10.0*i;
+}
+
+// Fills data with a field equal to the latitude plus 100 times the level.
+static void set_up_field(int num_levels, real_t* data)
+{
+  for (int l = 0; l < num_levels; ++l)
+    for (int j = 0; j < NLAT; ++j)
+      for (int i = 0; i < NLON; ++i)
+        data[NLAT*NLON*l + NLON*j + i] = lat[j] + 100.0*l;
+}
+
+static void test_bilinear(void** state)
+{
+  set_up_grid();
+  point_t points[3] = {{123.0, 12.3, 0.0},  // interior
+                       {355.0, -40.0, 0.0}, // across the seam
+                       {-5.0, 89.0, 0.0}};  // clamped to the northernmost latitude
+  latlon_regridder_t* r = latlon_regridder_new(LATLON_REGRID_BILINEAR, 
+                                               NLAT, lat, NLON, lon, 
+                                               3, points, NULL, NULL);
+  assert_int_equal(3, latlon_regridder_num_targets(r));
+  real_t data[2*NLAT*NLON], values[2*3];
+  set_up_field(2, data);
+  latlon_regridder_apply(r, 2, data, values);
+  assert_true(fabs(values[0] - 12.3) < 1e-12);
+  assert_true(fabs(values[1] + 40.0) < 1e-12);
+  assert_true(fabs(values[2] - 85.0) < 1e-12);
+  assert_true(fabs(values[3] - 112.3) < 1e-12);
+  latlon_regridder_free(r);
+}
+
+static void test_conservative(void** state)
+{
+  set_up_grid();
+  bbox_t cells[2] = {{.x1 = -5.0, .x2 = 5.0, .y1 = 0.0, .y2 = 10.0}, // one grid cell, across the seam
+                     {.x1 = 20.0, .x2 = 60.0, .y1 = -90.0, .y2 = 90.0}}; // a whole meridional band
+  latlon_regridder_t* r = latlon_regridder_new(LATLON_REGRID_CONSERVATIVE, 
+                                               NLAT, lat, NLON, lon, 
+                                               2, NULL, cells, NULL);
+  real_t data[NLAT*NLON], values[2];
+  set_up_field(1, data);
+  latlon_regridder_apply(r, 1, data, values);
+  assert_true(fabs(values[0] - 5.0) < 1e-12);
+
+  // The area-weighted mean of a field that's antisymmetric about the 
+  // equator vanishes.
+  assert_true(fabs(values[1]) < 1e-12);
+
+  // Constant fields are preserved.
+  for (int i = 0; i < NLAT*NLON; ++i)
+    data[i] = 7.0;
+  latlon_regridder_apply(r, 1, data, values);
+  assert_true(fabs(values[0] - 7.0) < 1e-12);
+  assert_true(fabs(values[1] - 7.0) < 1e-12);
+  latlon_regridder_free(r);
+}
+
+static void test_cached_weights(void** state)
+{
+  set_up_grid();
+  int num_points = 5000;
+  point_t points[num_points];
+  for (int p = 0; p < num_points; ++p)
+  {
+    points[p].x = 360.0 * p / num_points;
+    points[p].y = -80.0 + 160.0 * p / num_points;
+    points[p].z = 0.0;
+  }
+
+  // Compute the weights, writing them to the cache.
+  latlon_regridder_t* r1 = latlon_regridder_new(LATLON_REGRID_BILINEAR, 
+                                                NLAT, lat, NLON, lon, 
+                                                num_points, points, NULL, ".");
+  char filename[FILENAME_MAX];
+  snprintf(filename, FILENAME_MAX, "./latlon_regrid_%016llx.weights", 
+           (unsigned long long)latlon_regridder_fingerprint(r1));
+  FILE* f = fopen(filename, "rb");
+  assert_true(f != NULL);
+  fclose(f);
+
+  // Read them back and apply them with several threads.
+  latlon_regridder_t* r2 = latlon_regridder_new(LATLON_REGRID_BILINEAR, 
+                                                NLAT, lat, NLON, lon, 
+                                                num_points, points, NULL, ".");
+  assert_true(latlon_regridder_fingerprint(r1) == latlon_regridder_fingerprint(r2));
+  assert_true(latlon_regridder_num_weights(r1) == latlon_regridder_num_weights(r2));
+  latlon_regridder_set_num_threads(r2, 4);
+  real_t data[NLAT*NLON], values1[num_points], values2[num_points];
+  set_up_field(1, data);
+  latlon_regridder_apply(r1, 1, data, values1);
+  latlon_regridder_apply(r2, 1, data, values2);
+  for (int p = 0; p < num_points; ++p)
+  {
+    assert_true(fabs(values1[p] - points[p].y) < 1e-12);
+    assert_true(values1[p] == values2[p]);
+  }
+  latlon_regridder_free(r1);
+  latlon_regridder_free(r2);
+  remove(filename);
+}
+
+static void test_seam_crossing_elements(void** state)
+{
+  // Two elements that cross seams: one across the grid's seam at 0 degrees, 
+  // which covers the grid cell centered there, and one across 180 degrees 
+  // (given with longitudes in [-180, 180)), which covers the cell centered 
+  // there.
+  set_up_grid();
+  fe_mesh_t* mesh = fe_mesh_new(MPI_COMM_SELF, 8);
+  int elem_node_indices[] = {0, 1, 2, 3, 4, 5, 6, 7};
+  fe_block_t* block = fe_block_new(2, FE_TETRAHEDRON, 4, elem_node_indices);
+  fe_mesh_add_block(mesh, "block_1", block);
+  point_t* X = fe_mesh_node_positions(mesh);
+  real_t lons[8] = {355.0, 5.0, 5.0, 355.0, 175.0, -175.0, -175.0, 175.0};
+  real_t lats[8] = {0.0, 0.0, 10.0, 10.0, 0.0, 0.0, 10.0, 10.0};
+  for (int n = 0; n < 8; ++n)
+  {
+    X[n].x = lons[n];
+    X[n].y = lats[n];
+    X[n].z = 0.0;
+  }
+  latlon_regridder_t* r = latlon_regridder_from_fe_mesh(LATLON_REGRID_CONSERVATIVE, 
+                                                        NLAT, lat, NLON, lon, 
+                                                        mesh, NULL);
+  assert_int_equal(2, latlon_regridder_num_targets(r));
+
+  // A field equal to the longitude (in [-175, 175]) only away from the seam
+  // at 180 degrees.
+  real_t data[NLAT*NLON], values[2];
+  for (int j = 0; j < NLAT; ++j)
+    for (int i = 0; i < NLON; ++i)
+      data[NLON*j + i] = (i <= 18) ? lon[i] : lon[i] - 360.0;
+  latlon_regridder_apply(r, 1, data, values);
+  assert_true(fabs(values[0]) < 1e-12);
+  assert_true(fabs(values[1] - 180.0) < 1e-12);
+  latlon_regridder_free(r);
+  fe_mesh_free(mesh);
+
+  // A cell on a regional grid, given 360 degrees away from it.
+  real_t regional_lon[10];
+  for (int i = 0; i < 10; ++i)
+    regional_lon[i] = 10.0*i;
+  bbox_t cell = {.x1 = -355.0, .x2 = -345.0, .y1 = 0.0, .y2 = 10.0};
+  r = latlon_regridder_new(LATLON_REGRID_CONSERVATIVE, NLAT, lat, 10, regional_lon, 
+                           1, NULL, &cell, NULL);
+  real_t regional_data[NLAT*10];
+  for (int j = 0; j < NLAT; ++j)
+    for (int i = 0; i < 10; ++i)
+      regional_data[10*j + i] = regional_lon[i];
+  latlon_regridder_apply(r, 1, regional_data, values);
+  assert_true(fabs(values[0] - 10.0) < 1e-12);
+  latlon_regridder_free(r);
+}
+
+static void test_conservation(void** state)
+{
+  // A mesh of skewed quadrilaterals that tiles the box [23, 131] x [-37, 52], 
+  // whose edges aren't aligned with the grid.
+  set_up_grid();
+  int nx = 12, ny = 9;
+  real_t x1 = 23.0, x2 = 131.0, y1 = -37.0, y2 = 52.0;
+  real_t dx = (x2 - x1) / nx, dy = (y2 - y1) / ny;
+  int num_nodes = (nx+1) * (ny+1), num_elem = nx * ny;
+  fe_mesh_t* mesh = fe_mesh_new(MPI_COMM_SELF, num_nodes);
+  point_t* X = fe_mesh_node_positions(mesh);
+  for (int j = 0; j <= ny; ++j)
+  {
+    for (int i = 0; i <= nx; ++i)
+    {
+      // Nodes on the boundary move only along it.
+      point_t* x = &X[(nx+1)*j + i];
+      x->x = x1 + dx * i;
+      x->y = y1 + dy * j;
+      x->z = 0.0;
+      if ((j > 0) && (j < ny))
+        x->y += 0.2 * dy * sin(1.7*i + 2.3*j);
+      if ((i > 0) && (i < nx))
+        x->x += 0.2 * dx * cos(2.9*i + 1.1*j);
+    }
+  }
+  int elem_node_indices[4*num_elem];
+  for (int j = 0; j < ny; ++j)
+  {
+    for (int i = 0; i < nx; ++i)
+    {
+      int* n = &elem_node_indices[4*(nx*j + i)];
+      n[0] = (nx+1)*j + i;
+      n[1] = n[0] + 1;
+      n[2] = n[1] + nx+1;
+      n[3] = n[0] + nx+1;
+    }
+  }
+  fe_block_t* block = fe_block_new(num_elem, FE_TETRAHEDRON, 4, elem_node_indices);
+  fe_mesh_add_block(mesh, "block_1", block);
+  latlon_regridder_t* r = latlon_regridder_from_fe_mesh(LATLON_REGRID_CONSERVATIVE, 
+                                                        NLAT, lat, NLON, lon, 
+                                                        mesh, NULL);
+
+  // The integral of a field over the elements, each of which has the area 
+  // of its quadrilateral in the (longitude, sine of latitude) plane, must 
+  // match its integral over the box they tile.
+  real_t data[NLAT*NLON], values[num_elem];
+  for (int j = 0; j < NLAT; ++j)
+    for (int i = 0; i < NLON; ++i)
+      data[NLON*j + i] = lat[j] + 0.3 * lon[i] + 10.0 * sin(0.1 * lat[j] * lon[i]);
+  latlon_regridder_apply(r, 1, data, values);
+  real_t deg = M_PI / 180.0, integral = 0.0;
+  for (int e = 0; e < num_elem; ++e)
+  {
+    real_t area = 0.0;
+    for (int k = 0; k < 4; ++k)
+    {
+      point_t* a = &X[elem_node_indices[4*e + k]];
+      point_t* b = &X[elem_node_indices[4*e + (k+1)%4]];
+      area += 0.5 * deg * (a->x * sin(b->y * deg) - b->x * sin(a->y * deg));
+    }
+    integral += area * values[e];
+  }
+  latlon_regridder_free(r);
+  fe_mesh_free(mesh);
+
+  bbox_t box = {.x1 = x1, .x2 = x2, .y1 = y1, .y2 = y2};
+  r = latlon_regridder_new(LATLON_REGRID_CONSERVATIVE, NLAT, lat, NLON, lon, 
+                           1, NULL, &box, NULL);
+  real_t box_value;
+  latlon_regridder_apply(r, 1, data, &box_value);
+  real_t box_area = deg * (x2 - x1) * (sin(y2 * deg) - sin(y1 * deg));
+  real_t error = fabs(integral - box_area * box_value) / fabs(box_area * box_value);
+  log_debug("test_conservation: relative conservation error is %g.", error);
+  assert_true(error < 1e-12);
+  latlon_regridder_free(r);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_bilinear),
+    cmocka_unit_test(test_conservative),
+    cmocka_unit_test(test_cached_weights),
+    cmocka_unit_test(test_seam_crossing_elements),
+    cmocka_unit_test(test_conservation)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,307 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cmocka.h"
+#include "polyglot/create_voronoi_mesh.h"
+#include "polyglot/restricted_voronoi_cells.h"
+
+static void random_points(point_t* x, int num_points, bbox_t* bbox)
+{
+  for (int i = 0; i < num_points; ++i)
+  {
+    x[i].x = bbox->x1 + (bbox->x2 - bbox->x1) * (rand() + 0.5) / (RAND_MAX + 1.0);
+    x[i].y = bbox->y1 + (bbox->y2 - bbox->y1) * (rand() + 0.5) / (RAND_MAX + 1.0);
+    x[i].z = bbox->z1 + (bbox->z2 - bbox->z1) * (rand() + 0.5) / (RAND_MAX + 1.0);
+  }
+}
+
+// Returns the area of the face of cell c shared with cell d, or 0 if they 
+// share none.
+static real_t shared_area(restricted_voronoi_cells_t* cells, int c, int d)
+{
+  for (int k = cells->cell_face_offsets[c]; k < cells->cell_face_offsets[c+1]; ++k)
+  {
+    if (cells->face_cells[k] == d)
+      return cells->face_areas[k];
+  }
+  return 0.0;
+}
+
+// Checks that neighboring cells agree on the areas of their shared faces and 
+// returns the total area of the boundary faces with the given boundary index.
+static real_t check_faces(restricted_voronoi_cells_t* cells, int boundary)
+{
+  real_t area = 0.0;
+  for (int c = 0; c < cells->num_cells; ++c)
+  {
+    for (int k = cells->cell_face_offsets[c]; k < cells->cell_face_offsets[c+1]; ++k)
+    {
+      assert_true(cells->face_areas[k] > 0.0);
+      int d = cells->face_cells[k];
+      if (d >= 0)
+      {
+        assert_int_equal(-1, cells->face_boundaries[k]);
+        assert_true(fabs(shared_area(cells, d, c) - cells->face_areas[k]) < 1e-10);
+      }
+      else if (cells->face_boundaries[k] == boundary)
+        area += cells->face_areas[k];
+    }
+  }
+  return area;
+}
+
+// Builds the triangulated surface of the union of the unit cubes whose lower 
+// corners are given, storing 4 vertices and 2 triangles for each exposed 
+// face of a cube. Returns the number of triangles.
+static int voxel_surface(int (*voxels)[3], int num_voxels, 
+                         point_t* vertices, int* triangles)
+{
+  int num_vertices = 0, num_triangles = 0;
+  for (int v = 0; v < num_voxels; ++v)
+  {
+    for (int f = 0; f < 6; ++f)
+    {
+      int d = f / 2, d1 = (d + 1) % 3, d2 = (d + 2) % 3;
+      int neighbor[3] = {voxels[v][0], voxels[v][1], voxels[v][2]};
+      neighbor[d] += (f % 2 == 0) ? -1 : 1;
+      bool exposed = true;
+      for (int w = 0; w < num_voxels; ++w)
+      {
+        if ((voxels[w][0] == neighbor[0]) && (voxels[w][1] == neighbor[1]) && 
+            (voxels[w][2] == neighbor[2]))
+          exposed = false;
+      }
+      if (!exposed)
+        continue;
+
+      // The corners turn counterclockwise about the outward normal.
+      for (int k = 0; k < 4; ++k)
+      {
+        int j = (f % 2 == 0) ? 3 - k : k;
+        real_t x[3] = {voxels[v][0], voxels[v][1], voxels[v][2]};
+        x[d] += f % 2;
+        x[d1] += ((j == 1) || (j == 2)) ? 1.0 : 0.0;
+        x[d2] += (j >= 2) ? 1.0 : 0.0;
+        vertices[num_vertices + k].x = x[0];
+        vertices[num_vertices + k].y = x[1];
+        vertices[num_vertices + k].z = x[2];
+      }
+      int t[6] = {0, 1, 2, 0, 2, 3};
+      for (int i = 0; i < 6; ++i)
+        triangles[3*num_triangles + i] = num_vertices + t[i];
+      num_vertices += 4;
+      num_triangles += 2;
+    }
+  }
+  return num_triangles;
+}
+
+static void test_single_generator(void** state)
+{
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 2.0, .z1 = 0.0, .z2 = 3.0};
+  point_t generator = {.x = 0.25, .y = 0.5, .z = 0.75};
+  restricted_voronoi_cells_t* cells = restricted_voronoi_cells_new(&generator, 1, &bbox, NULL, NULL, 0);
+  assert_true(fabs(cells->cell_volumes[0] - 6.0) < 1e-14);
+  assert_true(fabs(cells->cell_centers[0].x - 0.5) < 1e-14);
+  assert_true(fabs(cells->cell_centers[0].y - 1.0) < 1e-14);
+  assert_true(fabs(cells->cell_centers[0].z - 1.5) < 1e-14);
+  assert_int_equal(6, cells->cell_face_offsets[1]);
+  for (int k = 0; k < 6; ++k)
+  {
+    assert_int_equal(-1, cells->face_cells[k]);
+    assert_int_equal(k, cells->face_boundaries[k]);
+  }
+  restricted_voronoi_cells_free(cells);
+}
+
+static void test_box_cells(void** state)
+{
+  // The cells clipped to a box are those of the Voronoi mesh.
+  int num_generators = 1000;
+  point_t generators[num_generators];
+  bbox_t bbox = {.x1 = -1.0, .x2 = 1.0, .y1 = -1.0, .y2 = 1.0, .z1 = -1.0, .z2 = 1.0};
+  srand(1);
+  random_points(generators, num_generators, &bbox);
+  restricted_voronoi_cells_t* cells = restricted_voronoi_cells_new(generators, num_generators, &bbox, NULL, NULL, 0);
+  mesh_t* mesh = create_voronoi_mesh(MPI_COMM_SELF, generators, num_generators, &bbox);
+  for (int c = 0; c < num_generators; ++c)
+  {
+    assert_true(fabs(cells->cell_volumes[c] - mesh->cell_volumes[c]) < 1e-12);
+    assert_true(point_distance(&cells->cell_centers[c], &mesh->cell_centers[c]) < 1e-12);
+    for (int k = mesh->cell_face_offsets[c]; k < mesh->cell_face_offsets[c+1]; ++k)
+    {
+      int f = mesh->cell_faces[k];
+      if (f < 0)
+        f = ~f;
+      int d = (mesh->face_cells[2*f] == c) ? mesh->face_cells[2*f+1] : mesh->face_cells[2*f];
+      if (d >= 0)
+        assert_true(fabs(shared_area(cells, c, d) - mesh->face_areas[f]) < 1e-12);
+    }
+  }
+  for (int b = 0; b < 6; ++b)
+    assert_true(fabs(check_faces(cells, b) - 4.0) < 1e-12);
+  mesh_free(mesh);
+  restricted_voronoi_cells_free(cells);
+}
+
+static void test_cube_surface(void** state)
+{
+  // Restricting cells to the interior of a cube's surface is the same as 
+  // clipping them to the cube, whether or not their generators lie inside.
+  int cube[1][3] = {{0, 0, 0}};
+  point_t vertices[24];
+  int triangles[36];
+  int num_triangles = voxel_surface(cube, 1, vertices, triangles);
+  assert_int_equal(12, num_triangles);
+
+  int num_generators = 200;
+  point_t generators[num_generators];
+  bbox_t bbox = {.x1 = -0.5, .x2 = 1.5, .y1 = -0.5, .y2 = 1.5, .z1 = -0.5, .z2 = 1.5};
+  srand(2);
+  random_points(generators, num_generators, &bbox);
+  restricted_voronoi_cells_t* cells = restricted_voronoi_cells_new(generators, num_generators, &bbox, vertices, triangles, num_triangles);
+  bbox_t unit_box = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  restricted_voronoi_cells_t* clipped = restricted_voronoi_cells_new(generators, num_generators, &unit_box, NULL, NULL, 0);
+  for (int c = 0; c < num_generators; ++c)
+  {
+    assert_true(fabs(cells->cell_volumes[c] - clipped->cell_volumes[c]) < 1e-12);
+    if (clipped->cell_volumes[c] > 0.0)
+      assert_true(point_distance(&cells->cell_centers[c], &clipped->cell_centers[c]) < 1e-10);
+    real_t boundary_area = 0.0;
+    for (int k = clipped->cell_face_offsets[c]; k < clipped->cell_face_offsets[c+1]; ++k)
+    {
+      int d = clipped->face_cells[k];
+      if (d >= 0)
+        assert_true(fabs(shared_area(cells, c, d) - clipped->face_areas[k]) < 1e-12);
+      else
+        boundary_area += clipped->face_areas[k];
+    }
+    for (int k = cells->cell_face_offsets[c]; k < cells->cell_face_offsets[c+1]; ++k)
+    {
+      if (cells->face_cells[k] == -1)
+      {
+        assert_int_equal(RESTRICTED_VORONOI_SURFACE, cells->face_boundaries[k]);
+        boundary_area -= cells->face_areas[k];
+      }
+    }
+    assert_true(fabs(boundary_area) < 1e-12);
+  }
+  assert_true(fabs(check_faces(cells, RESTRICTED_VORONOI_SURFACE) - 6.0) < 1e-12);
+  restricted_voronoi_cells_free(clipped);
+  restricted_voronoi_cells_free(cells);
+}
+
+static void test_nonconvex_surface(void** state)
+{
+  // An L-shaped prism made of 3 unit cubes, with volume 3, surface area 14, 
+  // and centroid (5/6, 5/6, 1/2).
+  int voxels[3][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+  point_t vertices[72];
+  int triangles[108];
+  int num_triangles = voxel_surface(voxels, 3, vertices, triangles);
+  assert_int_equal(28, num_triangles);
+  bbox_t bbox = {.x1 = -0.5, .x2 = 2.5, .y1 = -0.5, .y2 = 2.5, .z1 = -0.5, .z2 = 1.5};
+
+  // One generator's cell is the whole prism.
+  point_t generator = {.x = 1.75, .y = 1.75, .z = 0.25};
+  restricted_voronoi_cells_t* cells = restricted_voronoi_cells_new(&generator, 1, &bbox, vertices, triangles, num_triangles);
+  assert_true(fabs(cells->cell_volumes[0] - 3.0) < 1e-12);
+  assert_true(fabs(cells->cell_centers[0].x - 5.0/6.0) < 1e-12);
+  assert_true(fabs(cells->cell_centers[0].y - 5.0/6.0) < 1e-12);
+  assert_true(fabs(cells->cell_centers[0].z - 0.5) < 1e-12);
+  assert_int_equal(1, cells->cell_face_offsets[1]);
+  assert_true(fabs(cells->face_areas[0] - 14.0) < 1e-12);
+  restricted_voronoi_cells_free(cells);
+
+  // Many generators' cells fill it.
+  int num_generators = 600;
+  point_t generators[num_generators];
+  srand(3);
+  random_points(generators, num_generators, &bbox);
+  cells = restricted_voronoi_cells_new(generators, num_generators, &bbox, vertices, triangles, num_triangles);
+  real_t volume = 0.0;
+  vector_t moment = {.x = 0.0, .y = 0.0, .z = 0.0};
+  for (int c = 0; c < num_generators; ++c)
+  {
+    real_t V = cells->cell_volumes[c];
+    volume += V;
+    moment.x += V * cells->cell_centers[c].x;
+    moment.y += V * cells->cell_centers[c].y;
+    moment.z += V * cells->cell_centers[c].z;
+  }
+  assert_true(fabs(volume - 3.0) < 1e-12);
+  assert_true(fabs(moment.x - 2.5) < 1e-12);
+  assert_true(fabs(moment.y - 2.5) < 1e-12);
+  assert_true(fabs(moment.z - 1.5) < 1e-12);
+  assert_true(fabs(check_faces(cells, RESTRICTED_VORONOI_SURFACE) - 14.0) < 1e-12);
+  for (int b = 0; b < 6; ++b)
+    assert_true(check_faces(cells, b) == 0.0);
+  restricted_voronoi_cells_free(cells);
+}
+
+static void test_outside_generators(void** state)
+{
+  // A box that cuts a unit cube's surface, so that segments from generators 
+  // outside the box to points inside it cross triangles outside it.
+  int cube[1][3] = {{0, 0, 0}};
+  point_t vertices[24];
+  int triangles[36];
+  int num_triangles = voxel_surface(cube, 1, vertices, triangles);
+  bbox_t bbox = {.x1 = 0.5, .x2 = 1.5, .y1 = -0.5, .y2 = 1.5, .z1 = -0.5, .z2 = 1.5};
+
+  // The cell of a lone generator is the part of the cube within the box.
+  point_t generator = {.x = -1.0, .y = 0.25, .z = 0.5};
+  restricted_voronoi_cells_t* cells = restricted_voronoi_cells_new(&generator, 1, &bbox, vertices, triangles, num_triangles);
+  assert_true(fabs(cells->cell_volumes[0] - 0.5) < 1e-12);
+  assert_true(fabs(cells->cell_centers[0].x - 0.75) < 1e-12);
+  assert_true(fabs(cells->cell_centers[0].y - 0.5) < 1e-12);
+  assert_true(fabs(cells->cell_centers[0].z - 0.5) < 1e-12);
+  assert_true(fabs(check_faces(cells, RESTRICTED_VORONOI_SURFACE) - 3.0) < 1e-12);
+  restricted_voronoi_cells_free(cells);
+
+  // Many generators, most of them outside the box, give the cells clipped 
+  // to the part of the cube within it.
+  int num_generators = 200;
+  point_t generators[num_generators];
+  bbox_t generator_box = {.x1 = -1.0, .x2 = 2.0, .y1 = -1.0, .y2 = 2.0, .z1 = -1.0, .z2 = 2.0};
+  srand(4);
+  random_points(generators, num_generators, &generator_box);
+  cells = restricted_voronoi_cells_new(generators, num_generators, &bbox, vertices, triangles, num_triangles);
+  bbox_t clip_box = {.x1 = 0.5, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  restricted_voronoi_cells_t* clipped = restricted_voronoi_cells_new(generators, num_generators, &clip_box, NULL, NULL, 0);
+  real_t volume = 0.0;
+  for (int c = 0; c < num_generators; ++c)
+  {
+    assert_true(fabs(cells->cell_volumes[c] - clipped->cell_volumes[c]) < 1e-12);
+    if (clipped->cell_volumes[c] > 0.0)
+      assert_true(point_distance(&cells->cell_centers[c], &clipped->cell_centers[c]) < 1e-10);
+    volume += cells->cell_volumes[c];
+  }
+  assert_true(fabs(volume - 0.5) < 1e-12);
+  assert_true(fabs(check_faces(cells, RESTRICTED_VORONOI_SURFACE) - 3.0) < 1e-12);
+  restricted_voronoi_cells_free(clipped);
+  restricted_voronoi_cells_free(cells);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_single_generator),
+    cmocka_unit_test(test_box_cells),
+    cmocka_unit_test(test_cube_surface),
+    cmocka_unit_test(test_nonconvex_surface),
+    cmocka_unit_test(test_outside_generators)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
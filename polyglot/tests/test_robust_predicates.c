@@ -0,0 +1,118 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdlib.h>
+#include "cmocka.h"
+#include "polyglot/robust_predicates.h"
+
+// Translates the given points by a large offset, which makes the floating
+// point evaluation of the predicates uncertain but keeps them exact.
+static void translate(point_t* x, int num_points)
+{
+  for (int i = 0; i < num_points; ++i)
+  {
+    x[i].x += 1048576.0;
+    x[i].y += 2097152.0;
+    x[i].z += 4194304.0;
+  }
+}
+
+static void test_orientation(void** state)
+{
+  point_t x[5] = {{0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
+                  {0.0, 0.0, 1.0}, {0.375, 0.25, 0.0}};
+  assert_true(robust_orientation(&x[0], &x[1], &x[2], &x[3]) > 0.0);
+  assert_true(robust_orientation(&x[1], &x[0], &x[2], &x[3]) < 0.0);
+  assert_true(robust_orientation(&x[0], &x[1], &x[2], &x[4]) == 0.0);
+
+  // Nearly coplanar points far from the origin.
+  x[3] = x[4];
+  x[3].z = 1.0 / 1024.0;
+  translate(x, 5);
+  assert_true(robust_orientation(&x[0], &x[1], &x[2], &x[3]) > 0.0);
+  assert_true(robust_orientation(&x[0], &x[2], &x[1], &x[3]) < 0.0);
+  assert_true(robust_orientation(&x[0], &x[1], &x[2], &x[4]) == 0.0);
+}
+
+static void test_in_sphere(void** state)
+{
+  // Points on the sphere of radius 5 centered at the origin.
+  point_t x[7] = {{5.0, 0.0, 0.0}, {0.0, 5.0, 0.0}, {0.0, 0.0, 5.0},
+                  {0.0, 0.0, -5.0}, {3.0, 4.0, 0.0}, {0.0, 0.0, 0.0},
+                  {0.0, 3.0, 4.0}};
+  if (robust_orientation(&x[0], &x[1], &x[2], &x[3]) < 0.0)
+  {
+    point_t tmp = x[0];
+    x[0] = x[1];
+    x[1] = tmp;
+  }
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    assert_true(robust_in_sphere(&x[0], &x[1], &x[2], &x[3], &x[4]) == 0.0);
+    assert_true(robust_in_sphere(&x[0], &x[1], &x[2], &x[3], &x[5]) > 0.0);
+    x[6].z += 1.0 / 1024.0;
+    assert_true(robust_in_sphere(&x[0], &x[1], &x[2], &x[3], &x[6]) < 0.0);
+    x[6].z -= 1.0 / 512.0;
+    assert_true(robust_in_sphere(&x[0], &x[1], &x[2], &x[3], &x[6]) > 0.0);
+    x[6].z += 1.0 / 1024.0;
+
+    // Now do it again far from the origin.
+    translate(x, 7);
+  }
+}
+
+static void test_batches(void** state)
+{
+  // Random points, some of which lie exactly on the planes and spheres of
+  // the others.
+  int num_tests = 100;
+  point_t x[5*num_tests];
+  srand(1);
+  for (int i = 0; i < 5*num_tests; ++i)
+  {
+    x[i].x = (real_t)(rand() % 8);
+    x[i].y = (real_t)(rand() % 8);
+    x[i].z = (real_t)(rand() % 8);
+  }
+  translate(x, 5*num_tests);
+
+  point_t *a[num_tests], *b[num_tests], *c[num_tests], *d[num_tests], *e[num_tests];
+  for (int i = 0; i < num_tests; ++i)
+  {
+    a[i] = &x[5*i];
+    b[i] = &x[5*i+1];
+    c[i] = &x[5*i+2];
+    d[i] = &x[5*i+3];
+    e[i] = &x[5*i+4];
+  }
+  real_t orientations[num_tests], in_spheres[num_tests];
+  robust_orientations(num_tests, a, b, c, d, orientations);
+  robust_in_spheres(num_tests, a, b, c, d, e, in_spheres);
+  for (int i = 0; i < num_tests; ++i)
+  {
+    real_t o = robust_orientation(a[i], b[i], c[i], d[i]);
+    assert_true(SIGN(orientations[i]) == SIGN(o));
+    real_t s = robust_in_sphere(a[i], b[i], c[i], d[i], e[i]);
+    assert_true(SIGN(in_spheres[i]) == SIGN(s));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_orientation),
+    cmocka_unit_test(test_in_sphere),
+    cmocka_unit_test(test_batches)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}